@@ -0,0 +1,13 @@
+using System.Runtime.InteropServices;
+
+namespace Performance.Normalization
+{
+    internal static class NativeMethods
+    {
+        [DllImport("Datadog.Trace.ClrProfiler.Native", CharSet = CharSet.Unicode)]
+        public static extern int ObfuscateSql(string sql, int length, char[] buffer, int bufferLength);
+
+        [DllImport("Datadog.Trace.ClrProfiler.Native", CharSet = CharSet.Unicode)]
+        public static extern int QuantizeUrl(char[] url, int length);
+    }
+}
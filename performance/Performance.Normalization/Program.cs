@@ -0,0 +1,25 @@
+using BenchmarkDotNet.Running;
+
+namespace Performance.Normalization
+{
+    class Program
+    {
+        public static void Main(string[] args)
+        {
+#if DEBUG
+            // smoke test every implementation without the benchmark harness
+            var sql = new SqlObfuscationBenchmarks();
+            sql.Setup();
+            sql.ManagedRegex();
+            sql.Native();
+
+            var urls = new UrlQuantizationBenchmarks();
+            urls.Setup();
+            urls.Managed();
+            urls.Native();
+#else
+            BenchmarkSwitcher.FromAssembly(typeof(Program).Assembly).Run(args);
+#endif
+        }
+    }
+}
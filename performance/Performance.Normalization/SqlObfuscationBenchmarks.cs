@@ -0,0 +1,93 @@
+using System;
+using System.IO;
+using System.Linq;
+using System.Text.RegularExpressions;
+using BenchmarkDotNet.Attributes;
+
+namespace Performance.Normalization
+{
+    /// <summary>
+    /// Compares a regular-expression obfuscator, the usual managed approach,
+    /// with the native ObfuscateSql export on the statements of sql_corpus.sql.
+    /// NativeUncached cycles through more distinct statements than the native
+    /// cache holds, so it measures the tokenizer itself.
+    /// </summary>
+    [MinColumn, MaxColumn]
+    [MarkdownExporter, CsvExporter]
+    [Config(typeof(DatadogBenchmarkConfig))]
+    public class SqlObfuscationBenchmarks
+    {
+        // larger than the native cache (kSqlCacheCapacity)
+        private const int UncachedVariants = 2048;
+
+        private static readonly Regex Comments = new Regex(@"--[^\n]*|/\*.*?\*/", RegexOptions.Compiled | RegexOptions.Singleline);
+        private static readonly Regex Literals = new Regex(@"N?'(?:[^']|'')*'|\$\$.*?\$\$|\b0x[0-9a-fA-F]+\b|\b\d+(?:\.\d*)?(?:[eE][+-]?\d+)?\b|(?<!@)@\w+|\$\d+|\b(?:TRUE|FALSE|NULL)\b", RegexOptions.Compiled | RegexOptions.IgnoreCase | RegexOptions.Singleline);
+        private static readonly Regex InLists = new Regex(@"\bIN\s*\(\s*\?(?:\s*,\s*\?)*\s*\)", RegexOptions.Compiled | RegexOptions.IgnoreCase);
+        private static readonly Regex Whitespace = new Regex(@"\s+", RegexOptions.Compiled);
+
+        private string[] _corpus;
+        private string[] _uncachedCorpus;
+        private char[] _buffer;
+        private int _next;
+
+        [GlobalSetup]
+        public void Setup()
+        {
+            var path = Path.Combine(AppContext.BaseDirectory, "sql_corpus.sql");
+            _corpus = File.ReadAllLines(path).Where(line => line.Length > 0).ToArray();
+
+            _uncachedCorpus = new string[UncachedVariants];
+            for (var i = 0; i < UncachedVariants; i++)
+            {
+                _uncachedCorpus[i] = _corpus[i % _corpus.Length] + " /* " + i + " */";
+            }
+
+            _buffer = new char[_uncachedCorpus.Max(sql => sql.Length)];
+        }
+
+        [Benchmark(Baseline = true)]
+        public int ManagedRegex()
+        {
+            var length = 0;
+
+            foreach (var sql in _corpus)
+            {
+                var result = Comments.Replace(sql, " ");
+                result = Literals.Replace(result, "?");
+                result = InLists.Replace(result, "IN (?)");
+                result = Whitespace.Replace(result, " ").Trim();
+                length += result.Length;
+            }
+
+            return length;
+        }
+
+        [Benchmark]
+        public int Native()
+        {
+            var length = 0;
+
+            foreach (var sql in _corpus)
+            {
+                length += NativeMethods.ObfuscateSql(sql, sql.Length, _buffer, _buffer.Length);
+            }
+
+            return length;
+        }
+
+        [Benchmark]
+        public int NativeUncached()
+        {
+            var length = 0;
+
+            for (var i = 0; i < _corpus.Length; i++)
+            {
+                var sql = _uncachedCorpus[_next];
+                _next = (_next + 1) % _uncachedCorpus.Length;
+                length += NativeMethods.ObfuscateSql(sql, sql.Length, _buffer, _buffer.Length);
+            }
+
+            return length;
+        }
+    }
+}
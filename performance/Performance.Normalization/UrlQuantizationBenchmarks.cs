@@ -0,0 +1,88 @@
+using System;
+using System.IO;
+using System.Linq;
+using BenchmarkDotNet.Attributes;
+using Datadog.Trace.Util;
+
+namespace Performance.Normalization
+{
+    /// <summary>
+    /// Compares the managed UriHelpers.GetRelativeUrl, used for ASP.NET Core
+    /// resource names today, with the native QuantizeUrl export on the URLs of
+    /// url_corpus.txt. NativeUncached cycles through more distinct URLs than
+    /// the per-thread native cache holds, which is closer to traffic with
+    /// unique ids in every request.
+    /// </summary>
+    [MinColumn, MaxColumn]
+    [MarkdownExporter, CsvExporter]
+    [Config(typeof(DatadogBenchmarkConfig))]
+    public class UrlQuantizationBenchmarks
+    {
+        // larger than the native cache (kUrlCacheCapacity)
+        private const int UncachedVariants = 512;
+
+        private string[] _corpus;
+        private string[] _uncachedCorpus;
+        private char[] _buffer;
+        private int _next;
+
+        [GlobalSetup]
+        public void Setup()
+        {
+            var path = Path.Combine(AppContext.BaseDirectory, "url_corpus.txt");
+            _corpus = File.ReadAllLines(path).Where(line => line.Length > 0).ToArray();
+
+            _uncachedCorpus = new string[UncachedVariants];
+            for (var i = 0; i < UncachedVariants; i++)
+            {
+                _uncachedCorpus[i] = _corpus[i % _corpus.Length].Split('?')[0].TrimEnd('/') + "/" + i;
+            }
+
+            // Native and NativeUncached copy every URL of both corpora into the buffer
+            _buffer = new char[_corpus.Concat(_uncachedCorpus).Max(url => url.Length)];
+        }
+
+        [Benchmark(Baseline = true)]
+        public int Managed()
+        {
+            var length = 0;
+
+            foreach (var url in _corpus)
+            {
+                length += UriHelpers.GetRelativeUrl(new Uri(url), tryRemoveIds: true).Length;
+            }
+
+            return length;
+        }
+
+        [Benchmark]
+        public int Native()
+        {
+            var length = 0;
+
+            foreach (var url in _corpus)
+            {
+                url.CopyTo(0, _buffer, 0, url.Length);
+                length += NativeMethods.QuantizeUrl(_buffer, url.Length);
+            }
+
+            return length;
+        }
+
+        [Benchmark]
+        public int NativeUncached()
+        {
+            var length = 0;
+
+            for (var i = 0; i < _corpus.Length; i++)
+            {
+                var url = _uncachedCorpus[_next];
+                _next = (_next + 1) % _uncachedCorpus.Length;
+                url.CopyTo(0, _buffer, 0, url.Length);
+                length += NativeMethods.QuantizeUrl(_buffer, url.Length);
+            }
+
+            return length;
+        }
+    }
+}
@@ -0,0 +1,25 @@
+SELECT * FROM users WHERE id = 42
+SELECT TOP 10 [Id], [Name], [Email] FROM [dbo].[Customers] WHERE [Country] = N'France' ORDER BY [Name]
+SELECT o.id, o.total FROM orders o JOIN customers c ON c.id = o.customer_id WHERE c.region = 'EMEA' AND o.created_at > '2019-01-01'
+INSERT INTO audit_log (user_id, action, payload, created_at) VALUES (1234, 'login', '{"ip":"10.0.0.1"}', '2020-02-03 10:11:12')
+UPDATE accounts SET balance = balance - 125.50, updated_at = CURRENT_TIMESTAMP WHERE id = 998877 AND balance >= 125.50
+DELETE FROM sessions WHERE expires_at < '2020-01-01 00:00:00' AND user_id IN (1, 2, 3, 4, 5, 6, 7, 8, 9, 10)
+SELECT * FROM products WHERE sku IN ('A-100', 'A-101', 'B-200', 'C-300', 'C-301', 'C-302') AND active = TRUE
+SELECT COUNT(*) FROM events WHERE tenant_id = @tenantId AND kind = @kind AND ts BETWEEN @from AND @to
+SELECT id, name FROM items WHERE price > $1 AND category = $2 LIMIT 50 OFFSET 100
+SELECT u.id, u.name, p.title FROM users u LEFT JOIN posts p ON p.user_id = u.id WHERE u.id IN (SELECT user_id FROM follows WHERE follower_id = 77) ORDER BY p.created_at DESC
+SELECT CAST(amount AS decimal(18, 2)), created::date FROM payments WHERE status = 'settled' AND amount > 0.01
+EXEC sp_executesql N'SELECT * FROM Orders WHERE OrderId = @p0', N'@p0 int', @p0 = 10248
+SELECT * FROM #temp_results WHERE score >= 0.75 AND label <> 'noise'
+WITH recent AS (SELECT * FROM logins WHERE ts > NOW() - INTERVAL '1 day') SELECT user_id, COUNT(*) FROM recent GROUP BY user_id HAVING COUNT(*) > 5
+SELECT /* dashboard query */ region, SUM(total)   FROM sales	WHERE year = 2019 AND quarter IN (1, 2) GROUP BY region -- per region
+INSERT INTO metrics (name, value, tags) VALUES ('cpu', 0.93, 'host:web-1'), ('mem', 0.71, 'host:web-1'), ('disk', 0.42, 'host:web-1')
+SELECT id FROM documents WHERE body LIKE '%invoice%' AND owner_id = 31337 AND deleted IS NULL
+SELECT * FROM "Users" WHERE "Email" = 'someone@example.com' AND "IsActive" = true
+UPDATE "Orders" SET "Status" = 'shipped', "ShippedAt" = '2020-03-04T05:06:07Z' WHERE "Id" = 'c0a8011e-5f3b-4d2a-9a4f-0e2b7c1d9f00'
+SELECT a.*, b.value FROM settings a INNER JOIN overrides b ON a.key = b.key AND b.env = 'production' WHERE a.version = 0x1F2E
+SELECT @@ROWCOUNT, @@IDENTITY
+SELECT $$it's a body$$ AS body, 1e-3 AS epsilon
+MERGE INTO inventory AS t USING (VALUES (101, 5), (102, 7)) AS s (item_id, qty) ON t.item_id = s.item_id WHEN MATCHED THEN UPDATE SET t.qty = t.qty + s.qty;
+SELECT name FROM sys.tables WHERE object_id = OBJECT_ID(N'[dbo].[__EFMigrationsHistory]')
+SELECT "m"."MigrationId", "m"."ProductVersion" FROM "__EFMigrationsHistory" AS "m" ORDER BY "m"."MigrationId"
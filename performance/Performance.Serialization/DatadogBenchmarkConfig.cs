@@ -0,0 +1,18 @@
+using BenchmarkDotNet.Configs;
+using BenchmarkDotNet.Diagnosers;
+using BenchmarkDotNet.Jobs;
+
+namespace Performance.Serialization
+{
+    public class DatadogBenchmarkConfig : ManualConfig
+    {
+        public DatadogBenchmarkConfig()
+        {
+            Add(MemoryDiagnoser.Default);
+            Add(new Job
+            {
+                Run = { LaunchCount = 1, WarmupCount = 3, IterationCount = 20 }
+            });
+        }
+    }
+}
@@ -0,0 +1,188 @@
+using System;
+using System.Collections.Generic;
+using System.Runtime.InteropServices;
+using Datadog.Trace;
+using Datadog.Trace.ExtensionMethods;
+
+namespace Performance.Serialization
+{
+    /// <summary>
+    /// Fills the blittable span structs expected by the native SerializeTraces
+    /// export. Must be kept in sync with trace_serializer.h.
+    /// </summary>
+    internal unsafe class NativeTraceSerializer
+    {
+        private readonly List<GCHandle> _pinnedStrings = new List<GCHandle>();
+
+        private NativeSpan[] _spans = new NativeSpan[64];
+        private NativeTag[] _tags = new NativeTag[256];
+        private NativeMetric[] _metrics = new NativeMetric[128];
+        private int[] _traceSizes = new int[16];
+
+        public int Serialize(IList<List<Span>> traces)
+        {
+            var spanCount = 0;
+            var tagCount = 0;
+            var metricCount = 0;
+
+            if (_traceSizes.Length < traces.Count)
+            {
+                _traceSizes = new int[traces.Count * 2];
+            }
+
+            for (var t = 0; t < traces.Count; t++)
+            {
+                _traceSizes[t] = traces[t].Count;
+
+                foreach (var span in traces[t])
+                {
+                    spanCount++;
+                    tagCount += span.Tags.Count;
+                    metricCount += span.Metrics.Count;
+                }
+            }
+
+            Grow(ref _spans, spanCount);
+            Grow(ref _tags, tagCount);
+            Grow(ref _metrics, metricCount);
+
+            try
+            {
+                var spanIndex = 0;
+                var tagIndex = 0;
+                var metricIndex = 0;
+
+                foreach (var trace in traces)
+                {
+                    foreach (var span in trace)
+                    {
+                        ref var native = ref _spans[spanIndex++];
+                        native.TraceId = span.TraceId;
+                        native.SpanId = span.SpanId;
+                        native.ParentId = span.Context.ParentId ?? 0;
+                        native.Start = span.StartTime.ToUnixTimeNanoseconds();
+                        native.Duration = span.Duration.ToNanoseconds();
+                        native.Name = Pin(span.OperationName);
+                        native.Resource = Pin(span.ResourceName);
+                        native.Service = Pin(span.ServiceName);
+                        native.Type = Pin(span.Type);
+                        native.Error = span.Error ? 1 : 0;
+
+                        // offsets for now, turned into pointers once the arrays are fixed
+                        native.Tags = (NativeTag*)tagIndex;
+                        native.TagCount = span.Tags.Count;
+                        native.Metrics = (NativeMetric*)metricIndex;
+                        native.MetricCount = span.Metrics.Count;
+
+                        foreach (var tag in span.Tags)
+                        {
+                            _tags[tagIndex].Key = Pin(tag.Key);
+                            _tags[tagIndex].Value = Pin(tag.Value);
+                            tagIndex++;
+                        }
+
+                        foreach (var metric in span.Metrics)
+                        {
+                            _metrics[metricIndex].Key = Pin(metric.Key);
+                            _metrics[metricIndex].Value = metric.Value;
+                            metricIndex++;
+                        }
+                    }
+                }
+
+                fixed (NativeSpan* spans = _spans)
+                fixed (NativeTag* tags = _tags)
+                fixed (NativeMetric* metrics = _metrics)
+                fixed (int* traceSizes = _traceSizes)
+                {
+                    for (var i = 0; i < spanCount; i++)
+                    {
+                        spans[i].Tags = tags + (long)spans[i].Tags;
+                        spans[i].Metrics = metrics + (long)spans[i].Metrics;
+                    }
+
+                    return SerializeTraces(spans, traceSizes, traces.Count, out _);
+                }
+            }
+            finally
+            {
+                foreach (var handle in _pinnedStrings)
+                {
+                    handle.Free();
+                }
+
+                _pinnedStrings.Clear();
+            }
+        }
+
+        [DllImport("Datadog.Trace.ClrProfiler.Native")]
+        private static extern int SerializeTraces(NativeSpan* spans, int* traceSizes, int traceCount, out IntPtr payload);
+
+        private static void Grow<T>(ref T[] array, int count)
+        {
+            if (array.Length < count)
+            {
+                array = new T[Math.Max(count, array.Length * 2)];
+            }
+        }
+
+        private NativeString Pin(string value)
+        {
+            if (value == null)
+            {
+                return default;
+            }
+
+            var handle = GCHandle.Alloc(value, GCHandleType.Pinned);
+            _pinnedStrings.Add(handle);
+
+            return new NativeString
+            {
+                Chars = (char*)handle.AddrOfPinnedObject(),
+                Length = value.Length
+            };
+        }
+
+        [StructLayout(LayoutKind.Sequential)]
+        private struct NativeString
+        {
+            public char* Chars;
+            public int Length;
+            public int Reserved;
+        }
+
+        [StructLayout(LayoutKind.Sequential)]
+        private struct NativeTag
+        {
+            public NativeString Key;
+            public NativeString Value;
+        }
+
+        [StructLayout(LayoutKind.Sequential)]
+        private struct NativeMetric
+        {
+            public NativeString Key;
+            public double Value;
+        }
+
+        [StructLayout(LayoutKind.Sequential)]
+        private struct NativeSpan
+        {
+            public ulong TraceId;
+            public ulong SpanId;
+            public ulong ParentId;
+            public long Start;
+            public long Duration;
+            public NativeString Name;
+            public NativeString Resource;
+            public NativeString Service;
+            public NativeString Type;
+            public NativeTag* Tags;
+            public NativeMetric* Metrics;
+            public int TagCount;
+            public int MetricCount;
+            public int Error;
+            public int Reserved;
+        }
+    }
+}
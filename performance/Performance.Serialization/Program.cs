@@ -0,0 +1,20 @@
+using BenchmarkDotNet.Running;
+
+namespace Performance.Serialization
+{
+    class Program
+    {
+        public static void Main(string[] args)
+        {
+#if DEBUG
+            // smoke test both serializers without the benchmark harness
+            var benchmarks = new SerializationBenchmarks();
+            benchmarks.Setup();
+            benchmarks.Managed();
+            benchmarks.Native();
+#else
+            BenchmarkRunner.Run<SerializationBenchmarks>();
+#endif
+        }
+    }
+}
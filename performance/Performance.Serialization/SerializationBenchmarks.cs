@@ -0,0 +1,104 @@
+using System;
+using System.Collections.Generic;
+using System.IO;
+using BenchmarkDotNet.Attributes;
+using Datadog.Trace;
+using Datadog.Trace.Agent;
+using MsgPack.Serialization;
+
+namespace Performance.Serialization
+{
+    /// <summary>
+    /// Compares the managed SpanMessagePackSerializer with the native
+    /// SerializeTraces export on the same v0.4 payload. The native benchmark
+    /// includes the cost of pinning strings and filling the blittable span array.
+    /// </summary>
+    [MinColumn, MaxColumn]
+    [MarkdownExporter, CsvExporter]
+    [Config(typeof(DatadogBenchmarkConfig))]
+    public class SerializationBenchmarks
+    {
+        private IList<List<Span>> _traces;
+        private MessagePackSerializer<IList<List<Span>>> _managedSerializer;
+        private MemoryStream _stream;
+        private NativeTraceSerializer _nativeSerializer;
+
+        [Params(1, 10, 100)]
+        public int TraceCount { get; set; } = 10;
+
+        [Params(10)]
+        public int SpansPerTrace { get; set; } = 10;
+
+        [GlobalSetup]
+        public void Setup()
+        {
+            var context = new SerializationContext();
+            var spanSerializer = new SpanMessagePackSerializer(context);
+            context.ResolveSerializer += (sender, eventArgs) =>
+            {
+                if (eventArgs.TargetType == typeof(Span))
+                {
+                    eventArgs.SetSerializer(spanSerializer);
+                }
+            };
+
+            _managedSerializer = context.GetSerializer<IList<List<Span>>>();
+            _stream = new MemoryStream();
+            _nativeSerializer = new NativeTraceSerializer();
+            _traces = CreateTraces(TraceCount, SpansPerTrace);
+        }
+
+        [Benchmark(Baseline = true)]
+        public long Managed()
+        {
+            _stream.SetLength(0);
+            _managedSerializer.Pack(_stream, _traces);
+            return _stream.Length;
+        }
+
+        [Benchmark]
+        public int Native()
+        {
+            return _nativeSerializer.Serialize(_traces);
+        }
+
+        private static IList<List<Span>> CreateTraces(int traceCount, int spansPerTrace)
+        {
+            var start = DateTimeOffset.UtcNow;
+            var traces = new List<List<Span>>(traceCount);
+
+            for (var t = 0; t < traceCount; t++)
+            {
+                var trace = new List<Span>(spansPerTrace);
+                var root = new SpanContext((ulong)t + 1, 1, SamplingPriority.AutoKeep, "web-service");
+
+                for (var s = 0; s < spansPerTrace; s++)
+                {
+                    var context = s == 0
+                                      ? root
+                                      : new SpanContext(root, null, "web-service");
+
+                    var span = new Span(context, start)
+                    {
+                        OperationName = s == 0 ? "aspnet_core.request" : "http.request",
+                        ResourceName = "GET /api/users/?/orders",
+                        Type = SpanTypes.Web
+                    };
+
+                    span.SetTag(Tags.HttpMethod, "GET");
+                    span.SetTag(Tags.HttpUrl, "https://example.com/api/users/" + t + "/orders?page=" + s);
+                    span.SetTag(Tags.HttpStatusCode, "200");
+                    span.SetTag("env", "prod");
+                    span.SetMetric(Metrics.SamplingPriority, 1);
+                    span.SetMetric("_dd.agent_psr", 1.0);
+
+                    trace.Add(span);
+                }
+
+                traces.Add(trace);
+            }
+
+            return traces;
+        }
+    }
+}
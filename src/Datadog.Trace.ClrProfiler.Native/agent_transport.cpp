@@ -0,0 +1,717 @@
+// winsock2.h must be included before windows.h, which the other headers pull
+// in on Windows
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+#include "agent_transport.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#include "logging.h"
+#include "msgpack_writer.h"
+#include "version.h"
+
+namespace trace {
+
+namespace {
+
+#ifdef _WIN32
+typedef SOCKET socket_t;
+const socket_t kInvalidSocket = INVALID_SOCKET;
+
+void CloseSocket(socket_t socket) { closesocket(socket); }
+
+bool SetBlocking(socket_t socket, bool blocking) {
+  u_long non_blocking = blocking ? 0 : 1;
+  return ioctlsocket(socket, FIONBIO, &non_blocking) == 0;
+}
+
+bool WaitWritable(socket_t socket, int timeout_ms) {
+  WSAPOLLFD fd = {socket, POLLOUT, 0};
+  return WSAPoll(&fd, 1, timeout_ms) == 1;
+}
+
+bool ConnectInProgress() {
+  return WSAGetLastError() == WSAEWOULDBLOCK;
+}
+
+void SetTimeouts(socket_t socket, uint64_t timeout_ms) {
+  const DWORD timeout = static_cast<DWORD>(timeout_ms);
+  setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO,
+             reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+  setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO,
+             reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+}
+
+const int kSendFlags = 0;
+#else
+typedef int socket_t;
+const socket_t kInvalidSocket = -1;
+
+void CloseSocket(socket_t socket) { close(socket); }
+
+bool SetBlocking(socket_t socket, bool blocking) {
+  const int flags = fcntl(socket, F_GETFL, 0);
+  if (flags < 0) {
+    return false;
+  }
+  return fcntl(socket, F_SETFL,
+               blocking ? (flags & ~O_NONBLOCK) : (flags | O_NONBLOCK)) == 0;
+}
+
+bool WaitWritable(socket_t socket, int timeout_ms) {
+  pollfd fd = {socket, POLLOUT, 0};
+  return poll(&fd, 1, timeout_ms) == 1;
+}
+
+bool ConnectInProgress() { return errno == EINPROGRESS; }
+
+void SetTimeouts(socket_t socket, uint64_t timeout_ms) {
+  timeval timeout;
+  timeout.tv_sec = static_cast<time_t>(timeout_ms / 1000);
+  timeout.tv_usec = static_cast<suseconds_t>((timeout_ms % 1000) * 1000);
+  setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+}
+
+// don't raise SIGPIPE when the agent closed the connection
+const int kSendFlags = MSG_NOSIGNAL;
+#endif
+
+// ConnectWithTimeout connects socket without blocking longer than
+// kAgentTimeout, then puts it back in blocking mode.
+bool ConnectWithTimeout(socket_t socket, const sockaddr* address,
+                        socklen_t address_length) {
+  if (!SetBlocking(socket, false)) {
+    return false;
+  }
+
+  if (connect(socket, address, address_length) != 0) {
+    if (!ConnectInProgress() ||
+        !WaitWritable(socket, static_cast<int>(kAgentTimeout))) {
+      return false;
+    }
+
+    int error = 0;
+    socklen_t error_length = sizeof(error);
+    if (getsockopt(socket, SOL_SOCKET, SO_ERROR,
+                   reinterpret_cast<char*>(&error), &error_length) != 0 ||
+        error != 0) {
+      return false;
+    }
+  }
+
+  SetTimeouts(socket, kAgentTimeout);
+  return SetBlocking(socket, true);
+}
+
+bool StartsWithIgnoreCase(const std::string& str, const char* prefix) {
+  const auto length = std::strlen(prefix);
+  if (str.size() < length) {
+    return false;
+  }
+
+  for (size_t i = 0; i < length; i++) {
+    if (std::tolower(static_cast<unsigned char>(str[i])) !=
+        std::tolower(static_cast<unsigned char>(prefix[i]))) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// the agent's responses are small json documents: a larger chunk means the
+// stream is out of sync
+const size_t kMaxResponseChunkSize = 1 << 20;
+
+bool IsSuccessStatus(int status) { return status >= 200 && status < 300; }
+
+// connection errors (-1), timeouts, rate limiting and agent errors may pass
+// on a later attempt; any other client error would be rejected again
+bool IsRetryableStatus(int status) {
+  return status < 0 || status == 408 || status == 429 || status >= 500;
+}
+
+}  // namespace
+
+// AgentConnection is one kept-alive HTTP/1.1 connection to the agent. It is
+// only used by the flush thread.
+class AgentConnection {
+ private:
+  AgentEndpoint endpoint_;
+  socket_t socket_ = kInvalidSocket;
+
+  // bytes received after the end of the previous response
+  std::string pending_;
+
+  bool Receive();
+
+  // ReadLine returns the position of the CRLF ending the line that starts at
+  // position, receiving more bytes as needed, or npos if the connection
+  // failed.
+  size_t ReadLine(size_t position);
+
+  // ReadChunkedBody decodes a chunked body starting at position into body.
+  // Returns the position just past it, trailers included, or npos if the
+  // connection failed or the framing is invalid.
+  size_t ReadChunkedBody(size_t position, std::string* body);
+
+ public:
+  explicit AgentConnection(const AgentEndpoint& endpoint)
+      : endpoint_(endpoint) {}
+
+  ~AgentConnection() { Close(); }
+
+  bool IsOpen() const { return socket_ != kInvalidSocket; }
+
+  bool Open();
+  void Close();
+  bool Send(const char* data, size_t size);
+
+  // ReadResponse reads one HTTP response. Returns its status code, or -1 if
+  // the connection failed. The connection is closed if the agent asked for
+  // it.
+  int ReadResponse(std::string* body);
+};
+
+bool AgentConnection::Open() {
+  Close();
+
+#ifndef _WIN32
+  if (!endpoint_.unix_socket.empty()) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (endpoint_.unix_socket.size() >= sizeof(address.sun_path)) {
+      return false;
+    }
+    std::memcpy(address.sun_path, endpoint_.unix_socket.c_str(),
+                endpoint_.unix_socket.size() + 1);
+
+    socket_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (socket_ == kInvalidSocket) {
+      return false;
+    }
+
+    if (!ConnectWithTimeout(socket_, reinterpret_cast<sockaddr*>(&address),
+                            sizeof(address))) {
+      Close();
+      return false;
+    }
+
+    return true;
+  }
+#endif
+
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_protocol = IPPROTO_TCP;
+
+  addrinfo* addresses = nullptr;
+  const auto port = std::to_string(endpoint_.port);
+  if (getaddrinfo(endpoint_.host.c_str(), port.c_str(), &hints, &addresses) !=
+      0) {
+    return false;
+  }
+
+  for (auto address = addresses; address != nullptr;
+       address = address->ai_next) {
+    socket_ = socket(address->ai_family, address->ai_socktype,
+                     address->ai_protocol);
+    if (socket_ == kInvalidSocket) {
+      continue;
+    }
+
+    if (ConnectWithTimeout(socket_, address->ai_addr,
+                           static_cast<socklen_t>(address->ai_addrlen))) {
+      const int no_delay = 1;
+      setsockopt(socket_, IPPROTO_TCP, TCP_NODELAY,
+                 reinterpret_cast<const char*>(&no_delay), sizeof(no_delay));
+      break;
+    }
+
+    Close();
+  }
+
+  freeaddrinfo(addresses);
+  return IsOpen();
+}
+
+void AgentConnection::Close() {
+  if (socket_ != kInvalidSocket) {
+    CloseSocket(socket_);
+    socket_ = kInvalidSocket;
+  }
+  pending_.clear();
+}
+
+bool AgentConnection::Send(const char* data, size_t size) {
+  while (size > 0) {
+    const auto chunk = static_cast<int>(std::min<size_t>(size, 1 << 20));
+    const auto sent = send(socket_, data, chunk, kSendFlags);
+    if (sent <= 0) {
+      Close();
+      return false;
+    }
+
+    data += sent;
+    size -= static_cast<size_t>(sent);
+  }
+
+  return true;
+}
+
+bool AgentConnection::Receive() {
+  char buffer[4096];
+  const auto received = recv(socket_, buffer, sizeof(buffer), 0);
+  if (received <= 0) {
+    return false;
+  }
+
+  pending_.append(buffer, static_cast<size_t>(received));
+  return true;
+}
+
+size_t AgentConnection::ReadLine(size_t position) {
+  size_t line_end;
+  while ((line_end = pending_.find("\r\n", position)) == std::string::npos) {
+    if (!Receive()) {
+      return std::string::npos;
+    }
+  }
+
+  return line_end;
+}
+
+size_t AgentConnection::ReadChunkedBody(size_t position, std::string* body) {
+  body->clear();
+
+  while (true) {
+    // "<hex size>[;extensions]\r\n<data>\r\n"
+    const auto line_end = ReadLine(position);
+    if (line_end == std::string::npos) {
+      return std::string::npos;
+    }
+
+    const char* size_start = pending_.c_str() + position;
+    char* size_end = nullptr;
+    const auto chunk_size = std::strtoul(size_start, &size_end, 16);
+    if (size_end == size_start || chunk_size > kMaxResponseChunkSize) {
+      return std::string::npos;
+    }
+    position = line_end + 2;
+
+    if (chunk_size == 0) {
+      break;
+    }
+
+    while (pending_.size() < position + chunk_size + 2) {
+      if (!Receive()) {
+        return std::string::npos;
+      }
+    }
+    if (pending_.compare(position + chunk_size, 2, "\r\n") != 0) {
+      return std::string::npos;
+    }
+
+    body->append(pending_, position, chunk_size);
+    position += chunk_size + 2;
+  }
+
+  // trailers, up to an empty line
+  while (true) {
+    const auto line_end = ReadLine(position);
+    if (line_end == std::string::npos) {
+      return std::string::npos;
+    }
+
+    const bool empty = line_end == position;
+    position = line_end + 2;
+    if (empty) {
+      return position;
+    }
+  }
+}
+
+int AgentConnection::ReadResponse(std::string* body) {
+  size_t headers_end;
+  while ((headers_end = pending_.find("\r\n\r\n")) == std::string::npos) {
+    if (!Receive()) {
+      Close();
+      return -1;
+    }
+  }
+
+  // "HTTP/1.1 200 OK"
+  const auto status_start = pending_.find(' ');
+  if (status_start == std::string::npos || status_start > headers_end) {
+    Close();
+    return -1;
+  }
+  const int status = std::atoi(pending_.c_str() + status_start + 1);
+
+  size_t content_length = 0;
+  bool has_content_length = false;
+  bool chunked = false;
+  bool close_connection = false;
+
+  size_t line_start = pending_.find("\r\n") + 2;
+  while (line_start < headers_end) {
+    auto line_end = pending_.find("\r\n", line_start);
+    const auto line = pending_.substr(line_start, line_end - line_start);
+
+    if (StartsWithIgnoreCase(line, "content-length:")) {
+      content_length = std::strtoul(line.c_str() + 15, nullptr, 10);
+      has_content_length = true;
+    } else if (StartsWithIgnoreCase(line, "transfer-encoding:") &&
+               line.find("chunked") != std::string::npos) {
+      chunked = true;
+    } else if (StartsWithIgnoreCase(line, "connection:") &&
+               line.find("close") != std::string::npos) {
+      close_connection = true;
+    }
+
+    line_start = line_end + 2;
+  }
+
+  const auto body_start = headers_end + 4;
+
+  if (chunked) {
+    // chunked takes precedence over a content length
+    const auto body_end = ReadChunkedBody(body_start, body);
+    if (body_end == std::string::npos) {
+      Close();
+      return -1;
+    }
+    pending_.erase(0, body_end);
+  } else if (has_content_length) {
+    while (pending_.size() < body_start + content_length) {
+      if (!Receive()) {
+        Close();
+        return -1;
+      }
+    }
+    body->assign(pending_, body_start, content_length);
+    pending_.erase(0, body_start + content_length);
+  } else {
+    // no length: the body ends when the agent closes the connection
+    while (Receive()) {
+    }
+    body->assign(pending_, body_start, std::string::npos);
+    pending_.clear();
+    close_connection = true;
+  }
+
+  if (close_connection) {
+    Close();
+  }
+
+  return status;
+}
+
+size_t ReadMessagePackArrayHeader(const uint8_t* data, size_t size,
+                                  uint32_t* count) {
+  if (data == nullptr || size == 0) {
+    return 0;
+  }
+
+  if ((data[0] & 0xF0) == 0x90) {
+    *count = data[0] & 0x0F;
+    return 1;
+  }
+
+  // array 16 and array 32 lengths are big-endian
+  if (data[0] == 0xDC && size >= 3) {
+    *count = (static_cast<uint32_t>(data[1]) << 8) | data[2];
+    return 3;
+  }
+
+  if (data[0] == 0xDD && size >= 5) {
+    *count = (static_cast<uint32_t>(data[1]) << 24) |
+             (static_cast<uint32_t>(data[2]) << 16) |
+             (static_cast<uint32_t>(data[3]) << 8) | data[4];
+    return 5;
+  }
+
+  return 0;
+}
+
+AgentTransport::AgentTransport() = default;
+
+AgentTransport::~AgentTransport() { Stop(); }
+
+void AgentTransport::Configure(const AgentEndpoint& endpoint) {
+  endpoint_ = endpoint;
+}
+
+bool AgentTransport::Enqueue(const uint8_t* payload, size_t size) {
+  // the batch header is rewritten from the counts, take them from the
+  // payload itself rather than trusting the caller
+  uint32_t trace_count = 0;
+  const auto header_size =
+      ReadMessagePackArrayHeader(payload, size, &trace_count);
+  if (header_size == 0) {
+    return false;
+  }
+
+  std::unique_lock<std::mutex> lock(queue_lock_);
+
+  const auto traces_size = size - header_size;
+  if (stop_requested_ || queued_bytes_ + traces_size > kMaxQueuedTraceBytes) {
+    lock.unlock();
+    dropped_traces_.fetch_add(trace_count, std::memory_order_relaxed);
+    return false;
+  }
+
+  if (!started_) {
+    started_ = true;
+
+#ifdef _WIN32
+    WSADATA wsa_data;
+    WSAStartup(MAKEWORD(2, 2), &wsa_data);
+#endif
+
+    flusher_ = std::thread(&AgentTransport::FlushLoop, this);
+
+    if (endpoint_.unix_socket.empty()) {
+      Info("Sending traces to http://", endpoint_.host, ":",
+           static_cast<uint64_t>(endpoint_.port));
+    } else {
+      Info("Sending traces to unix://", endpoint_.unix_socket);
+    }
+  }
+
+  // keep only the traces, the array header is rewritten for the whole batch
+  Payload queued;
+  queued.bytes.assign(payload + header_size, payload + size);
+  queued.trace_count = trace_count;
+
+  queued_bytes_ += traces_size;
+  queued_traces_ += trace_count;
+  queue_.push_back(std::move(queued));
+
+  if (queued_bytes_ >= kMaxTraceBatchBytes) {
+    flush_requested_ = true;
+    lock.unlock();
+    queue_signal_.notify_one();
+  }
+
+  return true;
+}
+
+void AgentTransport::Flush() {
+  {
+    std::lock_guard<std::mutex> guard(queue_lock_);
+    flush_requested_ = true;
+  }
+  queue_signal_.notify_one();
+}
+
+void AgentTransport::Stop() {
+  {
+    std::lock_guard<std::mutex> guard(queue_lock_);
+    stop_requested_ = true;
+  }
+  queue_signal_.notify_one();
+
+  if (flusher_.joinable()) {
+    flusher_.join();
+  }
+}
+
+void AgentTransport::FlushLoop() {
+  connection_.reset(new AgentConnection(endpoint_));
+
+  std::unique_lock<std::mutex> lock(queue_lock_);
+
+  while (true) {
+    queue_signal_.wait_for(lock, std::chrono::milliseconds(kTraceFlushInterval),
+                           [this] {
+                             return flush_requested_ || stop_requested_;
+                           });
+    flush_requested_ = false;
+
+    const bool stopping = stop_requested_;
+
+    // take up to one batch, the payloads stay counted in queued_bytes_ until
+    // they are sent or dropped so memory stays bounded
+    std::vector<Payload> batch;
+    size_t batch_bytes = 0;
+    while (!queue_.empty() &&
+           (batch.empty() ||
+            batch_bytes + queue_.front().bytes.size() <= kMaxTraceBatchBytes)) {
+      batch_bytes += queue_.front().bytes.size();
+      batch.push_back(std::move(queue_.front()));
+      queue_.pop_front();
+    }
+
+    const bool more = !queue_.empty();
+
+    if (!batch.empty()) {
+      lock.unlock();
+      SendBatch(batch, stopping);
+      lock.lock();
+    }
+
+    if (stopping && !more) {
+      break;
+    }
+
+    if (more) {
+      flush_requested_ = true;
+    }
+  }
+
+  connection_.reset();
+}
+
+void AgentTransport::SendBatch(std::vector<Payload>& batch,
+                               bool final_attempt) {
+  uint32_t trace_count = 0;
+  size_t bytes = 0;
+  for (const auto& payload : batch) {
+    trace_count += payload.trace_count;
+    bytes += payload.bytes.size();
+  }
+
+  MessagePackWriter header;
+  header.WriteArrayHeader(trace_count);
+
+  std::vector<uint8_t> body;
+  body.reserve(header.Size() + bytes);
+  body.insert(body.end(), header.Data(), header.Data() + header.Size());
+  for (const auto& payload : batch) {
+    body.insert(body.end(), payload.bytes.begin(), payload.bytes.end());
+  }
+
+  const int attempts = final_attempt ? 1 : kMaxTraceSendAttempts;
+  auto delay = kTraceRetryDelay;
+  bool sent = false;
+
+  for (int attempt = 1; attempt <= attempts; attempt++) {
+    const auto status = Post(body, trace_count);
+    if (IsSuccessStatus(status)) {
+      sent = true;
+      break;
+    }
+
+    if (!IsRetryableStatus(status)) {
+      break;
+    }
+
+    if (attempt < attempts) {
+      retries_.fetch_add(1, std::memory_order_relaxed);
+
+      std::unique_lock<std::mutex> lock(queue_lock_);
+      queue_signal_.wait_for(lock, std::chrono::milliseconds(delay),
+                             [this] { return stop_requested_; });
+      if (stop_requested_) {
+        // one last try below rather than the whole back-off
+        attempt = attempts - 1;
+      }
+      delay *= 2;
+    }
+  }
+
+  if (sent) {
+    sent_traces_.fetch_add(trace_count, std::memory_order_relaxed);
+  } else {
+    failed_traces_.fetch_add(trace_count, std::memory_order_relaxed);
+    Warn("Unable to send ", static_cast<uint64_t>(trace_count),
+         " traces to the agent, dropping them.");
+  }
+
+  std::lock_guard<std::mutex> guard(queue_lock_);
+  for (const auto& payload : batch) {
+    queued_bytes_ -= std::min<uint64_t>(queued_bytes_, payload.bytes.size());
+    queued_traces_ -= std::min<uint64_t>(queued_traces_, payload.trace_count);
+  }
+}
+
+int AgentTransport::Post(const std::vector<uint8_t>& body,
+                         uint32_t trace_count) {
+  if (!connection_->IsOpen() && !connection_->Open()) {
+    return -1;
+  }
+
+  std::string request;
+  request.reserve(512);
+  request += "POST /v0.4/traces HTTP/1.1\r\n";
+  request += "Host: ";
+  request += endpoint_.unix_socket.empty() ? endpoint_.host : "localhost";
+  request += "\r\n";
+  request += "Content-Type: application/msgpack\r\n";
+  request += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+  request += "X-Datadog-Trace-Count: " + std::to_string(trace_count) + "\r\n";
+  request += "Datadog-Meta-Lang: .NET\r\n";
+  request += "Datadog-Meta-Tracer-Version: ";
+  request += PROFILER_VERSION;
+  request += "\r\n";
+  request += "Connection: keep-alive\r\n\r\n";
+
+  requests_.fetch_add(1, std::memory_order_relaxed);
+
+  if (!connection_->Send(request.data(), request.size()) ||
+      !connection_->Send(reinterpret_cast<const char*>(body.data()),
+                         body.size())) {
+    return -1;
+  }
+
+  std::string response;
+  const auto status = connection_->ReadResponse(&response);
+  if (status < 0) {
+    return -1;
+  }
+
+  last_status_code_.store(status, std::memory_order_relaxed);
+
+  if (IsSuccessStatus(status)) {
+    std::lock_guard<std::mutex> guard(response_lock_);
+    last_response_ = std::move(response);
+  }
+
+  return status;
+}
+
+AgentTransportStats AgentTransport::GetStats() {
+  AgentTransportStats stats{};
+  {
+    std::lock_guard<std::mutex> guard(queue_lock_);
+    stats.queued_traces = queued_traces_;
+    stats.queued_bytes = queued_bytes_;
+  }
+
+  stats.sent_traces = sent_traces_.load(std::memory_order_relaxed);
+  stats.requests = requests_.load(std::memory_order_relaxed);
+  stats.dropped_traces = dropped_traces_.load(std::memory_order_relaxed);
+  stats.failed_traces = failed_traces_.load(std::memory_order_relaxed);
+  stats.retries = retries_.load(std::memory_order_relaxed);
+  stats.last_status_code = last_status_code_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+std::string AgentTransport::LastResponse() {
+  std::lock_guard<std::mutex> guard(response_lock_);
+  return last_response_;
+}
+
+}  // namespace trace
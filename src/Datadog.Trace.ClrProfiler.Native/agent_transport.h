@@ -0,0 +1,155 @@
+#ifndef DD_CLR_PROFILER_AGENT_TRANSPORT_H_
+#define DD_CLR_PROFILER_AGENT_TRANSPORT_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace trace {
+
+const uint16_t kDefaultAgentPort = 8126;
+
+// Maximum number of payload bytes waiting to be sent, including the batch
+// being sent. New payloads are rejected once it is reached.
+const size_t kMaxQueuedTraceBytes = 16 * 1024 * 1024;
+
+// A batch is sent as soon as this many bytes are queued, without waiting for
+// the flush interval.
+const size_t kMaxTraceBatchBytes = 4 * 1024 * 1024;
+
+// Time between two flushes, in milliseconds. Matches the managed AgentWriter.
+const uint64_t kTraceFlushInterval = 1000;
+
+// Attempts per batch before it is dropped, with exponential back-off starting
+// at kTraceRetryDelay milliseconds. Matches the managed Api. Only connection
+// errors, 408, 429 and 5xx responses are retried: a batch rejected with
+// another status is dropped at once.
+const int kMaxTraceSendAttempts = 5;
+const uint64_t kTraceRetryDelay = 100;
+
+// Connect, send and receive timeout, in milliseconds.
+const uint64_t kAgentTimeout = 10000;
+
+// AgentEndpoint is where traces are sent: a Unix domain socket if
+// unix_socket is set, TCP to host:port otherwise.
+struct AgentEndpoint {
+  std::string host = "localhost";
+  uint16_t port = kDefaultAgentPort;
+  std::string unix_socket;
+};
+
+// AgentTransportStats is a snapshot of the transport counters, handed to
+// managed code by GetTraceTransportStats in interop.cpp. It is blittable:
+// keep its layout in sync with the managed definition.
+struct AgentTransportStats {
+  uint64_t queued_traces;
+  uint64_t queued_bytes;
+  uint64_t sent_traces;
+  uint64_t requests;
+  // rejected because the queue was full
+  uint64_t dropped_traces;
+  // dropped after kMaxTraceSendAttempts failed attempts, or rejected by the
+  // agent with a status that is not retried
+  uint64_t failed_traces;
+  uint64_t retries;
+  // HTTP status of the last response, 0 if none was received
+  int64_t last_status_code;
+};
+
+class AgentConnection;
+
+// AgentTransport sends v0.4 trace payloads to the agent from a background
+// thread, so flushing does not depend on the managed thread pool.
+//
+// Enqueue only copies the payload into a bounded queue. The flush thread
+// merges queued payloads into one request per interval (or as soon as a batch
+// is full), sends it over a kept-alive HTTP/1.1 connection and retries failed
+// requests with back-off. When the queue is full new payloads are rejected,
+// which callers can treat as backpressure, and counted as dropped.
+//
+// Payloads are not compressed: the agent's /v0.4/traces endpoint does not
+// accept compressed bodies.
+class AgentTransport {
+ private:
+  struct Payload {
+    std::vector<uint8_t> bytes;
+    uint32_t trace_count;
+  };
+
+  AgentEndpoint endpoint_;
+
+  std::mutex queue_lock_;
+  std::condition_variable queue_signal_;
+  std::deque<Payload> queue_;
+  size_t queued_bytes_ = 0;
+  uint64_t queued_traces_ = 0;
+  bool flush_requested_ = false;
+  bool stop_requested_ = false;
+  bool started_ = false;
+
+  std::thread flusher_;
+  std::unique_ptr<AgentConnection> connection_;
+
+  std::atomic<uint64_t> sent_traces_{0};
+  std::atomic<uint64_t> requests_{0};
+  std::atomic<uint64_t> dropped_traces_{0};
+  std::atomic<uint64_t> failed_traces_{0};
+  std::atomic<uint64_t> retries_{0};
+  std::atomic<int64_t> last_status_code_{0};
+
+  std::mutex response_lock_;
+  std::string last_response_;
+
+  void FlushLoop();
+  void SendBatch(std::vector<Payload>& batch, bool final_attempt);
+  // Post sends one request. Returns the HTTP status of the response, or -1 if
+  // the connection failed.
+  int Post(const std::vector<uint8_t>& body, uint32_t trace_count);
+
+ public:
+  AgentTransport();
+  AgentTransport(const AgentTransport&) = delete;
+  AgentTransport& operator=(const AgentTransport&) = delete;
+  ~AgentTransport();
+
+  // Configure sets the agent endpoint. Must be called before the first
+  // Enqueue.
+  void Configure(const AgentEndpoint& endpoint);
+
+  const AgentEndpoint& Endpoint() const { return endpoint_; }
+
+  // Enqueue queues a v0.4 payload (a MessagePack array of traces) and starts
+  // the flush thread on first use. Returns false if the payload was dropped
+  // because it is not an array, the queue is full or the transport is
+  // stopped.
+  bool Enqueue(const uint8_t* payload, size_t size);
+
+  // Flush asks the flush thread to send the queued payloads now.
+  void Flush();
+
+  // Stop sends what is still queued, with a single attempt, and stops the
+  // flush thread.
+  void Stop();
+
+  AgentTransportStats GetStats();
+
+  // LastResponse returns the body of the last successful response, which
+  // holds the agent's sampling rates by service.
+  std::string LastResponse();
+};
+
+// ReadMessagePackArrayHeader reads the array header at the start of a
+// MessagePack buffer into count. Returns the size of the header, or 0 if the
+// buffer does not start with an array.
+size_t ReadMessagePackArrayHeader(const uint8_t* data, size_t size,
+                                  uint32_t* count);
+
+}  // namespace trace
+
+#endif  // DD_CLR_PROFILER_AGENT_TRANSPORT_H_
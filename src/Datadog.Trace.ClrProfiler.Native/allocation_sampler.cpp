@@ -0,0 +1,164 @@
+#include "allocation_sampler.h"
+
+#include <chrono>
+#include <cmath>
+
+#include "live_heap.h"
+#include "logging.h"
+
+namespace trace {
+
+namespace {
+
+// Bytes the current thread may still allocate before its next sample.
+// 0 means the distance has not been drawn yet for this thread.
+thread_local int64_t bytes_until_sample = 0;
+
+thread_local uint64_t random_state = 0;
+
+// NextRandom returns a uniformly distributed double in (0, 1] using a
+// per-thread xorshift64* generator.
+double NextRandom() {
+  if (random_state == 0) {
+    random_state =
+        static_cast<uint64_t>(
+            std::chrono::steady_clock::now().time_since_epoch().count()) ^
+        reinterpret_cast<uintptr_t>(&random_state);
+    if (random_state == 0) {
+      random_state = 0x2545F4914F6CDD1DULL;
+    }
+  }
+
+  random_state ^= random_state >> 12;
+  random_state ^= random_state << 25;
+  random_state ^= random_state >> 27;
+  const auto value = random_state * 0x2545F4914F6CDD1DULL;
+
+  // 53 random bits mapped to (0, 1]
+  return (static_cast<double>(value >> 11) + 1.0) / 9007199254740992.0;
+}
+
+}  // namespace
+
+double SampleWeight(uint64_t size, uint64_t sampling_interval) {
+  // each sample stands for size / p bytes
+  const auto interval = static_cast<double>(sampling_interval);
+  const auto probability =
+      1.0 - std::exp(-static_cast<double>(size) / interval);
+  return probability > 0.0 ? static_cast<double>(size) / probability
+                           : interval;
+}
+
+int64_t SampleDistance(double uniform, uint64_t sampling_interval) {
+  const auto distance =
+      -std::log(uniform) * static_cast<double>(sampling_interval);
+  return distance < 1.0 ? 1 : static_cast<int64_t>(distance);
+}
+
+void AllocationSampler::Initialize(ICorProfilerInfo3* info,
+                                   uint64_t sampling_interval,
+                                   LiveHeap* live_heap) {
+  sampling_interval_ = sampling_interval > 0
+                           ? sampling_interval
+                           : kDefaultAllocationSamplingInterval;
+  live_heap_ = live_heap;
+  info_ = info;
+
+  Info("Allocation sampling enabled, mean sampling interval is ",
+       sampling_interval_, " bytes.");
+}
+
+int64_t AllocationSampler::NextSampleDistance() const {
+  return SampleDistance(NextRandom(), sampling_interval_);
+}
+
+void AllocationSampler::OnObjectAllocated(ObjectID object_id,
+                                          ClassID class_id) {
+  if (info_ == nullptr) {
+    return;
+  }
+
+  ULONG size = 0;
+  if (FAILED(info_->GetObjectSize(object_id, &size))) {
+    return;
+  }
+
+  if (!CountAllocation(size)) {
+    return;
+  }
+
+  AllocationSite site;
+  site.class_id = class_id;
+  CaptureStack(info_, 0, &site.stack);
+  RecordSample(object_id, site, size);
+}
+
+bool AllocationSampler::CountAllocation(uint64_t size) {
+  if (bytes_until_sample == 0) {
+    bytes_until_sample = NextSampleDistance();
+  }
+
+  bytes_until_sample -= static_cast<int64_t>(size);
+  if (bytes_until_sample > 0) {
+    return false;
+  }
+
+  // an object larger than the remaining distance is sampled once, its weight
+  // accounts for the intervals it spans
+  bytes_until_sample = NextSampleDistance();
+  return true;
+}
+
+void AllocationSampler::RecordSample(ObjectID object_id,
+                                     const AllocationSite& site,
+                                     uint64_t size) {
+  if (live_heap_ != nullptr) {
+    live_heap_->Track(object_id, site, size);
+  }
+
+  const auto weight = SampleWeight(size, sampling_interval_);
+
+  std::lock_guard<std::mutex> guard(sites_lock_);
+
+  auto existing = sites_.find(site);
+  if (existing == sites_.end()) {
+    if (sites_.size() >= kMaxAllocationSites) {
+      dropped_samples_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+
+    const AllocationStats stats = {0, 0, 0.0};
+    existing = sites_.emplace(site, stats).first;
+  }
+
+  existing->second.sample_count++;
+  existing->second.sampled_bytes += size;
+  existing->second.estimated_bytes += weight;
+}
+
+size_t AllocationSampler::Drain(AllocationSample* samples,
+                                size_t max_samples) {
+  std::lock_guard<std::mutex> guard(sites_lock_);
+
+  size_t written = 0;
+  for (auto it = sites_.begin(); it != sites_.end() && written < max_samples;
+       written++) {
+    auto& sample = samples[written];
+    sample.class_id = it->first.class_id;
+    sample.sample_count = it->second.sample_count;
+    sample.sampled_bytes = it->second.sampled_bytes;
+    sample.estimated_bytes = static_cast<uint64_t>(it->second.estimated_bytes);
+    sample.frame_count = it->first.stack.frame_count;
+    for (uint32_t i = 0; i < kMaxStackFrames; i++) {
+      sample.frames[i] = i < it->first.stack.frame_count
+                             ? it->first.stack.frames[i]
+                             : 0;
+    }
+
+    it = sites_.erase(it);
+  }
+
+  return written;
+}
+
+}  // namespace trace
@@ -0,0 +1,129 @@
+#ifndef DD_CLR_PROFILER_ALLOCATION_SAMPLER_H_
+#define DD_CLR_PROFILER_ALLOCATION_SAMPLER_H_
+
+#include <corhlpr.h>
+#include <corprof.h>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+#include "stack_walker.h"
+
+namespace trace {
+
+// Mean number of allocated bytes between two samples.
+const uint64_t kDefaultAllocationSamplingInterval = 512 * 1024;
+
+// Maximum number of distinct (class, stack) sites kept between two drains.
+// Samples for new sites are dropped (and counted) once the table is full.
+const size_t kMaxAllocationSites = 4096;
+
+// AllocationSample is the aggregated record for one allocation site, handed
+// to managed code by GetAllocationSamples in interop.cpp. It is blittable:
+// keep its layout in sync with the managed definition.
+struct AllocationSample {
+  uint64_t class_id;
+  uint64_t sample_count;
+  // sum of the sizes of the sampled objects
+  uint64_t sampled_bytes;
+  // unbiased estimate of the bytes allocated at this site, all objects
+  // included
+  uint64_t estimated_bytes;
+  uint64_t frame_count;
+  uint64_t frames[kMaxStackFrames];
+};
+
+// AllocationSite identifies where sampled objects were allocated: their class
+// and the managed stack of the allocating thread.
+struct AllocationSite {
+  ClassID class_id;
+  CompactStack stack;
+
+  bool operator==(const AllocationSite& other) const {
+    return class_id == other.class_id && stack == other.stack;
+  }
+};
+
+struct AllocationSiteHash {
+  size_t operator()(const AllocationSite& site) const {
+    return static_cast<size_t>(site.stack.Hash() ^
+                               (site.class_id * 0x9E3779B97F4A7C15ULL));
+  }
+};
+
+// SampleWeight returns the bytes a sampled object of the given size stands
+// for. An object is sampled with probability 1 - exp(-size / interval).
+double SampleWeight(uint64_t size, uint64_t sampling_interval);
+
+// SampleDistance returns the bytes to allocate before the next sample, drawn
+// from an exponential distribution of mean sampling_interval given a uniform
+// value in (0, 1]. It is at least 1.
+int64_t SampleDistance(double uniform, uint64_t sampling_interval);
+
+class LiveHeap;
+
+// AllocationSampler samples allocations reported by ObjectAllocated using a
+// Poisson process over allocated bytes: each thread draws the distance to its
+// next sample from an exponential distribution whose mean is the sampling
+// interval, so large objects are proportionally more likely to be sampled and
+// the per-object cost is a subtraction until a sample is due.
+//
+// Samples are aggregated by class and managed stack until drained, and handed
+// to the live heap profiler if one is given.
+class AllocationSampler {
+ private:
+  struct AllocationStats {
+    uint64_t sample_count;
+    uint64_t sampled_bytes;
+    double estimated_bytes;
+  };
+
+  ICorProfilerInfo3* info_ = nullptr;
+  uint64_t sampling_interval_ = kDefaultAllocationSamplingInterval;
+  LiveHeap* live_heap_ = nullptr;
+
+  std::mutex sites_lock_;
+  std::unordered_map<AllocationSite, AllocationStats, AllocationSiteHash>
+      sites_;
+  std::atomic<uint64_t> dropped_samples_{0};
+
+  int64_t NextSampleDistance() const;
+
+ public:
+  AllocationSampler() = default;
+  AllocationSampler(const AllocationSampler&) = delete;
+  AllocationSampler& operator=(const AllocationSampler&) = delete;
+
+  // Initialize enables sampling. live_heap is optional: it tracks the sampled
+  // objects until they are collected.
+  void Initialize(ICorProfilerInfo3* info, uint64_t sampling_interval,
+                  LiveHeap* live_heap = nullptr);
+
+  bool IsEnabled() const { return info_ != nullptr; }
+
+  // OnObjectAllocated must be called from ICorProfilerCallback::ObjectAllocated
+  void OnObjectAllocated(ObjectID object_id, ClassID class_id);
+
+  // CountAllocation counts size bytes allocated by the current thread and
+  // returns whether that allocation is to be sampled.
+  bool CountAllocation(uint64_t size);
+
+  // RecordSample aggregates a sampled allocation of size bytes at site.
+  void RecordSample(ObjectID object_id, const AllocationSite& site,
+                    uint64_t size);
+
+  // Drain moves up to max_samples aggregated sites into samples and returns
+  // how many were written. Sites that did not fit are kept for the next call.
+  size_t Drain(AllocationSample* samples, size_t max_samples);
+
+  // DroppedSamples returns how many samples were discarded because the site
+  // table was full.
+  uint64_t DroppedSamples() const {
+    return dropped_samples_.load(std::memory_order_relaxed);
+  }
+};
+
+}  // namespace trace
+
+#endif  // DD_CLR_PROFILER_ALLOCATION_SAMPLER_H_
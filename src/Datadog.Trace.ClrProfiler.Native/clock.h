@@ -0,0 +1,29 @@
+#ifndef DD_CLR_PROFILER_CLOCK_H_
+#define DD_CLR_PROFILER_CLOCK_H_
+
+#include <chrono>
+#include <cstdint>
+
+namespace trace {
+
+// MonotonicNanoseconds returns a timestamp suitable for measuring durations.
+// Its epoch is unspecified.
+inline uint64_t MonotonicNanoseconds() {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+// UnixNanoseconds returns the wall-clock time in nanoseconds since the Unix
+// epoch, comparable with span start times.
+inline uint64_t UnixNanoseconds() {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count());
+}
+
+}  // namespace trace
+
+#endif  // DD_CLR_PROFILER_CLOCK_H_
@@ -337,33 +337,159 @@ bool AssemblyMeetsIntegrationRequirements(
   return true;
 }
 
+std::vector<AssemblyMetadata> GetModuleAssemblies(
+    const ComPtr<IMetaDataAssemblyImport>& assembly_import) {
+  std::vector<AssemblyMetadata> assemblies;
+  assemblies.push_back(GetAssemblyImportMetadata(assembly_import));
+
+  for (auto& assembly_ref : EnumAssemblyRefs(assembly_import)) {
+    assemblies.push_back(
+        GetReferencedAssemblyMetadata(assembly_import, assembly_ref));
+  }
+
+  return assemblies;
+}
+
+std::vector<AssemblyMetadata> GetModuleAssemblies(
+    const MetadataReader& metadata_reader) {
+  std::vector<AssemblyMetadata> assemblies;
+
+  MetadataAssembly assembly;
+  if (metadata_reader.GetAssembly(&assembly)) {
+    assemblies.emplace_back(0, ToWSTRING(assembly.name),
+                            TokenFromRid(1, mdtAssembly), assembly.major,
+                            assembly.minor, assembly.build, assembly.revision);
+  }
+
+  const auto assembly_ref_count = metadata_reader.RowCount(kAssemblyRefTable);
+  for (uint32_t row = 1; row <= assembly_ref_count; row++) {
+    const auto assembly_ref = metadata_reader.GetAssemblyRef(row);
+    assemblies.emplace_back(0, ToWSTRING(assembly_ref.name),
+                            TokenFromRid(row, mdtAssemblyRef),
+                            assembly_ref.major, assembly_ref.minor,
+                            assembly_ref.build, assembly_ref.revision);
+  }
+
+  return assemblies;
+}
+
 std::vector<IntegrationMethod> FilterIntegrationsByTarget(
     const std::vector<IntegrationMethod>& integrations,
     const ComPtr<IMetaDataAssemblyImport>& assembly_import) {
   std::vector<IntegrationMethod> enabled;
 
-  const auto assembly_metadata = GetAssemblyImportMetadata(assembly_import);
+  const auto assemblies = GetModuleAssemblies(assembly_import);
 
   for (auto& i : integrations) {
-    bool found = false;
-    if (AssemblyMeetsIntegrationRequirements(assembly_metadata,
-                                             i.replacement)) {
-      found = true;
+    for (auto& metadata : assemblies) {
+      if (AssemblyMeetsIntegrationRequirements(metadata, i.replacement)) {
+        enabled.push_back(i);
+        break;
+      }
     }
-    for (auto& assembly_ref : EnumAssemblyRefs(assembly_import)) {
-      const auto metadata_ref =
-          GetReferencedAssemblyMetadata(assembly_import, assembly_ref);
-      // Info(L"-- assembly ref: " , assembly_name , " to " , ref_name);
-      if (AssemblyMeetsIntegrationRequirements(metadata_ref, i.replacement)) {
-        found = true;
+  }
+
+  return enabled;
+}
+
+std::unordered_set<mdToken> FindCallTargetTokens(
+    const std::vector<IntegrationMethod>& integrations,
+    const MetadataReader& metadata_reader) {
+  std::set<std::pair<std::string, std::string>> targets;
+  std::set<std::string> method_names;
+  std::vector<const MethodReference*> target_patterns;
+
+  for (auto& i : integrations) {
+    if (i.replacement.wrapper_method.action != "ReplaceTargetMethod"_W) {
+      continue;
+    }
+    if (i.replacement.target_method.HasNamePattern()) {
+      target_patterns.push_back(&i.replacement.target_method);
+      continue;
+    }
+    const auto method_name = ToString(i.replacement.target_method.method_name);
+    targets.emplace(ToString(i.replacement.target_method.type_name),
+                    method_name);
+    method_names.insert(method_name);
+  }
+
+  std::unordered_set<mdToken> tokens;
+  if (targets.empty() && target_patterns.empty()) {
+    return tokens;
+  }
+
+  std::string method_name;
+  std::string type_name;
+
+  // MatchesPattern checks the names against the targets using wildcards
+  const auto matches_pattern = [&](mdToken parent) {
+    const auto wide_method_name = ToWSTRING(method_name);
+    WSTRING wide_type_name;
+    bool has_type_name = false;
+
+    for (const auto target : target_patterns) {
+      if (!target->method_name.empty() &&
+          !WildcardMatch(target->method_name, wide_method_name)) {
+        continue;
+      }
+      if (!has_type_name) {
+        if (!metadata_reader.GetTypeName(parent, &type_name)) {
+          return true;
+        }
+        wide_type_name = ToWSTRING(type_name);
+        has_type_name = true;
+      }
+      if (target->type_name.empty() ||
+          WildcardMatch(target->type_name, wide_type_name)) {
+        return true;
       }
     }
-    if (found) {
-      enabled.push_back(i);
+    return false;
+  };
+
+  // MatchesTarget compares the names without resolving the type unless the
+  // method name is a target's
+  const auto matches_target = [&](const char* name, mdToken parent) {
+    method_name.assign(name);
+    if (method_names.count(method_name) > 0 &&
+        (!metadata_reader.GetTypeName(parent, &type_name) ||
+         targets.count(std::make_pair(type_name, method_name)) > 0)) {
+      return true;
+    }
+    return !target_patterns.empty() && matches_pattern(parent);
+  };
+
+  const auto member_ref_count = metadata_reader.RowCount(kMemberRefTable);
+  for (uint32_t row = 1; row <= member_ref_count; row++) {
+    const auto name = metadata_reader.GetString(
+        metadata_reader.GetColumn(kMemberRefTable, row, column::kMemberRefName));
+    const auto parent =
+        metadata_reader.GetToken(kMemberRefTable, row, column::kMemberRefClass);
+    if (matches_target(name, parent)) {
+      tokens.insert(TokenFromRid(row, mdtMemberRef));
     }
   }
 
-  return enabled;
+  const auto method_def_count = metadata_reader.RowCount(kMethodDefTable);
+  for (uint32_t row = 1; row <= method_def_count; row++) {
+    const auto name = metadata_reader.GetString(
+        metadata_reader.GetColumn(kMethodDefTable, row, column::kMethodDefName));
+    if (matches_target(name, metadata_reader.GetMethodDefParent(row))) {
+      tokens.insert(TokenFromRid(row, mdtMethodDef));
+    }
+  }
+
+  // generic method instantiations of the methods above
+  const auto method_spec_count = metadata_reader.RowCount(kMethodSpecTable);
+  for (uint32_t row = 1; row <= method_spec_count; row++) {
+    const auto method = metadata_reader.GetToken(kMethodSpecTable, row,
+                                                 column::kMethodSpecMethod);
+    if (tokens.count(method) > 0) {
+      tokens.insert(TokenFromRid(row, mdtMethodSpec));
+    }
+  }
+
+  return tokens;
 }
 
 mdMethodSpec DefineMethodSpec(const ComPtr<IMetaDataEmit2>& metadata_emit,
@@ -378,19 +504,6 @@ mdMethodSpec DefineMethodSpec(const ComPtr<IMetaDataEmit2>& metadata_emit,
   return spec;
 }
 
-bool DisableOptimizations() {
-  const auto disable_optimizations =
-      GetEnvironmentValue(environment::clr_disable_optimizations);
-
-  if (disable_optimizations == "1"_W ||
-      disable_optimizations == "true"_W) {
-    return true;
-  }
-
-  // default to false: don't disable JIT optimizations
-  return false;
-}
-
 TypeInfo RetrieveTypeForSignature(
     const ComPtr<IMetaDataImport2>& metadata_import,
     const FunctionInfo& function_info, const size_t current_index,
@@ -8,7 +8,9 @@
 
 #include "com_ptr.h"
 #include "integration.h"
+#include "metadata_reader.h"
 #include <set>
+#include <unordered_set>
 
 namespace trace {
 class ModuleMetadata;
@@ -313,6 +315,16 @@ AssemblyMetadata GetReferencedAssemblyMetadata(
     const ComPtr<IMetaDataAssemblyImport>& assembly_import,
     const mdAssemblyRef& assembly_ref);
 
+// GetModuleAssemblies returns the module's assembly followed by every
+// assembly it references
+std::vector<AssemblyMetadata> GetModuleAssemblies(
+    const ComPtr<IMetaDataAssemblyImport>& assembly_import);
+
+// GetModuleAssemblies does the same with the Assembly and AssemblyRef tables
+// read by a MetadataReader
+std::vector<AssemblyMetadata> GetModuleAssemblies(
+    const MetadataReader& metadata_reader);
+
 FunctionInfo GetFunctionInfo(const ComPtr<IMetaDataImport2>& metadata_import,
                              const mdToken& token);
 
@@ -347,12 +359,24 @@ std::vector<IntegrationMethod> FilterIntegrationsByTarget(
     const std::vector<IntegrationMethod>& integrations,
     const ComPtr<IMetaDataAssemblyImport>& assembly_import);
 
+// AssemblyMeetsIntegrationRequirements checks that the assembly is the target
+// assembly of the replacement, within its version range
+bool AssemblyMeetsIntegrationRequirements(
+    const AssemblyMetadata metadata,
+    const MethodReplacement method_replacement);
+
+// FindCallTargetTokens returns the MethodDef, MemberRef and MethodSpec tokens
+// that a call instruction could use to call the target method of any
+// "ReplaceTargetMethod" integration. Tokens whose type name can't be read from
+// the tables are included, so the set never misses a target.
+std::unordered_set<mdToken> FindCallTargetTokens(
+    const std::vector<IntegrationMethod>& integrations,
+    const MetadataReader& metadata_reader);
+
 mdMethodSpec DefineMethodSpec(const ComPtr<IMetaDataEmit2>& metadata_emit,
                               const mdToken& token,
                               const MethodSignature& signature);
 
-bool DisableOptimizations();
-
 bool TryParseSignatureTypes(const ComPtr<IMetaDataImport2>& metadata_import,
                          const FunctionInfo& function_info,
                          std::vector<WSTRING>& signature_result);
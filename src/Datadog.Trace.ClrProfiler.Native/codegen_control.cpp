@@ -0,0 +1,205 @@
+#include "codegen_control.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "il_rewriter.h"
+#include "logging.h"
+
+namespace trace {
+
+CodegenControl::~CodegenControl() { Stop(); }
+
+HRESULT CodegenControl::Initialize(ICorProfilerInfo4* info,
+                                   OverheadBudget* budget) {
+  if (info == nullptr) {
+    return E_INVALIDARG;
+  }
+
+  info_ = info;
+  budget_ = budget;
+  worker_ = std::thread(&CodegenControl::RequestLoop, this);
+  return S_OK;
+}
+
+void CodegenControl::Stop() {
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    stop_requested_ = true;
+    pending_.clear();
+  }
+  signal_.notify_all();
+
+  if (worker_.joinable()) {
+    worker_.join();
+  }
+}
+
+bool CodegenControl::Add(ModuleID module_id, mdMethodDef method_def,
+                         uint32_t flags) {
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+
+    auto& methods = methods_[module_id];
+    const auto it = methods.find(method_def);
+    if (it != methods.end()) {
+      // compiled again, e.g. by tiered compilation: keep the latest IL if it
+      // was rewritten
+      it->second |= flags;
+      return false;
+    }
+
+    methods[method_def] = flags;
+    pending_.emplace_back(module_id, method_def);
+  }
+
+  signal_.notify_one();
+  return true;
+}
+
+size_t CodegenControl::TakePending(std::vector<ModuleID>* modules,
+                                   std::vector<mdMethodDef>* methods,
+                                   size_t max_methods) {
+  std::lock_guard<std::mutex> guard(lock_);
+
+  const auto count = std::min(max_methods, pending_.size());
+  for (size_t i = 0; i < count; i++) {
+    modules->push_back(pending_[i].first);
+    methods->push_back(pending_[i].second);
+  }
+
+  pending_.erase(pending_.begin(), pending_.begin() + count);
+  return count;
+}
+
+bool CodegenControl::Find(ModuleID module_id, mdMethodDef method_def,
+                          uint32_t* flags) const {
+  std::lock_guard<std::mutex> guard(lock_);
+
+  const auto module = methods_.find(module_id);
+  if (module == methods_.end()) {
+    return false;
+  }
+
+  const auto method = module->second.find(method_def);
+  if (method == module->second.end()) {
+    return false;
+  }
+
+  *flags = method->second;
+  return true;
+}
+
+void CodegenControl::EvictModule(ModuleID module_id) {
+  std::lock_guard<std::mutex> guard(lock_);
+
+  methods_.erase(module_id);
+  pending_.erase(
+      std::remove_if(pending_.begin(), pending_.end(),
+                     [module_id](const std::pair<ModuleID, mdMethodDef>& m) {
+                       return m.first == module_id;
+                     }),
+      pending_.end());
+}
+
+size_t CodegenControl::MethodCount() const {
+  std::lock_guard<std::mutex> guard(lock_);
+
+  size_t count = 0;
+  for (const auto& module : methods_) {
+    count += module.second.size();
+  }
+  return count;
+}
+
+void CodegenControl::RequestLoop() {
+  std::vector<ModuleID> modules;
+  std::vector<mdMethodDef> methods;
+
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(lock_);
+      signal_.wait(lock,
+                   [this] { return stop_requested_ || !pending_.empty(); });
+      if (stop_requested_) {
+        return;
+      }
+
+      // leave the runtime alone while the profiler is over budget
+      if (budget_ != nullptr && budget_->IsThrottled()) {
+        signal_.wait_for(
+            lock, std::chrono::nanoseconds(kOverheadBudgetWindowNs),
+            [this] { return stop_requested_; });
+        continue;
+      }
+    }
+
+    modules.clear();
+    methods.clear();
+    const auto count = TakePending(&modules, &methods, kMaxReJITBatchSize);
+    if (count == 0) {
+      continue;
+    }
+
+    const auto hr = info_->RequestReJIT(static_cast<ULONG>(count),
+                                        modules.data(), methods.data());
+
+    std::lock_guard<std::mutex> guard(lock_);
+    if (FAILED(hr)) {
+      Warn("CodegenControl: RequestReJIT failed for ", count,
+           " methods, they keep their current code. hr=", hr);
+    } else {
+      requested_count_ += count;
+      if (debug_logging_enabled) {
+        Debug("CodegenControl: requested ReJIT of ", count,
+              " methods. total=", requested_count_);
+      }
+    }
+  }
+}
+
+HRESULT CodegenControl::GetReJITParameters(
+    ModuleID module_id, mdMethodDef method_def,
+    ICorProfilerFunctionControl* function_control, bool il_set) {
+  uint32_t flags = 0;
+  if (!IsEnabled() || !Find(module_id, method_def, &flags)) {
+    return S_OK;
+  }
+
+  if ((flags & kCodegenRewritten) != 0 && !il_set) {
+    // GetILFunctionBody returns the IL set on the first compilation. If it
+    // can't be copied, failing cancels the ReJIT and the method keeps its
+    // current code, instrumentation included.
+    ILRewriter rewriter(info_, function_control, module_id, method_def);
+
+    auto hr = rewriter.Import();
+    if (SUCCEEDED(hr)) {
+      hr = rewriter.Export();
+    }
+
+    if (FAILED(hr)) {
+      Warn("CodegenControl: unable to copy the rewritten IL of method ",
+           method_def, " in module ", module_id, ". hr=", hr);
+      return hr;
+    }
+  }
+
+  if ((flags & kCodegenUnoptimized) == 0) {
+    return S_OK;
+  }
+
+  return function_control->SetCodegenFlags(codegen_flags_);
+}
+
+void CodegenControl::OnReJITError(ModuleID module_id, mdMethodDef method_def,
+                                  HRESULT hr_status) {
+  uint32_t flags = 0;
+  if (!Find(module_id, method_def, &flags)) {
+    return;
+  }
+
+  Warn("CodegenControl: ReJIT failed for method ", method_def, " in module ",
+       module_id, ", it keeps its current code. hr=", hr_status);
+}
+
+}  // namespace trace
@@ -0,0 +1,115 @@
+#ifndef DD_CLR_PROFILER_CODEGEN_CONTROL_H_
+#define DD_CLR_PROFILER_CODEGEN_CONTROL_H_
+
+#include <corhlpr.h>
+#include <corprof.h>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "overhead_budget.h"
+
+namespace trace {
+
+// Maximum number of methods passed to a single RequestReJIT call.
+const size_t kMaxReJITBatchSize = 512;
+
+// What the ReJIT of a method is for, combined with |.
+// the profiler replaced its IL on its first compilation
+const uint32_t kCodegenRewritten = 1;
+// compile it without optimizations
+const uint32_t kCodegenUnoptimized = 2;
+// its low-priority integrations were deferred by the overhead budget
+const uint32_t kCodegenDeferred = 4;
+
+// CodegenControl compiles selected methods again with ReJIT: to disable JIT
+// optimizations in them while the rest of the process stays optimized, or to
+// apply the integrations deferred while the profiler was over its overhead
+// budget.
+//
+// COR_PRF_DISABLE_OPTIMIZATIONS applies to every method of the process, and
+// ICorProfilerFunctionControl::SetCodegenFlags is only offered when a method
+// is recompiled by ReJIT. So methods are queued when they are first JIT
+// compiled, and a worker thread requests their ReJIT in batches, outside of
+// the runtime callbacks. GetReJITParameters then sets the codegen flags and,
+// for methods the profiler rewrote on their first compilation, hands back the
+// rewritten IL, since ReJIT otherwise starts over from the original IL.
+//
+// With an overhead budget, ReJIT requests wait while it is exceeded, like the
+// integrations they apply.
+class CodegenControl {
+ private:
+  ICorProfilerInfo4* info_ = nullptr;
+  OverheadBudget* budget_ = nullptr;
+  DWORD codegen_flags_ = COR_PRF_CODEGEN_DISABLE_ALL_OPTIMIZATIONS |
+                         COR_PRF_CODEGEN_DISABLE_INLINING;
+
+  mutable std::mutex lock_;
+  // method -> kCodegen* flags, by module
+  std::unordered_map<ModuleID, std::unordered_map<mdMethodDef, uint32_t>>
+      methods_;
+  // methods whose ReJIT hasn't been requested yet
+  std::vector<std::pair<ModuleID, mdMethodDef>> pending_;
+  uint64_t requested_count_ = 0;
+
+  std::thread worker_;
+  std::condition_variable signal_;
+  bool stop_requested_ = false;
+
+  void RequestLoop();
+
+ public:
+  CodegenControl() = default;
+  CodegenControl(const CodegenControl&) = delete;
+  CodegenControl& operator=(const CodegenControl&) = delete;
+  ~CodegenControl();
+
+  // Initialize starts the worker thread. It must be called from
+  // ICorProfilerCallback::Initialize, with COR_PRF_ENABLE_REJIT in the event
+  // mask. budget is optional.
+  HRESULT Initialize(ICorProfilerInfo4* info,
+                     OverheadBudget* budget = nullptr);
+
+  // Stop signals the worker thread and waits for it to exit. Pending
+  // requests are dropped.
+  void Stop();
+
+  bool IsEnabled() const { return info_ != nullptr; }
+
+  // Add queues a method for recompilation, with kCodegen* flags. Returns
+  // false if the method was already queued, in which case the flags are
+  // added to its own.
+  bool Add(ModuleID module_id, mdMethodDef method_def, uint32_t flags);
+
+  // TakePending moves up to max_methods queued methods into modules and
+  // methods, in the order they were added. Returns how many were moved.
+  size_t TakePending(std::vector<ModuleID>* modules,
+                     std::vector<mdMethodDef>* methods, size_t max_methods);
+
+  // Find returns false if the method was never added.
+  bool Find(ModuleID module_id, mdMethodDef method_def, uint32_t* flags) const;
+
+  // EvictModule forgets the methods of a module being unloaded.
+  void EvictModule(ModuleID module_id);
+
+  size_t MethodCount() const;
+
+  // GetReJITParameters implements ICorProfilerCallback4::GetReJITParameters
+  // for the methods that were added. It ignores other methods. il_set tells
+  // whether the caller already set the new IL of the method.
+  HRESULT GetReJITParameters(ModuleID module_id, mdMethodDef method_def,
+                             ICorProfilerFunctionControl* function_control,
+                             bool il_set = false);
+
+  // OnReJITError logs a failed recompilation of a method that was added.
+  void OnReJITError(ModuleID module_id, mdMethodDef method_def,
+                    HRESULT hr_status);
+};
+
+}  // namespace trace
+
+#endif  // DD_CLR_PROFILER_CODEGEN_CONTROL_H_
@@ -27,43 +27,36 @@ CorProfiler* profiler = nullptr;
 //
 HRESULT STDMETHODCALLTYPE
 CorProfiler::Initialize(IUnknown* cor_profiler_info_unknown) {
-  // check if debug mode is enabled
-  const auto debug_enabled_value =
-      GetEnvironmentValue(environment::debug_enabled);
+  // read every setting once, nothing reads the environment afterwards
+  config_ = LoadProfilerConfig();
+  SetLogFilePath(config_.log_path);
 
-  if (debug_enabled_value == "1"_W || debug_enabled_value == "true"_W) {
+  // check if debug mode is enabled
+  if (config_.debug_enabled) {
     debug_logging_enabled = true;
   }
 
   CorProfilerBase::Initialize(cor_profiler_info_unknown);
 
   // check if tracing is completely disabled
-  const WSTRING tracing_enabled =
-      GetEnvironmentValue(environment::tracing_enabled);
-
-  if (tracing_enabled == "0"_W || tracing_enabled == "false"_W) {
+  if (!config_.tracing_enabled) {
     Info("Profiler disabled in ", environment::tracing_enabled);
     return E_FAIL;
   }
 
   const auto process_name = GetCurrentProcessName();
-  const auto include_process_names =
-      GetEnvironmentValues(environment::include_process_names);
 
   // if there is a process inclusion list, attach profiler only if this
   // process's name is on the list
-  if (!include_process_names.empty() &&
-      !Contains(include_process_names, process_name)) {
+  if (!config_.include_process_names.empty() &&
+      !Contains(config_.include_process_names, process_name)) {
     Info("Profiler disabled: ", process_name, " not found in ",
          environment::include_process_names, ".");
     return E_FAIL;
   }
 
-  const auto exclude_process_names =
-      GetEnvironmentValues(environment::exclude_process_names);
-
   // attach profiler only if this process's name is NOT on the list
-  if (Contains(exclude_process_names, process_name)) {
+  if (Contains(config_.exclude_process_names, process_name)) {
     Info("Profiler disabled: ", process_name, " found in ",
          environment::exclude_process_names, ".");
     return E_FAIL;
@@ -77,37 +70,21 @@ CorProfiler::Initialize(IUnknown* cor_profiler_info_unknown) {
     return E_FAIL;
   }
 
-  Info("Environment variables:");
+  if (!config_.config_file.empty()) {
+    Info("Configuration file: ", config_.config_file);
+  }
 
-  WSTRING env_vars[]{environment::tracing_enabled,
-                     environment::debug_enabled,
-                     environment::profiler_home_path,
-                     environment::integrations_path,
-                     environment::include_process_names,
-                     environment::exclude_process_names,
-                     environment::agent_host,
-                     environment::agent_port,
-                     environment::env,
-                     environment::service_name,
-                     environment::disabled_integrations,
-                     environment::clr_disable_optimizations,
-                     environment::azure_app_services,
-                     environment::azure_app_services_app_pool_id,
-                     environment::azure_app_services_cli_telemetry_profile_value};
+  Info("Settings:");
 
-  for (auto&& env_var : env_vars) {
-    Info("  ", env_var, "=", GetEnvironmentValue(env_var));
+  for (const auto& setting : config_.settings) {
+    Info("  ", setting.first, "=", setting.second);
   }
 
-  const WSTRING azure_app_services_value =
-      GetEnvironmentValue(environment::azure_app_services);
-
-  if (azure_app_services_value == "1"_W) {
+  if (config_.azure_app_services) {
     Info("Profiler is operating within Azure App Services context.");
     in_azure_app_services = true;
 
-    const auto app_pool_id_value =
-        GetEnvironmentValue(environment::azure_app_services_app_pool_id);
+    const auto& app_pool_id_value = config_.azure_app_services_app_pool_id;
 
     if (app_pool_id_value.size() > 1 && app_pool_id_value.at(0) == '~') {
       Info("Profiler disabled: ", environment::azure_app_services_app_pool_id,
@@ -116,10 +93,8 @@ CorProfiler::Initialize(IUnknown* cor_profiler_info_unknown) {
       return E_FAIL;
     }
 
-    const auto cli_telemetry_profile_value = GetEnvironmentValue(
-        environment::azure_app_services_cli_telemetry_profile_value);
-
-    if (cli_telemetry_profile_value == "AzureKudu"_W) {
+    if (config_.azure_app_services_cli_telemetry_profile_value ==
+        "AzureKudu"_W) {
       Info("Profiler disabled: ", app_pool_id_value,
            " is recognized as Kudu, an Azure App Services reserved process.");
       return E_FAIL;
@@ -127,10 +102,7 @@ CorProfiler::Initialize(IUnknown* cor_profiler_info_unknown) {
   }
 
   // get path to integration definition JSON files
-  const WSTRING integrations_paths =
-      GetEnvironmentValue(environment::integrations_path);
-
-  if (integrations_paths.empty()) {
+  if (config_.integrations_paths.empty()) {
     Warn("Profiler disabled: ", environment::integrations_path,
          " environment variable not set.");
     return E_FAIL;
@@ -138,15 +110,11 @@ CorProfiler::Initialize(IUnknown* cor_profiler_info_unknown) {
 
   // load all available integrations from JSON files
   const std::vector<Integration> all_integrations =
-      LoadIntegrationsFromEnvironment();
-
-  // get list of disabled integration names
-  const std::vector<WSTRING> disabled_integration_names =
-      GetEnvironmentValues(environment::disabled_integrations);
+      LoadIntegrationsFromFiles(config_.integrations_paths);
 
   // remove disabled integrations
-  integrations_ =
-      FilterIntegrationsByName(all_integrations, disabled_integration_names);
+  integrations_ = FilterIntegrationsByName(all_integrations,
+                                           config_.disabled_integrations);
 
   // check if there are any enabled integrations left
   if (integrations_.empty()) {
@@ -154,15 +122,106 @@ CorProfiler::Initialize(IUnknown* cor_profiler_info_unknown) {
     return E_FAIL;
   }
 
+  rules_ = std::make_shared<const IntegrationRuleSet>(
+      FlattenIntegrations(integrations_), config_.low_priority_integrations);
+
   DWORD event_mask = COR_PRF_MONITOR_JIT_COMPILATION |
                      COR_PRF_DISABLE_TRANSPARENCY_CHECKS_UNDER_FULL_TRUST |
                      COR_PRF_DISABLE_INLINING | COR_PRF_MONITOR_MODULE_LOADS |
                      COR_PRF_MONITOR_ASSEMBLY_LOADS |
                      COR_PRF_DISABLE_ALL_NGEN_IMAGES;
 
-  if (DisableOptimizations()) {
+  overhead_budget_.Configure(config_.overhead_budget_ms,
+                             config_.rewrite_budget);
+
+  if (config_.module_idle_timeout != 0) {
+    Info("Compacting modules idle for ", config_.module_idle_timeout, " ms.");
+    module_idle_timeout_ns_ = config_.module_idle_timeout * 1000000;
+  }
+
+  // per-method codegen flags, and the integrations deferred by the overhead
+  // budget, are only available through ReJIT
+  ICorProfilerInfo4* info4 = nullptr;
+  const bool defers_integrations = overhead_budget_.IsEnabled() &&
+                                   !config_.low_priority_integrations.empty();
+  if (config_.disable_rewritten_optimizations ||
+      !config_.unoptimized_methods.IsEmpty() || defers_integrations) {
+    hr = cor_profiler_info_unknown->QueryInterface<ICorProfilerInfo4>(&info4);
+    if (SUCCEEDED(hr)) {
+      event_mask |= COR_PRF_ENABLE_REJIT;
+    } else {
+      Warn("Unable to recompile methods with ReJIT: interface "
+           "ICorProfilerInfo4 not found. Optimizations can't be disabled per "
+           "method and low-priority integrations are never deferred.");
+      info4 = nullptr;
+    }
+  }
+
+  // rewritten methods run optimized until their ReJIT lands: only rely on it
+  // when all optimizations aren't explicitly disabled
+  if (config_.disable_optimizations ||
+      (info4 == nullptr && config_.disable_rewritten_optimizations)) {
     Info("Disabling all code optimizations.");
     event_mask |= COR_PRF_DISABLE_OPTIMIZATIONS;
+  } else if (config_.disable_rewritten_optimizations) {
+    Info("Disabling code optimizations of rewritten methods.");
+  }
+
+  if (info4 != nullptr && !config_.disable_optimizations &&
+      !config_.unoptimized_methods.IsEmpty()) {
+    Info("Disabling code optimizations of methods matching ",
+         config_.unoptimized_methods.Size(), " method patterns.");
+  }
+
+  if (config_.allocation_profiling_enabled) {
+    event_mask |= COR_PRF_ENABLE_OBJECT_ALLOCATED |
+                  COR_PRF_MONITOR_OBJECT_ALLOCATED |
+                  COR_PRF_ENABLE_STACK_SNAPSHOT;
+
+    if (config_.live_heap_enabled) {
+      event_mask |= COR_PRF_MONITOR_GC;
+    }
+  } else if (config_.live_heap_enabled) {
+    Warn("Live heap profiling disabled: it requires ",
+         environment::allocation_profiling_enabled, ".");
+  }
+
+  // span context slots are released in ThreadDestroyed; the thread count of
+  // the runtime metrics comes from the same callbacks
+  event_mask |= COR_PRF_MONITOR_THREADS;
+
+  if (config_.gc_timeline_enabled) {
+    event_mask |= COR_PRF_MONITOR_GC | COR_PRF_MONITOR_SUSPENDS;
+  }
+
+  if (config_.exception_counting_enabled) {
+    event_mask |= COR_PRF_MONITOR_EXCEPTIONS;
+  }
+
+  // the watchdog suspends the runtime to sample blocked threads, which is
+  // only possible since .NET Core 3.0
+  ICorProfilerInfo10* info10 = nullptr;
+  if (config_.thread_pool_watchdog_enabled) {
+    event_mask |= COR_PRF_MONITOR_THREADS | COR_PRF_ENABLE_STACK_SNAPSHOT;
+
+    hr = cor_profiler_info_unknown->QueryInterface<ICorProfilerInfo10>(&info10);
+    if (FAILED(hr)) {
+      info10 = nullptr;
+    }
+  }
+
+  if (!config_.timed_methods.IsEmpty()) {
+    event_mask |= COR_PRF_MONITOR_ENTERLEAVE;
+  }
+
+  // in-process EventPipe sessions are only possible since .NET 5
+  ICorProfilerInfo12* info12 = nullptr;
+  if (config_.runtime_events_enabled) {
+    hr = cor_profiler_info_unknown->QueryInterface<ICorProfilerInfo12>(&info12);
+    if (FAILED(hr)) {
+      Info("Runtime events disabled: requires .NET 5 or later.");
+      info12 = nullptr;
+    }
   }
 
   // set event mask to subscribe to events and disable NGEN images
@@ -172,8 +231,98 @@ CorProfiler::Initialize(IUnknown* cor_profiler_info_unknown) {
     return E_FAIL;
   }
 
+  if (info12 != nullptr &&
+      FAILED(info12->SetEventMask2(event_mask, kCorPrfHighMonitorEventPipe))) {
+    Warn("Runtime events disabled: unable to set the event mask.");
+    info12 = nullptr;
+  }
+
   runtime_information_ = GetRuntimeInformation(this->info_);
 
+  symbol_cache_.Initialize(this->info_);
+  span_contexts_.Initialize();
+
+  if (config_.allocation_profiling_enabled) {
+    if (config_.live_heap_enabled) {
+      live_heap_.Initialize(config_.allocation_sampling_interval,
+                            config_.live_heap_max_objects);
+    }
+
+    allocation_sampler_.Initialize(
+        this->info_, config_.allocation_sampling_interval,
+        live_heap_.IsEnabled() ? &live_heap_ : nullptr);
+  }
+
+  if (config_.gc_timeline_enabled) {
+    Info("GC pause timeline enabled.");
+    gc_timeline_.Initialize(this->info_);
+  }
+
+  if (config_.exception_counting_enabled) {
+    exception_counter_.Initialize(this->info_);
+  }
+
+  if (config_.runtime_metrics_enabled) {
+    runtime_metrics_.Initialize(&gc_timeline_,
+                                config_.runtime_metrics_interval);
+  }
+
+  if (config_.jit_statistics_enabled) {
+    jit_statistics_.Initialize(this->info_,
+                               config_.jit_statistics_top_methods);
+  }
+
+  if (!config_.startup_methods_file.empty()) {
+    startup_recorder_.Initialize(&symbol_cache_, config_.startup_methods_file,
+                                 config_.startup_window_ms,
+                                 MonotonicNanoseconds());
+  }
+
+  if (info12 != nullptr) {
+    runtime_events_.Start(info12, MonotonicNanoseconds());
+  }
+
+  if (config_.thread_pool_watchdog_enabled) {
+    thread_pool_watchdog_.Initialize(this->info_, info10, &symbol_cache_,
+                                     config_.thread_pool_watchdog_interval);
+  }
+
+  if (info4 != nullptr) {
+    codegen_control_.Initialize(
+        info4, overhead_budget_.IsEnabled() ? &overhead_budget_ : nullptr);
+  }
+
+  // the maps of ReJIT versions are only available through ICorProfilerInfo4
+  ICorProfilerInfo4* il_map_info = info4;
+  if (il_map_info == nullptr &&
+      FAILED(cor_profiler_info_unknown->QueryInterface<ICorProfilerInfo4>(
+          &il_map_info))) {
+    il_map_info = nullptr;
+  }
+  if (il_map_info != nullptr) {
+    // the native bodies of tiered compilation are only available through
+    // ICorProfilerInfo9, since .NET Core 3.0
+    ICorProfilerInfo9* il_map_info9 = nullptr;
+    if (FAILED(cor_profiler_info_unknown->QueryInterface<ICorProfilerInfo9>(
+            &il_map_info9))) {
+      il_map_info9 = nullptr;
+    }
+    il_map_cache_.Initialize(il_map_info, il_map_info9);
+  }
+
+  if (!config_.timed_methods.IsEmpty()) {
+    // failures are logged, the rest of the profiler works without it
+    method_timing_.Initialize(this->info_, &symbol_cache_,
+                              config_.timed_methods);
+  }
+
+  // the flush thread only starts once traces are enqueued
+  agent_transport_.Configure(config_.agent_endpoint);
+
+  // likewise, nothing is sent until a metric is recorded
+  dogstatsd_.Configure(config_.agent_endpoint.host, config_.dogstatsd_port,
+                       config_.dogstatsd_flush_interval);
+
   // we're in!
   Info("Profiler attached.");
   this->info_->AddRef();
@@ -191,6 +340,9 @@ HRESULT STDMETHODCALLTYPE CorProfiler::AssemblyLoadFinished(AssemblyID assembly_
     return S_OK;
   }
 
+  OverheadScope overhead(runtime_metrics_, &overhead_budget_);
+  runtime_metrics_.OnAssemblyLoaded();
+
   if (!is_attached_) {
     return S_OK;
   }
@@ -261,6 +413,12 @@ HRESULT STDMETHODCALLTYPE CorProfiler::AssemblyLoadFinished(AssemblyID assembly_
   return S_OK;
 }
 
+HRESULT STDMETHODCALLTYPE
+CorProfiler::AssemblyUnloadStarted(AssemblyID assembly_id) {
+  runtime_metrics_.OnAssemblyUnloaded();
+  return CorProfilerBase::AssemblyUnloadStarted(assembly_id);
+}
+
 HRESULT STDMETHODCALLTYPE CorProfiler::ModuleLoadFinished(ModuleID module_id,
                                                           HRESULT hr_status) {
   if (FAILED(hr_status)) {
@@ -270,6 +428,14 @@ HRESULT STDMETHODCALLTYPE CorProfiler::ModuleLoadFinished(ModuleID module_id,
     return S_OK;
   }
 
+  OverheadScope overhead(runtime_metrics_, &overhead_budget_);
+  runtime_metrics_.OnModuleLoaded();
+
+  const auto span_context = CurrentSpanContextSlot();
+  if (span_context != nullptr) {
+    span_context->AddModuleLoad();
+  }
+
   if (!is_attached_) {
     return S_OK;
   }
@@ -289,6 +455,11 @@ HRESULT STDMETHODCALLTYPE CorProfiler::ModuleLoadFinished(ModuleID module_id,
           module_info.assembly.app_domain_name);
   }
 
+  if (startup_recorder_.IsEnabled()) {
+    startup_recorder_.OnModuleLoaded(module_id, module_info.assembly.name,
+                                     module_info.path, MonotonicNanoseconds());
+  }
+
   AppDomainID app_domain_id = module_info.assembly.app_domain_id;
 
   // Identify the AppDomain ID of mscorlib which will be the Shared Domain
@@ -352,18 +523,39 @@ HRESULT STDMETHODCALLTYPE CorProfiler::ModuleLoadFinished(ModuleID module_id,
     }
   }
 
-  std::vector<IntegrationMethod> filtered_integrations =
-      FlattenIntegrations(integrations_);
-
-  filtered_integrations =
-      FilterIntegrationsByCaller(filtered_integrations, module_info.assembly);
-  if (filtered_integrations.empty()) {
+  if (!rules_->HasCallerRules(module_info.assembly.name)) {
     // we don't need to instrument anything in this module, skip it
     Debug("ModuleLoadFinished skipping module (filtered by caller): ",
           module_id, " ", module_info.assembly.name);
     return S_OK;
   }
 
+  // read the tables straight from the module's file when possible, so
+  // modules without targets are skipped before asking for metadata interfaces
+  MetadataReader metadata_reader;
+  const bool has_metadata_reader =
+      (module_info.flags & COR_PRF_MODULE_DISK) != 0 &&
+      (module_info.flags & COR_PRF_MODULE_DYNAMIC) == 0 &&
+      metadata_reader.Open(module_info.path);
+
+  // don't skip Microsoft.AspNetCore.Hosting so we can run the startup hook and
+  // subscribe to DiagnosticSource events
+  const bool filter_by_target =
+      module_info.assembly.name != "Microsoft.AspNetCore.Hosting"_W;
+
+  IntegrationRuleSet::Selection rule_selection;
+  if (has_metadata_reader) {
+    rule_selection = rules_->Select(module_info.assembly.name,
+                                    GetModuleAssemblies(metadata_reader));
+
+    if (filter_by_target && rule_selection.IsEmpty()) {
+      // we don't need to instrument anything in this module, skip it
+      Debug("ModuleLoadFinished skipping module (filtered by target): ",
+            module_id, " ", module_info.assembly.name);
+      return S_OK;
+    }
+  }
+
   ComPtr<IUnknown> metadata_interfaces;
   auto hr = this->info_->GetModuleMetaData(module_id, ofRead | ofWrite,
                                            IID_IMetaDataImport2,
@@ -384,13 +576,12 @@ HRESULT STDMETHODCALLTYPE CorProfiler::ModuleLoadFinished(ModuleID module_id,
   const auto assembly_emit =
       metadata_interfaces.As<IMetaDataAssemblyEmit>(IID_IMetaDataAssemblyEmit);
 
-  // don't skip Microsoft.AspNetCore.Hosting so we can run the startup hook and
-  // subscribe to DiagnosticSource events
-  if (module_info.assembly.name != "Microsoft.AspNetCore.Hosting"_W) {
-    filtered_integrations =
-        FilterIntegrationsByTarget(filtered_integrations, assembly_import);
+  // fall back to the metadata interfaces for dynamic and in-memory modules
+  if (!has_metadata_reader) {
+    rule_selection = rules_->Select(module_info.assembly.name,
+                                    GetModuleAssemblies(assembly_import));
 
-    if (filtered_integrations.empty()) {
+    if (filter_by_target && rule_selection.IsEmpty()) {
       // we don't need to instrument anything in this module, skip it
       Debug("ModuleLoadFinished skipping module (filtered by target): ",
             module_id, " ", module_info.assembly.name);
@@ -398,6 +589,8 @@ HRESULT STDMETHODCALLTYPE CorProfiler::ModuleLoadFinished(ModuleID module_id,
     }
   }
 
+  const auto filtered_integrations = rules_->GetIntegrations(rule_selection);
+
   mdModule module;
   hr = metadata_import->GetModuleFromScope(&module);
   if (FAILED(hr)) {
@@ -418,6 +611,16 @@ HRESULT STDMETHODCALLTYPE CorProfiler::ModuleLoadFinished(ModuleID module_id,
       metadata_import, metadata_emit, assembly_import, assembly_emit,
       module_info.assembly.name, app_domain_id,
       module_version_id, filtered_integrations);
+  module_metadata->rules = rules_;
+  module_metadata->rule_selection = rule_selection;
+  module_metadata->last_used_ns = MonotonicNanoseconds();
+
+  // the triage only speeds up JIT compilation: skip it while over budget
+  if (has_metadata_reader && !overhead_budget_.SkipAnalysis()) {
+    module_metadata->call_target_tokens =
+        FindCallTargetTokens(filtered_integrations, metadata_reader);
+    module_metadata->has_call_target_tokens = true;
+  }
 
   // store module info for later lookup
   module_id_to_info_map_[module_id] = module_metadata;
@@ -430,6 +633,8 @@ HRESULT STDMETHODCALLTYPE CorProfiler::ModuleLoadFinished(ModuleID module_id,
 }
 
 HRESULT STDMETHODCALLTYPE CorProfiler::ModuleUnloadStarted(ModuleID module_id) {
+  runtime_metrics_.OnModuleUnloaded();
+
   if (debug_logging_enabled) {
     const auto module_info = GetModuleInfo(this->info_, module_id);
 
@@ -460,12 +665,31 @@ HRESULT STDMETHODCALLTYPE CorProfiler::ModuleUnloadStarted(ModuleID module_id) {
     delete metadata;
   }
 
+  symbol_cache_.EvictModule(module_id);
+  codegen_control_.EvictModule(module_id);
+  il_map_cache_.EvictModule(module_id);
+  startup_recorder_.EvictModule(module_id);
+  jit_statistics_.EvictModule(module_id);
+
   return S_OK;
 }
 
 HRESULT STDMETHODCALLTYPE CorProfiler::Shutdown() {
   CorProfilerBase::Shutdown();
 
+  runtime_metrics_.Stop();
+  thread_pool_watchdog_.Stop();
+  runtime_events_.Stop();
+  method_timing_.Stop();
+  codegen_control_.Stop();
+  agent_transport_.Stop();
+  dogstatsd_.Stop();
+
+  jit_statistics_.LogSummary(&symbol_cache_);
+  if (startup_recorder_.IsEnabled()) {
+    startup_recorder_.Write();
+  }
+
   // keep this lock until we are done using the module,
   // to prevent it from unloading while in use
   std::lock_guard<std::mutex> guard(module_id_to_info_map_lock_);
@@ -476,10 +700,26 @@ HRESULT STDMETHODCALLTYPE CorProfiler::Shutdown() {
 
 HRESULT STDMETHODCALLTYPE CorProfiler::JITCompilationStarted(
     FunctionID function_id, BOOL is_safe_to_block) {
+  runtime_metrics_.OnJitStarted();
+
+  if (startup_recorder_.IsRecording()) {
+    // the module, so that its methods can be evicted when it unloads
+    ModuleID recorded_module_id = 0;
+    if (SUCCEEDED(this->info_->GetFunctionInfo(
+            function_id, nullptr, &recorded_module_id, nullptr))) {
+      startup_recorder_.OnJitStarted(function_id, recorded_module_id,
+                                     MonotonicNanoseconds());
+    }
+  }
+
+  JitInstrumentationScope jit_scope(jit_statistics_, function_id);
+
   if (!is_attached_ || !is_safe_to_block) {
     return S_OK;
   }
 
+  OverheadScope overhead(runtime_metrics_, &overhead_budget_);
+
   // keep this lock until we are done using the module,
   // to prevent it from unloading while in use
   std::lock_guard<std::mutex> guard(module_id_to_info_map_lock_);
@@ -491,12 +731,403 @@ HRESULT STDMETHODCALLTYPE CorProfiler::JITCompilationStarted(
                                             &function_token);
   RETURN_OK_IF_FAILED(hr);
 
-  // Verify that we have the metadata for this module
-  ModuleMetadata* module_metadata = nullptr;
-  if (module_id_to_info_map_.count(module_id) > 0) {
-    module_metadata = module_id_to_info_map_[module_id];
+  CompactIdleModules();
+
+  // over budget, low-priority integrations are deferred to a ReJIT
+  const auto pass = codegen_control_.IsEnabled() &&
+                            !config_.low_priority_integrations.empty() &&
+                            overhead_budget_.IsThrottled()
+                        ? ReplacementPass::kEssential
+                        : ReplacementPass::kAll;
+
+  bool rewritten = false;
+  bool deferred = false;
+  InstrumentMethod(function_id, module_id, function_token, pass, &rewritten,
+                   &deferred);
+
+  if (rewritten) {
+    overhead_budget_.AddRewrite();
+  }
+
+  if (!codegen_control_.IsEnabled()) {
+    return S_OK;
+  }
+
+  // with DD_CLR_DISABLE_REWRITTEN_OPTIMIZATIONS or
+  // DD_CLR_DISABLE_OPTIMIZATIONS_METHODS, the method is compiled again
+  // without optimizations. Queued last, once its IL is final.
+  uint32_t codegen_flags = 0;
+  if (rewritten) {
+    codegen_flags |= kCodegenRewritten;
+  }
+  if (!config_.disable_optimizations &&
+      ((rewritten && config_.disable_rewritten_optimizations) ||
+       IsUnoptimizedMethod(function_id))) {
+    codegen_flags |= kCodegenUnoptimized;
+  }
+  if (deferred) {
+    codegen_flags |= kCodegenDeferred;
+    overhead_budget_.OnMethodDeferred();
+  }
+
+  if ((codegen_flags & (kCodegenUnoptimized | kCodegenDeferred)) != 0 &&
+      codegen_control_.Add(module_id, function_token, codegen_flags) &&
+      debug_logging_enabled) {
+    Debug("JITCompilationStarted: recompiling with ReJIT. function_id=",
+          function_id, " token=", function_token, " flags=", codegen_flags);
+  }
+
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE CorProfiler::JITCompilationFinished(
+    FunctionID function_id, HRESULT hr_status, BOOL is_safe_to_block) {
+  const auto duration_ns = runtime_metrics_.OnJitFinished();
+
+  if (jit_statistics_.IsEnabled()) {
+    jit_statistics_.OnJitFinished(function_id, hr_status,
+                                  MonotonicNanoseconds());
+  }
+
+  const auto span_context = CurrentSpanContextSlot();
+  if (span_context != nullptr && duration_ns != 0) {
+    span_context->AddJit(duration_ns);
+  }
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE CorProfiler::EventPipeEventDelivered(
+    EVENTPIPE_PROVIDER provider, DWORD event_id, DWORD event_version,
+    ULONG metadata_size, LPCBYTE metadata, ULONG event_data_size,
+    LPCBYTE event_data, LPCGUID activity_id, LPCGUID related_activity_id,
+    ThreadID event_thread, ULONG stack_frame_count, UINT_PTR stack_frames[]) {
+  // the runtime provider is the only one enabled in our session
+  if (runtime_events_.IsEnabled()) {
+    runtime_events_.OnEvent(event_id, event_version, event_data,
+                            event_data_size, stack_frames, stack_frame_count,
+                            MonotonicNanoseconds());
+  }
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE CorProfiler::GetReJITParameters(
+    ModuleID module_id, mdMethodDef method_def,
+    ICorProfilerFunctionControl* function_control) {
+  uint32_t codegen_flags = 0;
+  if (!codegen_control_.Find(module_id, method_def, &codegen_flags)) {
+    return S_OK;
+  }
+
+  bool il_set = false;
+  if ((codegen_flags & kCodegenDeferred) != 0) {
+    OverheadScope overhead(runtime_metrics_, &overhead_budget_);
+    ApplyDeferredIntegrations(module_id, method_def, function_control,
+                              &il_set);
+  }
+
+  return codegen_control_.GetReJITParameters(module_id, method_def,
+                                             function_control, il_set);
+}
+
+HRESULT STDMETHODCALLTYPE CorProfiler::ReJITError(ModuleID module_id,
+                                                  mdMethodDef method_def,
+                                                  FunctionID function_id,
+                                                  HRESULT hr_status) {
+  codegen_control_.OnReJITError(module_id, method_def, hr_status);
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE CorProfiler::ThreadCreated(ThreadID thread_id) {
+  runtime_metrics_.OnThreadCreated();
+
+  if (thread_pool_watchdog_.IsEnabled()) {
+    thread_pool_watchdog_.OnThreadCreated(thread_id);
+  }
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE CorProfiler::ThreadDestroyed(ThreadID thread_id) {
+  runtime_metrics_.OnThreadDestroyed();
+  span_contexts_.Release(thread_id);
+
+  if (thread_pool_watchdog_.IsEnabled()) {
+    thread_pool_watchdog_.OnThreadDestroyed(thread_id);
+  }
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE
+CorProfiler::ThreadAssignedToOSThread(ThreadID thread_id, DWORD os_thread_id) {
+  if (thread_pool_watchdog_.IsEnabled()) {
+    thread_pool_watchdog_.OnThreadAssignedToOSThread(thread_id, os_thread_id);
+  }
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE CorProfiler::ThreadNameChanged(ThreadID thread_id,
+                                                         ULONG name_length,
+                                                         WCHAR name[]) {
+  // name is null when the name is cleared
+  if (thread_pool_watchdog_.IsEnabled() && name != nullptr) {
+    thread_pool_watchdog_.OnThreadNameChanged(thread_id,
+                                              WSTRING(name, name_length));
+  }
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE CorProfiler::ObjectAllocated(ObjectID object_id,
+                                                       ClassID class_id) {
+  // called for every allocation: no logging here
+  allocation_sampler_.OnObjectAllocated(object_id, class_id);
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE
+CorProfiler::RuntimeSuspendStarted(COR_PRF_SUSPEND_REASON suspend_reason) {
+  gc_timeline_.OnRuntimeSuspendStarted(suspend_reason);
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE CorProfiler::RuntimeSuspendFinished() {
+  gc_timeline_.OnRuntimeSuspendFinished();
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE CorProfiler::RuntimeSuspendAborted() {
+  gc_timeline_.OnRuntimeSuspendAborted();
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE CorProfiler::RuntimeResumeStarted() {
+  gc_timeline_.OnRuntimeResumeStarted();
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE CorProfiler::GarbageCollectionStarted(
+    int generation_count, BOOL generation_collected[],
+    COR_PRF_GC_REASON reason) {
+  gc_timeline_.OnGarbageCollectionStarted(generation_count,
+                                          generation_collected, reason);
+  live_heap_.OnGarbageCollectionStarted(this->info_, generation_count,
+                                        generation_collected);
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE CorProfiler::GarbageCollectionFinished() {
+  gc_timeline_.OnGarbageCollectionFinished();
+
+  if (live_heap_.IsEnabled()) {
+    live_heap_.OnGarbageCollectionFinished(UnixNanoseconds());
+  }
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE CorProfiler::MovedReferences2(
+    ULONG range_count, ObjectID old_object_id_range_start[],
+    ObjectID new_object_id_range_start[], SIZE_T object_id_range_length[]) {
+  if (live_heap_.IsEnabled()) {
+    live_heap_.OnMovedReferences(range_count, old_object_id_range_start,
+                                 new_object_id_range_start,
+                                 object_id_range_length);
+  }
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE CorProfiler::SurvivingReferences2(
+    ULONG range_count, ObjectID object_id_range_start[],
+    SIZE_T object_id_range_length[]) {
+  if (live_heap_.IsEnabled()) {
+    live_heap_.OnSurvivingReferences(range_count, object_id_range_start,
+                                     object_id_range_length);
+  }
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE
+CorProfiler::ExceptionThrown(ObjectID thrown_object_id) {
+  // no logging here: exception storms would flood the log
+  exception_counter_.OnExceptionThrown(thrown_object_id);
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE
+CorProfiler::ExceptionSearchFunctionEnter(FunctionID function_id) {
+  exception_counter_.OnExceptionSearchFunctionEnter(function_id);
+  return S_OK;
+}
+
+bool CorProfiler::IsAttached() const { return is_attached_; }
+
+size_t CorProfiler::GetAllocationSamples(AllocationSample* samples,
+                                         size_t max_samples) {
+  return allocation_sampler_.Drain(samples, max_samples);
+}
+
+size_t CorProfiler::GetLiveHeap(LiveHeapStats* stats, LiveHeapSite* sites,
+                                size_t max_sites) const {
+  return live_heap_.Read(stats, sites, max_sites);
+}
+
+bool CorProfiler::GetJitStatistics(JitSummary* summary) const {
+  if (!jit_statistics_.IsEnabled()) {
+    return false;
   }
 
+  jit_statistics_.GetSummary(summary);
+  return true;
+}
+
+size_t CorProfiler::GetJitModules(JitModuleStats* modules,
+                                  size_t max_modules) const {
+  return jit_statistics_.GetModules(modules, max_modules);
+}
+
+size_t CorProfiler::GetSlowestJitMethods(JitMethodTime* methods,
+                                         size_t max_methods) const {
+  return jit_statistics_.GetSlowestMethods(methods, max_methods);
+}
+
+bool CorProfiler::WriteStartupMethods() {
+  return startup_recorder_.IsEnabled() && startup_recorder_.Write();
+}
+
+size_t CorProfiler::GetRuntimeEvents(RuntimeEventStats* stats,
+                                     ContentionSite* sites,
+                                     size_t max_sites) const {
+  return runtime_events_.Read(stats, sites, max_sites, MonotonicNanoseconds());
+}
+
+size_t CorProfiler::GetILOffsets(const uint64_t* ips,
+                                 ILOffsetLocation* locations, size_t count) {
+  size_t resolved = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (il_map_cache_.LookupIP(static_cast<UINT_PTR>(ips[i]),
+                               &locations[i])) {
+      resolved++;
+    } else {
+      locations[i] = ILOffsetLocation{};
+    }
+  }
+  return resolved;
+}
+
+size_t CorProfiler::GetGcPauses(uint64_t* cursor, GcPause* pauses,
+                                size_t max_pauses) const {
+  return gc_timeline_.Read(cursor, pauses, max_pauses);
+}
+
+size_t CorProfiler::GetExceptionCounts(ExceptionCount* counts,
+                                       size_t max_counts) const {
+  return exception_counter_.Snapshot(counts, max_counts);
+}
+
+bool CorProfiler::GetRuntimeMetrics(RuntimeMetricsSnapshot* metrics) const {
+  return runtime_metrics_.IsEnabled() && runtime_metrics_.Read(metrics);
+}
+
+void CorProfiler::SetCurrentSpanContext(uint64_t trace_id, uint64_t span_id) {
+  auto slot = CurrentSpanContextSlot();
+
+  if (slot == nullptr) {
+    // first span of the thread: only then is its ThreadID needed
+    ThreadID thread_id;
+    if (!span_contexts_.IsEnabled() ||
+        FAILED(this->info_->GetCurrentThreadID(&thread_id))) {
+      return;
+    }
+
+    slot = span_contexts_.Acquire(thread_id);
+    if (slot == nullptr) {
+      return;
+    }
+  }
+
+  slot->Set(trace_id, span_id);
+}
+
+bool CorProfiler::GetCurrentSpanNativeCost(SpanNativeCost* cost) const {
+  const auto slot = CurrentSpanContextSlot();
+  if (slot == nullptr) {
+    return false;
+  }
+
+  slot->ReadCost(cost);
+  return true;
+}
+
+bool CorProfiler::GetThreadPoolWatchdogStats(
+    ThreadPoolWatchdogStats* stats) const {
+  if (!thread_pool_watchdog_.IsEnabled()) {
+    return false;
+  }
+
+  thread_pool_watchdog_.GetStats(stats);
+  return true;
+}
+
+size_t CorProfiler::GetThreadPoolStarvationEvents(uint64_t* cursor,
+                                                  StarvationEvent* events,
+                                                  size_t max_events) const {
+  return thread_pool_watchdog_.Read(cursor, events, max_events);
+}
+
+void CorProfiler::GetOverheadBudgetStats(OverheadBudgetStats* stats) const {
+  overhead_budget_.Read(stats);
+}
+
+size_t CorProfiler::GetModuleMemory(ModuleMemoryStats* stats,
+                                    ModuleMemoryUsage* modules,
+                                    size_t max_modules) {
+  std::lock_guard<std::mutex> guard(module_id_to_info_map_lock_);
+
+  *stats = ModuleMemoryStats{};
+  stats->shared_bytes = rules_ != nullptr ? rules_->MemoryUsage() : 0;
+  stats->compactions = module_compactions_;
+  stats->reacquisitions = module_reacquisitions_;
+
+  const auto now = MonotonicNanoseconds();
+  size_t count = 0;
+
+  for (const auto& entry : module_id_to_info_map_) {
+    const auto module_metadata = entry.second;
+    const auto bytes = module_metadata->MemoryUsage();
+
+    stats->module_count++;
+    stats->module_bytes += bytes;
+    if (module_metadata->compacted) {
+      stats->compacted_module_count++;
+    }
+
+    if (count < max_modules) {
+      auto& usage = modules[count++];
+      usage.module_id = entry.first;
+      usage.app_domain_id = module_metadata->app_domain_id;
+      usage.bytes = bytes;
+      usage.idle_ms = (now - module_metadata->last_used_ns) / 1000000;
+      usage.compacted = module_metadata->compacted ? 1 : 0;
+    }
+  }
+
+  return count;
+}
+
+size_t CorProfiler::GetMethodLatencies(MethodLatency* latencies,
+                                       size_t max_latencies) {
+  return method_timing_.Snapshot(latencies, max_latencies);
+}
+
+//
+// Helper methods
+//
+HRESULT CorProfiler::InstrumentMethod(const FunctionID function_id,
+                                      const ModuleID module_id,
+                                      const mdToken function_token,
+                                      const ReplacementPass pass,
+                                      bool* rewritten, bool* deferred) {
+  HRESULT hr = S_OK;
+
+  // Verify that we have the metadata for this module
+  ModuleMetadata* module_metadata = GetModuleMetadata(module_id);
   if (module_metadata == nullptr) {
     // we haven't stored a ModuleMetadata for this module,
     // so we can't modify its IL
@@ -525,7 +1156,10 @@ HRESULT STDMETHODCALLTYPE CorProfiler::JITCompilationStarted(
     first_jit_compilation_app_domains.insert(module_metadata->app_domain_id);
     hr = RunILStartupHook(module_metadata->metadata_emit, module_id,
                           function_token);
-    RETURN_OK_IF_FAILED(hr);
+    if (SUCCEEDED(hr)) {
+      // the hook is inserted in the method's IL
+      *rewritten = true;
+    }
   }
 
   // we don't actually need to instrument anything in
@@ -548,7 +1182,8 @@ HRESULT STDMETHODCALLTYPE CorProfiler::JITCompilationStarted(
                              module_id,
                              function_token,
                              caller,
-                             method_replacements);
+                             method_replacements,
+                             rewritten);
   RETURN_OK_IF_FAILED(hr);
 
   // Perform method replacement calls
@@ -557,157 +1192,210 @@ HRESULT STDMETHODCALLTYPE CorProfiler::JITCompilationStarted(
                              module_id,
                              function_token,
                              caller,
-                             method_replacements);
+                             pass,
+                             nullptr,
+                             rewritten,
+                             deferred);
   RETURN_OK_IF_FAILED(hr);
 
   return S_OK;
 }
 
-bool CorProfiler::IsAttached() const { return is_attached_; }
+HRESULT CorProfiler::ApplyDeferredIntegrations(
+    const ModuleID module_id, const mdMethodDef method_def,
+    ICorProfilerFunctionControl* function_control, bool* rewritten) {
+  // keep this lock until we are done using the module,
+  // to prevent it from unloading while in use
+  std::lock_guard<std::mutex> guard(module_id_to_info_map_lock_);
+
+  if (!is_attached_) {
+    return S_OK;
+  }
+
+  ModuleMetadata* module_metadata = GetModuleMetadata(module_id);
+  if (module_metadata == nullptr) {
+    return S_OK;
+  }
+
+  const auto caller =
+      GetFunctionInfo(module_metadata->metadata_import, method_def);
+  if (!caller.IsValid()) {
+    return S_OK;
+  }
+
+  // GetILFunctionBody returns the IL of the first compilation, with the
+  // essential integrations already applied
+  bool deferred = false;
+  return ProcessReplacementCalls(module_metadata, 0, module_id, method_def,
+                                 caller, ReplacementPass::kDeferred,
+                                 function_control, rewritten, &deferred);
+}
+
+ModuleMetadata* CorProfiler::GetModuleMetadata(ModuleID module_id) {
+  const auto it = module_id_to_info_map_.find(module_id);
+  if (it == module_id_to_info_map_.end()) {
+    return nullptr;
+  }
+
+  ModuleMetadata* module_metadata = it->second;
+  if (module_metadata->compacted) {
+    const auto hr = module_metadata->Reacquire(this->info_, module_id);
+    if (FAILED(hr)) {
+      Warn("Unable to reacquire the metadata interfaces of compacted module ",
+           module_id, " ", module_metadata->assemblyName, ". hr=", hr);
+      return nullptr;
+    }
+
+    module_reacquisitions_++;
+    if (debug_logging_enabled) {
+      Debug("Reacquired the metadata interfaces of module ", module_id, " ",
+            module_metadata->assemblyName);
+    }
+  }
+
+  module_metadata->last_used_ns = MonotonicNanoseconds();
+  return module_metadata;
+}
+
+void CorProfiler::CompactIdleModules() {
+  if (module_idle_timeout_ns_ == 0) {
+    return;
+  }
+
+  const auto now_ns = MonotonicNanoseconds();
+  if (now_ns < next_module_sweep_ns_) {
+    return;
+  }
+
+  next_module_sweep_ns_ = now_ns + module_idle_timeout_ns_ / 2;
+
+  size_t count = 0;
+  for (const auto& entry : module_id_to_info_map_) {
+    const auto module_metadata = entry.second;
+    if (now_ns - module_metadata->last_used_ns >= module_idle_timeout_ns_ &&
+        module_metadata->Compact()) {
+      count++;
+    }
+  }
+
+  if (count > 0) {
+    module_compactions_ += count;
+    if (debug_logging_enabled) {
+      Debug("Compacted ", count, " idle modules.");
+    }
+  }
+}
+
+bool CorProfiler::IsUnoptimizedMethod(FunctionID function_id) {
+  if (config_.unoptimized_methods.IsEmpty()) {
+    return false;
+  }
+
+  const auto symbol = symbol_cache_.GetOrResolve(function_id);
+  return symbol != nullptr && symbol->name != nullptr &&
+         config_.unoptimized_methods.Matches(*symbol->name);
+}
 
-//
-// Helper methods
-//
 HRESULT CorProfiler::ProcessReplacementCalls(
     ModuleMetadata* module_metadata,
     const FunctionID function_id,
     const ModuleID module_id,
     const mdToken function_token,
     const trace::FunctionInfo& caller,
-    const std::vector<MethodReplacement> method_replacements) {
-  ILRewriter rewriter(this->info_, nullptr, module_id, function_token);
+    const ReplacementPass pass,
+    ICorProfilerFunctionControl* function_control,
+    bool* rewritten,
+    bool* deferred) {
+  if (module_metadata->rules == nullptr) {
+    return S_OK;
+  }
+
+  ILRewriter rewriter(this->info_, function_control, module_id,
+                      function_token);
   bool modified = false;
 
   auto hr = rewriter.Import();
   RETURN_OK_IF_FAILED(hr);
 
-  // Perform method call replacements
-  for (auto& method_replacement : method_replacements) {
-    // Exit early if the method replacement isn't actually doing a replacement
-    if (method_replacement.wrapper_method.action != "ReplaceTargetMethod"_W) {
+  const auto caller_match =
+      module_metadata->rules->MatchCaller(caller.type.name, caller.name);
+  std::vector<const IntegrationRule*> candidates;
+  std::vector<WSTRING> actual_sig;
+
+  // for each IL instruction
+  for (ILInstr* pInstr = rewriter.GetILList()->m_pNext;
+       pInstr != rewriter.GetILList(); pInstr = pInstr->m_pNext) {
+    // only CALL or CALLVIRT
+    if (pInstr->m_opcode != CEE_CALL && pInstr->m_opcode != CEE_CALLVIRT) {
       continue;
     }
 
-    const auto& wrapper_method_key =
-        method_replacement.wrapper_method.get_method_cache_key();
-    // Exit early if we previously failed to store the method ref for this wrapper_method
-    if (module_metadata->IsFailedWrapperMemberKey(wrapper_method_key)) {
+    // skip calls that can't reach a target without a metadata lookup
+    if (module_metadata->has_call_target_tokens &&
+        module_metadata->call_target_tokens.count(pInstr->m_Arg32) == 0) {
       continue;
     }
 
-    // for each IL instruction
-    for (ILInstr* pInstr = rewriter.GetILList()->m_pNext;
-         pInstr != rewriter.GetILList(); pInstr = pInstr->m_pNext) {
-      // only CALL or CALLVIRT
-      if (pInstr->m_opcode != CEE_CALL && pInstr->m_opcode != CEE_CALLVIRT) {
-        continue;
-      }
+    // get the target function info, continue if its invalid
+    auto target =
+        GetFunctionInfo(module_metadata->metadata_import, pInstr->m_Arg32);
+    if (!target.IsValid()) {
+      continue;
+    }
 
-      // get the target function info, continue if its invalid
-      auto target =
-          GetFunctionInfo(module_metadata->metadata_import, pInstr->m_Arg32);
-      if (!target.IsValid()) {
-        continue;
-      }
+    // look up the replacements of this type and method name taking as many
+    // arguments. We always pass the instance as the first argument.
+    auto target_arity = static_cast<int>(target.signature.NumberOfArguments());
+    if (target.signature.IsInstanceMethod()) {
+      target_arity++;
+    }
 
-      // make sure the type and method names match
-      if (method_replacement.target_method.type_name != target.type.name ||
-          method_replacement.target_method.method_name != target.name) {
-        continue;
-      }
+    candidates.clear();
+    module_metadata->rules->FindReplacements(
+        module_metadata->rule_selection, target.type.name, target.name,
+        target_arity, &candidates);
 
-      // we add 3 parameters to every wrapper method: opcode, mdToken, and
-      // module_version_id
-      const short added_parameters_count = 3;
+    bool parsed_signature = false;
+    bool successfully_parsed_signature = false;
 
-      auto wrapper_method_signature_size =
-          method_replacement.wrapper_method.method_signature.data.size();
-
-      if (wrapper_method_signature_size < (added_parameters_count + 3)) {
-        // wrapper signature must have at least 6 bytes
-        // 0:{CallingConvention}|1:{ParamCount}|2:{ReturnType}|3:{OpCode}|4:{mdToken}|5:{ModuleVersionId}
-        if (debug_logging_enabled) {
-          Debug(
-              "JITCompilationStarted skipping function call: wrapper signature "
-              "too short. function_id=",
-              function_id, " token=", function_token,
-              " wrapper_method=", method_replacement.wrapper_method.type_name,
-              ".", method_replacement.wrapper_method.method_name,
-              "() wrapper_method_signature_size=",
-              wrapper_method_signature_size);
-        }
+    // the first matching replacement wins
+    for (const auto rule : candidates) {
+      const auto& method_replacement = rule->integration.replacement;
 
+      if (!module_metadata->rules->MatchesCaller(*rule, caller_match)) {
         continue;
       }
 
-      auto expected_number_args = method_replacement.wrapper_method
-                                      .method_signature.NumberOfArguments();
-
-      // subtract the last arguments we add to every wrapper
-      expected_number_args = expected_number_args - added_parameters_count;
-
-      if (target.signature.IsInstanceMethod()) {
-        // We always pass the instance as the first argument
-        expected_number_args--;
+      if (rule->low_priority && pass == ReplacementPass::kEssential) {
+        *deferred = true;
+        continue;
       }
 
-      auto target_arg_count = target.signature.NumberOfArguments();
-
-      if (expected_number_args != target_arg_count) {
-        // Number of arguments does not match our wrapper method
-        if (debug_logging_enabled) {
-          Debug(
-              "JITCompilationStarted skipping function call: argument counts "
-              "don't match. function_id=",
-              function_id, " token=", function_token,
-              " target_name=", target.type.name, ".", target.name,
-              "() expected_number_args=", expected_number_args,
-              " target_arg_count=", target_arg_count);
-        }
-
+      if (!rule->low_priority && pass == ReplacementPass::kDeferred) {
         continue;
       }
 
-      // Resolve the MethodRef now. If the method is generic, we'll need to use it
-      // to define a MethodSpec
-      // Generate a method ref token for the wrapper method
-      mdMemberRef wrapper_method_ref = mdMemberRefNil;
-      auto generated_wrapper_method_ref = GetWrapperMethodRef(module_metadata,
-                                                              module_id,
-                                                              method_replacement,
-                                                              wrapper_method_ref);
-      if (!generated_wrapper_method_ref) {
-        Warn(
-          "JITCompilationStarted failed to obtain wrapper method ref for ",
-          method_replacement.wrapper_method.type_name, ".", method_replacement.wrapper_method.method_name, "().",
-          " function_id=", function_id, " function_token=", function_token,
-          " name=", caller.type.name, ".", caller.name, "()");
+      const auto& wrapper_method_key =
+          method_replacement.wrapper_method.get_method_cache_key();
+      // Exit early if we previously failed to store the method ref for this wrapper_method
+      if (module_metadata->IsFailedWrapperMemberKey(wrapper_method_key)) {
         continue;
       }
-      
-
-      auto method_def_md_token = target.id;
 
-      if (target.is_generic) {
-        if (target.signature.NumberOfTypeArguments() !=
-            method_replacement.wrapper_method.method_signature
-                .NumberOfTypeArguments()) {
-          // Number of generic arguments does not match our wrapper method
-          continue;
-        }
-
-        // we need to emit a method spec to populate the generic arguments
-        wrapper_method_ref =
-            DefineMethodSpec(module_metadata->metadata_emit, wrapper_method_ref,
-                             target.function_spec_signature);
-        method_def_md_token = target.method_def_id;
+      if (target.is_generic &&
+          target.signature.NumberOfTypeArguments() !=
+              method_replacement.wrapper_method.method_signature
+                  .NumberOfTypeArguments()) {
+        // Number of generic arguments does not match our wrapper method
+        continue;
       }
 
-      std::vector<WSTRING> actual_sig;
-      const auto successfully_parsed_signature = TryParseSignatureTypes(
-          module_metadata->metadata_import, target, actual_sig);
-      auto expected_sig =
-          method_replacement.target_method.signature_types;
+      if (!parsed_signature) {
+        parsed_signature = true;
+        actual_sig.clear();
+        successfully_parsed_signature = TryParseSignatureTypes(
+            module_metadata->metadata_import, target, actual_sig);
+      }
 
       if (!successfully_parsed_signature) {
         if (debug_logging_enabled) {
@@ -715,60 +1403,26 @@ HRESULT CorProfiler::ProcessReplacementCalls(
               "JITCompilationStarted skipping function call: failed to parse "
               "signature. function_id=",
               function_id, " token=", function_token,
-              " target_name=", target.type.name, ".", target.name, "()",
-              " successfully_parsed_signature=", successfully_parsed_signature,
-              " sig_types.size()=", actual_sig.size(),
-              " expected_sig_types.size()=", expected_sig.size());
+              " target_name=", target.type.name, ".", target.name, "()");
         }
 
-        continue;
+        break;
       }
 
-      if (actual_sig.size() != expected_sig.size()) {
+      if (!rule->MatchesSignature(actual_sig)) {
         // we can't safely assume our wrapper methods handle the types
         if (debug_logging_enabled) {
           Debug(
-              "JITCompilationStarted skipping function call: unexpected type "
-              "count. function_id=",
+              "JITCompilationStarted skipping function call: types don't "
+              "match. function_id=",
               function_id, " token=", function_token,
               " target_name=", target.type.name, ".", target.name,
-              "() successfully_parsed_signature=",
-              successfully_parsed_signature,
-              " sig_types.size()=", actual_sig.size(),
-              " expected_sig_types.size()=", expected_sig.size());
+              "() integration=", rule->integration.integration_name);
         }
 
         continue;
       }
 
-      auto is_match = true;
-      for (size_t i = 0; i < expected_sig.size(); i++) {
-        if (expected_sig[i] == "_"_W) {
-          // We are supposed to ignore this index
-          continue;
-        }
-        if (expected_sig[i] != actual_sig[i]) {
-          // we have a type mismatch, drop out
-          if (debug_logging_enabled) {
-            Debug(
-                "JITCompilationStarted skipping function call: types don't "
-                "match. function_id=",
-                function_id, " token=", function_token,
-                " target_name=", target.type.name, ".", target.name,
-                "() actual[", i, "]=", actual_sig[i], ", expected[",
-                i, "]=", expected_sig[i]);
-          }
-
-          is_match = false;
-          break;
-        }
-      }
-
-      if (!is_match) {
-        // signatures don't match
-        continue;
-      }
-
       // At this point we know we've hit a match. Error out if
       //   1) The target assembly is Datadog.Trace.ClrProfiler.Managed
       //   2) The managed profiler has not been loaded yet
@@ -800,6 +1454,33 @@ HRESULT CorProfiler::ProcessReplacementCalls(
         continue;
       }
 
+      // Resolve the MethodRef now. If the method is generic, we'll need to use it
+      // to define a MethodSpec
+      // Generate a method ref token for the wrapper method
+      mdMemberRef wrapper_method_ref = mdMemberRefNil;
+      auto generated_wrapper_method_ref = GetWrapperMethodRef(module_metadata,
+                                                              module_id,
+                                                              method_replacement,
+                                                              wrapper_method_ref);
+      if (!generated_wrapper_method_ref) {
+        Warn(
+          "JITCompilationStarted failed to obtain wrapper method ref for ",
+          method_replacement.wrapper_method.type_name, ".", method_replacement.wrapper_method.method_name, "().",
+          " function_id=", function_id, " function_token=", function_token,
+          " name=", caller.type.name, ".", caller.name, "()");
+        continue;
+      }
+
+      auto method_def_md_token = target.id;
+
+      if (target.is_generic) {
+        // we need to emit a method spec to populate the generic arguments
+        wrapper_method_ref =
+            DefineMethodSpec(module_metadata->metadata_emit, wrapper_method_ref,
+                             target.function_spec_signature);
+        method_def_md_token = target.method_def_id;
+      }
+
       const auto original_argument = pInstr->m_Arg32;
       const void* module_version_id_ptr = &module_metadata->module_version_id;
 
@@ -857,12 +1538,14 @@ HRESULT CorProfiler::ProcessReplacementCalls(
            method_replacement.wrapper_method.type_name, ".",
            method_replacement.wrapper_method.method_name, "() ",
            wrapper_method_ref);
+      break;
     }
   }
 
   if (modified) {
     hr = rewriter.Export();
     RETURN_OK_IF_FAILED(hr);
+    *rewritten = true;
   }
 
   return S_OK;
@@ -874,7 +1557,8 @@ HRESULT CorProfiler::ProcessInsertionCalls(
     const ModuleID module_id,
     const mdToken function_token,
     const FunctionInfo& caller,
-    const std::vector<MethodReplacement> method_replacements) {
+    const std::vector<MethodReplacement> method_replacements,
+    bool* rewritten) {
 
   ILRewriter rewriter(this->info_, nullptr, module_id, function_token);
   bool modified = false;
@@ -933,6 +1617,7 @@ HRESULT CorProfiler::ProcessInsertionCalls(
   if (modified) {
     hr = rewriter.Export();
     RETURN_IF_FAILED(hr);
+    *rewritten = true;
   }
 
   return S_OK;
@@ -1015,12 +1700,12 @@ HRESULT CorProfiler::RunILStartupHook(
   auto hr = GenerateVoidILStartupMethod(module_id, &ret_method_token);
   if (FAILED(hr)) {
     Warn("RunILStartupHook: Call to GenerateVoidILStartupMethod failed for ", module_id);
-    return S_OK;
+    return hr;
   }
 
   ILRewriter rewriter(this->info_, nullptr, module_id, function_token);
   hr = rewriter.Import();
-  RETURN_OK_IF_FAILED(hr);
+  RETURN_IF_FAILED(hr);
 
   ILRewriterWrapper rewriter_wrapper(&rewriter);
 
@@ -1029,7 +1714,7 @@ HRESULT CorProfiler::RunILStartupHook(
   rewriter_wrapper.SetILPosition(pInstr);
   rewriter_wrapper.CallMember(ret_method_token, false);
   hr = rewriter.Export();
-  RETURN_OK_IF_FAILED(hr);
+  RETURN_IF_FAILED(hr);
 
   return S_OK;
 }
@@ -1136,21 +1821,7 @@ HRESULT CorProfiler::GenerateVoidILStartupMethod(const ModuleID module_id,
   WSTRING native_profiler_file = "DATADOG.TRACE.CLRPROFILER.NATIVE.DLL"_W;
 #else // _WIN32
 
-#ifdef BIT64
-  WSTRING native_profiler_file = GetEnvironmentValue("CORECLR_PROFILER_PATH_64"_W);
-  Debug("GenerateVoidILStartupMethod: Linux: CORECLR_PROFILER_PATH_64 defined as: ", native_profiler_file);
-  if (native_profiler_file == ""_W) {
-    native_profiler_file = GetEnvironmentValue("CORECLR_PROFILER_PATH"_W);
-    Debug("GenerateVoidILStartupMethod: Linux: CORECLR_PROFILER_PATH defined as: ", native_profiler_file);
-  }
-#else // BIT64
-  WSTRING native_profiler_file = GetEnvironmentValue("CORECLR_PROFILER_PATH_32"_W);
-  Debug("GenerateVoidILStartupMethod: Linux: CORECLR_PROFILER_PATH_32 defined as: ", native_profiler_file);
-  if (native_profiler_file == ""_W) {
-    native_profiler_file = GetEnvironmentValue("CORECLR_PROFILER_PATH"_W);
-    Debug("GenerateVoidILStartupMethod: Linux: CORECLR_PROFILER_PATH defined as: ", native_profiler_file);
-  }
-#endif // BIT64
+  const WSTRING& native_profiler_file = config_.native_profiler_file;
 Debug("GenerateVoidILStartupMethod: Linux: Setting the PInvoke native profiler library path to ", native_profiler_file);
 
 #endif // _WIN32
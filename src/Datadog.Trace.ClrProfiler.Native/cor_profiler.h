@@ -2,25 +2,54 @@
 #define DD_CLR_PROFILER_COR_PROFILER_H_
 
 #include <atomic>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <unordered_map>
 #include "cor.h"
 #include "corprof.h"
 
+#include "agent_transport.h"
+#include "allocation_sampler.h"
+#include "codegen_control.h"
 #include "cor_profiler_base.h"
+#include "dogstatsd.h"
 #include "environment_variables.h"
+#include "exception_counter.h"
+#include "gc_timeline.h"
+#include "il_map_cache.h"
 #include "integration.h"
+#include "integration_rules.h"
+#include "jit_statistics.h"
+#include "live_heap.h"
+#include "method_timing.h"
 #include "module_metadata.h"
+#include "overhead_budget.h"
 #include "pal.h"
+#include "profiler_config.h"
+#include "runtime_events.h"
+#include "runtime_metrics.h"
+#include "span_context.h"
+#include "startup_recorder.h"
+#include "symbol_cache.h"
+#include "thread_pool_watchdog.h"
 
 namespace trace {
 
+// ReplacementPass selects the integrations a ProcessReplacementCalls pass
+// applies: all of them, those that can't be deferred while the profiler is
+// over its overhead budget, or the deferred ones, applied later by ReJIT.
+enum class ReplacementPass { kAll, kEssential, kDeferred };
+
 class CorProfiler : public CorProfilerBase {
  private:
   bool is_attached_ = false;
+  // parsed once in Initialize, read-only afterwards
+  ProfilerConfig config_;
   RuntimeInformation runtime_information_;
   std::vector<Integration> integrations_;
+  // compiled from integrations_ in Initialize, shared with every module
+  std::shared_ptr<const IntegrationRuleSet> rules_;
 
   // Startup helper variables
   bool first_jit_compilation_completed = false;
@@ -37,10 +66,118 @@ class CorProfiler : public CorProfilerBase {
   //
   std::mutex module_id_to_info_map_lock_;
   std::unordered_map<ModuleID, ModuleMetadata*> module_id_to_info_map_;
+  // idle module compaction, guarded by module_id_to_info_map_lock_
+  uint64_t module_idle_timeout_ns_ = 0;
+  uint64_t next_module_sweep_ns_ = 0;
+  uint64_t module_compactions_ = 0;
+  uint64_t module_reacquisitions_ = 0;
+
+  //
+  // Symbolization
+  //
+  SymbolCache symbol_cache_;
+
+  //
+  // Allocation profiling
+  //
+  AllocationSampler allocation_sampler_;
+  LiveHeap live_heap_;
+
+  //
+  // GC pauses and runtime suspensions
+  //
+  GcTimeline gc_timeline_;
+
+  //
+  // First-chance exception counts
+  //
+  ExceptionCounter exception_counter_;
+
+  //
+  // Runtime metrics
+  //
+  RuntimeMetrics runtime_metrics_;
+
+  //
+  // Contention, thread-pool and GC events of the in-process EventPipe session
+  //
+  RuntimeEventListener runtime_events_;
+
+  //
+  // JIT compilation time per method and module
+  //
+  JitStatistics jit_statistics_;
+
+  //
+  // IL-to-native maps, for line-level profiles
+  //
+  ILMapCache il_map_cache_;
+
+  //
+  // Methods compiled during startup
+  //
+  StartupRecorder startup_recorder_;
+
+  //
+  // Span context of each managed thread
+  //
+  SpanContextTable span_contexts_;
+
+  //
+  // Thread-pool starvation watchdog
+  //
+  ThreadPoolWatchdog thread_pool_watchdog_;
+
+  //
+  // Method latency timing
+  //
+  MethodTiming method_timing_;
+
+  //
+  // Per-method codegen flags
+  //
+  CodegenControl codegen_control_;
+
+  //
+  // Overhead budget
+  //
+  OverheadBudget overhead_budget_;
+
+  //
+  // Native trace transport
+  //
+  AgentTransport agent_transport_;
+
+  //
+  // DogStatsD aggregation
+  //
+  DogStatsd dogstatsd_;
 
   //
   // Helper methods
   //
+  // InstrumentMethod rewrites the IL of a method being JIT compiled, if an
+  // integration applies. Sets rewritten if its IL was replaced, and deferred
+  // if the pass skipped low-priority integrations that apply.
+  HRESULT InstrumentMethod(const FunctionID function_id,
+                           const ModuleID module_id,
+                           const mdToken function_token, ReplacementPass pass,
+                           bool* rewritten, bool* deferred);
+  // ApplyDeferredIntegrations rewrites the IL of a method being recompiled by
+  // ReJIT with the integrations deferred on its first compilation.
+  HRESULT ApplyDeferredIntegrations(
+      const ModuleID module_id, const mdMethodDef method_def,
+      ICorProfilerFunctionControl* function_control, bool* rewritten);
+  // GetModuleMetadata returns what was stored about a module, reacquiring its
+  // metadata interfaces if it was compacted, or nullptr. The caller holds
+  // module_id_to_info_map_lock_.
+  ModuleMetadata* GetModuleMetadata(ModuleID module_id);
+  // CompactIdleModules compacts the modules idle for longer than
+  // DD_PROFILER_MODULE_IDLE_TIMEOUT, at most every half timeout. The caller
+  // holds module_id_to_info_map_lock_.
+  void CompactIdleModules();
+  // IsUnoptimizedMethod checks DD_CLR_DISABLE_OPTIMIZATIONS_METHODS.
+  bool IsUnoptimizedMethod(FunctionID function_id);
   bool GetWrapperMethodRef(ModuleMetadata* module_metadata,
                            ModuleID module_id,
                            const MethodReplacement& method_replacement,
@@ -50,13 +187,17 @@ class CorProfiler : public CorProfilerBase {
                                          const ModuleID module_id,
                                          const mdToken function_token,
                                          const FunctionInfo& caller,
-                                         const std::vector<MethodReplacement> method_replacements);
+                                         ReplacementPass pass,
+                                         ICorProfilerFunctionControl* function_control,
+                                         bool* rewritten,
+                                         bool* deferred);
   HRESULT ProcessInsertionCalls(ModuleMetadata* module_metadata,
                                          const FunctionID function_id,
                                          const ModuleID module_id,
                                          const mdToken function_token,
                                          const FunctionInfo& caller,
-                                         const std::vector<MethodReplacement> method_replacements);
+                                         const std::vector<MethodReplacement> method_replacements,
+                                         bool* rewritten);
   bool ProfilerAssemblyIsLoadedIntoAppDomain(AppDomainID app_domain_id);
 
   //
@@ -73,6 +214,63 @@ class CorProfiler : public CorProfilerBase {
 
   bool IsAttached() const;
 
+  const ProfilerConfig& GetConfig() const { return config_; }
+
+  SymbolCache& GetSymbolCache() { return symbol_cache_; }
+
+  size_t GetAllocationSamples(AllocationSample* samples, size_t max_samples);
+
+  size_t GetLiveHeap(LiveHeapStats* stats, LiveHeapSite* sites,
+                     size_t max_sites) const;
+
+  bool GetJitStatistics(JitSummary* summary) const;
+
+  size_t GetJitModules(JitModuleStats* modules, size_t max_modules) const;
+
+  size_t GetSlowestJitMethods(JitMethodTime* methods,
+                              size_t max_methods) const;
+
+  // WriteStartupMethods writes the methods compiled so far to
+  // DD_PROFILER_STARTUP_METHODS_FILE, unless they were written already.
+  bool WriteStartupMethods();
+
+  size_t GetRuntimeEvents(RuntimeEventStats* stats, ContentionSite* sites,
+                          size_t max_sites) const;
+
+  // GetILOffsets resolves each instruction pointer of ips to the IL
+  // instruction it belongs to. Returns the number resolved.
+  size_t GetILOffsets(const uint64_t* ips, ILOffsetLocation* locations,
+                      size_t count);
+
+  size_t GetGcPauses(uint64_t* cursor, GcPause* pauses,
+                     size_t max_pauses) const;
+
+  size_t GetExceptionCounts(ExceptionCount* counts, size_t max_counts) const;
+
+  bool GetRuntimeMetrics(RuntimeMetricsSnapshot* metrics) const;
+
+  void GetOverheadBudgetStats(OverheadBudgetStats* stats) const;
+
+  size_t GetModuleMemory(ModuleMemoryStats* stats, ModuleMemoryUsage* modules,
+                         size_t max_modules);
+
+  size_t GetMethodLatencies(MethodLatency* latencies, size_t max_latencies);
+
+  // SetCurrentSpanContext sets the span the calling thread is working on.
+  void SetCurrentSpanContext(uint64_t trace_id, uint64_t span_id);
+
+  bool GetCurrentSpanNativeCost(SpanNativeCost* cost) const;
+
+  bool GetThreadPoolWatchdogStats(ThreadPoolWatchdogStats* stats) const;
+
+  size_t GetThreadPoolStarvationEvents(uint64_t* cursor,
+                                       StarvationEvent* events,
+                                       size_t max_events) const;
+
+  AgentTransport& GetAgentTransport() { return agent_transport_; }
+
+  DogStatsd& GetDogStatsd() { return dogstatsd_; }
+
   void GetAssemblyAndSymbolsBytes(BYTE** pAssemblyArray, int* assemblySize,
                                  BYTE** pSymbolsArray, int* symbolsSize) const;
 
@@ -85,6 +283,9 @@ class CorProfiler : public CorProfilerBase {
   HRESULT STDMETHODCALLTYPE AssemblyLoadFinished(AssemblyID assembly_id,
                                                  HRESULT hr_status) override;
 
+  HRESULT STDMETHODCALLTYPE
+  AssemblyUnloadStarted(AssemblyID assembly_id) override;
+
   HRESULT STDMETHODCALLTYPE ModuleLoadFinished(ModuleID module_id,
                                                HRESULT hr_status) override;
 
@@ -93,7 +294,70 @@ class CorProfiler : public CorProfilerBase {
   HRESULT STDMETHODCALLTYPE
   JITCompilationStarted(FunctionID function_id, BOOL is_safe_to_block) override;
 
+  HRESULT STDMETHODCALLTYPE
+  JITCompilationFinished(FunctionID function_id, HRESULT hr_status,
+                         BOOL is_safe_to_block) override;
+
+  HRESULT STDMETHODCALLTYPE
+  GetReJITParameters(ModuleID module_id, mdMethodDef method_def,
+                     ICorProfilerFunctionControl* function_control) override;
+
+  HRESULT STDMETHODCALLTYPE ReJITError(ModuleID module_id,
+                                       mdMethodDef method_def,
+                                       FunctionID function_id,
+                                       HRESULT hr_status) override;
+
+  HRESULT STDMETHODCALLTYPE ThreadCreated(ThreadID thread_id) override;
+
+  HRESULT STDMETHODCALLTYPE ThreadDestroyed(ThreadID thread_id) override;
+
+  HRESULT STDMETHODCALLTYPE
+  ThreadAssignedToOSThread(ThreadID thread_id, DWORD os_thread_id) override;
+
+  HRESULT STDMETHODCALLTYPE ThreadNameChanged(ThreadID thread_id,
+                                              ULONG name_length,
+                                              WCHAR name[]) override;
+
   HRESULT STDMETHODCALLTYPE Shutdown() override;
+
+  HRESULT STDMETHODCALLTYPE ObjectAllocated(ObjectID object_id,
+                                            ClassID class_id) override;
+
+  HRESULT STDMETHODCALLTYPE
+  RuntimeSuspendStarted(COR_PRF_SUSPEND_REASON suspend_reason) override;
+
+  HRESULT STDMETHODCALLTYPE RuntimeSuspendFinished() override;
+
+  HRESULT STDMETHODCALLTYPE RuntimeSuspendAborted() override;
+
+  HRESULT STDMETHODCALLTYPE RuntimeResumeStarted() override;
+
+  HRESULT STDMETHODCALLTYPE
+  GarbageCollectionStarted(int generation_count, BOOL generation_collected[],
+                           COR_PRF_GC_REASON reason) override;
+
+  HRESULT STDMETHODCALLTYPE GarbageCollectionFinished() override;
+
+  HRESULT STDMETHODCALLTYPE MovedReferences2(
+      ULONG range_count, ObjectID old_object_id_range_start[],
+      ObjectID new_object_id_range_start[],
+      SIZE_T object_id_range_length[]) override;
+
+  HRESULT STDMETHODCALLTYPE SurvivingReferences2(
+      ULONG range_count, ObjectID object_id_range_start[],
+      SIZE_T object_id_range_length[]) override;
+
+  HRESULT STDMETHODCALLTYPE EventPipeEventDelivered(
+      EVENTPIPE_PROVIDER provider, DWORD event_id, DWORD event_version,
+      ULONG metadata_size, LPCBYTE metadata, ULONG event_data_size,
+      LPCBYTE event_data, LPCGUID activity_id, LPCGUID related_activity_id,
+      ThreadID event_thread, ULONG stack_frame_count,
+      UINT_PTR stack_frames[]) override;
+
+  HRESULT STDMETHODCALLTYPE ExceptionThrown(ObjectID thrown_object_id) override;
+
+  HRESULT STDMETHODCALLTYPE
+  ExceptionSearchFunctionEnter(FunctionID function_id) override;
 };
 
 // Note: Generally you should not have a single, global callback implementation,
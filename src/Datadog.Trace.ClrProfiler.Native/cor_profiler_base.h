@@ -5,9 +5,11 @@
 #include <corprof.h>
 #include <atomic>
 
+#include "event_pipe.h"
+
 namespace trace {
 
-class CorProfilerBase : public ICorProfilerCallback8 {
+class CorProfilerBase : public ICorProfilerCallback10 {
  private:
   std::atomic<int> ref_count_;
 
@@ -55,6 +57,18 @@ class CorProfilerBase : public ICorProfilerCallback8 {
                                                   BOOL fIsSafeToBlock) override;
   HRESULT STDMETHODCALLTYPE JITCompilationFinished(
       FunctionID functionId, HRESULT hrStatus, BOOL fIsSafeToBlock) override;
+
+  HRESULT STDMETHODCALLTYPE DynamicMethodUnloaded(
+      FunctionID functionId) override;
+
+  HRESULT STDMETHODCALLTYPE EventPipeEventDelivered(
+      EVENTPIPE_PROVIDER provider, DWORD eventId, DWORD eventVersion,
+      ULONG cbMetadataBlob, LPCBYTE metadataBlob, ULONG cbEventData,
+      LPCBYTE eventData, LPCGUID pActivityId, LPCGUID pRelatedActivityId,
+      ThreadID eventThread, ULONG numStackFrames,
+      UINT_PTR stackFrames[]) override;
+  HRESULT STDMETHODCALLTYPE
+  EventPipeProviderCreated(EVENTPIPE_PROVIDER provider) override;
   HRESULT STDMETHODCALLTYPE JITCachedFunctionSearchStarted(
       FunctionID functionId, BOOL* pbUseCachedFunction) override;
   HRESULT STDMETHODCALLTYPE JITCachedFunctionSearchFinished(
@@ -191,7 +205,9 @@ class CorProfilerBase : public ICorProfilerCallback8 {
 
   HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid,
                                            void** ppvObject) override {
-    if (riid == __uuidof(ICorProfilerCallback8) ||
+    if (riid == __uuidof(ICorProfilerCallback10) ||
+        riid == __uuidof(ICorProfilerCallback9) ||
+        riid == __uuidof(ICorProfilerCallback8) ||
         riid == __uuidof(ICorProfilerCallback7) ||
         riid == __uuidof(ICorProfilerCallback6) ||
         riid == __uuidof(ICorProfilerCallback5) ||
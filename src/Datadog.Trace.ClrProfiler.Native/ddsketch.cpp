@@ -0,0 +1,214 @@
+#include "ddsketch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace trace {
+
+namespace {
+
+const double kGamma =
+    (1 + kDDSketchRelativeAccuracy) / (1 - kDDSketchRelativeAccuracy);
+const double kLogGamma = std::log(kGamma);
+
+// smaller magnitudes are counted as zero, so that every index fits in an
+// int32_t
+const double kMinIndexableValue = std::numeric_limits<double>::min();
+
+}  // namespace
+
+void DDSketchStore::Add(int32_t index, uint64_t count) {
+  if (count == 0) {
+    return;
+  }
+
+  if (bins_.empty()) {
+    bins_.assign(1, 0);
+    offset_ = index;
+  }
+
+  const int32_t low = offset_;
+  const int32_t high = offset_ + static_cast<int32_t>(bins_.size()) - 1;
+
+  if (index > high) {
+    const int32_t new_low = std::max(low, index - kDDSketchMaxBins + 1);
+    if (new_low > low) {
+      // collapse the bins that fall out of range into the new lowest one
+      uint64_t collapsed = 0;
+      const int32_t kept_from = std::min(new_low, high + 1);
+      for (int32_t i = low; i < kept_from; i++) {
+        collapsed += bins_[i - low];
+      }
+
+      std::vector<uint64_t> bins(index - new_low + 1, 0);
+      for (int32_t i = kept_from; i <= high; i++) {
+        bins[i - new_low] = bins_[i - low];
+      }
+      bins[0] += collapsed;
+      bins_.swap(bins);
+      offset_ = new_low;
+    } else {
+      bins_.resize(index - low + 1, 0);
+    }
+  } else if (index < low) {
+    if (high - index + 1 > kDDSketchMaxBins) {
+      // out of range: it goes into the lowest bin we can keep
+      const int32_t new_low = high - kDDSketchMaxBins + 1;
+      bins_.insert(bins_.begin(), low - new_low, 0);
+      offset_ = new_low;
+      index = new_low;
+    } else {
+      bins_.insert(bins_.begin(), low - index, 0);
+      offset_ = index;
+    }
+  }
+
+  bins_[index - offset_] += count;
+  count_ += count;
+}
+
+void DDSketchStore::Merge(const DDSketchStore& other) {
+  for (size_t i = 0; i < other.bins_.size(); i++) {
+    if (other.bins_[i] != 0) {
+      Add(other.offset_ + static_cast<int32_t>(i), other.bins_[i]);
+    }
+  }
+}
+
+void DDSketchStore::Clear() {
+  bins_.clear();
+  offset_ = 0;
+  count_ = 0;
+}
+
+int32_t DDSketchStore::KeyAtRank(uint64_t rank, bool ascending) const {
+  uint64_t seen = 0;
+  const auto size = bins_.size();
+
+  for (size_t i = 0; i < size; i++) {
+    const auto bin = ascending ? i : size - 1 - i;
+    seen += bins_[bin];
+    if (seen > rank) {
+      return offset_ + static_cast<int32_t>(bin);
+    }
+  }
+
+  return ascending ? offset_ + static_cast<int32_t>(size) - 1 : offset_;
+}
+
+void DDSketchStore::ForEach(
+    bool ascending,
+    const std::function<void(int32_t, uint64_t)>& callback) const {
+  const auto size = bins_.size();
+
+  for (size_t i = 0; i < size; i++) {
+    const auto bin = ascending ? i : size - 1 - i;
+    if (bins_[bin] != 0) {
+      callback(offset_ + static_cast<int32_t>(bin), bins_[bin]);
+    }
+  }
+}
+
+int32_t DDSketch::Index(double value) {
+  return static_cast<int32_t>(std::ceil(std::log(value) / kLogGamma));
+}
+
+double DDSketch::Value(int32_t index) {
+  // the value with the same relative distance to both bounds of the bin,
+  // gamma^(index - 1) and gamma^index
+  return std::exp(index * kLogGamma) * 2 / (1 + kGamma);
+}
+
+void DDSketch::Add(double value, uint64_t count) {
+  if (count == 0 || !std::isfinite(value)) {
+    return;
+  }
+
+  if (count_ == 0) {
+    min_ = value;
+    max_ = value;
+  } else {
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+  }
+
+  count_ += count;
+  sum_ += value * static_cast<double>(count);
+
+  if (value >= kMinIndexableValue) {
+    positive_.Add(Index(value), count);
+  } else if (value <= -kMinIndexableValue) {
+    negative_.Add(Index(-value), count);
+  } else {
+    zero_count_ += count;
+  }
+}
+
+void DDSketch::Merge(const DDSketch& other) {
+  if (other.count_ == 0) {
+    return;
+  }
+
+  if (count_ == 0) {
+    min_ = other.min_;
+    max_ = other.max_;
+  } else {
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+  }
+
+  positive_.Merge(other.positive_);
+  negative_.Merge(other.negative_);
+  zero_count_ += other.zero_count_;
+  count_ += other.count_;
+  sum_ += other.sum_;
+}
+
+void DDSketch::Clear() {
+  positive_.Clear();
+  negative_.Clear();
+  zero_count_ = 0;
+  count_ = 0;
+  sum_ = 0;
+  min_ = 0;
+  max_ = 0;
+}
+
+double DDSketch::Quantile(double q) const {
+  if (count_ == 0 || !(q >= 0 && q <= 1)) {
+    return 0;
+  }
+
+  auto rank = static_cast<uint64_t>(q * static_cast<double>(count_ - 1));
+
+  double value;
+  if (rank < negative_.Count()) {
+    // the most negative values have the highest indexes
+    value = -Value(negative_.KeyAtRank(rank, false));
+  } else if (rank < negative_.Count() + zero_count_) {
+    value = 0;
+  } else {
+    rank -= negative_.Count() + zero_count_;
+    value = Value(positive_.KeyAtRank(rank, true));
+  }
+
+  return std::min(std::max(value, min_), max_);
+}
+
+void DDSketch::ForEachBin(
+    const std::function<void(double, uint64_t)>& callback) const {
+  negative_.ForEach(false, [&](int32_t index, uint64_t count) {
+    callback(-Value(index), count);
+  });
+
+  if (zero_count_ != 0) {
+    callback(0, zero_count_);
+  }
+
+  positive_.ForEach(true, [&](int32_t index, uint64_t count) {
+    callback(Value(index), count);
+  });
+}
+
+}  // namespace trace
@@ -0,0 +1,92 @@
+#ifndef DD_CLR_PROFILER_DDSKETCH_H_
+#define DD_CLR_PROFILER_DDSKETCH_H_
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace trace {
+
+// Relative accuracy of the quantiles returned by DDSketch. Matches the
+// sketches built by the agent for DogStatsD distributions.
+const double kDDSketchRelativeAccuracy = 0.01;
+
+// Maximum number of bins per store. With 1% accuracy, 2048 bins cover more
+// than 8 orders of magnitude before the lowest bins are collapsed.
+const int32_t kDDSketchMaxBins = 2048;
+
+// DDSketchStore counts values by bin index in a contiguous array. When the
+// range of indexes grows past kDDSketchMaxBins, the lowest bins are collapsed
+// into the lowest remaining one, which only degrades the accuracy of the
+// smallest values.
+class DDSketchStore {
+ private:
+  std::vector<uint64_t> bins_;
+  // index of bins_[0]
+  int32_t offset_ = 0;
+  uint64_t count_ = 0;
+
+ public:
+  void Add(int32_t index, uint64_t count);
+  void Merge(const DDSketchStore& other);
+  void Clear();
+
+  bool IsEmpty() const { return count_ == 0; }
+  uint64_t Count() const { return count_; }
+
+  // KeyAtRank returns the index of the bin holding the value of the given
+  // rank, counting from the lowest index if ascending.
+  int32_t KeyAtRank(uint64_t rank, bool ascending) const;
+
+  // ForEach calls callback with the index and count of every non-empty bin,
+  // lowest index first if ascending.
+  void ForEach(bool ascending,
+               const std::function<void(int32_t, uint64_t)>& callback) const;
+};
+
+// DDSketch is a quantile sketch with relative-error guarantees: any quantile
+// it returns is within kDDSketchRelativeAccuracy of the exact value. Values
+// are mapped to logarithmically sized bins, so sketches are small, cheap to
+// update and merge exactly. Count, sum, min and max are exact.
+//
+// See "DDSketch: A Fast and Fully-Mergeable Quantile Sketch with
+// Relative-Error Guarantees", Masson et al., VLDB 2019.
+class DDSketch {
+ private:
+  DDSketchStore positive_;
+  DDSketchStore negative_;
+  uint64_t zero_count_ = 0;
+  uint64_t count_ = 0;
+  double sum_ = 0;
+  double min_ = 0;
+  double max_ = 0;
+
+ public:
+  void Add(double value) { Add(value, 1); }
+  void Add(double value, uint64_t count);
+  void Merge(const DDSketch& other);
+  void Clear();
+
+  bool IsEmpty() const { return count_ == 0; }
+  uint64_t Count() const { return count_; }
+  double Sum() const { return sum_; }
+  double Min() const { return min_; }
+  double Max() const { return max_; }
+
+  // Quantile returns the value at quantile q, between 0 and 1, or 0 if the
+  // sketch is empty.
+  double Quantile(double q) const;
+
+  // ForEachBin calls callback with the representative value and the count of
+  // every non-empty bin, in ascending order of value. Adding each of them to
+  // an empty sketch rebuilds this one, up to the exact sum, min and max.
+  void ForEachBin(const std::function<void(double, uint64_t)>& callback) const;
+
+  // Index and Value convert between positive values and bin indexes.
+  static int32_t Index(double value);
+  static double Value(int32_t index);
+};
+
+}  // namespace trace
+
+#endif  // DD_CLR_PROFILER_DDSKETCH_H_
@@ -0,0 +1,440 @@
+// winsock2.h must be included before windows.h, which the other headers pull
+// in on Windows
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "dogstatsd.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+
+#include "logging.h"
+
+namespace trace {
+
+namespace {
+
+std::atomic<uint64_t> next_instance_id{1};
+
+// FormatNumber writes value with up to digits significant digits, without
+// trailing zeros: "3", "0.25", "1.5e+09".
+void FormatNumber(double value, int digits, std::string& out) {
+  char buffer[32];
+  const auto length = std::snprintf(buffer, sizeof(buffer), "%.*g", digits,
+                                    value);
+  out.append(buffer, static_cast<size_t>(length));
+}
+
+// the name cannot contain the separators of the DogStatsD line
+char SanitizeNameChar(char c) {
+  return c == ':' || c == '|' || c == '@' || c == '#' || c == '\n' ? '_' : c;
+}
+
+char SanitizeTagChar(char c) { return c == '|' || c == '\n' ? '_' : c; }
+
+}  // namespace
+
+// StatsdSocket is a UDP socket connected to the DogStatsD server. Sends never
+// block: a datagram that does not fit in the socket buffer is dropped.
+class StatsdSocket {
+ private:
+#ifdef _WIN32
+  SOCKET socket_ = INVALID_SOCKET;
+#else
+  int socket_ = -1;
+#endif
+
+ public:
+  StatsdSocket() = default;
+  StatsdSocket(const StatsdSocket&) = delete;
+  StatsdSocket& operator=(const StatsdSocket&) = delete;
+
+  ~StatsdSocket() {
+#ifdef _WIN32
+    if (socket_ != INVALID_SOCKET) {
+      closesocket(socket_);
+    }
+#else
+    if (socket_ != -1) {
+      close(socket_);
+    }
+#endif
+  }
+
+  bool Open(const std::string& host, uint16_t port) {
+#ifdef _WIN32
+    WSADATA wsa_data;
+    WSAStartup(MAKEWORD(2, 2), &wsa_data);
+#endif
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_protocol = IPPROTO_UDP;
+
+    addrinfo* addresses = nullptr;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints,
+                    &addresses) != 0) {
+      return false;
+    }
+
+    bool connected = false;
+    for (auto address = addresses; address != nullptr && !connected;
+         address = address->ai_next) {
+      socket_ = socket(address->ai_family, address->ai_socktype,
+                       address->ai_protocol);
+#ifdef _WIN32
+      if (socket_ == INVALID_SOCKET) {
+        continue;
+      }
+      u_long non_blocking = 1;
+      connected =
+          ioctlsocket(socket_, FIONBIO, &non_blocking) == 0 &&
+          connect(socket_, address->ai_addr,
+                  static_cast<int>(address->ai_addrlen)) == 0;
+      if (!connected) {
+        closesocket(socket_);
+        socket_ = INVALID_SOCKET;
+      }
+#else
+      if (socket_ == -1) {
+        continue;
+      }
+      connected =
+          fcntl(socket_, F_SETFL, fcntl(socket_, F_GETFL, 0) | O_NONBLOCK) ==
+              0 &&
+          connect(socket_, address->ai_addr, address->ai_addrlen) == 0;
+      if (!connected) {
+        close(socket_);
+        socket_ = -1;
+      }
+#endif
+    }
+
+    freeaddrinfo(addresses);
+    return connected;
+  }
+
+  bool Send(const std::string& datagram) {
+    return send(socket_, datagram.data(), static_cast<int>(datagram.size()),
+                0) == static_cast<int>(datagram.size());
+  }
+};
+
+DogStatsd::DogStatsd() : id_(next_instance_id.fetch_add(1)) {}
+
+DogStatsd::~DogStatsd() { Stop(); }
+
+void DogStatsd::Configure(const std::string& host, uint16_t port,
+                          uint64_t interval_ms) {
+  host_ = host;
+  port_ = port;
+  interval_ms_ = interval_ms;
+}
+
+DogStatsd::Shard* DogStatsd::LocalShard() {
+  // a thread records into a single instance in practice; switching instances
+  // gives the thread a new shard and the old one is released once flushed
+  struct LocalCache {
+    uint64_t owner = 0;
+    std::shared_ptr<Shard> shard;
+  };
+  thread_local LocalCache cache;
+
+  if (cache.owner != id_) {
+    cache.shard = std::make_shared<Shard>();
+    cache.owner = id_;
+
+    std::lock_guard<std::mutex> guard(shards_lock_);
+    shards_.push_back(cache.shard);
+  }
+
+  return cache.shard.get();
+}
+
+void DogStatsd::Record(StatsdMetricType type, const std::string& name,
+                       const std::string& tags, double value) {
+  if (name.empty() ||
+      (!started_.load(std::memory_order_acquire) && !Start())) {
+    return;
+  }
+
+  // reused so that recording an existing metric does not allocate
+  thread_local std::string key;
+  key.clear();
+  key.reserve(2 + name.size() + tags.size());
+  key.push_back(static_cast<char>(type));
+  for (const auto c : name) {
+    key.push_back(SanitizeNameChar(c));
+  }
+  key.push_back('|');
+  for (const auto c : tags) {
+    key.push_back(SanitizeTagChar(c));
+  }
+
+  const auto sequence =
+      type == StatsdMetricType::kGauge
+          ? gauge_sequence_.fetch_add(1, std::memory_order_relaxed) + 1
+          : 0;
+
+  auto shard = LocalShard();
+  {
+    std::lock_guard<std::mutex> guard(shard->lock);
+
+    auto it = shard->metrics.find(key);
+    if (it == shard->metrics.end()) {
+      it = shard->metrics.emplace(key, Metric()).first;
+    }
+
+    auto& metric = it->second;
+    switch (type) {
+      case StatsdMetricType::kCount:
+        metric.value += value;
+        break;
+      case StatsdMetricType::kGauge:
+        metric.value = value;
+        metric.sequence = sequence;
+        break;
+      case StatsdMetricType::kDistribution:
+        metric.sketch.Add(value);
+        break;
+    }
+  }
+
+  points_.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool DogStatsd::Start() {
+  std::lock_guard<std::mutex> guard(state_lock_);
+  if (stop_requested_) {
+    return false;
+  }
+
+  if (started_.load(std::memory_order_relaxed)) {
+    return true;
+  }
+
+  {
+    std::lock_guard<std::mutex> flush_guard(flush_lock_);
+    socket_.reset(new StatsdSocket());
+    if (!socket_->Open(host_, port_)) {
+      Warn("Unable to open the DogStatsD socket to ", host_, ":",
+           static_cast<uint64_t>(port_));
+      socket_.reset();
+    }
+  }
+
+  flusher_ = std::thread(&DogStatsd::FlushLoop, this);
+  started_.store(true, std::memory_order_release);
+  return true;
+}
+
+void DogStatsd::FlushLoop() {
+  std::unique_lock<std::mutex> lock(state_lock_);
+
+  while (!stop_requested_) {
+    stop_signal_.wait_for(lock, std::chrono::milliseconds(interval_ms_),
+                          [this] { return stop_requested_; });
+
+    lock.unlock();
+    Flush();
+    lock.lock();
+  }
+}
+
+void DogStatsd::Stop() {
+  {
+    std::lock_guard<std::mutex> guard(state_lock_);
+    stop_requested_ = true;
+    // Record goes through Start, which refuses once stopped
+    started_.store(false, std::memory_order_release);
+  }
+  stop_signal_.notify_all();
+
+  if (flusher_.joinable()) {
+    // the flush thread sends what is left on its way out
+    flusher_.join();
+  }
+}
+
+void DogStatsd::Flush() {
+  std::lock_guard<std::mutex> flush_guard(flush_lock_);
+
+  std::vector<std::shared_ptr<Shard>> shards;
+  {
+    std::lock_guard<std::mutex> guard(shards_lock_);
+    shards = shards_;
+  }
+
+  std::unordered_map<std::string, Metric> merged;
+  std::unordered_map<std::string, Metric> metrics;
+
+  for (const auto& shard : shards) {
+    {
+      std::lock_guard<std::mutex> guard(shard->lock);
+      metrics.swap(shard->metrics);
+    }
+
+    for (auto& entry : metrics) {
+      auto it = merged.find(entry.first);
+      if (it == merged.end()) {
+        merged.emplace(entry.first, std::move(entry.second));
+        continue;
+      }
+
+      auto& metric = it->second;
+      switch (static_cast<StatsdMetricType>(entry.first[0])) {
+        case StatsdMetricType::kCount:
+          metric.value += entry.second.value;
+          break;
+        case StatsdMetricType::kGauge:
+          if (entry.second.sequence > metric.sequence) {
+            metric.value = entry.second.value;
+            metric.sequence = entry.second.sequence;
+          }
+          break;
+        case StatsdMetricType::kDistribution:
+          metric.sketch.Merge(entry.second.sketch);
+          break;
+      }
+    }
+
+    metrics.clear();
+  }
+
+  shards.clear();
+  {
+    // release the shards of the threads that exited
+    std::lock_guard<std::mutex> guard(shards_lock_);
+    shards_.erase(std::remove_if(shards_.begin(), shards_.end(),
+                                 [](const std::shared_ptr<Shard>& shard) {
+                                   return shard.use_count() == 1;
+                                 }),
+                  shards_.end());
+  }
+
+  if (merged.empty()) {
+    return;
+  }
+
+  std::vector<std::string> lines;
+  for (const auto& entry : merged) {
+    FormatLines(entry.first, entry.second, lines);
+  }
+  lines_.fetch_add(lines.size(), std::memory_order_relaxed);
+
+  std::string datagram;
+  datagram.reserve(kMaxDogStatsdDatagramSize);
+
+  for (const auto& line : lines) {
+    if (!datagram.empty() &&
+        datagram.size() + 1 + line.size() > kMaxDogStatsdDatagramSize) {
+      Send(datagram);
+      datagram.clear();
+    }
+
+    if (!datagram.empty()) {
+      datagram.push_back('\n');
+    }
+    datagram += line;
+  }
+
+  Send(datagram);
+}
+
+void DogStatsd::Send(const std::string& datagram) {
+  if (socket_ == nullptr || !socket_->Send(datagram)) {
+    send_errors_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  datagrams_.fetch_add(1, std::memory_order_relaxed);
+  bytes_.fetch_add(datagram.size(), std::memory_order_relaxed);
+}
+
+void DogStatsd::FormatLines(const std::string& key, const Metric& metric,
+                            std::vector<std::string>& lines) {
+  // key is the type, the name, '|' and the tags
+  const auto type = key[0];
+  const auto separator = key.find('|');
+  const auto name = key.substr(1, separator - 1);
+
+  std::string suffix;
+  suffix.push_back('|');
+  suffix.push_back(type);
+  const auto tags = key.substr(separator + 1);
+
+  if (static_cast<StatsdMetricType>(type) !=
+      StatsdMetricType::kDistribution) {
+    std::string line = name;
+    line.push_back(':');
+    FormatNumber(metric.value, 15, line);
+    line += suffix;
+    if (!tags.empty()) {
+      line += "|#" + tags;
+    }
+    lines.push_back(std::move(line));
+    return;
+  }
+
+  // group the bins by count, so each group is one multi-value line with the
+  // sample rate that gives every value its count back
+  std::map<uint64_t, std::vector<double>> groups;
+  metric.sketch.ForEachBin(
+      [&](double value, uint64_t count) { groups[count].push_back(value); });
+
+  for (const auto& group : groups) {
+    std::string line_suffix = suffix;
+    if (group.first > 1) {
+      line_suffix += "|@";
+      FormatNumber(1.0 / static_cast<double>(group.first), 6, line_suffix);
+    }
+    if (!tags.empty()) {
+      line_suffix += "|#" + tags;
+    }
+
+    std::string line = name;
+    std::string value;
+    bool has_values = false;
+
+    for (const auto bin : group.second) {
+      value.clear();
+      value.push_back(':');
+      // the bin is only accurate to 1% anyway
+      FormatNumber(bin, 6, value);
+
+      if (has_values && line.size() + value.size() + line_suffix.size() >
+                            kMaxDogStatsdDatagramSize) {
+        lines.push_back(line + line_suffix);
+        line = name;
+      }
+
+      line += value;
+      has_values = true;
+    }
+
+    lines.push_back(line + line_suffix);
+  }
+}
+
+DogStatsdStats DogStatsd::GetStats() const {
+  DogStatsdStats stats{};
+  stats.points = points_.load(std::memory_order_relaxed);
+  stats.lines = lines_.load(std::memory_order_relaxed);
+  stats.datagrams = datagrams_.load(std::memory_order_relaxed);
+  stats.bytes = bytes_.load(std::memory_order_relaxed);
+  stats.send_errors = send_errors_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+}  // namespace trace
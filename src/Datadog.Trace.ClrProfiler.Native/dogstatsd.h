@@ -0,0 +1,155 @@
+#ifndef DD_CLR_PROFILER_DOGSTATSD_H_
+#define DD_CLR_PROFILER_DOGSTATSD_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "ddsketch.h"
+
+namespace trace {
+
+const uint16_t kDefaultDogStatsdPort = 8125;
+
+// Default time between two flushes, in milliseconds. Matches the agent's
+// DogStatsD aggregation interval.
+const uint64_t kDefaultDogStatsdFlushInterval = 10000;
+
+// Maximum size of a datagram, so that it fits in a single packet on a typical
+// 1500-byte MTU network. Larger lines are sent on their own.
+const size_t kMaxDogStatsdDatagramSize = 1432;
+
+enum class StatsdMetricType : char {
+  kCount = 'c',
+  kGauge = 'g',
+  kDistribution = 'd',
+};
+
+// DogStatsdStats is a snapshot of the aggregator counters, handed to managed
+// code by GetDogStatsdStats in interop.cpp. It is blittable: keep its layout
+// in sync with the managed definition.
+struct DogStatsdStats {
+  // values recorded
+  uint64_t points;
+  // metric lines sent, one per name, tags and type per flush (more for
+  // distributions with many distinct values)
+  uint64_t lines;
+  uint64_t datagrams;
+  uint64_t bytes;
+  uint64_t send_errors;
+};
+
+class StatsdSocket;
+
+// DogStatsd aggregates counts, gauges and distributions in process and sends
+// them to the agent's DogStatsD server as multi-metric datagrams, instead of
+// one packet per point.
+//
+// Each thread records into its own shard, guarded by a lock only contended
+// while a flush swaps it out. Every flush interval the shards are merged:
+// counts are summed, the latest gauge wins and distributions are merged into
+// a DDSketch. A distribution is sent as the representative value of each
+// non-empty bin, grouped by count and weighted with a sample rate of
+// 1/count, which lets the agent rebuild the sketch from a few values.
+class DogStatsd {
+ private:
+  struct Metric {
+    double value = 0;
+    // order of the last gauge update, across threads
+    uint64_t sequence = 0;
+    DDSketch sketch;
+  };
+
+  // Shard holds the metrics recorded by one thread since the last flush,
+  // keyed by type, name and tags.
+  struct Shard {
+    std::mutex lock;
+    std::unordered_map<std::string, Metric> metrics;
+  };
+
+  std::string host_ = "localhost";
+  uint16_t port_ = kDefaultDogStatsdPort;
+  uint64_t interval_ms_ = kDefaultDogStatsdFlushInterval;
+
+  // identifies this instance in the thread-local shard cache
+  const uint64_t id_;
+
+  std::mutex shards_lock_;
+  std::vector<std::shared_ptr<Shard>> shards_;
+
+  std::atomic<uint64_t> gauge_sequence_{0};
+
+  std::atomic<bool> started_{false};
+  std::mutex state_lock_;
+  std::condition_variable stop_signal_;
+  bool stop_requested_ = false;
+  std::thread flusher_;
+
+  // held while flushing, also guards socket_
+  std::mutex flush_lock_;
+  std::unique_ptr<StatsdSocket> socket_;
+
+  std::atomic<uint64_t> points_{0};
+  std::atomic<uint64_t> lines_{0};
+  std::atomic<uint64_t> datagrams_{0};
+  std::atomic<uint64_t> bytes_{0};
+  std::atomic<uint64_t> send_errors_{0};
+
+  Shard* LocalShard();
+  // Start opens the socket and starts the flush thread, unless stopped
+  bool Start();
+  void FlushLoop();
+  void Record(StatsdMetricType type, const std::string& name,
+              const std::string& tags, double value);
+  void Send(const std::string& datagram);
+
+  // FormatLines appends the DogStatsD lines of one aggregated metric to
+  // lines.
+  static void FormatLines(const std::string& key, const Metric& metric,
+                          std::vector<std::string>& lines);
+
+ public:
+  DogStatsd();
+  DogStatsd(const DogStatsd&) = delete;
+  DogStatsd& operator=(const DogStatsd&) = delete;
+  ~DogStatsd();
+
+  // Configure sets the DogStatsD server and flush interval. Must be called
+  // before the first metric is recorded.
+  void Configure(const std::string& host, uint16_t port, uint64_t interval_ms);
+
+  // Count, Gauge and Distribution record a value. tags is a comma-separated
+  // list of key:value tags, possibly empty. The flush thread starts with the
+  // first value recorded, values recorded after Stop are ignored.
+  void Count(const std::string& name, const std::string& tags, double value) {
+    Record(StatsdMetricType::kCount, name, tags, value);
+  }
+
+  void Gauge(const std::string& name, const std::string& tags, double value) {
+    Record(StatsdMetricType::kGauge, name, tags, value);
+  }
+
+  void Distribution(const std::string& name, const std::string& tags,
+                    double value) {
+    Record(StatsdMetricType::kDistribution, name, tags, value);
+  }
+
+  // Flush merges the shards and sends the metrics now, on the calling thread.
+  void Flush();
+
+  // Stop stops the flush thread and sends what was recorded since the last
+  // flush.
+  void Stop();
+
+  DogStatsdStats GetStats() const;
+};
+
+}  // namespace trace
+
+#endif  // DD_CLR_PROFILER_DOGSTATSD_H_
@@ -18,6 +18,11 @@ const WSTRING debug_enabled = "DD_TRACE_DEBUG"_W;
 // "C:\Program Files\Datadog .NET Tracer\integrations.json;D:\temp\test_integrations.json"
 const WSTRING integrations_path = "DD_INTEGRATIONS"_W;
 
+// Sets the path of a JSON file with more settings, keyed by environment
+// variable name. Environment variables take precedence over the file. No file
+// is read when it isn't set.
+const WSTRING config_file = "DD_DOTNET_TRACER_CONFIG_FILE"_W;
+
 // Sets the path to the profiler's home directory, for example:
 // "C:\Program Files\Datadog .NET Tracer\" or "/opt/datadog/"
 const WSTRING profiler_home_path = "DD_DOTNET_TRACER_HOME"_W;
@@ -40,6 +45,20 @@ const WSTRING agent_host = "DD_AGENT_HOST"_W;
 // Sets the Agent's port. Default is 8126.
 const WSTRING agent_port = "DD_TRACE_AGENT_PORT"_W;
 
+// Sets the path of the Agent's Unix domain socket. If set, the native trace
+// transport uses it instead of DD_AGENT_HOST and DD_TRACE_AGENT_PORT.
+// Ignored on Windows.
+const WSTRING agent_unix_socket = "DD_APM_RECEIVER_SOCKET"_W;
+
+// Sets the port of the Agent's DogStatsD server, on DD_AGENT_HOST.
+// Default is 8125.
+const WSTRING dogstatsd_port = "DD_DOGSTATSD_PORT"_W;
+
+// Sets the time between two flushes of the native DogStatsD aggregator in
+// milliseconds. Default is 10000.
+const WSTRING dogstatsd_flush_interval =
+    "DD_PROFILER_DOGSTATSD_FLUSH_INTERVAL"_W;
+
 // Sets the "env" tag for every span.
 const WSTRING env = "DD_ENV"_W;
 
@@ -67,6 +86,40 @@ const WSTRING log_path = "DD_TRACE_LOG_PATH"_W;
 // https://github.com/dotnet/coreclr/issues/12468
 const WSTRING clr_disable_optimizations = "DD_CLR_DISABLE_OPTIMIZATIONS"_W;
 
+// Sets whether to disable optimizations only in the methods whose IL the
+// profiler rewrites, which are compiled again by ReJIT. Default is false.
+// Rewritten methods are first compiled with optimizations and run that way
+// until the ReJIT lands, and frames already on the stack keep running the
+// optimized code: set DD_CLR_DISABLE_OPTIMIZATIONS instead where that code
+// must never run. Ignored when DD_CLR_DISABLE_OPTIMIZATIONS is set.
+const WSTRING clr_disable_rewritten_optimizations =
+    "DD_CLR_DISABLE_REWRITTEN_OPTIMIZATIONS"_W;
+
+// Sets a semicolon-separated list of methods to compile without
+// optimizations, rewritten or not, as [Assembly!]Namespace.Type.Method
+// patterns with '*' and '?' wildcards.
+const WSTRING clr_disable_optimizations_methods =
+    "DD_CLR_DISABLE_OPTIMIZATIONS_METHODS"_W;
+
+// Sets the milliseconds per second the profiler may spend in its runtime
+// callbacks before it degrades. Default is 0 (unlimited).
+const WSTRING overhead_budget_ms = "DD_PROFILER_OVERHEAD_BUDGET_MS"_W;
+
+// Sets the number of methods per second the profiler may rewrite before it
+// degrades. Default is 0 (unlimited).
+const WSTRING rewrite_budget = "DD_PROFILER_REWRITE_BUDGET"_W;
+
+// Sets a semicolon-separated list of integrations whose instrumentation is
+// deferred while the profiler is over its overhead budget. They are applied
+// later by ReJIT, which requires .NET Core 3.0 or .NET Framework 4.5.
+const WSTRING low_priority_integrations =
+    "DD_PROFILER_LOW_PRIORITY_INTEGRATIONS"_W;
+
+// Sets the milliseconds after which the profiler compacts what it keeps about
+// a module none of whose methods were JIT compiled since. Default is 0
+// (never).
+const WSTRING module_idle_timeout = "DD_PROFILER_MODULE_IDLE_TIMEOUT"_W;
+
 // Indicates whether the profiler is running in the context
 // of Azure App Services
 const WSTRING azure_app_services = "DD_AZURE_APP_SERVICES"_W;
@@ -78,6 +131,87 @@ const WSTRING azure_app_services_app_pool_id = "APP_POOL_ID"_W;
 const WSTRING azure_app_services_cli_telemetry_profile_value =
     "DOTNET_CLI_TELEMETRY_PROFILE"_W;
 
+// Enables sampled allocation profiling. Default is false.
+// Adds COR_PRF_ENABLE_OBJECT_ALLOCATED to the event mask, which slows down
+// every allocation, so it is meant to be enabled on demand.
+const WSTRING allocation_profiling_enabled =
+    "DD_PROFILER_ALLOCATIONS_ENABLED"_W;
+
+// Sets the mean number of allocated bytes between two allocation samples.
+// Default is 524288 (512 KB).
+const WSTRING allocation_sampling_interval =
+    "DD_PROFILER_ALLOCATIONS_SAMPLING_INTERVAL"_W;
+
+// Enables live heap profiling: sampled allocations are tracked until they are
+// collected. Default is false. Requires DD_PROFILER_ALLOCATIONS_ENABLED and
+// adds COR_PRF_MONITOR_GC to the event mask, which disables concurrent
+// (background) garbage collection for the whole process.
+const WSTRING live_heap_enabled = "DD_PROFILER_LIVE_HEAP_ENABLED"_W;
+
+// Sets the maximum number of sampled objects tracked by live heap profiling.
+// Default is 65536.
+const WSTRING live_heap_max_objects = "DD_PROFILER_LIVE_HEAP_MAX_OBJECTS"_W;
+
+// Enables the GC pause and runtime suspension timeline. Default is false.
+// Adds COR_PRF_MONITOR_GC to the event mask, which disables concurrent
+// (background) garbage collection for the whole process.
+const WSTRING gc_timeline_enabled = "DD_PROFILER_GC_TIMELINE_ENABLED"_W;
+
+// Enables counting first-chance exceptions by class and throwing method.
+// Default is false.
+const WSTRING exception_counting_enabled =
+    "DD_PROFILER_EXCEPTIONS_ENABLED"_W;
+
+// Enables the native runtime metrics collector. Default is false.
+// GC metrics also require DD_PROFILER_GC_TIMELINE_ENABLED.
+const WSTRING runtime_metrics_enabled =
+    "DD_PROFILER_RUNTIME_METRICS_ENABLED"_W;
+
+// Sets the runtime metrics sampling interval in milliseconds. Default is 1000.
+const WSTRING runtime_metrics_interval =
+    "DD_PROFILER_RUNTIME_METRICS_INTERVAL"_W;
+
+// Enables the native thread-pool starvation watchdog. Default is false.
+// Requires .NET 6 or later, whose thread-pool workers are named.
+const WSTRING thread_pool_watchdog_enabled =
+    "DD_PROFILER_THREADPOOL_WATCHDOG_ENABLED"_W;
+
+// Sets the thread-pool watchdog check interval in milliseconds. Default is
+// 1000.
+const WSTRING thread_pool_watchdog_interval =
+    "DD_PROFILER_THREADPOOL_WATCHDOG_INTERVAL"_W;
+
+// Enables measuring the JIT compilation time of each method and module, and
+// the part of it spent instrumenting. Default is false.
+const WSTRING jit_statistics_enabled = "DD_PROFILER_JIT_STATISTICS_ENABLED"_W;
+
+// Sets the number of slowest compiled methods kept by the JIT statistics.
+// Default is 50.
+const WSTRING jit_statistics_top_methods =
+    "DD_PROFILER_JIT_STATISTICS_TOP_METHODS"_W;
+
+// Sets the path of a file to write the methods JIT-compiled during startup
+// to, in order, to pick the methods to precompile with ReadyToRun. Startup
+// recording is disabled if not set.
+const WSTRING startup_methods_file = "DD_PROFILER_STARTUP_METHODS_FILE"_W;
+
+// Sets the length of the startup recorded to DD_PROFILER_STARTUP_METHODS_FILE
+// in milliseconds. Default is 30000.
+const WSTRING startup_window_ms = "DD_PROFILER_STARTUP_WINDOW_MS"_W;
+
+// Enables the in-process EventPipe session for lock contention, thread-pool
+// adjustment and GC events. Default is false. Requires .NET 5 or later.
+const WSTRING runtime_events_enabled = "DD_PROFILER_RUNTIME_EVENTS_ENABLED"_W;
+
+// Sets a semicolon-separated list of methods to time with the enter/leave
+// hooks, as [Assembly!]Namespace.Type.Method patterns with '*' and '?'
+// wildcards. Method timing is disabled if neither this nor
+// DD_PROFILER_METHOD_TIMING_FILE selects any method.
+const WSTRING method_timing = "DD_PROFILER_METHOD_TIMING"_W;
+
+// Sets the path of a file listing methods to time, one pattern per line.
+const WSTRING method_timing_file = "DD_PROFILER_METHOD_TIMING_FILE"_W;
+
 }  // namespace environment
 }  // namespace trace
 
@@ -0,0 +1,119 @@
+#ifndef DD_CLR_PROFILER_EVENT_PIPE_H_
+#define DD_CLR_PROFILER_EVENT_PIPE_H_
+
+// The EventPipe profiler APIs added in .NET 5, declared as in the runtime's
+// corprof.idl since the corprof.h this project builds against stops at
+// ICorProfilerInfo10. Keep them in sync with corprof.idl, and drop them once
+// corprof.h declares them.
+
+#include <corhlpr.h>
+#include <corprof.h>
+
+#ifndef __ICorProfilerInfo12_INTERFACE_DEFINED__
+
+typedef UINT64 EVENTPIPE_SESSION;
+typedef UINT_PTR EVENTPIPE_PROVIDER;
+typedef UINT_PTR EVENTPIPE_EVENT;
+
+typedef struct {
+  const WCHAR* providerName;
+  UINT64 keywords;
+  UINT32 loggingLevel;
+  // filterData expects a semicolon delimited string that defines key value
+  // pairs such as "key1=value1;key2=value2;"
+  const WCHAR* filterData;
+} COR_PRF_EVENTPIPE_PROVIDER_CONFIG;
+
+typedef struct {
+  UINT32 type;
+  UINT32 elementType;
+  const WCHAR* name;
+} COR_PRF_EVENTPIPE_PARAM_DESC;
+
+typedef struct {
+  UINT64 ptr;
+  UINT32 size;
+  UINT32 reserved;
+} COR_PRF_EVENT_DATA;
+
+#endif  // __ICorProfilerInfo12_INTERFACE_DEFINED__
+
+#ifndef __ICorProfilerInfo11_INTERFACE_DEFINED__
+#define __ICorProfilerInfo11_INTERFACE_DEFINED__
+
+MIDL_INTERFACE("06398876-8987-4154-B621-40A00D6E4D04")
+ICorProfilerInfo11 : public ICorProfilerInfo10 {
+ public:
+  virtual HRESULT STDMETHODCALLTYPE GetEnvironmentVariable(
+      const WCHAR* szName, ULONG cchValue, ULONG* pcchValue,
+      WCHAR szValue[]) = 0;
+
+  virtual HRESULT STDMETHODCALLTYPE
+  SetEnvironmentVariable(const WCHAR* szName, const WCHAR* szValue) = 0;
+};
+
+#endif  // __ICorProfilerInfo11_INTERFACE_DEFINED__
+
+#ifndef __ICorProfilerInfo12_INTERFACE_DEFINED__
+#define __ICorProfilerInfo12_INTERFACE_DEFINED__
+
+MIDL_INTERFACE("27B24CCD-1CB1-47C5-96EE-98190DC30959")
+ICorProfilerInfo12 : public ICorProfilerInfo11 {
+ public:
+  virtual HRESULT STDMETHODCALLTYPE EventPipeStartSession(
+      UINT32 cProviderConfigs,
+      COR_PRF_EVENTPIPE_PROVIDER_CONFIG pProviderConfigs[],
+      BOOL requestRundown, EVENTPIPE_SESSION* pSession) = 0;
+
+  virtual HRESULT STDMETHODCALLTYPE EventPipeAddProviderToSession(
+      EVENTPIPE_SESSION session,
+      COR_PRF_EVENTPIPE_PROVIDER_CONFIG providerConfig) = 0;
+
+  virtual HRESULT STDMETHODCALLTYPE
+  EventPipeStopSession(EVENTPIPE_SESSION session) = 0;
+
+  virtual HRESULT STDMETHODCALLTYPE EventPipeCreateProvider(
+      const WCHAR* providerName, EVENTPIPE_PROVIDER* pProvider) = 0;
+
+  virtual HRESULT STDMETHODCALLTYPE EventPipeGetProviderInfo(
+      EVENTPIPE_PROVIDER provider, ULONG cchName, ULONG* pcchName,
+      WCHAR providerName[]) = 0;
+
+  virtual HRESULT STDMETHODCALLTYPE EventPipeDefineEvent(
+      EVENTPIPE_PROVIDER provider, const WCHAR* eventName, UINT32 eventID,
+      UINT64 keywords, UINT32 eventVersion, UINT32 level, UINT8 opcode,
+      BOOL needStack, UINT32 cParamDescs,
+      COR_PRF_EVENTPIPE_PARAM_DESC pParamDescs[],
+      EVENTPIPE_EVENT* pEvent) = 0;
+
+  virtual HRESULT STDMETHODCALLTYPE EventPipeWriteEvent(
+      EVENTPIPE_EVENT event, UINT32 cData, COR_PRF_EVENT_DATA data[],
+      LPCGUID pActivityId, LPCGUID pRelatedActivityId) = 0;
+};
+
+#endif  // __ICorProfilerInfo12_INTERFACE_DEFINED__
+
+#ifndef __ICorProfilerCallback10_INTERFACE_DEFINED__
+#define __ICorProfilerCallback10_INTERFACE_DEFINED__
+
+MIDL_INTERFACE("CEC5B60E-C69C-495F-87F6-84D28EE16FFB")
+ICorProfilerCallback10 : public ICorProfilerCallback9 {
+ public:
+  virtual HRESULT STDMETHODCALLTYPE EventPipeEventDelivered(
+      EVENTPIPE_PROVIDER provider, DWORD eventId, DWORD eventVersion,
+      ULONG cbMetadataBlob, LPCBYTE metadataBlob, ULONG cbEventData,
+      LPCBYTE eventData, LPCGUID pActivityId, LPCGUID pRelatedActivityId,
+      ThreadID eventThread, ULONG numStackFrames,
+      UINT_PTR stackFrames[]) = 0;
+
+  virtual HRESULT STDMETHODCALLTYPE
+  EventPipeProviderCreated(EVENTPIPE_PROVIDER provider) = 0;
+};
+
+#endif  // __ICorProfilerCallback10_INTERFACE_DEFINED__
+
+// COR_PRF_HIGH_MONITOR_EVENT_PIPE of COR_PRF_HIGH_MONITOR, which enables
+// EventPipeEventDelivered.
+const DWORD kCorPrfHighMonitorEventPipe = 0x80;
+
+#endif  // DD_CLR_PROFILER_EVENT_PIPE_H_
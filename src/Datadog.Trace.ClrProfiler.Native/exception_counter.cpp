@@ -0,0 +1,139 @@
+#include "exception_counter.h"
+
+#include "logging.h"
+
+namespace trace {
+
+namespace {
+
+// class of the exception thrown by the thread whose throwing frame is not
+// known yet, 0 if none
+thread_local ClassID pending_class_id = 0;
+
+}  // namespace
+
+void ExceptionCounter::Initialize(ICorProfilerInfo3* info) {
+  slots_.reset(new Slot[kExceptionTableCapacity]);
+  for (size_t i = 0; i < kExceptionTableCapacity; i++) {
+    slots_[i].state.store(kEmpty, std::memory_order_relaxed);
+    slots_[i].class_id = 0;
+    slots_[i].function_id = 0;
+    slots_[i].count.store(0, std::memory_order_relaxed);
+  }
+
+  info_ = info;
+  enabled_ = true;
+
+  Info("Exception counting enabled.");
+}
+
+ExceptionCounter::Slot* ExceptionCounter::FindOrInsert(ClassID class_id,
+                                                       FunctionID function_id) {
+  uint64_t hash = (static_cast<uint64_t>(class_id) * 0x9E3779B97F4A7C15ULL) ^
+                  static_cast<uint64_t>(function_id);
+  hash ^= hash >> 29;
+
+  for (size_t probe = 0; probe < kExceptionTableMaxProbes; probe++) {
+    auto& slot = slots_[(hash + probe) & (kExceptionTableCapacity - 1)];
+    auto state = slot.state.load(std::memory_order_acquire);
+
+    if (state == kEmpty) {
+      uint32_t expected = kEmpty;
+      if (slot.state.compare_exchange_strong(expected, kClaimed,
+                                             std::memory_order_acquire)) {
+        slot.class_id = class_id;
+        slot.function_id = function_id;
+        slot.state.store(kReady, std::memory_order_release);
+        return &slot;
+      }
+
+      state = expected;
+    }
+
+    // another thread is filling in this slot, the window is a couple of
+    // stores long
+    while (state == kClaimed) {
+      state = slot.state.load(std::memory_order_acquire);
+    }
+
+    if (slot.class_id == class_id && slot.function_id == function_id) {
+      return &slot;
+    }
+  }
+
+  return nullptr;
+}
+
+void ExceptionCounter::OnExceptionThrown(ObjectID thrown_object_id) {
+  if (!enabled_ || info_ == nullptr) {
+    return;
+  }
+
+  // the previous exception of this thread never reached a managed frame
+  if (pending_class_id != 0) {
+    Count(pending_class_id, 0);
+    pending_class_id = 0;
+  }
+
+  ClassID class_id = 0;
+  if (FAILED(info_->GetClassFromObject(thrown_object_id, &class_id)) ||
+      class_id == 0) {
+    total_count_.fetch_add(1, std::memory_order_relaxed);
+    dropped_count_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  pending_class_id = class_id;
+}
+
+void ExceptionCounter::OnExceptionSearchFunctionEnter(FunctionID function_id) {
+  // the search enters the frames from the innermost one: only the first is
+  // the throwing method
+  if (pending_class_id == 0) {
+    return;
+  }
+
+  Count(pending_class_id, function_id);
+  pending_class_id = 0;
+}
+
+void ExceptionCounter::Count(ClassID class_id, FunctionID function_id) {
+  if (!enabled_) {
+    return;
+  }
+
+  total_count_.fetch_add(1, std::memory_order_relaxed);
+
+  auto slot = FindOrInsert(class_id, function_id);
+  if (slot == nullptr) {
+    dropped_count_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  slot->count.fetch_add(1, std::memory_order_relaxed);
+}
+
+size_t ExceptionCounter::Snapshot(ExceptionCount* counts,
+                                  size_t max_counts) const {
+  if (!slots_) {
+    return 0;
+  }
+
+  size_t written = 0;
+  for (size_t i = 0; i < kExceptionTableCapacity && written < max_counts;
+       i++) {
+    const auto& slot = slots_[i];
+    if (slot.state.load(std::memory_order_acquire) != kReady) {
+      continue;
+    }
+
+    auto& count = counts[written++];
+    count.class_id = slot.class_id;
+    count.function_id = slot.function_id;
+    count.count = slot.count.load(std::memory_order_relaxed);
+  }
+
+  return written;
+}
+
+}  // namespace trace
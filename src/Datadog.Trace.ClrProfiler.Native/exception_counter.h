@@ -0,0 +1,100 @@
+#ifndef DD_CLR_PROFILER_EXCEPTION_COUNTER_H_
+#define DD_CLR_PROFILER_EXCEPTION_COUNTER_H_
+
+#include <corhlpr.h>
+#include <corprof.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace trace {
+
+// Number of distinct (exception class, throwing method) pairs that can be
+// counted. Must be a power of two.
+const size_t kExceptionTableCapacity = 4096;
+
+// Maximum number of slots probed before an exception is counted as dropped.
+const size_t kExceptionTableMaxProbes = 16;
+
+// ExceptionCount is the running total for one exception class thrown from one
+// method, handed to managed code by GetExceptionCounts in interop.cpp. Names
+// are resolved when read, with ResolveClassName and ResolveFunctionName: the
+// IDs of a module that was unloaded since can no longer be named. It is
+// blittable: keep its layout in sync with the managed definition.
+struct ExceptionCount {
+  uint64_t class_id;
+  // innermost managed frame when the exception was thrown, 0 if unknown
+  uint64_t function_id;
+  uint64_t count;
+};
+
+// ExceptionCounter counts first-chance exceptions reported by ExceptionThrown
+// by class and throwing method.
+//
+// Only raw IDs are kept on the throwing thread: ExceptionThrown reads the
+// class of the exception, and the first ExceptionSearchFunctionEnter of the
+// first pass that follows on the same thread names the innermost managed
+// frame, so no stack is walked and no name is resolved. Counts live in a
+// fixed-size open-addressed table updated without locks, so the cost of an
+// exception is bounded by kExceptionTableMaxProbes and nothing is allocated.
+class ExceptionCounter {
+ private:
+  enum SlotState : uint32_t { kEmpty = 0, kClaimed = 1, kReady = 2 };
+
+  struct Slot {
+    std::atomic<uint32_t> state;
+    ClassID class_id;
+    FunctionID function_id;
+    std::atomic<uint64_t> count;
+  };
+
+  ICorProfilerInfo3* info_ = nullptr;
+  bool enabled_ = false;
+  std::unique_ptr<Slot[]> slots_;
+
+  std::atomic<uint64_t> total_count_{0};
+  std::atomic<uint64_t> dropped_count_{0};
+
+  // returns nullptr if the pair cannot be inserted within the probe limit
+  Slot* FindOrInsert(ClassID class_id, FunctionID function_id);
+
+ public:
+  ExceptionCounter() = default;
+  ExceptionCounter(const ExceptionCounter&) = delete;
+  ExceptionCounter& operator=(const ExceptionCounter&) = delete;
+
+  // Initialize enables counting. info may be null in tests: exceptions are
+  // then only counted through Count.
+  void Initialize(ICorProfilerInfo3* info);
+
+  bool IsEnabled() const { return enabled_; }
+
+  // OnExceptionThrown must be called from ICorProfilerCallback::ExceptionThrown
+  void OnExceptionThrown(ObjectID thrown_object_id);
+
+  // OnExceptionSearchFunctionEnter must be called from
+  // ICorProfilerCallback::ExceptionSearchFunctionEnter.
+  void OnExceptionSearchFunctionEnter(FunctionID function_id);
+
+  // Count counts one exception of class_id thrown from function_id.
+  void Count(ClassID class_id, FunctionID function_id);
+
+  // Snapshot copies up to max_counts running totals into counts and returns
+  // how many were written. Totals are never reset: consumers compute deltas
+  // between snapshots.
+  size_t Snapshot(ExceptionCount* counts, size_t max_counts) const;
+
+  uint64_t TotalCount() const {
+    return total_count_.load(std::memory_order_relaxed);
+  }
+
+  // DroppedCount returns how many exceptions were not attributed because the
+  // table was full.
+  uint64_t DroppedCount() const {
+    return dropped_count_.load(std::memory_order_relaxed);
+  }
+};
+
+}  // namespace trace
+
+#endif  // DD_CLR_PROFILER_EXCEPTION_COUNTER_H_
@@ -0,0 +1,178 @@
+#include "gc_timeline.h"
+
+#include <cstring>
+#include <vector>
+
+#include "clock.h"
+
+namespace trace {
+
+GcTimeline::GcTimeline() {
+  for (int i = 0; i < kGcGenerationCount; i++) {
+    gc_counts_[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+void GcTimeline::Initialize(ICorProfilerInfo3* info) {
+  slots_.reset(new Slot[kGcTimelineCapacity]);
+  for (size_t i = 0; i < kGcTimelineCapacity; i++) {
+    slots_[i].sequence.store(0, std::memory_order_relaxed);
+  }
+  info_ = info;
+  enabled_ = true;
+}
+
+void GcTimeline::OnRuntimeSuspendStarted(COR_PRF_SUSPEND_REASON reason) {
+  if (!enabled_) {
+    return;
+  }
+
+  std::memset(&current_, 0, sizeof(current_));
+  current_.start_unix_ns = UnixNanoseconds();
+  current_.suspend_reason = static_cast<uint32_t>(reason);
+  current_.generation = -1;
+  current_start_ = MonotonicNanoseconds();
+  current_large_object_heap_ = false;
+  in_pause_ = true;
+}
+
+void GcTimeline::OnRuntimeSuspendFinished() {
+  if (!in_pause_) {
+    return;
+  }
+
+  current_.suspend_ns = MonotonicNanoseconds() - current_start_;
+}
+
+void GcTimeline::OnRuntimeSuspendAborted() { in_pause_ = false; }
+
+void GcTimeline::OnGarbageCollectionStarted(int generation_count,
+                                            const BOOL generation_collected[],
+                                            COR_PRF_GC_REASON reason) {
+  if (!in_pause_) {
+    return;
+  }
+
+  // the runtime flags the large object heap along with gen 2
+  for (int i = 0; i < generation_count && i < kGcLargeObjectHeap; i++) {
+    if (generation_collected[i]) {
+      current_.generation = i;
+    }
+  }
+  current_large_object_heap_ = generation_count > kGcLargeObjectHeap &&
+                               generation_collected[kGcLargeObjectHeap];
+  current_.gc_reason = static_cast<uint32_t>(reason);
+}
+
+void GcTimeline::OnGarbageCollectionFinished() {
+  if (!in_pause_) {
+    return;
+  }
+
+  if (current_.generation >= 0) {
+    gc_counts_[current_.generation].fetch_add(1, std::memory_order_relaxed);
+  }
+  if (current_large_object_heap_) {
+    gc_counts_[kGcLargeObjectHeap].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  if (info_ == nullptr) {
+    return;
+  }
+
+  COR_PRF_GC_GENERATION_RANGE ranges[64];
+  ULONG range_count = 0;
+  auto hr = info_->GetGenerationBounds(64, &range_count, ranges);
+  if (FAILED(hr)) {
+    return;
+  }
+
+  const COR_PRF_GC_GENERATION_RANGE* all_ranges = ranges;
+  std::vector<COR_PRF_GC_GENERATION_RANGE> more_ranges;
+
+  if (range_count > 64) {
+    more_ranges.resize(range_count);
+    hr = info_->GetGenerationBounds(range_count, &range_count,
+                                    more_ranges.data());
+    if (FAILED(hr)) {
+      return;
+    }
+    all_ranges = more_ranges.data();
+  }
+
+  for (ULONG i = 0; i < range_count; i++) {
+    const int generation = static_cast<int>(all_ranges[i].generation);
+    if (generation >= 0 && generation < kGcGenerationCount) {
+      current_.generation_sizes[generation] += all_ranges[i].rangeLength;
+    }
+  }
+}
+
+void GcTimeline::OnRuntimeResumeStarted() {
+  if (!in_pause_) {
+    return;
+  }
+
+  in_pause_ = false;
+  current_.pause_ns = MonotonicNanoseconds() - current_start_;
+
+  pause_count_.fetch_add(1, std::memory_order_relaxed);
+  total_pause_ns_.fetch_add(current_.pause_ns, std::memory_order_relaxed);
+
+  Publish(current_);
+}
+
+void GcTimeline::Publish(const GcPause& pause) {
+  const auto sequence =
+      last_sequence_.load(std::memory_order_relaxed) + 1;
+  auto& slot = slots_[sequence & (kGcTimelineCapacity - 1)];
+
+  // 0 marks the slot as being written
+  slot.sequence.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  slot.pause = pause;
+  slot.pause.sequence = sequence;
+
+  slot.sequence.store(sequence, std::memory_order_release);
+  last_sequence_.store(sequence, std::memory_order_release);
+}
+
+size_t GcTimeline::Read(uint64_t* cursor, GcPause* pauses,
+                        size_t max_pauses) const {
+  if (!slots_) {
+    return 0;
+  }
+
+  const auto last = last_sequence_.load(std::memory_order_acquire);
+  auto next = *cursor + 1;
+
+  // skip pauses that were already overwritten
+  if (last >= kGcTimelineCapacity && next <= last - kGcTimelineCapacity) {
+    next = last - kGcTimelineCapacity + 1;
+  }
+
+  size_t copied = 0;
+  for (; next <= last && copied < max_pauses; next++) {
+    const auto& slot = slots_[next & (kGcTimelineCapacity - 1)];
+
+    if (slot.sequence.load(std::memory_order_acquire) != next) {
+      continue;
+    }
+
+    pauses[copied] = slot.pause;
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    // the writer lapped us while we were copying
+    if (slot.sequence.load(std::memory_order_relaxed) != next) {
+      continue;
+    }
+
+    copied++;
+  }
+
+  *cursor = next - 1;
+  return copied;
+}
+
+}  // namespace trace
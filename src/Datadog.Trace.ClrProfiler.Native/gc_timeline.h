@@ -0,0 +1,123 @@
+#ifndef DD_CLR_PROFILER_GC_TIMELINE_H_
+#define DD_CLR_PROFILER_GC_TIMELINE_H_
+
+#include <corhlpr.h>
+#include <corprof.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace trace {
+
+// Number of pauses kept in the timeline. Must be a power of two. Readers that
+// fall further behind lose the oldest pauses.
+const size_t kGcTimelineCapacity = 1024;
+
+// Gen 0, gen 1, gen 2 and the large object heap.
+const int kGcGenerationCount = 4;
+
+// Index of the large object heap in the generation arrays. It is only
+// collected along with gen 2, and is never reported as the generation of a
+// pause.
+const int kGcLargeObjectHeap = COR_PRF_GC_LARGE_OBJECT_HEAP;
+
+// GcPause describes one runtime suspension, from RuntimeSuspendStarted to
+// RuntimeResumeStarted, and the garbage collection it ran if any. It is
+// blittable: keep its layout in sync with the managed definition.
+struct GcPause {
+  // position of this pause in the timeline, starting at 1
+  uint64_t sequence;
+  // wall-clock start of the suspension, nanoseconds since the Unix epoch
+  uint64_t start_unix_ns;
+  // time spent suspending managed threads
+  uint64_t suspend_ns;
+  // total time managed threads were paused
+  uint64_t pause_ns;
+  // COR_PRF_SUSPEND_REASON
+  uint32_t suspend_reason;
+  // COR_PRF_GC_REASON, only meaningful if generation >= 0
+  uint32_t gc_reason;
+  // highest generation collected, from 0 to 2, -1 if no GC ran during the
+  // pause
+  int32_t generation;
+  uint32_t reserved;
+  // size of each generation once the GC finished, in bytes
+  uint64_t generation_sizes[kGcGenerationCount];
+};
+
+// GcTimeline records runtime suspensions and garbage collections reported by
+// the profiler callbacks into a fixed-size ring buffer.
+//
+// The runtime serializes suspensions, so there is a single writer at a time
+// and the pause under construction needs no synchronization. Published pauses
+// are guarded by a per-slot sequence number: readers never block the GC and
+// discard slots that were overwritten while they were copying them.
+class GcTimeline {
+ private:
+  struct Slot {
+    std::atomic<uint64_t> sequence;
+    GcPause pause;
+  };
+
+  ICorProfilerInfo3* info_ = nullptr;
+  bool enabled_ = false;
+  std::unique_ptr<Slot[]> slots_;
+  std::atomic<uint64_t> last_sequence_{0};
+
+  std::atomic<uint64_t> pause_count_{0};
+  std::atomic<uint64_t> total_pause_ns_{0};
+  std::atomic<uint64_t> gc_counts_[kGcGenerationCount];
+
+  // pause under construction, only touched by the suspending thread
+  GcPause current_{};
+  uint64_t current_start_ = 0;
+  bool current_large_object_heap_ = false;
+  bool in_pause_ = false;
+
+  void Publish(const GcPause& pause);
+
+ public:
+  GcTimeline();
+  GcTimeline(const GcTimeline&) = delete;
+  GcTimeline& operator=(const GcTimeline&) = delete;
+
+  // Initialize starts recording. info may be null in tests: generation sizes
+  // are then not read.
+  void Initialize(ICorProfilerInfo3* info);
+
+  bool IsEnabled() const { return enabled_; }
+
+  void OnRuntimeSuspendStarted(COR_PRF_SUSPEND_REASON reason);
+  void OnRuntimeSuspendFinished();
+  void OnRuntimeSuspendAborted();
+  void OnRuntimeResumeStarted();
+  void OnGarbageCollectionStarted(int generation_count,
+                                  const BOOL generation_collected[],
+                                  COR_PRF_GC_REASON reason);
+  void OnGarbageCollectionFinished();
+
+  // Read copies the pauses that follow *cursor (a sequence number, 0 to start
+  // from the oldest retained pause) into pauses and advances *cursor past the
+  // last one copied. Returns the number of pauses copied.
+  size_t Read(uint64_t* cursor, GcPause* pauses, size_t max_pauses) const;
+
+  uint64_t PauseCount() const {
+    return pause_count_.load(std::memory_order_relaxed);
+  }
+
+  uint64_t TotalPauseNanoseconds() const {
+    return total_pause_ns_.load(std::memory_order_relaxed);
+  }
+
+  // GcCount returns the number of collections of the given generation, or
+  // of those that collected the large object heap for kGcLargeObjectHeap.
+  uint64_t GcCount(int generation) const {
+    return generation >= 0 && generation < kGcGenerationCount
+               ? gc_counts_[generation].load(std::memory_order_relaxed)
+               : 0;
+  }
+};
+
+}  // namespace trace
+
+#endif  // DD_CLR_PROFILER_GC_TIMELINE_H_
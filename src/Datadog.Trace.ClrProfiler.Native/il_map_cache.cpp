@@ -0,0 +1,446 @@
+#include "il_map_cache.h"
+
+#include <algorithm>
+
+#include "logging.h"
+
+namespace trace {
+
+namespace {
+
+// IL offset of native code that maps to no IL instruction.
+const int32_t kNoMapping = -1;
+
+void WriteVarint(std::vector<uint8_t>& bytes, uint64_t value) {
+  while (value >= 0x80) {
+    bytes.push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  bytes.push_back(static_cast<uint8_t>(value));
+}
+
+uint64_t ReadVarint(const uint8_t* bytes, size_t* position) {
+  uint64_t value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    const auto byte = bytes[(*position)++];
+    value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      break;
+    }
+  }
+  return value;
+}
+
+uint64_t ZigZag(int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^
+         static_cast<uint64_t>(value >> 63);
+}
+
+int64_t UnZigZag(uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+bool InCode(const COR_PRF_CODE_INFO code_ranges[], uint32_t range_count,
+            UINT_PTR ip) {
+  for (uint32_t i = 0; i < range_count; i++) {
+    if (ip >= code_ranges[i].startAddress &&
+        ip - code_ranges[i].startAddress < code_ranges[i].size) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+void ILMapCache::Initialize(ICorProfilerInfo4* info, ICorProfilerInfo9* info9) {
+  info_ = info;
+  info9_ = info9;
+  enabled_ = true;
+}
+
+void ILMapCache::Encode(FunctionID function_id, ReJITID rejit_id,
+                        ModuleID module_id, mdToken method_token,
+                        const COR_PRF_CODE_INFO code_ranges[],
+                        uint32_t range_count,
+                        const COR_DEBUG_IL_TO_NATIVE_MAP entries[],
+                        uint32_t entry_count, Map* map) {
+  map->function_id = function_id;
+  map->rejit_id = rejit_id;
+  map->module_id = module_id;
+  map->method_token = method_token;
+  map->range_count = std::min(range_count, kMaxILMapCodeRanges);
+  for (uint32_t i = 0; i < map->range_count; i++) {
+    map->ranges[i].start = code_ranges[i].startAddress;
+    map->ranges[i].size = code_ranges[i].size;
+  }
+
+  std::vector<COR_DEBUG_IL_TO_NATIVE_MAP> sorted(entries,
+                                                 entries + entry_count);
+  std::stable_sort(sorted.begin(), sorted.end(),
+                   [](const COR_DEBUG_IL_TO_NATIVE_MAP& a,
+                      const COR_DEBUG_IL_TO_NATIVE_MAP& b) {
+                     return a.nativeStartOffset < b.nativeStartOffset;
+                   });
+
+  map->entry_count = entry_count;
+  map->anchors.clear();
+  map->anchors.reserve((entry_count + kILMapBlockSize - 1) / kILMapBlockSize);
+  map->bytes.clear();
+  // most deltas take a byte
+  map->bytes.reserve(entry_count * 3);
+
+  uint32_t previous_native_offset = 0;
+  int32_t previous_il_offset = 0;
+
+  for (uint32_t i = 0; i < entry_count; i++) {
+    const auto& entry = sorted[i];
+    const auto il_offset = static_cast<int32_t>(entry.ilOffset);
+
+    if (i % kILMapBlockSize == 0) {
+      map->anchors.push_back({entry.nativeStartOffset, previous_native_offset,
+                              previous_il_offset,
+                              static_cast<uint32_t>(map->bytes.size())});
+    }
+
+    WriteVarint(map->bytes, entry.nativeStartOffset - previous_native_offset);
+    WriteVarint(map->bytes,
+                entry.nativeEndOffset > entry.nativeStartOffset
+                    ? entry.nativeEndOffset - entry.nativeStartOffset
+                    : 0);
+    WriteVarint(map->bytes, ZigZag(static_cast<int64_t>(il_offset) -
+                                   previous_il_offset));
+
+    previous_native_offset = entry.nativeStartOffset;
+    previous_il_offset = il_offset;
+  }
+
+  map->anchors.shrink_to_fit();
+  map->bytes.shrink_to_fit();
+}
+
+bool ILMapCache::Find(const Map& map, UINT_PTR ip, int32_t* il_offset) {
+  // native offsets run through the code ranges one after the other
+  uint64_t native_offset = 0;
+  uint64_t range_base = 0;
+  bool in_code = false;
+  for (uint32_t i = 0; i < map.range_count; i++) {
+    const auto& range = map.ranges[i];
+    if (ip >= range.start && ip - range.start < range.size) {
+      native_offset = range_base + (ip - range.start);
+      in_code = true;
+      break;
+    }
+    range_base += range.size;
+  }
+
+  if (!in_code) {
+    return false;
+  }
+
+  const auto anchor = std::upper_bound(
+      map.anchors.begin(), map.anchors.end(), native_offset,
+      [](uint64_t offset, const Anchor& a) { return offset < a.native_offset; });
+  if (anchor == map.anchors.begin()) {
+    // before the first entry
+    *il_offset = kNoMapping;
+    return true;
+  }
+
+  const auto& block = *(anchor - 1);
+  const auto first = static_cast<uint32_t>(anchor - 1 - map.anchors.begin()) *
+                     kILMapBlockSize;
+  const auto last = std::min(first + kILMapBlockSize, map.entry_count);
+
+  size_t position = block.position;
+  uint64_t start = block.previous_native_offset;
+  int64_t il = block.previous_il_offset;
+  uint64_t found_start = 0;
+  uint64_t found_length = 0;
+  int64_t found_il = kNoMapping;
+
+  for (uint32_t i = first; i < last; i++) {
+    start += ReadVarint(map.bytes.data(), &position);
+    const auto length = ReadVarint(map.bytes.data(), &position);
+    il += UnZigZag(ReadVarint(map.bytes.data(), &position));
+
+    if (start > native_offset) {
+      break;
+    }
+
+    found_start = start;
+    found_length = length;
+    found_il = il;
+  }
+
+  // an entry without a length runs until the next one
+  *il_offset = found_length == 0 || native_offset - found_start < found_length
+                   ? static_cast<int32_t>(found_il)
+                   : kNoMapping;
+  return true;
+}
+
+bool ILMapCache::Load(FunctionID function_id, ReJITID rejit_id, UINT_PTR ip,
+                      Map* map) const {
+  ModuleID module_id = 0;
+  mdToken method_token = mdTokenNil;
+  if (FAILED(info_->GetFunctionInfo(function_id, nullptr, &module_id,
+                                    &method_token))) {
+    return false;
+  }
+
+  COR_PRF_CODE_INFO code_ranges[kMaxILMapCodeRanges];
+  ULONG32 range_count = 0;
+  ULONG32 entry_count = 0;
+  std::vector<COR_DEBUG_IL_TO_NATIVE_MAP> entries;
+
+  if (info9_ != nullptr) {
+    // tier-0, tier-1 and OSR bodies share the version: take the one that
+    // holds ip
+    UINT_PTR code_starts[kMaxILMapNativeBodies];
+    ULONG32 code_start_count = 0;
+    if (FAILED(info9_->GetNativeCodeStartAddresses(
+            function_id, rejit_id, kMaxILMapNativeBodies, &code_start_count,
+            code_starts))) {
+      return false;
+    }
+
+    UINT_PTR code_start = 0;
+    code_start_count = std::min(code_start_count, kMaxILMapNativeBodies);
+    for (ULONG32 i = 0; i < code_start_count && code_start == 0; i++) {
+      if (SUCCEEDED(info9_->GetCodeInfo4(code_starts[i], kMaxILMapCodeRanges,
+                                         &range_count, code_ranges)) &&
+          InCode(code_ranges, std::min(range_count, kMaxILMapCodeRanges),
+                 ip)) {
+        code_start = code_starts[i];
+      }
+    }
+
+    if (code_start == 0 ||
+        FAILED(info9_->GetILToNativeMapping3(code_start, 0, &entry_count,
+                                             nullptr)) ||
+        entry_count == 0) {
+      return false;
+    }
+
+    entries.resize(entry_count);
+    if (FAILED(info9_->GetILToNativeMapping3(code_start, entry_count,
+                                             &entry_count, entries.data()))) {
+      return false;
+    }
+  } else {
+    if (FAILED(info_->GetCodeInfo3(function_id, rejit_id, kMaxILMapCodeRanges,
+                                   &range_count, code_ranges)) ||
+        !InCode(code_ranges, std::min(range_count, kMaxILMapCodeRanges),
+                ip)) {
+      return false;
+    }
+
+    if (FAILED(info_->GetILToNativeMapping2(function_id, rejit_id, 0,
+                                            &entry_count, nullptr)) ||
+        entry_count == 0) {
+      return false;
+    }
+
+    entries.resize(entry_count);
+    if (FAILED(info_->GetILToNativeMapping2(function_id, rejit_id,
+                                            entry_count, &entry_count,
+                                            entries.data()))) {
+      return false;
+    }
+  }
+
+  Encode(function_id, rejit_id, module_id, method_token, code_ranges,
+         std::min<uint32_t>(range_count, kMaxILMapCodeRanges), entries.data(),
+         std::min<uint32_t>(entry_count,
+                            static_cast<uint32_t>(entries.size())),
+         map);
+  return true;
+}
+
+bool ILMapCache::Resolve(const Map& map, UINT_PTR ip,
+                         ILOffsetLocation* location) {
+  int32_t il_offset = kNoMapping;
+  if (!Find(map, ip, &il_offset)) {
+    return false;
+  }
+
+  location->function_id = map.function_id;
+  location->rejit_id = map.rejit_id;
+  location->module_id = map.module_id;
+  location->method_token = map.method_token;
+  location->il_offset = il_offset;
+  return true;
+}
+
+size_t ILMapCache::SizeOf(const Map& map) {
+  return sizeof(Map) + map.bytes.capacity() +
+         map.anchors.capacity() * sizeof(Anchor);
+}
+
+const ILMapCache::Map* ILMapCache::FindMap(UINT_PTR ip) const {
+  auto range = ranges_.upper_bound(ip);
+  if (range == ranges_.begin()) {
+    return nullptr;
+  }
+
+  --range;
+  if (ip >= range->second.end) {
+    return nullptr;
+  }
+
+  const auto map = maps_.find(range->second.code_start);
+  return map == maps_.end() ? nullptr : &map->second;
+}
+
+bool ILMapCache::Insert(Map&& map) {
+  if (map.range_count == 0) {
+    return false;
+  }
+
+  const auto size = SizeOf(map);
+  if (size_bytes_ + size > kMaxILMapCacheBytes) {
+    return false;
+  }
+
+  // code of an unloaded method can be reused: drop the maps it overlaps
+  std::vector<UINT_PTR> overlapped;
+  for (uint32_t i = 0; i < map.range_count; i++) {
+    const auto start = map.ranges[i].start;
+    const auto end = start + map.ranges[i].size;
+
+    auto range = ranges_.lower_bound(start);
+    if (range != ranges_.begin()) {
+      --range;
+    }
+    for (; range != ranges_.end() && range->first < end; ++range) {
+      if (range->second.end > start) {
+        overlapped.push_back(range->second.code_start);
+      }
+    }
+  }
+  for (const auto code_start : overlapped) {
+    Remove(code_start);
+  }
+
+  const auto code_start = map.ranges[0].start;
+  for (uint32_t i = 0; i < map.range_count; i++) {
+    ranges_[map.ranges[i].start] = {map.ranges[i].start + map.ranges[i].size,
+                                    code_start};
+  }
+  maps_.emplace(code_start, std::move(map));
+  size_bytes_ += size;
+  return true;
+}
+
+void ILMapCache::Remove(UINT_PTR code_start) {
+  const auto map = maps_.find(code_start);
+  if (map == maps_.end()) {
+    return;
+  }
+
+  for (uint32_t i = 0; i < map->second.range_count; i++) {
+    const auto range = ranges_.find(map->second.ranges[i].start);
+    if (range != ranges_.end() && range->second.code_start == code_start) {
+      ranges_.erase(range);
+    }
+  }
+
+  size_bytes_ -= std::min(size_bytes_, SizeOf(map->second));
+  maps_.erase(map);
+}
+
+bool ILMapCache::Add(FunctionID function_id, ReJITID rejit_id,
+                     ModuleID module_id, mdToken method_token,
+                     const COR_PRF_CODE_INFO code_ranges[],
+                     uint32_t range_count,
+                     const COR_DEBUG_IL_TO_NATIVE_MAP entries[],
+                     uint32_t entry_count) {
+  Map map;
+  Encode(function_id, rejit_id, module_id, method_token, code_ranges,
+         range_count, entries, entry_count, &map);
+
+  std::lock_guard<std::mutex> guard(lock_);
+  return Insert(std::move(map));
+}
+
+bool ILMapCache::Lookup(FunctionID function_id, ReJITID rejit_id, UINT_PTR ip,
+                        ILOffsetLocation* location) {
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    const auto cached = FindMap(ip);
+    if (cached != nullptr && cached->function_id == function_id &&
+        cached->rejit_id == rejit_id) {
+      return Resolve(*cached, ip, location);
+    }
+  }
+
+  if (!enabled_ || info_ == nullptr) {
+    return false;
+  }
+
+  // fetched without the lock: the runtime may block
+  Map map;
+  if (!Load(function_id, rejit_id, ip, &map) ||
+      !Resolve(map, ip, location)) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> guard(lock_);
+  if (!Insert(std::move(map)) && debug_logging_enabled) {
+    Debug("ILMapCache: full, not caching the map of function_id=",
+          function_id);
+  }
+  return true;
+}
+
+bool ILMapCache::LookupIP(UINT_PTR ip, ILOffsetLocation* location) {
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    const auto cached = FindMap(ip);
+    if (cached != nullptr) {
+      return Resolve(*cached, ip, location);
+    }
+  }
+
+  if (!enabled_ || info_ == nullptr) {
+    return false;
+  }
+
+  FunctionID function_id = 0;
+  ReJITID rejit_id = 0;
+  if (FAILED(info_->GetFunctionFromIP2(reinterpret_cast<LPCBYTE>(ip),
+                                       &function_id, &rejit_id)) ||
+      function_id == 0) {
+    return false;
+  }
+
+  return Lookup(function_id, rejit_id, ip, location);
+}
+
+void ILMapCache::EvictModule(ModuleID module_id) {
+  std::lock_guard<std::mutex> guard(lock_);
+
+  std::vector<UINT_PTR> evicted;
+  for (const auto& map : maps_) {
+    if (map.second.module_id == module_id) {
+      evicted.push_back(map.first);
+    }
+  }
+
+  for (const auto code_start : evicted) {
+    Remove(code_start);
+  }
+}
+
+size_t ILMapCache::MapCount() const {
+  std::lock_guard<std::mutex> guard(lock_);
+  return maps_.size();
+}
+
+size_t ILMapCache::SizeBytes() const {
+  std::lock_guard<std::mutex> guard(lock_);
+  return size_bytes_;
+}
+
+}  // namespace trace
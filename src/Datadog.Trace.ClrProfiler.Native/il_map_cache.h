@@ -0,0 +1,174 @@
+#ifndef DD_CLR_PROFILER_IL_MAP_CACHE_H_
+#define DD_CLR_PROFILER_IL_MAP_CACHE_H_
+
+#include <corhlpr.h>
+#include <corprof.h>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace trace {
+
+// Maximum memory taken by the encoded maps. Methods beyond it are resolved
+// without being cached.
+const size_t kMaxILMapCacheBytes = 32 * 1024 * 1024;
+
+// Number of mapping entries between two anchors of the index. Lookups decode
+// at most that many entries after a binary search on the anchors.
+const uint32_t kILMapBlockSize = 16;
+
+// Maximum number of code ranges of a method (hot and cold code).
+const uint32_t kMaxILMapCodeRanges = 4;
+
+// Maximum number of native bodies of a method version: with tiered
+// compilation, tier-0, tier-1 and OSR code.
+const uint32_t kMaxILMapNativeBodies = 8;
+
+// ILOffsetLocation is the IL instruction an instruction pointer belongs to,
+// handed to managed code by GetILOffsets in interop.cpp. With the method
+// token, it is matched offline against the sequence points of the PDB. It is
+// blittable: keep its layout in sync with the managed definition.
+struct ILOffsetLocation {
+  // 0 if the instruction pointer could not be resolved
+  uint64_t function_id;
+  uint64_t rejit_id;
+  uint64_t module_id;
+  uint32_t method_token;
+  // IL offset, or a CorDebugIlToNativeMappingTypes value: -1 (no mapping),
+  // -2 (prolog) or -3 (epilog)
+  int32_t il_offset;
+};
+
+// ILMapCache caches the IL-to-native maps of jitted methods, per native
+// body, to tell which IL instruction a sampled instruction pointer belongs
+// to. A method version can have several bodies under tiered compilation, so
+// maps are keyed by native code start address and found through the code
+// ranges they cover, without calling the runtime.
+//
+// Maps are fetched from the runtime the first time an instruction pointer of
+// their body is looked up.
+// They are sorted by native offset and delta-encoded as varints, every
+// kILMapBlockSize-th entry being indexed by an anchor: a lookup binary
+// searches the anchors and decodes one block, in O(log n) without
+// allocating. Maps are freed when their module unloads.
+class ILMapCache {
+ private:
+  struct Anchor {
+    // native start offset of the first entry of the block
+    uint32_t native_offset;
+    // the entry before the block, the deltas of its first entry are relative
+    // to it
+    uint32_t previous_native_offset;
+    int32_t previous_il_offset;
+    // position of the first entry of the block in bytes
+    uint32_t position;
+  };
+
+  struct CodeRange {
+    UINT_PTR start;
+    UINT_PTR size;
+  };
+
+  // a code range of a cached map, indexed by its start address
+  struct IndexedRange {
+    UINT_PTR end;
+    UINT_PTR code_start;
+  };
+
+  struct Map {
+    FunctionID function_id;
+    ReJITID rejit_id;
+    ModuleID module_id;
+    mdToken method_token;
+    uint32_t range_count;
+    CodeRange ranges[kMaxILMapCodeRanges];
+    uint32_t entry_count;
+    std::vector<Anchor> anchors;
+    // per entry: native start delta, native length, zigzag IL offset delta
+    std::vector<uint8_t> bytes;
+  };
+
+  ICorProfilerInfo4* info_ = nullptr;
+  ICorProfilerInfo9* info9_ = nullptr;
+  bool enabled_ = false;
+
+  mutable std::mutex lock_;
+  // by native code start address, the start of the first code range
+  std::unordered_map<UINT_PTR, Map> maps_;
+  // the code ranges of every cached map, by start address
+  std::map<UINT_PTR, IndexedRange> ranges_;
+  size_t size_bytes_ = 0;
+
+  // Load fetches and encodes the map of the native body of a method version
+  // that holds ip from the runtime.
+  bool Load(FunctionID function_id, ReJITID rejit_id, UINT_PTR ip,
+            Map* map) const;
+
+  static void Encode(FunctionID function_id, ReJITID rejit_id,
+                     ModuleID module_id, mdToken method_token,
+                     const COR_PRF_CODE_INFO code_ranges[],
+                     uint32_t range_count,
+                     const COR_DEBUG_IL_TO_NATIVE_MAP entries[],
+                     uint32_t entry_count, Map* map);
+
+  // Find decodes the entry of map that holds ip.
+  static bool Find(const Map& map, UINT_PTR ip, int32_t* il_offset);
+
+  // Resolve fills location with the entry of map that holds ip.
+  static bool Resolve(const Map& map, UINT_PTR ip, ILOffsetLocation* location);
+
+  static size_t SizeOf(const Map& map);
+
+  // The following are called with lock_ held.
+
+  // FindMap returns the cached map whose code holds ip, or nullptr.
+  const Map* FindMap(UINT_PTR ip) const;
+
+  // Insert caches map unless the cache is full, replacing the maps of code
+  // it overlaps, which was freed and reused.
+  bool Insert(Map&& map);
+
+  void Remove(UINT_PTR code_start);
+
+ public:
+  ILMapCache() = default;
+  ILMapCache(const ILMapCache&) = delete;
+  ILMapCache& operator=(const ILMapCache&) = delete;
+
+  // Initialize enables looking up maps from info. info9 is optional: without
+  // it, which is before .NET Core 3.0, only the first native body of a
+  // method version can be resolved.
+  void Initialize(ICorProfilerInfo4* info, ICorProfilerInfo9* info9);
+
+  bool IsEnabled() const { return enabled_; }
+
+  // Add encodes and caches a map. code_ranges are one native body of the
+  // method, in the order GetCodeInfo4 reports them: native offsets run
+  // through them one after the other. Returns false if the cache is full.
+  bool Add(FunctionID function_id, ReJITID rejit_id, ModuleID module_id,
+           mdToken method_token, const COR_PRF_CODE_INFO code_ranges[],
+           uint32_t range_count, const COR_DEBUG_IL_TO_NATIVE_MAP entries[],
+           uint32_t entry_count);
+
+  // Lookup resolves ip, inside the code of the given method version, loading
+  // the map of the body that holds it on a miss. Returns false if it cannot
+  // be resolved.
+  bool Lookup(FunctionID function_id, ReJITID rejit_id, UINT_PTR ip,
+              ILOffsetLocation* location);
+
+  // LookupIP resolves ip from the cached maps, or finds the method version
+  // it belongs to and loads its map.
+  bool LookupIP(UINT_PTR ip, ILOffsetLocation* location);
+
+  // EvictModule frees the maps of the methods of a module being unloaded.
+  void EvictModule(ModuleID module_id);
+
+  size_t MapCount() const;
+  size_t SizeBytes() const;
+};
+
+}  // namespace trace
+
+#endif  // DD_CLR_PROFILER_IL_MAP_CACHE_H_
@@ -209,6 +209,13 @@ struct MethodReference {
         max_version(max_version),
         signature_types(signature_types) {}
 
+  // HasNamePattern returns true if the type or method name uses the '*' or
+  // '?' wildcards of WildcardMatch.
+  inline bool HasNamePattern() const {
+    return type_name.find_first_of("*?"_W) != WSTRING::npos ||
+           method_name.find_first_of("*?"_W) != WSTRING::npos;
+  }
+
   inline WSTRING get_type_cache_key() const {
     return "["_W + assembly.name + "]"_W + type_name + "_vMin_"_W +
            min_version.str() + "_vMax_"_W + max_version.str();
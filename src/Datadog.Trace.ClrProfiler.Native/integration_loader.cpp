@@ -12,8 +12,14 @@ namespace trace {
 using json = nlohmann::json;
 
 std::vector<Integration> LoadIntegrationsFromEnvironment() {
+  return LoadIntegrationsFromFiles(
+      GetEnvironmentValues(environment::integrations_path));
+}
+
+std::vector<Integration> LoadIntegrationsFromFiles(
+    const std::vector<WSTRING>& file_paths) {
   std::vector<Integration> integrations;
-  for (const auto f : GetEnvironmentValues(environment::integrations_path)) {
+  for (const auto& f : file_paths) {
     Debug("Loading integrations from file: ", f);
     auto is = LoadIntegrationsFromFile(f);
     for (auto& i : is) {
@@ -124,6 +130,14 @@ std::pair<MethodReplacement, bool> MethodReplacementFromJson(
       MethodReferenceFromJson(src.value("target", json::object()), true, false);
   const auto wrapper =
       MethodReferenceFromJson(src.value("wrapper", json::object()), false, true);
+
+  // callers and targets can be patterns, but a wrapper must name one method
+  if (wrapper.HasNamePattern()) {
+    Warn("Wrapper method names can't use wildcards: ", wrapper.type_name, ".",
+         wrapper.method_name);
+    return std::make_pair<MethodReplacement, bool>({}, false);
+  }
+
   return std::make_pair<MethodReplacement, bool>({caller, target, wrapper},
                                                  true);
 }
@@ -17,6 +17,9 @@ using json = nlohmann::json;
 // LoadIntegrationsFromEnvironment loads integrations from any files specified
 // in the DD_INTEGRATIONS environment variable
 std::vector<Integration> LoadIntegrationsFromEnvironment();
+// LoadIntegrationsFromFiles loads the integrations from every file, in order
+std::vector<Integration> LoadIntegrationsFromFiles(
+    const std::vector<WSTRING>& file_paths);
 // LoadIntegrationsFromFile loads the integrations from a file
 std::vector<Integration> LoadIntegrationsFromFile(const WSTRING& file_path);
 // LoadIntegrationsFromFile loads the integrations from a stream
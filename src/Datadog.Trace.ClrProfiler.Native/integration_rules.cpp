@@ -0,0 +1,383 @@
+#include "integration_rules.h"
+
+#include <algorithm>
+
+#include "logging.h"
+#include "util.h"
+
+namespace trace {
+
+namespace {
+
+// we add 3 parameters to every wrapper method: opcode, mdToken, and
+// module_version_id
+const int kAddedWrapperParameters = 3;
+
+// a wrapper signature has at least 6 bytes:
+// 0:{CallingConvention}|1:{ParamCount}|2:{ReturnType}|3:{OpCode}|4:{mdToken}|5:{ModuleVersionId}
+const size_t kMinWrapperSignatureSize = kAddedWrapperParameters + 3;
+
+// separates the type and method names in automaton keys; it can't appear in
+// metadata names
+const WCHAR kNameSeparator = '\n';
+
+// NameKey returns the automaton key of a type and method name pair. Empty
+// names match anything.
+WSTRING NameKey(const WSTRING& type_name, const WSTRING& method_name) {
+  WSTRING key = type_name.empty() ? "*"_W : type_name;
+  key += kNameSeparator;
+  key += method_name.empty() ? "*"_W : method_name;
+  return key;
+}
+
+uint32_t RunNames(const WildcardAutomaton& automaton, const WSTRING& type_name,
+                  const WSTRING& method_name) {
+  auto state = automaton.Run(automaton.Start(), type_name);
+  state = automaton.Step(state, kNameSeparator);
+  return automaton.Run(state, method_name);
+}
+
+bool NameMatches(const WSTRING& pattern, const WSTRING& name) {
+  return pattern.empty() || WildcardMatch(pattern, name);
+}
+
+void SortByIndex(std::vector<const IntegrationRule*>* rules, size_t first) {
+  std::sort(rules->begin() + first, rules->end(),
+            [](const IntegrationRule* a, const IntegrationRule* b) {
+              return a->index < b->index;
+            });
+}
+
+}  // namespace
+
+size_t HeapBytes(const MethodReference& method) {
+  size_t bytes = HeapBytes(method.assembly.name) +
+                 HeapBytes(method.assembly.locale) +
+                 HeapBytes(method.type_name) + HeapBytes(method.method_name) +
+                 HeapBytes(method.action) +
+                 HeapBytes(method.method_signature.data) +
+                 HeapBytes(method.signature_types);
+  for (const auto& type : method.signature_types) {
+    bytes += HeapBytes(type);
+  }
+  return bytes;
+}
+
+size_t HeapBytes(const IntegrationMethod& integration) {
+  const auto& replacement = integration.replacement;
+  return HeapBytes(integration.integration_name) +
+         HeapBytes(replacement.caller_method) +
+         HeapBytes(replacement.target_method) +
+         HeapBytes(replacement.wrapper_method);
+}
+
+bool CallerMatches(const MethodReference& caller, const WSTRING& type_name,
+                   const WSTRING& method_name) {
+  return NameMatches(caller.type_name, type_name) &&
+         NameMatches(caller.method_name, method_name);
+}
+
+IntegrationRule::IntegrationRule(size_t index,
+                                 const IntegrationMethod& integration)
+    : index(index), integration(integration) {
+  const auto& wrapper_signature =
+      integration.replacement.wrapper_method.method_signature;
+  if (wrapper_signature.data.size() >= kMinWrapperSignatureSize) {
+    arity = static_cast<int>(wrapper_signature.NumberOfArguments()) -
+            kAddedWrapperParameters;
+  }
+}
+
+bool IntegrationRule::IsReplacement() const {
+  return integration.replacement.wrapper_method.action ==
+         "ReplaceTargetMethod"_W;
+}
+
+bool IntegrationRule::MatchesCaller(const WSTRING& type_name,
+                                    const WSTRING& method_name) const {
+  return CallerMatches(integration.replacement.caller_method, type_name,
+                       method_name);
+}
+
+bool IntegrationRule::MatchesSignature(
+    const std::vector<WSTRING>& signature_types) const {
+  const auto& expected = integration.replacement.target_method.signature_types;
+  if (expected.size() != signature_types.size()) {
+    return false;
+  }
+
+  for (size_t i = 0; i < expected.size(); i++) {
+    if (expected[i] != "_"_W && expected[i] != signature_types[i]) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+IntegrationRuleSet::IntegrationRuleSet(
+    const std::vector<IntegrationMethod>& integrations,
+    const std::vector<WSTRING>& low_priority_integrations) {
+  rules_.reserve(integrations.size());
+
+  for (size_t i = 0; i < integrations.size(); i++) {
+    rules_.emplace_back(i, integrations[i]);
+    auto& rule = rules_.back();
+    const auto& replacement = rule.integration.replacement;
+
+    rule.low_priority =
+        std::find(low_priority_integrations.begin(),
+                  low_priority_integrations.end(),
+                  rule.integration.integration_name) !=
+        low_priority_integrations.end();
+
+    if (replacement.caller_method.assembly.name.empty()) {
+      has_any_caller_rules_ = true;
+    } else {
+      caller_assemblies_.insert(replacement.caller_method.assembly.name);
+    }
+
+    rule.caller_pattern = callers_.Add(
+        NameKey(replacement.caller_method.type_name,
+                replacement.caller_method.method_name));
+    caller_rules_.resize(callers_.PatternCount());
+    caller_rules_[rule.caller_pattern].push_back(i);
+
+    auto& assembly_rules = assemblies_[replacement.target_method.assembly.name];
+    assembly_rules.rules.push_back(i);
+
+    if (!rule.IsReplacement()) {
+      continue;
+    }
+
+    if (rule.arity < 0) {
+      Warn("Integration ", rule.integration.integration_name,
+           " ignores calls to ", replacement.target_method.type_name, ".",
+           replacement.target_method.method_name,
+           "(): wrapper signature too short. wrapper_method=",
+           replacement.wrapper_method.type_name, ".",
+           replacement.wrapper_method.method_name, "()");
+      continue;
+    }
+
+    if (replacement.target_method.HasNamePattern()) {
+      rule.has_target_pattern = true;
+      rule.target_pattern = targets_.Add(
+          NameKey(replacement.target_method.type_name,
+                  replacement.target_method.method_name));
+      target_rules_.resize(targets_.PatternCount());
+      target_rules_[rule.target_pattern].push_back(i);
+      target_pattern_rules_.push_back(i);
+      continue;
+    }
+
+    assembly_rules.types[replacement.target_method.type_name]
+                        [replacement.target_method.method_name][rule.arity]
+                            .push_back(i);
+  }
+
+  if (!callers_.Compile(kNameSeparator)) {
+    Warn("Too many integration caller patterns to combine: matching them "
+         "one at a time. patterns=",
+         callers_.PatternCount());
+  }
+
+  if (!targets_.Compile(kNameSeparator)) {
+    Warn("Too many integration target patterns to combine: matching them "
+         "one at a time. patterns=",
+         targets_.PatternCount());
+  }
+}
+
+size_t IntegrationRuleSet::MemoryUsage() const {
+  size_t bytes = sizeof(*this) + HeapBytes(rules_) +
+                 HashTableBytes(assemblies_) +
+                 HashTableBytes(caller_assemblies_) + callers_.MemoryUsage() +
+                 HeapBytes(caller_rules_) + targets_.MemoryUsage() +
+                 HeapBytes(target_rules_) + HeapBytes(target_pattern_rules_);
+
+  for (const auto& rule : rules_) {
+    bytes += HeapBytes(rule.integration);
+  }
+
+  for (const auto& assembly : assemblies_) {
+    bytes += HeapBytes(assembly.first) + HeapBytes(assembly.second.rules) +
+             HashTableBytes(assembly.second.types);
+    for (const auto& type : assembly.second.types) {
+      bytes += HeapBytes(type.first) + HashTableBytes(type.second);
+      for (const auto& method : type.second) {
+        bytes += HeapBytes(method.first) + HashTableBytes(method.second);
+        for (const auto& arity : method.second) {
+          bytes += HeapBytes(arity.second);
+        }
+      }
+    }
+  }
+
+  for (const auto& assembly : caller_assemblies_) {
+    bytes += HeapBytes(assembly);
+  }
+  for (const auto& rules : caller_rules_) {
+    bytes += HeapBytes(rules);
+  }
+  for (const auto& rules : target_rules_) {
+    bytes += HeapBytes(rules);
+  }
+  return bytes;
+}
+
+bool IntegrationRuleSet::HasCallerRules(const WSTRING& caller_assembly) const {
+  return has_any_caller_rules_ || caller_assemblies_.count(caller_assembly) > 0;
+}
+
+IntegrationRuleSet::Selection IntegrationRuleSet::Select(
+    const WSTRING& caller_assembly,
+    const std::vector<AssemblyMetadata>& assemblies) const {
+  Selection selection;
+  selection.enabled.resize(rules_.size(), false);
+
+  for (const auto& assembly : assemblies) {
+    const auto it = assemblies_.find(assembly.name);
+    if (it == assemblies_.end()) {
+      continue;
+    }
+
+    bool has_rules = false;
+    for (const auto index : it->second.rules) {
+      const auto& replacement = rules_[index].integration.replacement;
+      const auto& caller_assembly_name = replacement.caller_method.assembly.name;
+
+      if (selection.enabled[index] ||
+          (!caller_assembly_name.empty() &&
+           caller_assembly_name != caller_assembly) ||
+          !AssemblyMeetsIntegrationRequirements(assembly, replacement)) {
+        continue;
+      }
+
+      selection.enabled[index] = true;
+      selection.enabled_count++;
+      has_rules = true;
+    }
+
+    if (has_rules && std::find(selection.targets.begin(),
+                               selection.targets.end(),
+                               &it->second) == selection.targets.end()) {
+      selection.targets.push_back(&it->second);
+    }
+  }
+
+  return selection;
+}
+
+std::vector<IntegrationMethod> IntegrationRuleSet::GetIntegrations(
+    const Selection& selection) const {
+  std::vector<IntegrationMethod> integrations;
+  integrations.reserve(selection.enabled_count);
+
+  for (size_t i = 0; i < selection.enabled.size() && i < rules_.size(); i++) {
+    if (selection.enabled[i]) {
+      integrations.push_back(rules_[i].integration);
+    }
+  }
+
+  return integrations;
+}
+
+IntegrationRuleSet::CallerMatch IntegrationRuleSet::MatchCaller(
+    const WSTRING& type_name, const WSTRING& method_name) const {
+  return {&type_name, &method_name, RunNames(callers_, type_name, method_name)};
+}
+
+bool IntegrationRuleSet::MatchesCaller(const IntegrationRule& rule,
+                                       const CallerMatch& caller) const {
+  if (callers_.IsCompiled()) {
+    return callers_.Matches(caller.state, rule.caller_pattern);
+  }
+  return rule.MatchesCaller(*caller.type_name, *caller.method_name);
+}
+
+void IntegrationRuleSet::AddEnabled(
+    const Selection& selection, const std::vector<size_t>& rules, int arity,
+    std::vector<const IntegrationRule*>* found) const {
+  for (const auto index : rules) {
+    if (index < selection.enabled.size() && selection.enabled[index] &&
+        (arity < 0 || rules_[index].arity == arity)) {
+      found->push_back(&rules_[index]);
+    }
+  }
+}
+
+void IntegrationRuleSet::FindCallerRules(
+    const Selection& selection, const CallerMatch& caller,
+    std::vector<const IntegrationRule*>* rules) const {
+  const auto first = rules->size();
+
+  if (callers_.IsCompiled()) {
+    for (const auto pattern : callers_.Matches(caller.state)) {
+      AddEnabled(selection, caller_rules_[pattern], -1, rules);
+    }
+    SortByIndex(rules, first);
+    return;
+  }
+
+  for (const auto& rule : rules_) {
+    if (rule.index < selection.enabled.size() &&
+        selection.enabled[rule.index] &&
+        rule.MatchesCaller(*caller.type_name, *caller.method_name)) {
+      rules->push_back(&rule);
+    }
+  }
+}
+
+void IntegrationRuleSet::FindReplacements(
+    const Selection& selection, const WSTRING& type_name,
+    const WSTRING& method_name, int arity,
+    std::vector<const IntegrationRule*>* rules) const {
+  const auto first = rules->size();
+
+  for (const auto target : selection.targets) {
+    const auto type = target->types.find(type_name);
+    if (type == target->types.end()) {
+      continue;
+    }
+
+    const auto method = type->second.find(method_name);
+    if (method == type->second.end()) {
+      continue;
+    }
+
+    const auto candidates = method->second.find(arity);
+    if (candidates != method->second.end()) {
+      AddEnabled(selection, candidates->second, arity, rules);
+    }
+  }
+
+  bool has_pattern_rules = false;
+  if (targets_.IsCompiled()) {
+    const auto state = RunNames(targets_, type_name, method_name);
+    for (const auto pattern : targets_.Matches(state)) {
+      const auto size = rules->size();
+      AddEnabled(selection, target_rules_[pattern], arity, rules);
+      has_pattern_rules = has_pattern_rules || rules->size() > size;
+    }
+  } else {
+    for (const auto index : target_pattern_rules_) {
+      const auto& target = rules_[index].integration.replacement.target_method;
+      if (index < selection.enabled.size() && selection.enabled[index] &&
+          rules_[index].arity == arity &&
+          NameMatches(target.type_name, type_name) &&
+          NameMatches(target.method_name, method_name)) {
+        rules->push_back(&rules_[index]);
+        has_pattern_rules = true;
+      }
+    }
+  }
+
+  // rules from several target assemblies or patterns are merged back in
+  // index order
+  if (selection.targets.size() > 1 || has_pattern_rules) {
+    SortByIndex(rules, first);
+  }
+}
+
+}  // namespace trace
@@ -0,0 +1,168 @@
+#ifndef DD_CLR_PROFILER_INTEGRATION_RULES_H_
+#define DD_CLR_PROFILER_INTEGRATION_RULES_H_
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "clr_helpers.h"
+#include "integration.h"
+#include "memory_usage.h"
+#include "string.h"
+#include "wildcard_automaton.h"
+
+namespace trace {
+
+// CallerMatches checks a caller type and method names against a caller
+// reference. Empty names match any caller, and names can use the wildcards
+// of WildcardMatch.
+bool CallerMatches(const MethodReference& caller, const WSTRING& type_name,
+                   const WSTRING& method_name);
+
+// HeapBytes estimates the memory allocated by an integration method.
+size_t HeapBytes(const MethodReference& method);
+size_t HeapBytes(const IntegrationMethod& integration);
+
+// IntegrationRule is a method replacement compiled for matching call sites.
+struct IntegrationRule {
+  // position in the integrations the rule set was compiled from. When
+  // several rules match a call, the lowest index wins.
+  size_t index = 0;
+  IntegrationMethod integration;
+  // number of arguments the wrapper takes from the target, counting the
+  // instance of instance methods; -1 if the wrapper signature is invalid
+  int arity = -1;
+  // ids of the rule's caller pattern, and of its target pattern if the
+  // target names use wildcards
+  uint32_t caller_pattern = 0;
+  uint32_t target_pattern = 0;
+  bool has_target_pattern = false;
+  // low-priority rules are deferred while the profiler is over its overhead
+  // budget
+  bool low_priority = false;
+
+  IntegrationRule(size_t index, const IntegrationMethod& integration);
+
+  bool IsReplacement() const;
+
+  // MatchesCaller checks the caller type and method names, one pattern at a
+  // time. IntegrationRuleSet::MatchesCaller is faster.
+  bool MatchesCaller(const WSTRING& type_name,
+                     const WSTRING& method_name) const;
+
+  // MatchesSignature compares the parsed target signature types with the
+  // rule's. "_" matches any type.
+  bool MatchesSignature(const std::vector<WSTRING>& signature_types) const;
+};
+
+// IntegrationRuleSet compiles the enabled integrations into a hashed trie,
+// target assembly -> type -> method -> arity, so a call site is matched
+// with a few hash lookups however many integrations are loaded. It is built
+// once and never modified afterwards: every thread can share it without
+// locking.
+//
+// Caller and target names can be wildcard patterns. All the caller patterns
+// are compiled into one WildcardAutomaton, and so are the target patterns,
+// matched against "Type\nMethod": matching a method costs the same with one
+// pattern or hundreds. If an automaton would be too large, its patterns are
+// matched one at a time instead.
+class IntegrationRuleSet {
+ public:
+  // rule indexes by the number of arguments of the target
+  typedef std::unordered_map<int, std::vector<size_t>> MethodRules;
+  typedef std::unordered_map<WSTRING, MethodRules> TypeRules;
+
+  struct AssemblyRules {
+    // every rule targeting the assembly, whatever the method
+    std::vector<size_t> rules;
+    std::unordered_map<WSTRING, TypeRules> types;
+  };
+
+  // Selection is the part of a rule set that applies to one module: the
+  // rules of its caller assembly whose target assembly it references within
+  // the rule's version interval.
+  struct Selection {
+    std::vector<const AssemblyRules*> targets;
+    std::vector<bool> enabled;
+    size_t enabled_count = 0;
+
+    bool IsEmpty() const { return enabled_count == 0; }
+  };
+
+  // CallerMatch is the result of matching a method against every caller
+  // pattern. It refers to the names it was made from.
+  struct CallerMatch {
+    const WSTRING* type_name;
+    const WSTRING* method_name;
+    uint32_t state;
+  };
+
+ private:
+  std::vector<IntegrationRule> rules_;
+  std::unordered_map<WSTRING, AssemblyRules> assemblies_;
+  std::unordered_set<WSTRING> caller_assemblies_;
+  bool has_any_caller_rules_ = false;
+
+  WildcardAutomaton callers_;
+  // rule indexes by caller pattern id
+  std::vector<std::vector<size_t>> caller_rules_;
+  WildcardAutomaton targets_;
+  // replacement rule indexes by target pattern id
+  std::vector<std::vector<size_t>> target_rules_;
+  std::vector<size_t> target_pattern_rules_;
+
+  void AddEnabled(const Selection& selection, const std::vector<size_t>& rules,
+                  int arity, std::vector<const IntegrationRule*>* found) const;
+
+ public:
+  // The rules of the integrations named in low_priority_integrations are
+  // marked low priority.
+  explicit IntegrationRuleSet(
+      const std::vector<IntegrationMethod>& integrations,
+      const std::vector<WSTRING>& low_priority_integrations = {});
+  IntegrationRuleSet(const IntegrationRuleSet&) = delete;
+  IntegrationRuleSet& operator=(const IntegrationRuleSet&) = delete;
+
+  size_t RuleCount() const { return rules_.size(); }
+  const IntegrationRule& GetRule(size_t index) const { return rules_[index]; }
+
+  // HasCallerRules returns false if no rule can apply to code in the
+  // assembly.
+  bool HasCallerRules(const WSTRING& caller_assembly) const;
+
+  // Select finds the rules that apply to a module of caller_assembly which
+  // is or references the given assemblies.
+  Selection Select(const WSTRING& caller_assembly,
+                   const std::vector<AssemblyMetadata>& assemblies) const;
+
+  // GetIntegrations returns the integrations of the selected rules, in order.
+  std::vector<IntegrationMethod> GetIntegrations(
+      const Selection& selection) const;
+
+  CallerMatch MatchCaller(const WSTRING& type_name,
+                          const WSTRING& method_name) const;
+
+  bool MatchesCaller(const IntegrationRule& rule,
+                     const CallerMatch& caller) const;
+
+  // FindCallerRules appends the selected rules, replacements or not, whose
+  // caller matches, lowest index first.
+  void FindCallerRules(const Selection& selection, const CallerMatch& caller,
+                       std::vector<const IntegrationRule*>* rules) const;
+
+  // FindReplacements appends the selected replacement rules for calls to
+  // type_name.method_name with arity arguments (counting the instance),
+  // lowest index first, whether the target names are patterns or not.
+  // Callers still check the caller and the signature.
+  void FindReplacements(const Selection& selection, const WSTRING& type_name,
+                        const WSTRING& method_name, int arity,
+                        std::vector<const IntegrationRule*>* rules) const;
+
+  // MemoryUsage estimates the memory owned by the rule set, shared by every
+  // module.
+  size_t MemoryUsage() const;
+};
+
+}  // namespace trace
+
+#endif  // DD_CLR_PROFILER_INTEGRATION_RULES_H_
@@ -7,6 +7,10 @@
 //---------------------------------------------------------------------------------------
 
 #include "cor_profiler.h"
+#include "sql_obfuscator.h"
+#include "trace_serializer.h"
+#include "url_quantizer.h"
+#include "utf8.h"
 
 EXTERN_C BOOL STDAPICALLTYPE IsProfilerAttached() {
   return trace::profiler->IsAttached();
@@ -15,3 +19,476 @@ EXTERN_C BOOL STDAPICALLTYPE IsProfilerAttached() {
 EXTERN_C VOID STDAPICALLTYPE GetAssemblyAndSymbolsBytes(BYTE** pAssemblyArray, int* assemblySize, BYTE** pSymbolsArray, int* symbolsSize) {
   return trace::profiler->GetAssemblyAndSymbolsBytes(pAssemblyArray, assemblySize, pSymbolsArray, symbolsSize);
 }
+
+// Writes the name of the given FunctionID ("Assembly!Namespace.Type.Method")
+// or ClassID ("Namespace.Type") into buffer, null-terminated. Returns the
+// length of the name, or -1 if it cannot be resolved. Nothing is written if
+// buffer_length is not greater than the returned length.
+static int CopyName(const trace::WSTRING* name, WCHAR* buffer,
+                    int buffer_length) {
+  if (name == nullptr) {
+    return -1;
+  }
+
+  const auto length = static_cast<int>(name->length());
+  if (buffer != nullptr && length < buffer_length) {
+    name->copy(buffer, name->length());
+    buffer[length] = 0;
+  }
+  return length;
+}
+
+EXTERN_C int STDAPICALLTYPE ResolveFunctionName(UINT_PTR function_id,
+                                                WCHAR* buffer,
+                                                int buffer_length) {
+  if (trace::profiler == nullptr) {
+    return -1;
+  }
+
+  const auto symbol =
+      trace::profiler->GetSymbolCache().GetOrResolve(function_id);
+  return CopyName(symbol == nullptr ? nullptr : symbol->name, buffer,
+                  buffer_length);
+}
+
+EXTERN_C int STDAPICALLTYPE ResolveClassName(UINT_PTR class_id, WCHAR* buffer,
+                                             int buffer_length) {
+  if (trace::profiler == nullptr) {
+    return -1;
+  }
+
+  return CopyName(
+      trace::profiler->GetSymbolCache().GetOrResolveClassName(class_id),
+      buffer, buffer_length);
+}
+
+// Moves up to max_samples aggregated allocation sites into samples and returns
+// how many were written.
+EXTERN_C int STDAPICALLTYPE GetAllocationSamples(
+    trace::AllocationSample* samples, int max_samples) {
+  if (trace::profiler == nullptr || samples == nullptr || max_samples <= 0) {
+    return 0;
+  }
+
+  return static_cast<int>(trace::profiler->GetAllocationSamples(
+      samples, static_cast<size_t>(max_samples)));
+}
+
+// Copies the stats of the live heap snapshot taken after the last garbage
+// collection into stats, and up to max_sites of its allocation sites, largest
+// first, into sites, which can be null if max_sites is 0. Returns the number
+// of sites copied, or -1 if the profiler isn't attached.
+EXTERN_C int STDAPICALLTYPE GetLiveHeap(trace::LiveHeapStats* stats,
+                                        trace::LiveHeapSite* sites,
+                                        int max_sites) {
+  if (trace::profiler == nullptr || stats == nullptr ||
+      (sites == nullptr && max_sites > 0)) {
+    return -1;
+  }
+
+  return static_cast<int>(trace::profiler->GetLiveHeap(
+      stats, sites, max_sites > 0 ? max_sites : 0));
+}
+
+// Copies the JIT compilation totals into summary. Returns FALSE if JIT
+// statistics are disabled.
+EXTERN_C BOOL STDAPICALLTYPE GetJitStatistics(trace::JitSummary* summary) {
+  if (trace::profiler == nullptr || summary == nullptr) {
+    return FALSE;
+  }
+
+  return trace::profiler->GetJitStatistics(summary) ? TRUE : FALSE;
+}
+
+// Copies up to max_modules per-module JIT totals into modules, most expensive
+// first. Returns the number of modules copied.
+EXTERN_C int STDAPICALLTYPE GetJitModules(trace::JitModuleStats* modules,
+                                          int max_modules) {
+  if (trace::profiler == nullptr || modules == nullptr || max_modules <= 0) {
+    return 0;
+  }
+
+  return static_cast<int>(
+      trace::profiler->GetJitModules(modules, max_modules));
+}
+
+// Copies up to max_methods of the methods that took the longest to compile
+// into methods, slowest first. Returns the number of methods copied.
+EXTERN_C int STDAPICALLTYPE GetSlowestJitMethods(trace::JitMethodTime* methods,
+                                                 int max_methods) {
+  if (trace::profiler == nullptr || methods == nullptr || max_methods <= 0) {
+    return 0;
+  }
+
+  return static_cast<int>(
+      trace::profiler->GetSlowestJitMethods(methods, max_methods));
+}
+
+// Copies the totals of the runtime events session into stats, and up to
+// max_sites of its contention sites, longest first, into sites, which can be
+// null if max_sites is 0. Returns the number of sites copied, or -1 if the
+// profiler isn't attached. stats->session_active is 0 if the session is
+// disabled or stopped.
+EXTERN_C int STDAPICALLTYPE GetRuntimeEvents(trace::RuntimeEventStats* stats,
+                                             trace::ContentionSite* sites,
+                                             int max_sites) {
+  if (trace::profiler == nullptr || stats == nullptr ||
+      (sites == nullptr && max_sites > 0)) {
+    return -1;
+  }
+
+  return static_cast<int>(trace::profiler->GetRuntimeEvents(
+      stats, sites, max_sites > 0 ? max_sites : 0));
+}
+
+// Resolves each of the count instruction pointers of ips, sampled in jitted
+// code, to the method version and IL offset it belongs to, written to the
+// same index of locations. Unresolved ones get a function_id of 0. Returns
+// the number resolved.
+EXTERN_C int STDAPICALLTYPE GetILOffsets(const uint64_t* ips,
+                                         trace::ILOffsetLocation* locations,
+                                         int count) {
+  if (trace::profiler == nullptr || ips == nullptr || locations == nullptr ||
+      count <= 0) {
+    return 0;
+  }
+
+  return static_cast<int>(
+      trace::profiler->GetILOffsets(ips, locations, count));
+}
+
+// Stops recording the startup methods and writes them to
+// DD_PROFILER_STARTUP_METHODS_FILE, unless they were written already. Returns
+// FALSE if startup recording is disabled or the file could not be written.
+EXTERN_C BOOL STDAPICALLTYPE WriteStartupMethods() {
+  if (trace::profiler == nullptr) {
+    return FALSE;
+  }
+
+  return trace::profiler->WriteStartupMethods() ? TRUE : FALSE;
+}
+
+// Copies the GC pauses recorded after *cursor into pauses and advances
+// *cursor. Start with *cursor == 0 and keep passing the updated value back.
+// Returns the number of pauses copied.
+EXTERN_C int STDAPICALLTYPE GetGcPauses(uint64_t* cursor,
+                                        trace::GcPause* pauses,
+                                        int max_pauses) {
+  if (trace::profiler == nullptr || cursor == nullptr || pauses == nullptr ||
+      max_pauses <= 0) {
+    return 0;
+  }
+
+  return static_cast<int>(trace::profiler->GetGcPauses(
+      cursor, pauses, static_cast<size_t>(max_pauses)));
+}
+
+// Copies up to max_counts running exception totals, by class and throwing
+// method, into counts. Returns the number of totals copied.
+EXTERN_C int STDAPICALLTYPE GetExceptionCounts(trace::ExceptionCount* counts,
+                                               int max_counts) {
+  if (trace::profiler == nullptr || counts == nullptr || max_counts <= 0) {
+    return 0;
+  }
+
+  return static_cast<int>(trace::profiler->GetExceptionCounts(
+      counts, static_cast<size_t>(max_counts)));
+}
+
+// Copies the latest runtime metrics sample into metrics. Returns FALSE if
+// runtime metrics are disabled or no sample was taken yet.
+EXTERN_C BOOL STDAPICALLTYPE
+GetRuntimeMetrics(trace::RuntimeMetricsSnapshot* metrics) {
+  if (trace::profiler == nullptr || metrics == nullptr) {
+    return FALSE;
+  }
+
+  return trace::profiler->GetRuntimeMetrics(metrics) ? TRUE : FALSE;
+}
+
+// Copies the overhead budget counters into stats. Returns FALSE if the
+// profiler isn't attached.
+EXTERN_C BOOL STDAPICALLTYPE
+GetOverheadBudgetStats(trace::OverheadBudgetStats* stats) {
+  if (trace::profiler == nullptr || stats == nullptr) {
+    return FALSE;
+  }
+
+  trace::profiler->GetOverheadBudgetStats(stats);
+  return TRUE;
+}
+
+// Copies the memory accounting of modules into stats, and the usage of up to
+// max_modules modules into modules, which can be null if max_modules is 0.
+// Returns the number of modules copied, or -1 if the profiler isn't attached.
+EXTERN_C int STDAPICALLTYPE GetModuleMemory(trace::ModuleMemoryStats* stats,
+                                            trace::ModuleMemoryUsage* modules,
+                                            int max_modules) {
+  if (trace::profiler == nullptr || stats == nullptr ||
+      (modules == nullptr && max_modules > 0)) {
+    return -1;
+  }
+
+  return static_cast<int>(trace::profiler->GetModuleMemory(
+      stats, modules, max_modules > 0 ? max_modules : 0));
+}
+
+// Sets the span the calling thread is working on, called by the scope manager
+// on every scope change; zeros when it leaves its last span. What the profiler
+// observes on the thread is then attributed to that span.
+EXTERN_C void STDAPICALLTYPE SetCurrentSpanContext(uint64_t trace_id,
+                                                   uint64_t span_id) {
+  if (trace::profiler == nullptr) {
+    return;
+  }
+
+  trace::profiler->SetCurrentSpanContext(trace_id, span_id);
+}
+
+// Copies the native cost observed on the calling thread since its current
+// span was set into cost. Returns FALSE if the thread never set a span.
+EXTERN_C BOOL STDAPICALLTYPE
+GetCurrentSpanNativeCost(trace::SpanNativeCost* cost) {
+  if (trace::profiler == nullptr || cost == nullptr) {
+    return FALSE;
+  }
+
+  return trace::profiler->GetCurrentSpanNativeCost(cost) ? TRUE : FALSE;
+}
+
+// Copies the thread-pool watchdog counters into stats. Returns FALSE if the
+// watchdog is disabled.
+EXTERN_C BOOL STDAPICALLTYPE
+GetThreadPoolWatchdogStats(trace::ThreadPoolWatchdogStats* stats) {
+  if (trace::profiler == nullptr || stats == nullptr) {
+    return FALSE;
+  }
+
+  return trace::profiler->GetThreadPoolWatchdogStats(stats) ? TRUE : FALSE;
+}
+
+// Copies the thread-pool starvation events recorded after *cursor into events
+// and advances *cursor. Start with *cursor == 0 and keep passing the updated
+// value back. Returns the number of events copied.
+EXTERN_C int STDAPICALLTYPE GetThreadPoolStarvationEvents(
+    uint64_t* cursor, trace::StarvationEvent* events, int max_events) {
+  if (trace::profiler == nullptr || cursor == nullptr || events == nullptr ||
+      max_events <= 0) {
+    return 0;
+  }
+
+  return static_cast<int>(trace::profiler->GetThreadPoolStarvationEvents(
+      cursor, events, static_cast<size_t>(max_events)));
+}
+
+// Copies up to max_latencies per-method latency histograms, for the methods
+// selected by DD_PROFILER_METHOD_TIMING, into latencies. Returns the number
+// of histograms copied.
+EXTERN_C int STDAPICALLTYPE GetMethodLatencies(trace::MethodLatency* latencies,
+                                               int max_latencies) {
+  if (trace::profiler == nullptr || latencies == nullptr ||
+      max_latencies <= 0) {
+    return 0;
+  }
+
+  return static_cast<int>(trace::profiler->GetMethodLatencies(
+      latencies, static_cast<size_t>(max_latencies)));
+}
+
+// Encodes trace_count traces into a v0.4 MessagePack payload. spans holds the
+// spans of every trace one after the other, trace i having trace_sizes[i]
+// spans. On success, *payload points to a buffer owned by the calling thread
+// that stays valid until its next call, and the payload size is returned.
+// Returns -1 if the input is invalid. Does not require the profiler to be
+// attached.
+EXTERN_C int STDAPICALLTYPE SerializeTraces(const trace::NativeSpan* spans,
+                                            const int* trace_sizes,
+                                            int trace_count,
+                                            const BYTE** payload) {
+  // reused across calls so the buffer only grows to the largest payload
+  thread_local trace::TraceSerializer serializer;
+
+  if (payload == nullptr ||
+      !serializer.Serialize(spans, trace_sizes, trace_count)) {
+    return -1;
+  }
+
+  *payload = serializer.Data();
+  return static_cast<int>(serializer.Size());
+}
+
+// Queues a v0.4 payload holding trace_count traces, as returned by
+// SerializeTraces, to be sent to the agent by the native flush thread.
+// Returns FALSE if the payload was dropped because it does not hold
+// trace_count traces or the queue is full.
+EXTERN_C BOOL STDAPICALLTYPE EnqueueTraces(const BYTE* payload, int size,
+                                           int trace_count) {
+  if (trace::profiler == nullptr || payload == nullptr || size <= 0 ||
+      trace_count < 0) {
+    return FALSE;
+  }
+
+  uint32_t payload_trace_count = 0;
+  if (trace::ReadMessagePackArrayHeader(payload, static_cast<size_t>(size),
+                                        &payload_trace_count) == 0 ||
+      payload_trace_count != static_cast<uint32_t>(trace_count)) {
+    return FALSE;
+  }
+
+  return trace::profiler->GetAgentTransport().Enqueue(
+             payload, static_cast<size_t>(size))
+             ? TRUE
+             : FALSE;
+}
+
+// Serializes traces like SerializeTraces and queues the payload like
+// EnqueueTraces, without handing the payload back to managed code.
+EXTERN_C BOOL STDAPICALLTYPE SerializeAndEnqueueTraces(
+    const trace::NativeSpan* spans, const int* trace_sizes, int trace_count) {
+  const BYTE* payload = nullptr;
+  const auto size = SerializeTraces(spans, trace_sizes, trace_count, &payload);
+  if (size <= 0) {
+    return FALSE;
+  }
+
+  return EnqueueTraces(payload, size, trace_count);
+}
+
+// Asks the flush thread to send the queued traces without waiting for the
+// flush interval. Does not wait for them to be sent.
+EXTERN_C VOID STDAPICALLTYPE FlushTraces() {
+  if (trace::profiler != nullptr) {
+    trace::profiler->GetAgentTransport().Flush();
+  }
+}
+
+// Copies the native trace transport counters into stats. Returns FALSE if the
+// profiler is not attached.
+EXTERN_C BOOL STDAPICALLTYPE
+GetTraceTransportStats(trace::AgentTransportStats* stats) {
+  if (trace::profiler == nullptr || stats == nullptr) {
+    return FALSE;
+  }
+
+  *stats = trace::profiler->GetAgentTransport().GetStats();
+  return TRUE;
+}
+
+// Writes the body of the last successful agent response (the sampling rates
+// by service, as JSON) into buffer, null-terminated. Returns its length, or
+// -1 if there is none. Nothing is written if buffer_length is not greater
+// than the returned length.
+EXTERN_C int STDAPICALLTYPE GetAgentResponse(char* buffer, int buffer_length) {
+  if (trace::profiler == nullptr) {
+    return -1;
+  }
+
+  const auto response = trace::profiler->GetAgentTransport().LastResponse();
+  if (response.empty()) {
+    return -1;
+  }
+
+  const auto length = static_cast<int>(response.size());
+  if (buffer != nullptr && length < buffer_length) {
+    response.copy(buffer, response.size());
+    buffer[length] = 0;
+  }
+
+  return length;
+}
+
+// Converts a null-terminated UTF-16 string from managed code to UTF-8 into
+// buffer, which is reused across calls to avoid allocating.
+static const std::string& ToUtf8(const WCHAR* str, std::string& buffer) {
+  buffer.clear();
+  if (str == nullptr) {
+    return buffer;
+  }
+
+  size_t length = 0;
+  while (str[length] != 0) {
+    length++;
+  }
+
+  buffer.resize(trace::Utf8MaxLength(length));
+  buffer.resize(trace::Utf16ToUtf8(
+      str, length, reinterpret_cast<uint8_t*>(&buffer[0])));
+  return buffer;
+}
+
+// Adds value to the count, sets the gauge or records the value into the
+// distribution named name with the given comma-separated tags (may be null).
+// Values are aggregated natively and sent to DogStatsD every
+// DD_PROFILER_DOGSTATSD_FLUSH_INTERVAL.
+EXTERN_C VOID STDAPICALLTYPE DogStatsdCount(const WCHAR* name,
+                                            const WCHAR* tags, double value) {
+  if (trace::profiler != nullptr) {
+    thread_local std::string name_utf8;
+    thread_local std::string tags_utf8;
+    trace::profiler->GetDogStatsd().Count(ToUtf8(name, name_utf8),
+                                          ToUtf8(tags, tags_utf8), value);
+  }
+}
+
+EXTERN_C VOID STDAPICALLTYPE DogStatsdGauge(const WCHAR* name,
+                                            const WCHAR* tags, double value) {
+  if (trace::profiler != nullptr) {
+    thread_local std::string name_utf8;
+    thread_local std::string tags_utf8;
+    trace::profiler->GetDogStatsd().Gauge(ToUtf8(name, name_utf8),
+                                          ToUtf8(tags, tags_utf8), value);
+  }
+}
+
+EXTERN_C VOID STDAPICALLTYPE DogStatsdDistribution(const WCHAR* name,
+                                                   const WCHAR* tags,
+                                                   double value) {
+  if (trace::profiler != nullptr) {
+    thread_local std::string name_utf8;
+    thread_local std::string tags_utf8;
+    trace::profiler->GetDogStatsd().Distribution(
+        ToUtf8(name, name_utf8), ToUtf8(tags, tags_utf8), value);
+  }
+}
+
+// Copies the DogStatsD aggregator counters into stats. Returns FALSE if the
+// profiler is not attached.
+EXTERN_C BOOL STDAPICALLTYPE GetDogStatsdStats(trace::DogStatsdStats* stats) {
+  if (trace::profiler == nullptr || stats == nullptr) {
+    return FALSE;
+  }
+
+  *stats = trace::profiler->GetDogStatsd().GetStats();
+  return TRUE;
+}
+
+// Writes the obfuscated form of the SQL statement sql (length UTF-16 code
+// units) into buffer and returns its length, or -1 if buffer_length is less
+// than length. The result is never longer than the statement. Recently seen
+// statements are cached. Does not require the profiler to be attached.
+EXTERN_C int STDAPICALLTYPE ObfuscateSql(const WCHAR* sql, int length,
+                                         WCHAR* buffer, int buffer_length) {
+  static trace::SqlObfuscationCache cache;
+
+  if (sql == nullptr || buffer == nullptr || length < 0 ||
+      buffer_length < length) {
+    return -1;
+  }
+
+  return static_cast<int>(
+      cache.Obfuscate(sql, static_cast<size_t>(length), buffer));
+}
+
+// Rewrites the URL or path url (length UTF-16 code units) in place into its
+// quantized form and returns the new length, which is never more than length,
+// or -1 on invalid arguments. Each thread caches its recently used URLs. Does
+// not require the profiler to be attached.
+EXTERN_C int STDAPICALLTYPE QuantizeUrl(WCHAR* url, int length) {
+  static thread_local trace::UrlQuantizationCache cache;
+
+  if (url == nullptr || length < 0) {
+    return -1;
+  }
+
+  return static_cast<int>(cache.Quantize(url, static_cast<size_t>(length)));
+}
@@ -0,0 +1,233 @@
+#include "jit_statistics.h"
+
+#include <algorithm>
+#include <functional>
+
+#include "logging.h"
+#include "symbol_cache.h"
+
+namespace trace {
+
+namespace {
+
+// Number of the slowest methods named by LogSummary.
+const size_t kLoggedJitMethods = 10;
+
+struct JitFrame {
+  FunctionID function_id;
+  uint64_t start_ns;
+  // inclusive time of the compilations nested in this one
+  uint64_t nested_ns;
+  uint64_t instrumentation_ns;
+};
+
+// The compilations in progress on a thread. depth keeps counting past
+// kMaxJitNesting so the frames stay balanced.
+struct JitThreadState {
+  size_t depth = 0;
+  JitFrame frames[kMaxJitNesting];
+};
+
+thread_local JitThreadState jit_thread;
+
+bool SlowerThan(const JitMethodTime& a, const JitMethodTime& b) {
+  return a.duration_ns > b.duration_ns;
+}
+
+}  // namespace
+
+void JitStatistics::Initialize(ICorProfilerInfo3* info, size_t top_methods) {
+  info_ = info;
+  top_methods_ = top_methods > 0 ? top_methods : kDefaultJitTopMethods;
+  slowest_.reserve(top_methods_);
+  enabled_ = true;
+
+  Info("JIT statistics enabled, keeping the ", top_methods_,
+       " slowest methods.");
+}
+
+void JitStatistics::OnJitStarted(FunctionID function_id, uint64_t now_ns) {
+  auto& thread = jit_thread;
+  if (thread.depth < kMaxJitNesting) {
+    thread.frames[thread.depth] = {function_id, now_ns, 0, 0};
+  }
+  thread.depth++;
+}
+
+void JitStatistics::OnInstrumentationFinished(FunctionID function_id,
+                                              uint64_t now_ns) {
+  auto& thread = jit_thread;
+  if (thread.depth == 0 || thread.depth > kMaxJitNesting) {
+    return;
+  }
+
+  auto& frame = thread.frames[thread.depth - 1];
+  if (frame.function_id == function_id) {
+    const auto elapsed = now_ns - frame.start_ns;
+    frame.instrumentation_ns =
+        elapsed > frame.nested_ns ? elapsed - frame.nested_ns : 0;
+  }
+}
+
+void JitStatistics::OnJitFinished(FunctionID function_id, HRESULT hr_status,
+                                  uint64_t now_ns) {
+  auto& thread = jit_thread;
+  if (thread.depth == 0) {
+    // started before the statistics were enabled
+    return;
+  }
+
+  thread.depth--;
+  if (thread.depth >= kMaxJitNesting) {
+    // too deep: its time stays in its parent's
+    return;
+  }
+
+  const auto frame = thread.frames[thread.depth];
+  if (frame.function_id != function_id) {
+    return;
+  }
+
+  const auto inclusive = now_ns - frame.start_ns;
+  if (thread.depth > 0) {
+    thread.frames[thread.depth - 1].nested_ns += inclusive;
+  }
+
+  const auto duration =
+      inclusive > frame.nested_ns ? inclusive - frame.nested_ns : 0;
+
+  ClassID class_id = 0;
+  ModuleID module_id = 0;
+  mdToken token = mdTokenNil;
+  if (info_ != nullptr &&
+      FAILED(info_->GetFunctionInfo(function_id, &class_id, &module_id,
+                                    &token))) {
+    module_id = 0;
+  }
+
+  std::lock_guard<std::mutex> guard(lock_);
+
+  if (FAILED(hr_status)) {
+    failed_count_++;
+    return;
+  }
+
+  histogram_.Record(duration);
+  instrumentation_ns_ += frame.instrumentation_ns;
+
+  auto& module = modules_[module_id];
+  module.module_id = module_id;
+  module.method_count++;
+  module.total_ns += duration;
+  module.instrumentation_ns += frame.instrumentation_ns;
+  module.max_ns = std::max(module.max_ns, duration);
+
+  if (slowest_.size() == top_methods_) {
+    if (duration <= slowest_.front().duration_ns) {
+      return;
+    }
+    std::pop_heap(slowest_.begin(), slowest_.end(), SlowerThan);
+    slowest_.pop_back();
+  }
+
+  slowest_.push_back(
+      {function_id, module_id, duration, frame.instrumentation_ns});
+  std::push_heap(slowest_.begin(), slowest_.end(), SlowerThan);
+}
+
+void JitStatistics::EvictModule(ModuleID module_id) {
+  std::lock_guard<std::mutex> guard(lock_);
+
+  const auto end = std::remove_if(slowest_.begin(), slowest_.end(),
+                                  [&](const JitMethodTime& method) {
+                                    return method.module_id == module_id;
+                                  });
+  if (end != slowest_.end()) {
+    slowest_.erase(end, slowest_.end());
+    std::make_heap(slowest_.begin(), slowest_.end(), SlowerThan);
+  }
+}
+
+void JitStatistics::GetSummary(JitSummary* summary) const {
+  std::lock_guard<std::mutex> guard(lock_);
+
+  *summary = JitSummary{};
+  summary->method_count = histogram_.count;
+  summary->failed_count = failed_count_;
+  summary->total_ns = histogram_.total;
+  summary->instrumentation_ns = instrumentation_ns_;
+  summary->module_count = modules_.size();
+  summary->max_ns = histogram_.max;
+  summary->p50_ns = histogram_.Percentile(50);
+  summary->p90_ns = histogram_.Percentile(90);
+  summary->p99_ns = histogram_.Percentile(99);
+  std::copy(std::begin(histogram_.buckets), std::end(histogram_.buckets),
+            summary->buckets);
+}
+
+size_t JitStatistics::GetModules(JitModuleStats* modules,
+                                 size_t max_modules) const {
+  std::vector<JitModuleStats> all;
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    all.reserve(modules_.size());
+    for (const auto& entry : modules_) {
+      all.push_back(entry.second);
+    }
+  }
+
+  const auto count = std::min(max_modules, all.size());
+  std::partial_sort(all.begin(), all.begin() + count, all.end(),
+                    [](const JitModuleStats& a, const JitModuleStats& b) {
+                      return a.total_ns > b.total_ns;
+                    });
+  std::copy(all.begin(), all.begin() + count, modules);
+  return count;
+}
+
+size_t JitStatistics::GetSlowestMethods(JitMethodTime* methods,
+                                        size_t max_methods) const {
+  std::vector<JitMethodTime> slowest;
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    slowest = slowest_;
+  }
+
+  std::sort(slowest.begin(), slowest.end(), SlowerThan);
+  const auto count = std::min(max_methods, slowest.size());
+  std::copy(slowest.begin(), slowest.begin() + count, methods);
+  return count;
+}
+
+void JitStatistics::LogSummary(SymbolCache* symbols) const {
+  if (!enabled_) {
+    return;
+  }
+
+  JitSummary summary;
+  GetSummary(&summary);
+
+  Info("JIT statistics: ", summary.method_count, " methods in ",
+       summary.module_count, " modules compiled in ",
+       summary.total_ns / 1000000, " ms, ", summary.instrumentation_ns / 1000000,
+       " ms of it instrumenting, ", summary.failed_count, " failed.");
+
+  JitMethodTime slowest[kLoggedJitMethods];
+  const auto count = GetSlowestMethods(slowest, kLoggedJitMethods);
+
+  for (size_t i = 0; i < count; i++) {
+    const auto& method = slowest[i];
+    const auto symbol = symbols != nullptr
+                            ? symbols->GetOrResolve(method.function_id)
+                            : nullptr;
+
+    if (symbol != nullptr && symbol->name != nullptr) {
+      Info("  ", method.duration_ns / 1000, " us ", *symbol->name);
+    } else {
+      Info("  ", method.duration_ns / 1000, " us FunctionID ",
+           method.function_id);
+    }
+  }
+}
+
+}  // namespace trace
@@ -0,0 +1,156 @@
+#ifndef DD_CLR_PROFILER_JIT_STATISTICS_H_
+#define DD_CLR_PROFILER_JIT_STATISTICS_H_
+
+#include <corhlpr.h>
+#include <corprof.h>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "clock.h"
+#include "latency_histogram.h"
+
+namespace trace {
+
+class SymbolCache;
+
+// Default number of slowest methods kept.
+const size_t kDefaultJitTopMethods = 50;
+
+// Maximum depth of nested compilations tracked per thread. Deeper ones are
+// folded into their parent.
+const size_t kMaxJitNesting = 16;
+
+// JitSummary aggregates every JIT compilation since the profiler attached,
+// handed to managed code by GetJitStatistics in interop.cpp. Durations
+// exclude nested compilations. Bucket i holds compilations whose duration is
+// at least LatencyBucketLowerBound(i) nanoseconds. It is blittable: keep its
+// layout in sync with the managed definition.
+struct JitSummary {
+  uint64_t method_count;
+  uint64_t failed_count;
+  uint64_t total_ns;
+  // part of total_ns spent instrumenting methods in JITCompilationStarted
+  uint64_t instrumentation_ns;
+  uint64_t module_count;
+  uint64_t max_ns;
+  uint64_t p50_ns;
+  uint64_t p90_ns;
+  uint64_t p99_ns;
+  uint64_t buckets[kLatencyBucketCount];
+};
+
+// JitModuleStats are the JIT compilations of one module. It is blittable:
+// keep its layout in sync with the managed definition.
+struct JitModuleStats {
+  uint64_t module_id;
+  uint64_t method_count;
+  uint64_t total_ns;
+  uint64_t instrumentation_ns;
+  uint64_t max_ns;
+};
+
+// JitMethodTime is the JIT compilation of one method. It is blittable: keep
+// its layout in sync with the managed definition.
+struct JitMethodTime {
+  uint64_t function_id;
+  uint64_t module_id;
+  uint64_t duration_ns;
+  uint64_t instrumentation_ns;
+};
+
+// JitStatistics measures how long the JIT compiler takes per method, and how
+// much of it the profiler spends instrumenting them, to tell what is worth
+// precompiling and what the profiler costs at startup.
+//
+// Each thread keeps a stack of the compilations in progress, so nested
+// compilations are subtracted from their parent. Finished compilations are
+// aggregated under a lock into a latency histogram, per-module totals and a
+// min-heap of the slowest methods.
+class JitStatistics {
+ private:
+  ICorProfilerInfo3* info_ = nullptr;
+  size_t top_methods_ = kDefaultJitTopMethods;
+  bool enabled_ = false;
+
+  mutable std::mutex lock_;
+  LatencyHistogram histogram_;
+  uint64_t failed_count_ = 0;
+  uint64_t instrumentation_ns_ = 0;
+  std::unordered_map<ModuleID, JitModuleStats> modules_;
+  // min-heap on duration_ns, at most top_methods_ long
+  std::vector<JitMethodTime> slowest_;
+
+ public:
+  JitStatistics() = default;
+  JitStatistics(const JitStatistics&) = delete;
+  JitStatistics& operator=(const JitStatistics&) = delete;
+
+  // Initialize enables the statistics. info may be null in tests: module ids
+  // are then reported as 0.
+  void Initialize(ICorProfilerInfo3* info, size_t top_methods);
+
+  bool IsEnabled() const { return enabled_; }
+
+  // OnJitStarted must be called on entering JITCompilationStarted and
+  // OnInstrumentationFinished when leaving it; JitInstrumentationScope does
+  // both.
+  void OnJitStarted(FunctionID function_id, uint64_t now_ns);
+  void OnInstrumentationFinished(FunctionID function_id, uint64_t now_ns);
+
+  // OnJitFinished must be called from JITCompilationFinished on the same
+  // thread.
+  void OnJitFinished(FunctionID function_id, HRESULT hr_status,
+                     uint64_t now_ns);
+
+  // EvictModule must be called from ModuleUnloadStarted: it drops the
+  // module's methods from the slowest ones, whose FunctionIDs would no
+  // longer be valid when named. The totals are kept.
+  void EvictModule(ModuleID module_id);
+
+  void GetSummary(JitSummary* summary) const;
+
+  // GetModules copies up to max_modules module totals, most expensive first.
+  // Returns the number copied.
+  size_t GetModules(JitModuleStats* modules, size_t max_modules) const;
+
+  // GetSlowestMethods copies up to max_methods of the slowest methods,
+  // slowest first. Returns the number copied.
+  size_t GetSlowestMethods(JitMethodTime* methods, size_t max_methods) const;
+
+  // LogSummary logs the totals and the slowest methods, named through
+  // symbols.
+  void LogSummary(SymbolCache* symbols) const;
+};
+
+// JitInstrumentationScope reports the start of a compilation and the time the
+// profiler spends instrumenting it. Put one at the top of
+// JITCompilationStarted.
+class JitInstrumentationScope {
+ private:
+  JitStatistics& statistics_;
+  const FunctionID function_id_;
+
+ public:
+  JitInstrumentationScope(JitStatistics& statistics, FunctionID function_id)
+      : statistics_(statistics), function_id_(function_id) {
+    if (statistics_.IsEnabled()) {
+      statistics_.OnJitStarted(function_id_, MonotonicNanoseconds());
+    }
+  }
+
+  JitInstrumentationScope(const JitInstrumentationScope&) = delete;
+  JitInstrumentationScope& operator=(const JitInstrumentationScope&) = delete;
+
+  ~JitInstrumentationScope() {
+    if (statistics_.IsEnabled()) {
+      statistics_.OnInstrumentationFinished(function_id_,
+                                            MonotonicNanoseconds());
+    }
+  }
+};
+
+}  // namespace trace
+
+#endif  // DD_CLR_PROFILER_JIT_STATISTICS_H_
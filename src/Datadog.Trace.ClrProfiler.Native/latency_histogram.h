@@ -0,0 +1,89 @@
+#ifndef DD_CLR_PROFILER_LATENCY_HISTOGRAM_H_
+#define DD_CLR_PROFILER_LATENCY_HISTOGRAM_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace trace {
+
+// Latencies are bucketed log-linearly: values below 4 get their own bucket,
+// above that every power of two is split into 4 equal buckets, so a bucket's
+// width is at most 25% of its lower bound. 160 buckets cover up to 2^41 ns
+// (about 36 minutes); larger values go to the last bucket.
+const size_t kLatencyBucketCount = 160;
+
+// LatencyBucket returns the index of the bucket holding value.
+inline size_t LatencyBucket(uint64_t value) {
+  if (value < 4) {
+    return static_cast<size_t>(value);
+  }
+
+  size_t exponent = 2;
+  while (exponent < 63 && (value >> (exponent + 1)) != 0) {
+    exponent++;
+  }
+
+  const size_t index = (exponent - 1) * 4 + ((value >> (exponent - 2)) & 3);
+  return index < kLatencyBucketCount ? index : kLatencyBucketCount - 1;
+}
+
+// LatencyBucketLowerBound returns the smallest value that falls into the
+// bucket at index.
+inline uint64_t LatencyBucketLowerBound(size_t index) {
+  if (index < 4) {
+    return index;
+  }
+
+  const size_t exponent = index / 4 + 1;
+  return static_cast<uint64_t>(4 + index % 4) << (exponent - 2);
+}
+
+// LatencyHistogram aggregates durations in nanoseconds. It is not
+// synchronized.
+struct LatencyHistogram {
+  uint64_t count = 0;
+  uint64_t total = 0;
+  uint64_t min = 0;
+  uint64_t max = 0;
+  uint64_t buckets[kLatencyBucketCount]{};
+
+  void Record(uint64_t value) {
+    if (count == 0 || value < min) {
+      min = value;
+    }
+    if (value > max) {
+      max = value;
+    }
+    count++;
+    total += value;
+    buckets[LatencyBucket(value)]++;
+  }
+
+  // Percentile returns the lower bound of the bucket holding the given
+  // percentile (0 to 100), clamped to the observed range.
+  uint64_t Percentile(double percentile) const {
+    if (count == 0) {
+      return 0;
+    }
+
+    auto rank = static_cast<uint64_t>(percentile / 100.0 * count);
+    if (rank >= count) {
+      rank = count - 1;
+    }
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kLatencyBucketCount; i++) {
+      seen += buckets[i];
+      if (seen > rank) {
+        const auto bound = LatencyBucketLowerBound(i);
+        return bound < min ? min : (bound > max ? max : bound);
+      }
+    }
+
+    return max;
+  }
+};
+
+}  // namespace trace
+
+#endif  // DD_CLR_PROFILER_LATENCY_HISTOGRAM_H_
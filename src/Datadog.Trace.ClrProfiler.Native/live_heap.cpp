@@ -0,0 +1,276 @@
+#include "live_heap.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "logging.h"
+
+namespace trace {
+
+namespace {
+
+// Maximum number of generation ranges read when a collection starts.
+const ULONG kMaxGenerationRanges = 256;
+
+}  // namespace
+
+void LiveHeap::Initialize(uint64_t sampling_interval, size_t max_objects) {
+  sampling_interval_ = sampling_interval > 0
+                           ? sampling_interval
+                           : kDefaultAllocationSamplingInterval;
+  max_objects_ = max_objects > 0 ? max_objects : kDefaultLiveHeapMaxObjects;
+  enabled_ = true;
+
+  Info("Live heap profiling enabled, tracking up to ", max_objects_,
+       " sampled objects.");
+}
+
+void LiveHeap::Track(ObjectID object_id, const AllocationSite& site,
+                     uint64_t size) {
+  if (!enabled_) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> guard(lock_);
+
+  if (objects_.size() + pending_.size() >= max_objects_) {
+    dropped_objects_++;
+    return;
+  }
+
+  uint32_t index;
+  const auto existing = site_indexes_.find(site);
+
+  if (existing != site_indexes_.end()) {
+    index = existing->second;
+  } else if (!free_sites_.empty()) {
+    index = free_sites_.back();
+    free_sites_.pop_back();
+    sites_[index].site = site;
+    sites_[index].live_objects = 0;
+    site_indexes_.emplace(site, index);
+  } else if (sites_.size() < kMaxLiveHeapSites) {
+    index = static_cast<uint32_t>(sites_.size());
+    sites_.push_back({site, 0});
+    site_indexes_.emplace(site, index);
+  } else {
+    dropped_objects_++;
+    return;
+  }
+
+  sites_[index].live_objects++;
+
+  TrackedObject object;
+  object.address = object_id;
+  object.site = index;
+  object.size = static_cast<uint32_t>(
+      std::min<uint64_t>(size, std::numeric_limits<uint32_t>::max()));
+  pending_.push_back(object);
+}
+
+void LiveHeap::OnGarbageCollectionStarted(ICorProfilerInfo3* info,
+                                          int generation_count,
+                                          const BOOL generation_collected[]) {
+  if (!enabled_) {
+    return;
+  }
+
+  COR_PRF_GC_GENERATION_RANGE ranges[kMaxGenerationRanges];
+  ULONG range_count = 0;
+
+  if (FAILED(info->GetGenerationBounds(kMaxGenerationRanges, &range_count,
+                                       ranges))) {
+    // without the bounds every object is kept until the next collection
+    range_count = 0;
+  }
+
+  BeginCollection(generation_count, generation_collected, ranges,
+                  std::min(range_count, kMaxGenerationRanges));
+}
+
+void LiveHeap::BeginCollection(int generation_count,
+                               const BOOL generation_collected[],
+                               const COR_PRF_GC_GENERATION_RANGE ranges[],
+                               size_t range_count) {
+  std::lock_guard<std::mutex> guard(lock_);
+
+  const auto by_address = [](const TrackedObject& a, const TrackedObject& b) {
+    return a.address < b.address;
+  };
+
+  if (!pending_.empty()) {
+    const auto middle = objects_.size();
+    std::sort(pending_.begin(), pending_.end(), by_address);
+    objects_.insert(objects_.end(), pending_.begin(), pending_.end());
+    std::inplace_merge(objects_.begin(), objects_.begin() + middle,
+                       objects_.end(), by_address);
+    pending_.clear();
+  }
+
+  new_addresses_.resize(objects_.size());
+
+  for (size_t i = 0; i < objects_.size(); i++) {
+    const auto address = objects_[i].address;
+    new_addresses_[i] = address;
+
+    for (size_t r = 0; r < range_count; r++) {
+      const auto& range = ranges[r];
+      if (address < range.rangeStart ||
+          address - range.rangeStart >= range.rangeLength) {
+        continue;
+      }
+
+      const auto generation = static_cast<int>(range.generation);
+      if (generation >= 0 && generation < generation_count &&
+          generation_collected[generation]) {
+        new_addresses_[i] = 0;
+      }
+      break;
+    }
+  }
+
+  collecting_ = true;
+}
+
+void LiveHeap::Survived(ObjectID start, ObjectID new_start, uint64_t length) {
+  auto object = std::lower_bound(
+      objects_.begin(), objects_.end(), start,
+      [](const TrackedObject& a, ObjectID address) {
+        return a.address < address;
+      });
+
+  for (; object != objects_.end() && object->address - start < length;
+       ++object) {
+    new_addresses_[object - objects_.begin()] =
+        new_start + (object->address - start);
+  }
+}
+
+void LiveHeap::OnMovedReferences(ULONG range_count,
+                                 const ObjectID old_starts[],
+                                 const ObjectID new_starts[],
+                                 const SIZE_T lengths[]) {
+  std::lock_guard<std::mutex> guard(lock_);
+  if (!collecting_) {
+    return;
+  }
+
+  for (ULONG i = 0; i < range_count; i++) {
+    Survived(old_starts[i], new_starts[i], lengths[i]);
+  }
+}
+
+void LiveHeap::OnSurvivingReferences(ULONG range_count,
+                                     const ObjectID starts[],
+                                     const SIZE_T lengths[]) {
+  std::lock_guard<std::mutex> guard(lock_);
+  if (!collecting_) {
+    return;
+  }
+
+  for (ULONG i = 0; i < range_count; i++) {
+    Survived(starts[i], starts[i], lengths[i]);
+  }
+}
+
+void LiveHeap::ReleaseSite(uint32_t site) {
+  auto& entry = sites_[site];
+  if (--entry.live_objects > 0) {
+    return;
+  }
+
+  site_indexes_.erase(entry.site);
+  free_sites_.push_back(site);
+}
+
+void LiveHeap::OnGarbageCollectionFinished(uint64_t timestamp_unix_ns) {
+  std::lock_guard<std::mutex> guard(lock_);
+  if (!collecting_) {
+    return;
+  }
+
+  size_t kept = 0;
+  bool moved = false;
+
+  for (size_t i = 0; i < objects_.size(); i++) {
+    if (new_addresses_[i] == 0) {
+      ReleaseSite(objects_[i].site);
+      continue;
+    }
+
+    moved = moved || new_addresses_[i] != objects_[i].address;
+    objects_[kept] = objects_[i];
+    objects_[kept].address = new_addresses_[i];
+    kept++;
+  }
+
+  objects_.resize(kept);
+  if (moved) {
+    // compaction keeps the order within a generation, not across them
+    std::sort(objects_.begin(), objects_.end(),
+              [](const TrackedObject& a, const TrackedObject& b) {
+                return a.address < b.address;
+              });
+  }
+
+  collecting_ = false;
+  gc_count_++;
+  TakeSnapshot(timestamp_unix_ns);
+}
+
+void LiveHeap::TakeSnapshot(uint64_t timestamp_unix_ns) {
+  std::lock_guard<std::mutex> guard(snapshot_lock_);
+
+  snapshot_.clear();
+  snapshot_stats_ = LiveHeapStats{};
+  snapshot_stats_.gc_count = gc_count_;
+  snapshot_stats_.timestamp_unix_ns = timestamp_unix_ns;
+  snapshot_stats_.tracked_objects = objects_.size();
+  snapshot_stats_.dropped_objects = dropped_objects_;
+
+  // position + 1 of each site in snapshot_, 0 until it is added
+  std::vector<uint32_t> entries(sites_.size(), 0);
+
+  for (const auto& object : objects_) {
+    auto& entry = entries[object.site];
+    if (entry == 0) {
+      const auto& site = sites_[object.site].site;
+      LiveHeapSite live_site{};
+      live_site.class_id = site.class_id;
+      live_site.frame_count = site.stack.frame_count;
+      for (uint32_t i = 0; i < site.stack.frame_count; i++) {
+        live_site.frames[i] = site.stack.frames[i];
+      }
+
+      snapshot_.push_back(live_site);
+      entry = static_cast<uint32_t>(snapshot_.size());
+    }
+
+    auto& live_site = snapshot_[entry - 1];
+    const auto weight = static_cast<uint64_t>(
+        SampleWeight(object.size, sampling_interval_));
+    live_site.live_objects++;
+    live_site.sampled_bytes += object.size;
+    live_site.estimated_bytes += weight;
+    snapshot_stats_.sampled_bytes += object.size;
+    snapshot_stats_.estimated_bytes += weight;
+  }
+
+  std::sort(snapshot_.begin(), snapshot_.end(),
+            [](const LiveHeapSite& a, const LiveHeapSite& b) {
+              return a.estimated_bytes > b.estimated_bytes;
+            });
+  snapshot_stats_.site_count = snapshot_.size();
+}
+
+size_t LiveHeap::Read(LiveHeapStats* stats, LiveHeapSite* sites,
+                      size_t max_sites) const {
+  std::lock_guard<std::mutex> guard(snapshot_lock_);
+
+  *stats = snapshot_stats_;
+  const auto count = std::min(max_sites, snapshot_.size());
+  std::copy(snapshot_.begin(), snapshot_.begin() + count, sites);
+  return count;
+}
+
+}  // namespace trace
@@ -0,0 +1,159 @@
+#ifndef DD_CLR_PROFILER_LIVE_HEAP_H_
+#define DD_CLR_PROFILER_LIVE_HEAP_H_
+
+#include <corhlpr.h>
+#include <corprof.h>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "allocation_sampler.h"
+#include "stack_walker.h"
+
+namespace trace {
+
+// Default maximum number of sampled objects tracked at the same time. Samples
+// beyond it are not tracked (and counted) until collections free some.
+const size_t kDefaultLiveHeapMaxObjects = 64 * 1024;
+
+// Maximum number of allocation sites with live sampled objects.
+const size_t kMaxLiveHeapSites = 4096;
+
+// LiveHeapSite is the part of the live heap allocated at one site, handed to
+// managed code by GetLiveHeap in interop.cpp. It is blittable: keep its
+// layout in sync with the managed definition.
+struct LiveHeapSite {
+  uint64_t class_id;
+  // sampled objects from this site that survived every collection so far
+  uint64_t live_objects;
+  uint64_t sampled_bytes;
+  // unbiased estimate of the live bytes allocated at this site
+  uint64_t estimated_bytes;
+  uint64_t frame_count;
+  uint64_t frames[kMaxStackFrames];
+};
+
+// LiveHeapStats describes the snapshot taken after the last collection. It is
+// blittable: keep its layout in sync with the managed definition.
+struct LiveHeapStats {
+  // collections seen since the profiler attached, 0 before the first one
+  uint64_t gc_count;
+  // wall-clock end of the collection, nanoseconds since the Unix epoch
+  uint64_t timestamp_unix_ns;
+  uint64_t tracked_objects;
+  uint64_t site_count;
+  uint64_t sampled_bytes;
+  uint64_t estimated_bytes;
+  // samples that were not tracked because a table was full
+  uint64_t dropped_objects;
+};
+
+// LiveHeap follows sampled allocations until they are collected, to tell
+// who retains memory rather than who allocates it.
+//
+// Tracked objects are kept in a table ordered by address. When a collection
+// starts, objects in the collected generations are condemned. The
+// MovedReferences2 and SurvivingReferences2 callbacks then report the
+// address ranges that survived, each looked up in the table in O(log n), and
+// when the collection finishes the condemned objects that were not reported
+// are dropped and the others take their new address. Each collection
+// publishes a snapshot of the live heap by allocation site.
+//
+// Objects sampled between collections are added to an unordered list and
+// merged into the table when the next collection starts.
+class LiveHeap {
+ private:
+  struct TrackedObject {
+    ObjectID address;
+    uint32_t site;
+    // capped at 4 GB
+    uint32_t size;
+  };
+
+  struct Site {
+    AllocationSite site;
+    uint32_t live_objects;
+  };
+
+  uint64_t sampling_interval_ = kDefaultAllocationSamplingInterval;
+  size_t max_objects_ = 0;
+  bool enabled_ = false;
+
+  // guards everything but the snapshot
+  std::mutex lock_;
+  // ordered by address
+  std::vector<TrackedObject> objects_;
+  // sampled since the last collection
+  std::vector<TrackedObject> pending_;
+  std::vector<Site> sites_;
+  std::vector<uint32_t> free_sites_;
+  std::unordered_map<AllocationSite, uint32_t, AllocationSiteHash>
+      site_indexes_;
+  uint64_t dropped_objects_ = 0;
+
+  // during a collection, the address of each object of objects_ once it is
+  // over, 0 if it was condemned and not reported as surviving yet
+  std::vector<ObjectID> new_addresses_;
+  bool collecting_ = false;
+  uint64_t gc_count_ = 0;
+
+  mutable std::mutex snapshot_lock_;
+  LiveHeapStats snapshot_stats_{};
+  std::vector<LiveHeapSite> snapshot_;
+
+  // Survived records that the objects of [start, start + length) now start
+  // at new_start.
+  void Survived(ObjectID start, ObjectID new_start, uint64_t length);
+
+  // ReleaseSite and TakeSnapshot are called with lock_ held.
+  void ReleaseSite(uint32_t site);
+  void TakeSnapshot(uint64_t timestamp_unix_ns);
+
+ public:
+  LiveHeap() = default;
+  LiveHeap(const LiveHeap&) = delete;
+  LiveHeap& operator=(const LiveHeap&) = delete;
+
+  // Initialize enables tracking. sampling_interval is the one of the
+  // allocation sampler, to weigh the samples. Requires COR_PRF_MONITOR_GC in
+  // the event mask.
+  void Initialize(uint64_t sampling_interval, size_t max_objects);
+
+  bool IsEnabled() const { return enabled_; }
+
+  // Track adds an object sampled by the AllocationSampler.
+  void Track(ObjectID object_id, const AllocationSite& site, uint64_t size);
+
+  // OnGarbageCollectionStarted must be called from GarbageCollectionStarted.
+  // It reads the generation bounds from info.
+  void OnGarbageCollectionStarted(ICorProfilerInfo3* info,
+                                  int generation_count,
+                                  const BOOL generation_collected[]);
+
+  // BeginCollection condemns the tracked objects that lie in a range of a
+  // collected generation.
+  void BeginCollection(int generation_count, const BOOL generation_collected[],
+                       const COR_PRF_GC_GENERATION_RANGE ranges[],
+                       size_t range_count);
+
+  void OnMovedReferences(ULONG range_count, const ObjectID old_starts[],
+                         const ObjectID new_starts[], const SIZE_T lengths[]);
+
+  void OnSurvivingReferences(ULONG range_count, const ObjectID starts[],
+                             const SIZE_T lengths[]);
+
+  // OnGarbageCollectionFinished drops the objects that were collected and
+  // publishes a snapshot.
+  void OnGarbageCollectionFinished(uint64_t timestamp_unix_ns);
+
+  // Read copies the stats of the last snapshot into stats and up to max_sites
+  // of its sites, largest first, into sites. Returns the number of sites
+  // copied.
+  size_t Read(LiveHeapStats* stats, LiveHeapSite* sites,
+              size_t max_sites) const;
+};
+
+}  // namespace trace
+
+#endif  // DD_CLR_PROFILER_LIVE_HEAP_H_
@@ -2,14 +2,85 @@
 
 #include <fstream>
 #include <ios>
+#include <mutex>
 #include <sstream>
+#include <vector>
 
 #include "pal.h"
+#include "span_context.h"
 
 namespace trace {
 
 bool debug_logging_enabled = false;
 
+namespace {
+
+// lines logged before the configuration is loaded, written to its log path
+const size_t kMaxPendingLines = 256;
+
+std::mutex log_mutex;
+std::string log_file_path;
+std::vector<std::string> pending_lines;
+
+// Append writes line to the log file. log_mutex must be held.
+void Append(const std::string& line) {
+  const auto& path = log_file_path;
+
+#ifdef _WIN32
+  // on VC++, use std::filesystem (C++ 17) to
+  // create directory if missing
+  const auto log_path = std::filesystem::path(path);
+
+  if (log_path.has_parent_path()) {
+    const auto parent_path = log_path.parent_path();
+
+    if (!std::filesystem::exists(parent_path)) {
+      std::filesystem::create_directories(parent_path);
+    }
+  }
+#endif
+
+  std::ofstream out(path, std::ios::app);
+  out << line;
+}
+
+}  // namespace
+
+void SetLogFilePath(const WSTRING& path) {
+  try {
+    std::lock_guard<std::mutex> lock(log_mutex);
+    log_file_path = ToString(path);
+
+    std::string lines;
+    for (const auto& line : pending_lines) {
+      lines += line;
+    }
+    pending_lines.clear();
+    pending_lines.shrink_to_fit();
+
+    if (!lines.empty()) {
+      Append(lines);
+    }
+  } catch (...) {
+  }
+}
+
+std::string WarningContext() {
+  const auto slot = CurrentSpanContextSlot();
+  SpanContext context;
+
+  if (slot == nullptr || !slot->Get(&context) || context.span_id == 0) {
+    return std::string();
+  }
+
+  slot->AddWarning();
+
+  std::ostringstream oss;
+  oss << " (trace_id: " << context.trace_id
+      << ", span_id: " << context.span_id << ")";
+  return oss.str();
+}
+
 void Log(const std::string& str) {
   static auto current_process_name = ToString(GetCurrentProcessName());
 
@@ -19,24 +90,16 @@ void Log(const std::string& str) {
   auto line = ss.str();
 
   try {
-    const auto path = ToString(DatadogLogFilePath());
+    std::lock_guard<std::mutex> lock(log_mutex);
 
-#ifdef _WIN32
-    // on VC++, use std::filesystem (C++ 17) to
-    // create directory if missing
-    const auto log_path = std::filesystem::path(path);
-
-    if (log_path.has_parent_path()) {
-      const auto parent_path = log_path.parent_path();
-
-      if (!std::filesystem::exists(parent_path)) {
-        std::filesystem::create_directories(parent_path);
+    if (log_file_path.empty()) {
+      if (pending_lines.size() < kMaxPendingLines) {
+        pending_lines.push_back(line);
       }
+      return;
     }
-#endif
 
-    std::ofstream out(path, std::ios::app);
-    out << line;
+    Append(line);
   } catch (...) {
   }
 }
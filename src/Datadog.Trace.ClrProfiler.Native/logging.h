@@ -7,6 +7,10 @@ namespace trace {
 
 extern bool debug_logging_enabled;
 
+// SetLogFilePath sets the file Log appends to, from the loaded configuration.
+// Lines logged before it is called are kept and written to that file then.
+void SetLogFilePath(const WSTRING &path);
+
 void Log(const std::string &str);
 
 template <typename Arg>
@@ -33,9 +37,14 @@ void Info(const Args... args) {
   Log("[info] " + LogToString(args...));
 }
 
+// WarningContext formats the span the calling thread is working on, as set
+// by SetCurrentSpanContext, and counts the warning against it. Empty if the
+// thread has no span.
+std::string WarningContext();
+
 template <typename... Args>
 void Warn(const Args... args) {
-  Log("[warn] " + LogToString(args...));
+  Log("[warn] " + LogToString(args...) + WarningContext());
 }
 
 }  // namespace trace
@@ -0,0 +1,39 @@
+#ifndef DD_CLR_PROFILER_MEMORY_USAGE_H_
+#define DD_CLR_PROFILER_MEMORY_USAGE_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "string.h"  // NOLINT
+
+namespace trace {
+
+// HeapBytes estimates the memory a container allocated, not counting the
+// container itself, for the memory accounting of the profiler. Allocator
+// overhead and the small string optimization are ignored.
+
+inline size_t HeapBytes(const WSTRING& str) {
+  return str.capacity() * sizeof(WCHAR);
+}
+
+inline size_t HeapBytes(const std::vector<bool>& vector) {
+  return vector.capacity() / 8;
+}
+
+template <typename T>
+size_t HeapBytes(const std::vector<T>& vector) {
+  return vector.capacity() * sizeof(T);
+}
+
+// HashTableBytes works for every unordered container: a pointer per bucket,
+// and a node per element with a link to the next one.
+template <typename HashTable>
+size_t HashTableBytes(const HashTable& table) {
+  return table.bucket_count() * sizeof(void*) +
+         table.size() *
+             (sizeof(typename HashTable::value_type) + sizeof(void*));
+}
+
+}  // namespace trace
+
+#endif  // DD_CLR_PROFILER_MEMORY_USAGE_H_
@@ -0,0 +1,773 @@
+#include "metadata_reader.h"
+
+#include <cstring>
+
+#ifdef _WIN32
+#include "windows.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace trace {
+
+namespace {
+
+enum ColumnType : uint8_t {
+  kEndColumn = 0,
+  kUInt16Column,
+  kUInt32Column,
+  kStringColumn,
+  kGuidColumn,
+  kBlobColumn,
+  // index of a row of the table in Column::target
+  kTableColumn,
+  // coded index of the kind in Column::target
+  kCodedColumn,
+};
+
+// Coded index kinds, ECMA-335 II.24.2.6
+enum CodedIndex : uint8_t {
+  kTypeDefOrRef,
+  kHasConstant,
+  kHasCustomAttribute,
+  kHasFieldMarshal,
+  kHasDeclSecurity,
+  kMemberRefParent,
+  kHasSemantics,
+  kMethodDefOrRef,
+  kMemberForwarded,
+  kImplementation,
+  kCustomAttributeType,
+  kResolutionScope,
+  kTypeOrMethodDef,
+  kCodedIndexCount,
+};
+
+struct Column {
+  ColumnType type;
+  uint8_t target;
+};
+
+struct CodedIndexInfo {
+  uint8_t tag_bits;
+  uint8_t table_count;
+  uint8_t tables[22];
+};
+
+// tags that don't refer to any table
+const uint8_t kNoTable = 0xFF;
+
+const CodedIndexInfo kCodedIndexes[kCodedIndexCount] = {
+    // TypeDefOrRef
+    {2, 3, {kTypeDefTable, kTypeRefTable, kTypeSpecTable}},
+    // HasConstant
+    {2, 3, {kFieldTable, kParamTable, kPropertyTable}},
+    // HasCustomAttribute
+    {5,
+     22,
+     {kMethodDefTable, kFieldTable, kTypeRefTable, kTypeDefTable, kParamTable,
+      kInterfaceImplTable, kMemberRefTable, kModuleTable, kDeclSecurityTable,
+      kPropertyTable, kEventTable, kStandAloneSigTable, kModuleRefTable,
+      kTypeSpecTable, kAssemblyTable, kAssemblyRefTable, kFileTable,
+      kExportedTypeTable, kManifestResourceTable, kGenericParamTable,
+      kGenericParamConstraintTable, kMethodSpecTable}},
+    // HasFieldMarshal
+    {1, 2, {kFieldTable, kParamTable}},
+    // HasDeclSecurity
+    {2, 3, {kTypeDefTable, kMethodDefTable, kAssemblyTable}},
+    // MemberRefParent
+    {3,
+     5,
+     {kTypeDefTable, kTypeRefTable, kModuleRefTable, kMethodDefTable,
+      kTypeSpecTable}},
+    // HasSemantics
+    {1, 2, {kEventTable, kPropertyTable}},
+    // MethodDefOrRef
+    {1, 2, {kMethodDefTable, kMemberRefTable}},
+    // MemberForwarded
+    {1, 2, {kFieldTable, kMethodDefTable}},
+    // Implementation
+    {2, 3, {kFileTable, kAssemblyRefTable, kExportedTypeTable}},
+    // CustomAttributeType
+    {3, 5, {kNoTable, kNoTable, kMethodDefTable, kMemberRefTable, kNoTable}},
+    // ResolutionScope
+    {2, 4, {kModuleTable, kModuleRefTable, kAssemblyRefTable, kTypeRefTable}},
+    // TypeOrMethodDef
+    {1, 2, {kTypeDefTable, kMethodDefTable}},
+};
+
+const Column kU16 = {kUInt16Column, 0};
+const Column kU32 = {kUInt32Column, 0};
+const Column kString = {kStringColumn, 0};
+const Column kGuid = {kGuidColumn, 0};
+const Column kBlob = {kBlobColumn, 0};
+
+Column Index(MetadataTable table) { return {kTableColumn, table}; }
+Column Coded(CodedIndex kind) { return {kCodedColumn, kind}; }
+
+// GetSchema returns the columns of a table, ECMA-335 II.22, terminated by
+// a kEndColumn.
+const Column* GetSchema(uint8_t table) {
+  static const Column kEnd = {kEndColumn, 0};
+  static const Column schemas[kMetadataTableCount][kMaxMetadataColumns + 1] = {
+      // Module
+      {kU16, kString, kGuid, kGuid, kGuid, kEnd},
+      // TypeRef
+      {Coded(kResolutionScope), kString, kString, kEnd},
+      // TypeDef
+      {kU32, kString, kString, Coded(kTypeDefOrRef), Index(kFieldTable),
+       Index(kMethodDefTable), kEnd},
+      // FieldPtr
+      {Index(kFieldTable), kEnd},
+      // Field
+      {kU16, kString, kBlob, kEnd},
+      // MethodPtr
+      {Index(kMethodDefTable), kEnd},
+      // MethodDef
+      {kU32, kU16, kU16, kString, kBlob, Index(kParamTable), kEnd},
+      // ParamPtr
+      {Index(kParamTable), kEnd},
+      // Param
+      {kU16, kU16, kString, kEnd},
+      // InterfaceImpl
+      {Index(kTypeDefTable), Coded(kTypeDefOrRef), kEnd},
+      // MemberRef
+      {Coded(kMemberRefParent), kString, kBlob, kEnd},
+      // Constant: a type byte and a padding byte
+      {kU16, Coded(kHasConstant), kBlob, kEnd},
+      // CustomAttribute
+      {Coded(kHasCustomAttribute), Coded(kCustomAttributeType), kBlob, kEnd},
+      // FieldMarshal
+      {Coded(kHasFieldMarshal), kBlob, kEnd},
+      // DeclSecurity
+      {kU16, Coded(kHasDeclSecurity), kBlob, kEnd},
+      // ClassLayout
+      {kU16, kU32, Index(kTypeDefTable), kEnd},
+      // FieldLayout
+      {kU32, Index(kFieldTable), kEnd},
+      // StandAloneSig
+      {kBlob, kEnd},
+      // EventMap
+      {Index(kTypeDefTable), Index(kEventTable), kEnd},
+      // EventPtr
+      {Index(kEventTable), kEnd},
+      // Event
+      {kU16, kString, Coded(kTypeDefOrRef), kEnd},
+      // PropertyMap
+      {Index(kTypeDefTable), Index(kPropertyTable), kEnd},
+      // PropertyPtr
+      {Index(kPropertyTable), kEnd},
+      // Property
+      {kU16, kString, kBlob, kEnd},
+      // MethodSemantics
+      {kU16, Index(kMethodDefTable), Coded(kHasSemantics), kEnd},
+      // MethodImpl
+      {Index(kTypeDefTable), Coded(kMethodDefOrRef), Coded(kMethodDefOrRef),
+       kEnd},
+      // ModuleRef
+      {kString, kEnd},
+      // TypeSpec
+      {kBlob, kEnd},
+      // ImplMap
+      {kU16, Coded(kMemberForwarded), kString, Index(kModuleRefTable), kEnd},
+      // FieldRVA
+      {kU32, Index(kFieldTable), kEnd},
+      // ENCLog
+      {kU32, kU32, kEnd},
+      // ENCMap
+      {kU32, kEnd},
+      // Assembly
+      {kU32, kU16, kU16, kU16, kU16, kU32, kBlob, kString, kString, kEnd},
+      // AssemblyProcessor
+      {kU32, kEnd},
+      // AssemblyOS
+      {kU32, kU32, kU32, kEnd},
+      // AssemblyRef
+      {kU16, kU16, kU16, kU16, kU32, kBlob, kString, kString, kBlob, kEnd},
+      // AssemblyRefProcessor
+      {kU32, Index(kAssemblyRefTable), kEnd},
+      // AssemblyRefOS
+      {kU32, kU32, kU32, Index(kAssemblyRefTable), kEnd},
+      // File
+      {kU32, kString, kBlob, kEnd},
+      // ExportedType
+      {kU32, kU32, kString, kString, Coded(kImplementation), kEnd},
+      // ManifestResource
+      {kU32, kU32, kString, Coded(kImplementation), kEnd},
+      // NestedClass
+      {Index(kTypeDefTable), Index(kTypeDefTable), kEnd},
+      // GenericParam
+      {kU16, kU16, Coded(kTypeOrMethodDef), kString, kEnd},
+      // MethodSpec
+      {Coded(kMethodDefOrRef), kBlob, kEnd},
+      // GenericParamConstraint
+      {Index(kGenericParamTable), Coded(kTypeDefOrRef), kEnd},
+  };
+
+  return schemas[table];
+}
+
+// the #~ stream's HeapSizes flags
+const uint8_t kLargeStrings = 0x01;
+const uint8_t kLargeGuids = 0x02;
+const uint8_t kLargeBlobs = 0x04;
+// 4 more bytes follow the row counts
+const uint8_t kExtraData = 0x40;
+
+const uint32_t kMetadataSignature = 0x424A5342;  // "BSJB"
+const uint16_t kPe32Magic = 0x10B;
+const uint16_t kPe32PlusMagic = 0x20B;
+const uint32_t kCliHeaderDirectory = 14;
+
+const uint8_t kElementTypeValueType = 0x11;
+const uint8_t kElementTypeClass = 0x12;
+const uint8_t kElementTypeGenericInst = 0x15;
+
+inline uint16_t ReadUInt16(const uint8_t* p) {
+  return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+inline uint32_t ReadUInt32(const uint8_t* p) {
+  return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+         (static_cast<uint32_t>(p[2]) << 16) |
+         (static_cast<uint32_t>(p[3]) << 24);
+}
+
+// ReadCompressedUInt32 decodes an ECMA-335 II.23.2 compressed integer.
+// Returns the number of bytes read, or 0 if it doesn't fit in size.
+uint32_t ReadCompressedUInt32(const uint8_t* p, size_t size, uint32_t* value) {
+  if (size >= 1 && (p[0] & 0x80) == 0) {
+    *value = p[0];
+    return 1;
+  }
+  if (size >= 2 && (p[0] & 0xC0) == 0x80) {
+    *value = ((p[0] & 0x3Fu) << 8) | p[1];
+    return 2;
+  }
+  if (size >= 4 && (p[0] & 0xE0) == 0xC0) {
+    *value = ((p[0] & 0x1Fu) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+             (static_cast<uint32_t>(p[2]) << 8) | p[3];
+    return 4;
+  }
+  return 0;
+}
+
+}  // namespace
+
+MappedFile::~MappedFile() { Close(); }
+
+bool MappedFile::Open(const WSTRING& path) {
+  Close();
+
+#ifdef _WIN32
+  const auto file =
+      CreateFileW(path.c_str(), GENERIC_READ,
+                  FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                  nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  file_ = file;
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0) {
+    Close();
+    return false;
+  }
+
+  mapping_ = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping_ == nullptr) {
+    Close();
+    return false;
+  }
+
+  data_ = static_cast<const uint8_t*>(
+      MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+  if (data_ == nullptr) {
+    Close();
+    return false;
+  }
+  size_ = static_cast<size_t>(size.QuadPart);
+#else
+  const int fd = open(ToString(path).c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+    close(fd);
+    return false;
+  }
+
+  // the mapping stays valid once the descriptor is closed
+  void* data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ,
+                    MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+
+  data_ = static_cast<const uint8_t*>(data);
+  size_ = static_cast<size_t>(st.st_size);
+#endif
+
+  return true;
+}
+
+void MappedFile::Close() {
+#ifdef _WIN32
+  if (data_ != nullptr) {
+    UnmapViewOfFile(data_);
+  }
+  if (mapping_ != nullptr) {
+    CloseHandle(mapping_);
+    mapping_ = nullptr;
+  }
+  if (file_ != nullptr) {
+    CloseHandle(file_);
+    file_ = nullptr;
+  }
+#else
+  if (data_ != nullptr) {
+    munmap(const_cast<uint8_t*>(data_), size_);
+  }
+#endif
+  data_ = nullptr;
+  size_ = 0;
+}
+
+bool MetadataReader::Open(const WSTRING& path) {
+  return file_.Open(path) && OpenImage(file_.Data(), file_.Size());
+}
+
+bool MetadataReader::OpenImage(const uint8_t* image, size_t size) {
+  strings_ = blobs_ = guids_ = nullptr;
+  strings_size_ = blobs_size_ = guids_size_ = 0;
+  for (auto& table : tables_) {
+    table = Table();
+  }
+
+  // DOS header, then the PE signature and the COFF header
+  if (size < 0x40 || image[0] != 'M' || image[1] != 'Z') {
+    return false;
+  }
+
+  const uint64_t pe = ReadUInt32(image + 0x3C);
+  if (pe + 24 > size || std::memcmp(image + pe, "PE\0\0", 4) != 0) {
+    return false;
+  }
+
+  const auto coff = image + pe + 4;
+  const uint32_t section_count = ReadUInt16(coff + 2);
+  const uint32_t optional_header_size = ReadUInt16(coff + 16);
+  const uint64_t optional_header_offset = pe + 24;
+
+  if (optional_header_offset + optional_header_size > size ||
+      optional_header_size < 2) {
+    return false;
+  }
+
+  // the data directories follow the fixed part of the optional header
+  const auto optional_header = image + optional_header_offset;
+  uint32_t directories_offset;
+  switch (ReadUInt16(optional_header)) {
+    case kPe32Magic:
+      directories_offset = 96;
+      break;
+    case kPe32PlusMagic:
+      directories_offset = 112;
+      break;
+    default:
+      return false;
+  }
+
+  if (directories_offset + (kCliHeaderDirectory + 1) * 8 >
+          optional_header_size ||
+      ReadUInt32(optional_header + directories_offset - 4) <=
+          kCliHeaderDirectory) {
+    return false;
+  }
+
+  const uint64_t sections_offset =
+      optional_header_offset + optional_header_size;
+  if (sections_offset + section_count * 40ull > size) {
+    return false;
+  }
+
+  // RvaToOffset finds the file offset of length bytes at rva, or returns 0
+  const auto rva_to_offset = [&](uint32_t rva, uint32_t length) -> uint64_t {
+    for (uint32_t i = 0; i < section_count; i++) {
+      const auto section = image + sections_offset + i * 40ull;
+      const uint32_t address = ReadUInt32(section + 12);
+      const uint32_t raw_size = ReadUInt32(section + 16);
+      const uint32_t raw_offset = ReadUInt32(section + 20);
+
+      if (rva >= address && static_cast<uint64_t>(rva) + length <=
+                                 static_cast<uint64_t>(address) + raw_size) {
+        const uint64_t offset = raw_offset + static_cast<uint64_t>(rva - address);
+        return offset + length <= size ? offset : 0;
+      }
+    }
+    return 0;
+  };
+
+  const auto cli_directory =
+      optional_header + directories_offset + kCliHeaderDirectory * 8;
+  const auto cli_header = rva_to_offset(ReadUInt32(cli_directory), 16);
+  if (cli_header == 0) {
+    return false;
+  }
+
+  const uint32_t metadata_rva = ReadUInt32(image + cli_header + 8);
+  const uint32_t metadata_size = ReadUInt32(image + cli_header + 12);
+  const auto metadata = rva_to_offset(metadata_rva, metadata_size);
+  if (metadata == 0) {
+    return false;
+  }
+
+  return ParseMetadata(image + metadata, metadata_size);
+}
+
+bool MetadataReader::ParseMetadata(const uint8_t* metadata, size_t size) {
+  if (size < 16 || ReadUInt32(metadata) != kMetadataSignature) {
+    return false;
+  }
+
+  // the version string is padded to 4 bytes
+  uint64_t offset = 16 + ((ReadUInt32(metadata + 12) + 3ull) & ~3ull);
+  if (offset + 4 > size) {
+    return false;
+  }
+
+  const uint32_t stream_count = ReadUInt16(metadata + offset + 2);
+  offset += 4;
+
+  const uint8_t* tables = nullptr;
+  uint32_t tables_size = 0;
+
+  for (uint32_t i = 0; i < stream_count; i++) {
+    if (offset + 8 > size) {
+      return false;
+    }
+
+    const uint32_t stream_offset = ReadUInt32(metadata + offset);
+    const uint32_t stream_size = ReadUInt32(metadata + offset + 4);
+    if (static_cast<uint64_t>(stream_offset) + stream_size > size) {
+      return false;
+    }
+
+    // names are at most 32 characters, null-terminated and padded to 4 bytes
+    const auto name = reinterpret_cast<const char*>(metadata + offset + 8);
+    size_t name_length = 0;
+    while (offset + 8 + name_length < size && name_length < 32 &&
+           name[name_length] != '\0') {
+      name_length++;
+    }
+    if (offset + 8 + name_length >= size || name[name_length] != '\0') {
+      return false;
+    }
+    offset += 8 + ((name_length + 4) & ~static_cast<size_t>(3));
+
+    const auto stream = metadata + stream_offset;
+    if (std::strcmp(name, "#~") == 0) {
+      tables = stream;
+      tables_size = stream_size;
+    } else if (std::strcmp(name, "#-") == 0) {
+      // edit-and-continue layout, with pointer tables
+      return false;
+    } else if (std::strcmp(name, "#Strings") == 0) {
+      // every string must end within the heap
+      if (stream_size > 0 && stream[stream_size - 1] != '\0') {
+        return false;
+      }
+      strings_ = stream;
+      strings_size_ = stream_size;
+    } else if (std::strcmp(name, "#Blob") == 0) {
+      blobs_ = stream;
+      blobs_size_ = stream_size;
+    } else if (std::strcmp(name, "#GUID") == 0) {
+      guids_ = stream;
+      guids_size_ = stream_size;
+    }
+  }
+
+  return tables != nullptr && ParseTables(tables, tables_size);
+}
+
+bool MetadataReader::ParseTables(const uint8_t* stream, size_t size) {
+  if (size < 24) {
+    return false;
+  }
+
+  const uint8_t heap_sizes = stream[6];
+  uint64_t valid = 0;
+  for (int i = 7; i >= 0; i--) {
+    valid = (valid << 8) | stream[8 + i];
+  }
+
+  if (valid >> kMetadataTableCount != 0) {
+    // tables this reader doesn't know the layout of
+    return false;
+  }
+
+  uint64_t offset = 24;
+  for (uint8_t table = 0; table < kMetadataTableCount; table++) {
+    if ((valid & (1ull << table)) == 0) {
+      continue;
+    }
+    if (offset + 4 > size) {
+      return false;
+    }
+    tables_[table].row_count = ReadUInt32(stream + offset);
+    offset += 4;
+  }
+
+  if (heap_sizes & kExtraData) {
+    offset += 4;
+  }
+
+  const uint8_t string_size = heap_sizes & kLargeStrings ? 4 : 2;
+  const uint8_t guid_size = heap_sizes & kLargeGuids ? 4 : 2;
+  const uint8_t blob_size = heap_sizes & kLargeBlobs ? 4 : 2;
+
+  for (uint8_t table = 0; table < kMetadataTableCount; table++) {
+    auto& t = tables_[table];
+    const auto schema = GetSchema(table);
+    uint32_t row_size = 0;
+
+    for (size_t c = 0; schema[c].type != kEndColumn; c++) {
+      uint8_t column_size = 2;
+
+      switch (schema[c].type) {
+        case kUInt32Column:
+          column_size = 4;
+          break;
+        case kStringColumn:
+          column_size = string_size;
+          break;
+        case kGuidColumn:
+          column_size = guid_size;
+          break;
+        case kBlobColumn:
+          column_size = blob_size;
+          break;
+        case kTableColumn:
+          column_size = tables_[schema[c].target].row_count < 0x10000 ? 2 : 4;
+          break;
+        case kCodedColumn: {
+          const auto& coded = kCodedIndexes[schema[c].target];
+          uint32_t max_rows = 0;
+          for (uint8_t i = 0; i < coded.table_count; i++) {
+            if (coded.tables[i] != kNoTable &&
+                tables_[coded.tables[i]].row_count > max_rows) {
+              max_rows = tables_[coded.tables[i]].row_count;
+            }
+          }
+          column_size = max_rows < (1u << (16 - coded.tag_bits)) ? 2 : 4;
+          break;
+        }
+        default:
+          break;
+      }
+
+      t.column_offsets[c] = static_cast<uint8_t>(row_size);
+      t.column_sizes[c] = column_size;
+      row_size += column_size;
+    }
+
+    t.row_size = row_size;
+    t.rows = stream + offset;
+    offset += static_cast<uint64_t>(t.row_count) * row_size;
+    if (offset > size) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+uint32_t MetadataReader::GetColumn(MetadataTable table, uint32_t row,
+                                   uint32_t column) const {
+  const auto& t = tables_[table];
+  if (row == 0 || row > t.row_count || column >= kMaxMetadataColumns ||
+      t.column_sizes[column] == 0) {
+    return 0;
+  }
+
+  const auto p = t.rows + static_cast<size_t>(row - 1) * t.row_size +
+                 t.column_offsets[column];
+  return t.column_sizes[column] == 2 ? ReadUInt16(p) : ReadUInt32(p);
+}
+
+uint32_t MetadataReader::GetToken(MetadataTable table, uint32_t row,
+                                  uint32_t column) const {
+  if (column >= kMaxMetadataColumns) {
+    return 0;
+  }
+
+  const auto& schema = GetSchema(table)[column];
+  const auto value = GetColumn(table, row, column);
+
+  if (schema.type == kTableColumn) {
+    return value == 0 ? 0 : (static_cast<uint32_t>(schema.target) << 24) | value;
+  }
+
+  if (schema.type != kCodedColumn) {
+    return 0;
+  }
+
+  const auto& coded = kCodedIndexes[schema.target];
+  const auto tag = value & ((1u << coded.tag_bits) - 1);
+  const auto rid = value >> coded.tag_bits;
+
+  if (rid == 0 || tag >= coded.table_count || coded.tables[tag] == kNoTable) {
+    return 0;
+  }
+
+  return (static_cast<uint32_t>(coded.tables[tag]) << 24) | rid;
+}
+
+const char* MetadataReader::GetString(uint32_t index) const {
+  if (index >= strings_size_) {
+    return "";
+  }
+  return reinterpret_cast<const char*>(strings_ + index);
+}
+
+bool MetadataReader::GetBlob(uint32_t index, const uint8_t** data,
+                             uint32_t* length) const {
+  *data = nullptr;
+  *length = 0;
+
+  if (index >= blobs_size_) {
+    return false;
+  }
+
+  uint32_t blob_length;
+  const auto header = ReadCompressedUInt32(blobs_ + index, blobs_size_ - index,
+                                           &blob_length);
+  if (header == 0 ||
+      static_cast<uint64_t>(index) + header + blob_length > blobs_size_) {
+    return false;
+  }
+
+  *data = blobs_ + index + header;
+  *length = blob_length;
+  return true;
+}
+
+const uint8_t* MetadataReader::GetGuid(uint32_t index) const {
+  if (index == 0 || static_cast<uint64_t>(index) * 16 > guids_size_) {
+    return nullptr;
+  }
+  return guids_ + (index - 1) * 16;
+}
+
+bool MetadataReader::GetAssembly(MetadataAssembly* assembly) const {
+  if (RowCount(kAssemblyTable) == 0) {
+    return false;
+  }
+
+  assembly->major = static_cast<uint16_t>(GetColumn(kAssemblyTable, 1, 1));
+  assembly->minor = static_cast<uint16_t>(GetColumn(kAssemblyTable, 1, 2));
+  assembly->build = static_cast<uint16_t>(GetColumn(kAssemblyTable, 1, 3));
+  assembly->revision = static_cast<uint16_t>(GetColumn(kAssemblyTable, 1, 4));
+  assembly->name = GetString(GetColumn(kAssemblyTable, 1, 7));
+  return true;
+}
+
+MetadataAssembly MetadataReader::GetAssemblyRef(uint32_t row) const {
+  MetadataAssembly assembly;
+  assembly.major = static_cast<uint16_t>(GetColumn(kAssemblyRefTable, row, 0));
+  assembly.minor = static_cast<uint16_t>(GetColumn(kAssemblyRefTable, row, 1));
+  assembly.build = static_cast<uint16_t>(GetColumn(kAssemblyRefTable, row, 2));
+  assembly.revision =
+      static_cast<uint16_t>(GetColumn(kAssemblyRefTable, row, 3));
+  assembly.name = GetString(GetColumn(kAssemblyRefTable, row, 6));
+  return assembly;
+}
+
+bool MetadataReader::GetTypeName(uint32_t token, std::string* name) const {
+  const auto table = static_cast<uint8_t>(token >> 24);
+  const auto row = token & 0x00FFFFFF;
+
+  if (table == kTypeDefTable || table == kTypeRefTable) {
+    const auto t = static_cast<MetadataTable>(table);
+    const auto name_column =
+        table == kTypeDefTable ? column::kTypeDefName : column::kTypeRefName;
+    const auto namespace_column = table == kTypeDefTable
+                                      ? column::kTypeDefNamespace
+                                      : column::kTypeRefNamespace;
+    if (row == 0 || row > RowCount(t)) {
+      return false;
+    }
+
+    const char* type_namespace = GetString(GetColumn(t, row, namespace_column));
+    name->assign(type_namespace);
+    if (!name->empty()) {
+      name->push_back('.');
+    }
+    name->append(GetString(GetColumn(t, row, name_column)));
+    return true;
+  }
+
+  if (table != kTypeSpecTable) {
+    return false;
+  }
+
+  // GENERICINST (CLASS | VALUETYPE) TypeDefOrRefEncoded ...
+  const uint8_t* signature;
+  uint32_t length;
+  if (!GetBlob(GetColumn(kTypeSpecTable, row, column::kTypeSpecSignature),
+               &signature, &length) ||
+      length < 3 || signature[0] != kElementTypeGenericInst ||
+      (signature[1] != kElementTypeClass &&
+       signature[1] != kElementTypeValueType)) {
+    return false;
+  }
+
+  uint32_t encoded;
+  if (ReadCompressedUInt32(signature + 2, length - 2, &encoded) == 0) {
+    return false;
+  }
+
+  const auto tag = encoded & 3;
+  if (tag > 1) {
+    return false;
+  }
+
+  const uint32_t generic_type =
+      (static_cast<uint32_t>(tag == 0 ? kTypeDefTable : kTypeRefTable) << 24) |
+      (encoded >> 2);
+  return GetTypeName(generic_type, name);
+}
+
+uint32_t MetadataReader::GetMethodDefParent(uint32_t row) const {
+  if (row == 0 || row > RowCount(kMethodDefTable)) {
+    return 0;
+  }
+
+  // method lists are sorted: find the last type whose list starts at or
+  // before row
+  uint32_t low = 1;
+  uint32_t high = RowCount(kTypeDefTable);
+  uint32_t parent = 0;
+
+  while (low <= high) {
+    const auto middle = low + (high - low) / 2;
+    if (GetColumn(kTypeDefTable, middle, column::kTypeDefMethodList) <= row) {
+      parent = middle;
+      low = middle + 1;
+    } else {
+      high = middle - 1;
+    }
+  }
+
+  return parent == 0 ? 0 : (static_cast<uint32_t>(kTypeDefTable) << 24) | parent;
+}
+
+}  // namespace trace
@@ -0,0 +1,220 @@
+#ifndef DD_CLR_PROFILER_METADATA_READER_H_
+#define DD_CLR_PROFILER_METADATA_READER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "string.h"  // NOLINT
+
+namespace trace {
+
+// Metadata tables, ECMA-335 II.22. The table id is also the high byte of the
+// tokens of its rows.
+enum MetadataTable : uint8_t {
+  kModuleTable = 0x00,
+  kTypeRefTable = 0x01,
+  kTypeDefTable = 0x02,
+  kFieldPtrTable = 0x03,
+  kFieldTable = 0x04,
+  kMethodPtrTable = 0x05,
+  kMethodDefTable = 0x06,
+  kParamPtrTable = 0x07,
+  kParamTable = 0x08,
+  kInterfaceImplTable = 0x09,
+  kMemberRefTable = 0x0A,
+  kConstantTable = 0x0B,
+  kCustomAttributeTable = 0x0C,
+  kFieldMarshalTable = 0x0D,
+  kDeclSecurityTable = 0x0E,
+  kClassLayoutTable = 0x0F,
+  kFieldLayoutTable = 0x10,
+  kStandAloneSigTable = 0x11,
+  kEventMapTable = 0x12,
+  kEventPtrTable = 0x13,
+  kEventTable = 0x14,
+  kPropertyMapTable = 0x15,
+  kPropertyPtrTable = 0x16,
+  kPropertyTable = 0x17,
+  kMethodSemanticsTable = 0x18,
+  kMethodImplTable = 0x19,
+  kModuleRefTable = 0x1A,
+  kTypeSpecTable = 0x1B,
+  kImplMapTable = 0x1C,
+  kFieldRvaTable = 0x1D,
+  kEncLogTable = 0x1E,
+  kEncMapTable = 0x1F,
+  kAssemblyTable = 0x20,
+  kAssemblyProcessorTable = 0x21,
+  kAssemblyOsTable = 0x22,
+  kAssemblyRefTable = 0x23,
+  kAssemblyRefProcessorTable = 0x24,
+  kAssemblyRefOsTable = 0x25,
+  kFileTable = 0x26,
+  kExportedTypeTable = 0x27,
+  kManifestResourceTable = 0x28,
+  kNestedClassTable = 0x29,
+  kGenericParamTable = 0x2A,
+  kMethodSpecTable = 0x2B,
+  kGenericParamConstraintTable = 0x2C,
+};
+
+const size_t kMetadataTableCount = 0x2D;
+
+// Maximum number of columns of a metadata table (Assembly and AssemblyRef).
+const size_t kMaxMetadataColumns = 9;
+
+// Column indexes of the tables read by the profiler, in ECMA-335 order.
+namespace column {
+const uint32_t kTypeRefResolutionScope = 0;
+const uint32_t kTypeRefName = 1;
+const uint32_t kTypeRefNamespace = 2;
+
+const uint32_t kTypeDefFlags = 0;
+const uint32_t kTypeDefName = 1;
+const uint32_t kTypeDefNamespace = 2;
+const uint32_t kTypeDefExtends = 3;
+const uint32_t kTypeDefFieldList = 4;
+const uint32_t kTypeDefMethodList = 5;
+
+const uint32_t kMethodDefRva = 0;
+const uint32_t kMethodDefImplFlags = 1;
+const uint32_t kMethodDefFlags = 2;
+const uint32_t kMethodDefName = 3;
+const uint32_t kMethodDefSignature = 4;
+
+const uint32_t kMemberRefClass = 0;
+const uint32_t kMemberRefName = 1;
+const uint32_t kMemberRefSignature = 2;
+
+const uint32_t kTypeSpecSignature = 0;
+
+const uint32_t kMethodSpecMethod = 0;
+const uint32_t kMethodSpecInstantiation = 1;
+
+const uint32_t kModuleMvid = 2;
+}  // namespace column
+
+// MetadataAssembly is a row of the Assembly or AssemblyRef table.
+struct MetadataAssembly {
+  std::string name;
+  uint16_t major = 0;
+  uint16_t minor = 0;
+  uint16_t build = 0;
+  uint16_t revision = 0;
+};
+
+// MappedFile maps a whole file read-only into memory.
+class MappedFile {
+ private:
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+#ifdef _WIN32
+  void* file_ = nullptr;
+  void* mapping_ = nullptr;
+#endif
+
+ public:
+  MappedFile() = default;
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile();
+
+  // Open returns false if the file can't be mapped. Empty files can't.
+  bool Open(const WSTRING& path);
+  void Close();
+
+  const uint8_t* Data() const { return data_; }
+  size_t Size() const { return size_; }
+};
+
+// MetadataReader parses the CLI metadata of a PE file directly: the #~ table
+// stream and the #Strings, #Blob and #GUID heaps. It reads the file layout of
+// the image, as found on disk, through a read-only mapping, so looking up
+// names and scanning tables is plain memory access rather than
+// IMetaDataImport calls.
+//
+// Every offset is checked against the image: malformed images make Open
+// fail and out-of-range indexes read as zero or empty. Edit-and-continue
+// images, with a #- table stream, are not supported; use IMetaDataImport for
+// those and for dynamic or in-memory modules.
+class MetadataReader {
+ private:
+  struct Table {
+    const uint8_t* rows = nullptr;
+    uint32_t row_count = 0;
+    uint32_t row_size = 0;
+    uint8_t column_offsets[kMaxMetadataColumns]{};
+    uint8_t column_sizes[kMaxMetadataColumns]{};
+  };
+
+  MappedFile file_;
+
+  const uint8_t* strings_ = nullptr;
+  uint32_t strings_size_ = 0;
+  const uint8_t* blobs_ = nullptr;
+  uint32_t blobs_size_ = 0;
+  const uint8_t* guids_ = nullptr;
+  uint32_t guids_size_ = 0;
+
+  Table tables_[kMetadataTableCount];
+
+  bool ParseMetadata(const uint8_t* metadata, size_t size);
+  bool ParseTables(const uint8_t* stream, size_t size);
+
+ public:
+  MetadataReader() = default;
+  MetadataReader(const MetadataReader&) = delete;
+  MetadataReader& operator=(const MetadataReader&) = delete;
+
+  // Open maps the file and parses its metadata. Returns false if the file
+  // can't be read or isn't a supported .NET image.
+  bool Open(const WSTRING& path);
+
+  // OpenImage parses an image already in memory, in file layout. The memory
+  // must outlive the reader.
+  bool OpenImage(const uint8_t* image, size_t size);
+
+  uint32_t RowCount(MetadataTable table) const {
+    return tables_[table].row_count;
+  }
+
+  // GetColumn returns the raw value of a column: a constant, a heap index, a
+  // row number or a coded index. Rows are numbered from 1.
+  uint32_t GetColumn(MetadataTable table, uint32_t row, uint32_t column) const;
+
+  // GetToken decodes a column holding a simple or coded index into a token.
+  // Returns 0 for null references.
+  uint32_t GetToken(MetadataTable table, uint32_t row, uint32_t column) const;
+
+  // GetString returns the UTF-8 string at index in the #Strings heap, or ""
+  // if index is out of range.
+  const char* GetString(uint32_t index) const;
+
+  // GetBlob finds the blob at index in the #Blob heap. Returns false, and an
+  // empty blob, if index or the blob's length is out of range.
+  bool GetBlob(uint32_t index, const uint8_t** data, uint32_t* length) const;
+
+  // GetGuid returns the 16 bytes of the GUID at index (from 1) in the #GUID
+  // heap, or nullptr.
+  const uint8_t* GetGuid(uint32_t index) const;
+
+  // GetAssembly reads the Assembly row. Returns false for modules that are
+  // not the manifest module of an assembly.
+  bool GetAssembly(MetadataAssembly* assembly) const;
+
+  MetadataAssembly GetAssemblyRef(uint32_t row) const;
+
+  // GetTypeName returns the name of a TypeDef or TypeRef as Namespace.Name,
+  // like IMetaDataImport, and for TypeSpecs that instantiate a generic type,
+  // the name of that type. Returns false for other tokens.
+  bool GetTypeName(uint32_t token, std::string* name) const;
+
+  // GetMethodDefParent returns the TypeDef token that owns a MethodDef row,
+  // or 0, with a binary search of the TypeDef method lists.
+  uint32_t GetMethodDefParent(uint32_t row) const;
+};
+
+}  // namespace trace
+
+#endif  // DD_CLR_PROFILER_METADATA_READER_H_
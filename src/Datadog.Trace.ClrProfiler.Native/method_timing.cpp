@@ -0,0 +1,356 @@
+#include "method_timing.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <utility>
+
+#include "clock.h"
+#include "logging.h"
+#include "symbol_cache.h"
+#include "util.h"
+
+namespace trace {
+
+namespace {
+
+// The hooks are process-wide and receive no context besides the value
+// returned by the function mapper.
+MethodTiming* timing_instance = nullptr;
+
+struct ThreadBufferHolder {
+  std::shared_ptr<MethodTiming::ThreadBuffer> buffer;
+
+  ~ThreadBufferHolder() {
+    if (buffer) {
+      buffer->retired.store(true, std::memory_order_release);
+    }
+  }
+};
+
+thread_local ThreadBufferHolder thread_buffer;
+
+// the function mapper returns method_index + 1 as the client id
+uint32_t MethodIndex(FunctionIDOrClientID id) {
+  return static_cast<uint32_t>(id.clientID - 1);
+}
+
+void STDMETHODCALLTYPE OnMethodEnter(FunctionIDOrClientID id,
+                                     COR_PRF_ELT_INFO elt_info) {
+  auto buffer = thread_buffer.buffer.get();
+  if (buffer == nullptr) {
+    if (timing_instance == nullptr) {
+      return;
+    }
+    buffer = timing_instance->RegisterThread();
+  }
+
+  if (buffer->depth >= kMaxTimedDepth) {
+    buffer->untracked_depth++;
+    return;
+  }
+
+  auto& frame = buffer->frames[buffer->depth++];
+  frame.method_index = MethodIndex(id);
+  frame.start_ns = MonotonicNanoseconds();
+}
+
+void STDMETHODCALLTYPE OnMethodLeave(FunctionIDOrClientID id,
+                                     COR_PRF_ELT_INFO elt_info) {
+  const auto now = MonotonicNanoseconds();
+
+  auto buffer = thread_buffer.buffer.get();
+  if (buffer == nullptr) {
+    return;
+  }
+
+  if (buffer->untracked_depth > 0) {
+    buffer->untracked_depth--;
+    return;
+  }
+
+  // frames unwound by an exception get no leave callback, drop them until
+  // the frame of the returning method
+  const auto method_index = MethodIndex(id);
+  auto depth = buffer->depth;
+  while (depth > 0 && buffer->frames[depth - 1].method_index != method_index) {
+    depth--;
+  }
+
+  if (depth == 0) {
+    return;
+  }
+
+  buffer->depth = depth - 1;
+
+  const auto head = buffer->head.load(std::memory_order_relaxed);
+  if (head - buffer->tail.load(std::memory_order_acquire) >=
+      kMethodTimingBufferCapacity) {
+    buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  auto& call = buffer->calls[head & (kMethodTimingBufferCapacity - 1)];
+  call.method_index = method_index;
+  call.duration_ns = now - buffer->frames[depth - 1].start_ns;
+  buffer->head.store(head + 1, std::memory_order_release);
+}
+
+void STDMETHODCALLTYPE OnMethodTailcall(FunctionIDOrClientID id,
+                                        COR_PRF_ELT_INFO elt_info) {
+  // the caller's frame is replaced, time it as if it returned here
+  OnMethodLeave(id, elt_info);
+}
+
+}  // namespace
+
+void MethodPatternList::Add(const WSTRING& pattern) {
+  const auto trimmed = Trim(pattern);
+  if (trimmed.find_first_not_of(" \t"_W) == WSTRING::npos) {
+    return;
+  }
+
+  if (trimmed.find('!'_W) != WSTRING::npos) {
+    qualified_.push_back(trimmed);
+  } else {
+    unqualified_.push_back(trimmed);
+  }
+}
+
+bool MethodPatternList::AddFromFile(const WSTRING& file_path) {
+  std::ifstream stream;
+  stream.open(ToString(file_path));
+
+  if (!stream.is_open()) {
+    return false;
+  }
+
+  std::string line;
+  while (std::getline(stream, line)) {
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+
+    if (!line.empty() && line[0] == '#') {
+      continue;
+    }
+    Add(ToWSTRING(line));
+  }
+
+  return true;
+}
+
+bool MethodPatternList::Matches(const WSTRING& name) const {
+  for (const auto& pattern : qualified_) {
+    if (WildcardMatch(pattern, name)) {
+      return true;
+    }
+  }
+
+  if (unqualified_.empty()) {
+    return false;
+  }
+
+  const auto separator = name.find('!'_W);
+  const auto method_name =
+      separator == WSTRING::npos ? name : name.substr(separator + 1);
+
+  for (const auto& pattern : unqualified_) {
+    if (WildcardMatch(pattern, method_name)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+MethodTiming::~MethodTiming() { Stop(); }
+
+HRESULT MethodTiming::Initialize(ICorProfilerInfo3* info, SymbolCache* symbols,
+                                 MethodPatternList patterns) {
+#if defined(_WIN64) || defined(BIT64)
+  if (timing_instance != nullptr) {
+    return E_FAIL;
+  }
+
+  info_ = info;
+  symbols_ = symbols;
+  patterns_ = std::move(patterns);
+  timing_instance = this;
+
+  auto hr = info->SetFunctionIDMapper2(MapFunction, this);
+  if (FAILED(hr)) {
+    Warn("MethodTiming: unable to set the function mapper.");
+    info_ = nullptr;
+    return hr;
+  }
+
+  hr = info->SetEnterLeaveFunctionHooks3WithInfo(
+      OnMethodEnter, OnMethodLeave, OnMethodTailcall);
+  if (FAILED(hr)) {
+    Warn("MethodTiming: unable to set the enter/leave hooks.");
+    info_ = nullptr;
+    return hr;
+  }
+
+  aggregator_ = std::thread(&MethodTiming::AggregateLoop, this);
+
+  Info("Method timing enabled for ", patterns_.Size(), " method patterns.");
+  return S_OK;
+#else
+  // on 32-bit the hooks must be naked functions that preserve all registers
+  Warn("Method timing is only supported in 64-bit processes.");
+  return E_NOTIMPL;
+#endif
+}
+
+void MethodTiming::Stop() {
+  {
+    std::lock_guard<std::mutex> guard(stop_lock_);
+    stop_requested_ = true;
+  }
+  stop_signal_.notify_all();
+
+  if (aggregator_.joinable()) {
+    aggregator_.join();
+  }
+}
+
+UINT_PTR STDMETHODCALLTYPE MethodTiming::MapFunction(FunctionID function_id,
+                                                     void* client_data,
+                                                     BOOL* hook_function) {
+  auto timing = static_cast<MethodTiming*>(client_data);
+  *hook_function = FALSE;
+
+  const auto symbol = timing->symbols_->GetOrResolve(function_id);
+  if (symbol == nullptr || symbol->name == nullptr ||
+      !timing->patterns_.Matches(*symbol->name)) {
+    return function_id;
+  }
+
+  std::lock_guard<std::mutex> guard(timing->methods_lock_);
+
+  const auto index = timing->method_count_.load(std::memory_order_relaxed);
+  if (index >= kMaxTimedMethods) {
+    if (!timing->methods_full_logged_) {
+      timing->methods_full_logged_ = true;
+      Warn("MethodTiming: more than ", kMaxTimedMethods,
+           " methods match, the others are not timed.");
+    }
+    return function_id;
+  }
+
+  timing->methods_[index] = function_id;
+  timing->method_count_.store(index + 1, std::memory_order_release);
+
+  Info("MethodTiming: timing ", *symbol->name);
+
+  *hook_function = TRUE;
+  return static_cast<UINT_PTR>(index) + 1;
+}
+
+MethodTiming::ThreadBuffer* MethodTiming::RegisterThread() {
+  thread_buffer.buffer = std::make_shared<ThreadBuffer>();
+
+  std::lock_guard<std::mutex> guard(buffers_lock_);
+  buffers_.push_back(thread_buffer.buffer);
+  return thread_buffer.buffer.get();
+}
+
+void MethodTiming::AggregateLoop() {
+  std::unique_lock<std::mutex> lock(stop_lock_);
+
+  while (!stop_requested_) {
+    stop_signal_.wait_for(
+        lock, std::chrono::milliseconds(kMethodTimingAggregationInterval),
+        [this] { return stop_requested_; });
+
+    lock.unlock();
+    Aggregate();
+    lock.lock();
+  }
+}
+
+void MethodTiming::Aggregate() {
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+  {
+    std::lock_guard<std::mutex> guard(buffers_lock_);
+    buffers = buffers_;
+  }
+
+  // also makes this the only consumer of the buffers
+  std::lock_guard<std::mutex> guard(histograms_lock_);
+
+  bool any_retired = false;
+  for (const auto& buffer : buffers) {
+    any_retired |= buffer->retired.load(std::memory_order_acquire);
+
+    const auto head = buffer->head.load(std::memory_order_acquire);
+    auto tail = buffer->tail.load(std::memory_order_relaxed);
+
+    for (; tail != head; tail++) {
+      const auto& call = buffer->calls[tail & (kMethodTimingBufferCapacity - 1)];
+      if (call.method_index >= histograms_.size()) {
+        histograms_.resize(call.method_index + 1);
+      }
+      histograms_[call.method_index].Record(call.duration_ns);
+    }
+
+    buffer->tail.store(tail, std::memory_order_release);
+    dropped_calls_ += buffer->dropped.exchange(0, std::memory_order_relaxed);
+  }
+
+  if (any_retired) {
+    // threads that exited never write to their buffer again
+    std::lock_guard<std::mutex> buffers_guard(buffers_lock_);
+    buffers_.erase(
+        std::remove_if(buffers_.begin(), buffers_.end(),
+                       [](const std::shared_ptr<ThreadBuffer>& buffer) {
+                         return buffer->retired.load(
+                                    std::memory_order_acquire) &&
+                                buffer->head.load(std::memory_order_acquire) ==
+                                    buffer->tail.load(
+                                        std::memory_order_relaxed);
+                       }),
+        buffers_.end());
+  }
+}
+
+size_t MethodTiming::Snapshot(MethodLatency* latencies, size_t max_latencies) {
+  if (!IsEnabled()) {
+    return 0;
+  }
+
+  Aggregate();
+
+  std::lock_guard<std::mutex> guard(histograms_lock_);
+
+  size_t written = 0;
+  for (size_t i = 0; i < histograms_.size() && written < max_latencies; i++) {
+    const auto& histogram = histograms_[i];
+    if (histogram.count == 0) {
+      continue;
+    }
+
+    auto& latency = latencies[written++];
+    latency.function_id = methods_[i];
+    latency.count = histogram.count;
+    latency.total_ns = histogram.total;
+    latency.min_ns = histogram.min;
+    latency.max_ns = histogram.max;
+    latency.p50_ns = histogram.Percentile(50);
+    latency.p90_ns = histogram.Percentile(90);
+    latency.p99_ns = histogram.Percentile(99);
+    std::copy(histogram.buckets, histogram.buckets + kLatencyBucketCount,
+              latency.buckets);
+  }
+
+  return written;
+}
+
+uint64_t MethodTiming::DroppedCalls() {
+  std::lock_guard<std::mutex> guard(histograms_lock_);
+  return dropped_calls_;
+}
+
+}  // namespace trace
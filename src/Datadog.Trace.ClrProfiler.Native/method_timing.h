@@ -0,0 +1,176 @@
+#ifndef DD_CLR_PROFILER_METHOD_TIMING_H_
+#define DD_CLR_PROFILER_METHOD_TIMING_H_
+
+#include <corhlpr.h>
+#include <corprof.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "latency_histogram.h"
+#include "string.h"
+
+namespace trace {
+
+class SymbolCache;
+
+// Maximum number of distinct methods that can be timed.
+const size_t kMaxTimedMethods = 1024;
+
+// Nesting depth of timed methods tracked per thread. Deeper calls (usually
+// recursion) are not timed.
+const uint32_t kMaxTimedDepth = 256;
+
+// Number of completed calls buffered per thread between two aggregations.
+// Must be a power of two. Calls are dropped (and counted) when it is full.
+const size_t kMethodTimingBufferCapacity = 4096;
+
+// Time between two aggregations of the per-thread buffers, in milliseconds.
+const uint64_t kMethodTimingAggregationInterval = 100;
+
+// MethodLatency is the latency histogram of one timed method, handed to
+// managed code by GetMethodLatencies in interop.cpp. Bucket i holds calls
+// whose duration is at least LatencyBucketLowerBound(i) nanoseconds. It is
+// blittable: keep its layout in sync with the managed definition.
+struct MethodLatency {
+  uint64_t function_id;
+  uint64_t count;
+  uint64_t total_ns;
+  uint64_t min_ns;
+  uint64_t max_ns;
+  uint64_t p50_ns;
+  uint64_t p90_ns;
+  uint64_t p99_ns;
+  uint64_t buckets[kLatencyBucketCount];
+};
+
+// MethodPattern selects the methods to time. Patterns have the form
+// [Assembly!]Namespace.Type.Method and accept '*' and '?' wildcards, e.g.
+// "MyApp.Controllers.*Controller.Get*" or "System.Net.Http!*.SendAsync".
+// Without an assembly part, methods from any assembly match.
+class MethodPatternList {
+ private:
+  std::vector<WSTRING> qualified_;
+  std::vector<WSTRING> unqualified_;
+
+ public:
+  void Add(const WSTRING& pattern);
+
+  // AddFromFile adds one pattern per non-empty line of the file. Lines
+  // starting with '#' are comments. Returns false if the file can't be read.
+  bool AddFromFile(const WSTRING& file_path);
+
+  bool IsEmpty() const { return qualified_.empty() && unqualified_.empty(); }
+
+  size_t Size() const { return qualified_.size() + unqualified_.size(); }
+
+  // Matches returns true if name, formatted as Assembly!Type.Method, matches
+  // any pattern.
+  bool Matches(const WSTRING& name) const;
+};
+
+// MethodTiming times the methods selected by a MethodPatternList using the
+// enter/leave hooks.
+//
+// The FunctionIDMapper2 callback runs once per method when it is JIT
+// compiled and enables the hooks only for matching methods, so the JIT does
+// not emit hook calls anywhere else. The hooks push and pop a per-thread
+// shadow stack and write completed calls into a per-thread single-producer
+// buffer; an aggregator thread drains the buffers into per-method latency
+// histograms, so the hooks themselves never lock or allocate.
+//
+// Only one instance can install the hooks, since they are process-wide.
+class MethodTiming {
+ public:
+  struct CompletedCall {
+    uint32_t method_index;
+    uint64_t duration_ns;
+  };
+
+  struct ThreadBuffer {
+    struct Frame {
+      uint32_t method_index;
+      uint64_t start_ns;
+    };
+
+    // owned by the hooked thread
+    Frame frames[kMaxTimedDepth];
+    uint32_t depth = 0;
+    uint32_t untracked_depth = 0;
+
+    // single-producer single-consumer ring, written by the hooked thread and
+    // read by the aggregator
+    CompletedCall calls[kMethodTimingBufferCapacity];
+    std::atomic<uint64_t> head{0};
+    std::atomic<uint64_t> tail{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<bool> retired{false};
+  };
+
+ private:
+  ICorProfilerInfo3* info_ = nullptr;
+  SymbolCache* symbols_ = nullptr;
+  MethodPatternList patterns_;
+
+  // method_index -> FunctionID, append-only
+  std::mutex methods_lock_;
+  FunctionID methods_[kMaxTimedMethods]{};
+  std::atomic<uint32_t> method_count_{0};
+  bool methods_full_logged_ = false;
+
+  std::mutex buffers_lock_;
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers_;
+
+  std::mutex histograms_lock_;
+  std::vector<LatencyHistogram> histograms_;
+  uint64_t dropped_calls_ = 0;
+
+  std::thread aggregator_;
+  std::mutex stop_lock_;
+  std::condition_variable stop_signal_;
+  bool stop_requested_ = false;
+
+  void Aggregate();
+  void AggregateLoop();
+
+  static UINT_PTR STDMETHODCALLTYPE MapFunction(FunctionID function_id,
+                                                void* client_data,
+                                                BOOL* hook_function);
+
+ public:
+  MethodTiming() = default;
+  MethodTiming(const MethodTiming&) = delete;
+  MethodTiming& operator=(const MethodTiming&) = delete;
+  ~MethodTiming();
+
+  // Initialize installs the function mapper and the enter/leave hooks, and
+  // starts the aggregator. It must be called from ICorProfilerCallback::
+  // Initialize, with COR_PRF_MONITOR_ENTERLEAVE in the event mask.
+  HRESULT Initialize(ICorProfilerInfo3* info, SymbolCache* symbols,
+                     MethodPatternList patterns);
+
+  // Stop signals the aggregator thread and waits for it to exit.
+  void Stop();
+
+  bool IsEnabled() const { return info_ != nullptr; }
+
+  // Snapshot aggregates pending calls and copies up to max_latencies method
+  // histograms into latencies. Returns how many were written.
+  size_t Snapshot(MethodLatency* latencies, size_t max_latencies);
+
+  // DroppedCalls returns how many calls were not timed because a thread's
+  // buffer was full.
+  uint64_t DroppedCalls();
+
+  // RegisterThread returns the calling thread's buffer, creating it on the
+  // thread's first timed call. Used by the hooks.
+  ThreadBuffer* RegisterThread();
+};
+
+}  // namespace trace
+
+#endif  // DD_CLR_PROFILER_METHOD_TIMING_H_
@@ -0,0 +1,74 @@
+#include "module_metadata.h"
+
+namespace trace {
+
+size_t ModuleMetadata::MemoryUsage() const {
+  size_t bytes = sizeof(*this) + HeapBytes(assemblyName) +
+                 HashTableBytes(wrapper_refs) +
+                 HashTableBytes(wrapper_parent_type) +
+                 HashTableBytes(failed_wrapper_keys) +
+                 HeapBytes(integrations) +
+                 HeapBytes(rule_selection.targets) +
+                 HeapBytes(rule_selection.enabled) +
+                 HashTableBytes(call_target_tokens);
+
+  for (const auto& ref : wrapper_refs) {
+    bytes += HeapBytes(ref.first);
+  }
+  for (const auto& ref : wrapper_parent_type) {
+    bytes += HeapBytes(ref.first);
+  }
+  for (const auto& key : failed_wrapper_keys) {
+    bytes += HeapBytes(key);
+  }
+  for (const auto& integration : integrations) {
+    bytes += HeapBytes(integration);
+  }
+  return bytes;
+}
+
+bool ModuleMetadata::Compact() {
+  if (compacted) {
+    return false;
+  }
+
+  metadata_import.Reset();
+  metadata_emit.Reset();
+  assembly_import.Reset();
+  assembly_emit.Reset();
+
+  // the integrations are only read when there are no compiled rules
+  if (rules != nullptr) {
+    std::vector<IntegrationMethod>().swap(integrations);
+  }
+
+  compacted = true;
+  return true;
+}
+
+HRESULT ModuleMetadata::Reacquire(ICorProfilerInfo* info, ModuleID module_id) {
+  if (!compacted) {
+    return S_OK;
+  }
+
+  ComPtr<IUnknown> metadata_interfaces;
+  const auto hr = info->GetModuleMetaData(module_id, ofRead | ofWrite,
+                                          IID_IMetaDataImport2,
+                                          metadata_interfaces.GetAddressOf());
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  metadata_import =
+      metadata_interfaces.As<IMetaDataImport2>(IID_IMetaDataImport);
+  metadata_emit = metadata_interfaces.As<IMetaDataEmit2>(IID_IMetaDataEmit);
+  assembly_import = metadata_interfaces.As<IMetaDataAssemblyImport>(
+      IID_IMetaDataAssemblyImport);
+  assembly_emit =
+      metadata_interfaces.As<IMetaDataAssemblyEmit>(IID_IMetaDataAssemblyEmit);
+
+  compacted = false;
+  return S_OK;
+}
+
+}  // namespace trace
@@ -2,16 +2,54 @@
 #define DD_CLR_PROFILER_MODULE_METADATA_H_
 
 #include <corhlpr.h>
+#include <corprof.h>
+#include <cstdint>
+#include <memory>
 #include <unordered_map>
 #include <unordered_set>
 
 #include "clr_helpers.h"
 #include "com_ptr.h"
 #include "integration.h"
+#include "integration_rules.h"
 #include "string.h"
 
 namespace trace {
 
+// ModuleMemoryUsage is the memory the profiler owns for one module, handed
+// to managed code by GetModuleMemory in interop.cpp. It is blittable: keep
+// its layout in sync with the managed definition.
+struct ModuleMemoryUsage {
+  uint64_t module_id;
+  uint64_t app_domain_id;
+  uint64_t bytes;
+  // time since the last JIT compilation of one of the module's methods
+  uint64_t idle_ms;
+  // 1 if the module was compacted since
+  uint64_t compacted;
+};
+
+// ModuleMemoryStats totals the memory the profiler owns for modules. It is
+// blittable: keep its layout in sync with the managed definition.
+struct ModuleMemoryStats {
+  uint64_t module_count;
+  uint64_t compacted_module_count;
+  // sum of ModuleMemoryUsage::bytes
+  uint64_t module_bytes;
+  // the integration rules, shared by every module
+  uint64_t shared_bytes;
+  // running totals since the profiler attached
+  uint64_t compactions;
+  uint64_t reacquisitions;
+};
+
+// ModuleMetadata is what the profiler keeps about a loaded module to rewrite
+// its methods.
+//
+// A module without JIT compilations for a while can be compacted: its
+// metadata interfaces and its copy of the integrations are released, leaving
+// the MVID, the selected rules, the call target tokens and the wrapper
+// tokens. The interfaces are reacquired on its next JIT compilation.
 class ModuleMetadata {
  private:
   std::unordered_map<WSTRING, mdMemberRef> wrapper_refs{};
@@ -19,14 +57,26 @@ class ModuleMetadata {
   std::unordered_set<WSTRING> failed_wrapper_keys{};
 
  public:
-  const ComPtr<IMetaDataImport2> metadata_import{};
-  const ComPtr<IMetaDataEmit2> metadata_emit{};
-  const ComPtr<IMetaDataAssemblyImport> assembly_import{};
-  const ComPtr<IMetaDataAssemblyEmit> assembly_emit{};
+  // null while the module is compacted
+  ComPtr<IMetaDataImport2> metadata_import{};
+  ComPtr<IMetaDataEmit2> metadata_emit{};
+  ComPtr<IMetaDataAssemblyImport> assembly_import{};
+  ComPtr<IMetaDataAssemblyEmit> assembly_emit{};
   WSTRING assemblyName = ""_W;
   AppDomainID app_domain_id;
   GUID module_version_id;
   std::vector<IntegrationMethod> integrations = {};
+  // the compiled rules, shared by every module, and the ones enabled here
+  std::shared_ptr<const IntegrationRuleSet> rules{};
+  IntegrationRuleSet::Selection rule_selection{};
+  // when the module's metadata could be read from its file: every token that
+  // may refer to the target of a method replacement. Calls to other tokens
+  // are skipped without looking them up.
+  std::unordered_set<mdToken> call_target_tokens{};
+  bool has_call_target_tokens = false;
+  // MonotonicNanoseconds of the last JIT compilation in the module
+  uint64_t last_used_ns = 0;
+  bool compacted = false;
 
   ModuleMetadata(ComPtr<IMetaDataImport2> metadata_import,
                  ComPtr<IMetaDataEmit2> metadata_emit,
@@ -45,6 +95,17 @@ class ModuleMetadata {
         module_version_id(module_version_id),
         integrations(integrations) {}
 
+  // MemoryUsage estimates the memory owned by this object, not counting the
+  // shared rules and the metadata interfaces, owned by the runtime.
+  size_t MemoryUsage() const;
+
+  // Compact releases what can be reacquired or is no longer needed. Returns
+  // false if the module was already compacted.
+  bool Compact();
+
+  // Reacquire gets the metadata interfaces of a compacted module back.
+  HRESULT Reacquire(ICorProfilerInfo* info, ModuleID module_id);
+
   bool TryGetWrapperMemberRef(const WSTRING& keyIn,
                               mdMemberRef& valueOut) const {
     const auto search = wrapper_refs.find(keyIn);
@@ -94,11 +155,21 @@ class ModuleMetadata {
   inline std::vector<MethodReplacement> GetMethodReplacementsForCaller(
       const trace::FunctionInfo& caller) {
     std::vector<MethodReplacement> enabled;
+
+    if (rules != nullptr) {
+      std::vector<const IntegrationRule*> caller_rules;
+      rules->FindCallerRules(rule_selection,
+                             rules->MatchCaller(caller.type.name, caller.name),
+                             &caller_rules);
+      for (const auto rule : caller_rules) {
+        enabled.push_back(rule->integration.replacement);
+      }
+      return enabled;
+    }
+
     for (auto& i : integrations) {
-      if ((i.replacement.caller_method.type_name.empty() ||
-           i.replacement.caller_method.type_name == caller.type.name) &&
-          (i.replacement.caller_method.method_name.empty() ||
-           i.replacement.caller_method.method_name == caller.name)) {
+      if (CallerMatches(i.replacement.caller_method, caller.type.name,
+                        caller.name)) {
         enabled.push_back(i.replacement);
       }
     }
@@ -0,0 +1,162 @@
+#include "msgpack_writer.h"
+
+#include <cstring>
+
+#include "utf8.h"
+
+namespace trace {
+
+uint8_t* MessagePackWriter::Reserve(size_t size) {
+  const auto offset = buffer_.size();
+  buffer_.resize(offset + size);
+  return buffer_.data() + offset;
+}
+
+void MessagePackWriter::WriteBigEndian(uint8_t type, uint64_t value,
+                                       size_t size) {
+  auto out = Reserve(size + 1);
+  out[0] = type;
+  for (size_t i = 0; i < size; i++) {
+    out[size - i] = static_cast<uint8_t>(value >> (8 * i));
+  }
+}
+
+void MessagePackWriter::WriteNil() { buffer_.push_back(0xC0); }
+
+void MessagePackWriter::WriteBool(bool value) {
+  buffer_.push_back(value ? 0xC3 : 0xC2);
+}
+
+void MessagePackWriter::WriteUInt64(uint64_t value) {
+  if (value < 0x80) {
+    buffer_.push_back(static_cast<uint8_t>(value));
+  } else if (value <= UINT8_MAX) {
+    WriteBigEndian(0xCC, value, 1);
+  } else if (value <= UINT16_MAX) {
+    WriteBigEndian(0xCD, value, 2);
+  } else if (value <= UINT32_MAX) {
+    WriteBigEndian(0xCE, value, 4);
+  } else {
+    WriteBigEndian(0xCF, value, 8);
+  }
+}
+
+void MessagePackWriter::WriteInt64(int64_t value) {
+  if (value >= 0) {
+    WriteUInt64(static_cast<uint64_t>(value));
+  } else if (value >= -32) {
+    buffer_.push_back(static_cast<uint8_t>(value));
+  } else if (value >= INT8_MIN) {
+    WriteBigEndian(0xD0, static_cast<uint64_t>(value), 1);
+  } else if (value >= INT16_MIN) {
+    WriteBigEndian(0xD1, static_cast<uint64_t>(value), 2);
+  } else if (value >= INT32_MIN) {
+    WriteBigEndian(0xD2, static_cast<uint64_t>(value), 4);
+  } else {
+    WriteBigEndian(0xD3, static_cast<uint64_t>(value), 8);
+  }
+}
+
+void MessagePackWriter::WriteDouble(double value) {
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  WriteBigEndian(0xCB, bits, 8);
+}
+
+void MessagePackWriter::WriteArrayHeader(uint32_t count) {
+  if (count < 16) {
+    buffer_.push_back(static_cast<uint8_t>(0x90 | count));
+  } else if (count <= UINT16_MAX) {
+    WriteBigEndian(0xDC, count, 2);
+  } else {
+    WriteBigEndian(0xDD, count, 4);
+  }
+}
+
+void MessagePackWriter::WriteMapHeader(uint32_t count) {
+  if (count < 16) {
+    buffer_.push_back(static_cast<uint8_t>(0x80 | count));
+  } else if (count <= UINT16_MAX) {
+    WriteBigEndian(0xDE, count, 2);
+  } else {
+    WriteBigEndian(0xDF, count, 4);
+  }
+}
+
+void MessagePackWriter::WriteString(const char* utf8, size_t length) {
+  if (length < 32) {
+    buffer_.push_back(static_cast<uint8_t>(0xA0 | length));
+  } else if (length <= UINT8_MAX) {
+    WriteBigEndian(0xD9, length, 1);
+  } else if (length <= UINT16_MAX) {
+    WriteBigEndian(0xDA, length, 2);
+  } else {
+    WriteBigEndian(0xDB, length, 4);
+  }
+
+  WriteRaw(reinterpret_cast<const uint8_t*>(utf8), length);
+}
+
+void MessagePackWriter::WriteString(const WCHAR* chars, size_t length) {
+  // encode straight into the buffer after the largest possible header, then
+  // move the bytes back if a smaller header is enough
+  const auto max_length = Utf8MaxLength(length);
+  const size_t max_header = max_length < 32 ? 1
+                            : max_length <= UINT8_MAX ? 2
+                            : max_length <= UINT16_MAX ? 3
+                            : 5;
+
+  const auto offset = buffer_.size();
+  Reserve(max_header + max_length);
+
+  auto payload = buffer_.data() + offset + max_header;
+  const auto utf8_length = Utf16ToUtf8(chars, length, payload);
+
+  const size_t header = utf8_length < 32 ? 1
+                        : utf8_length <= UINT8_MAX ? 2
+                        : utf8_length <= UINT16_MAX ? 3
+                        : 5;
+
+  auto out = buffer_.data() + offset;
+  switch (header) {
+    case 1:
+      out[0] = static_cast<uint8_t>(0xA0 | utf8_length);
+      break;
+    case 2:
+      out[0] = 0xD9;
+      out[1] = static_cast<uint8_t>(utf8_length);
+      break;
+    case 3:
+      out[0] = 0xDA;
+      out[1] = static_cast<uint8_t>(utf8_length >> 8);
+      out[2] = static_cast<uint8_t>(utf8_length);
+      break;
+    default:
+      out[0] = 0xDB;
+      out[1] = static_cast<uint8_t>(utf8_length >> 24);
+      out[2] = static_cast<uint8_t>(utf8_length >> 16);
+      out[3] = static_cast<uint8_t>(utf8_length >> 8);
+      out[4] = static_cast<uint8_t>(utf8_length);
+      break;
+  }
+
+  if (header != max_header) {
+    std::memmove(out + header, payload, utf8_length);
+  }
+
+  buffer_.resize(offset + header + utf8_length);
+}
+
+void MessagePackWriter::WriteRaw(const uint8_t* bytes, size_t length) {
+  if (length > 0) {
+    std::memcpy(Reserve(length), bytes, length);
+  }
+}
+
+void MessagePackWriter::CopyWithin(size_t offset, size_t length) {
+  // reserve first: growing the buffer may move the source bytes
+  auto out = Reserve(length);
+  std::memcpy(out, buffer_.data() + offset, length);
+}
+
+}  // namespace trace
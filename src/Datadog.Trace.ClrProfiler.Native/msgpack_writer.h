@@ -0,0 +1,52 @@
+#ifndef DD_CLR_PROFILER_MSGPACK_WRITER_H_
+#define DD_CLR_PROFILER_MSGPACK_WRITER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "string.h"
+
+namespace trace {
+
+// MessagePackWriter appends MessagePack values to a growable buffer. Integers
+// use the smallest encoding that holds them, like the managed MsgPack packer.
+// Clear keeps the allocated capacity, so a long-lived writer stops allocating
+// once it has seen its largest payload.
+class MessagePackWriter {
+ private:
+  std::vector<uint8_t> buffer_;
+
+  uint8_t* Reserve(size_t size);
+  void WriteBigEndian(uint8_t type, uint64_t value, size_t size);
+
+ public:
+  void Clear() { buffer_.clear(); }
+
+  const uint8_t* Data() const { return buffer_.data(); }
+  size_t Size() const { return buffer_.size(); }
+
+  void WriteNil();
+  void WriteBool(bool value);
+  void WriteUInt64(uint64_t value);
+  void WriteInt64(int64_t value);
+  void WriteDouble(double value);
+  void WriteArrayHeader(uint32_t count);
+  void WriteMapHeader(uint32_t count);
+
+  // WriteString writes a str value from UTF-8 bytes.
+  void WriteString(const char* utf8, size_t length);
+
+  // WriteString writes a str value from UTF-16 code units.
+  void WriteString(const WCHAR* chars, size_t length);
+
+  // WriteRaw appends already encoded MessagePack bytes.
+  void WriteRaw(const uint8_t* bytes, size_t length);
+
+  // CopyWithin appends a copy of length bytes written earlier at offset.
+  void CopyWithin(size_t offset, size_t length);
+};
+
+}  // namespace trace
+
+#endif  // DD_CLR_PROFILER_MSGPACK_WRITER_H_
@@ -0,0 +1,123 @@
+#include "overhead_budget.h"
+
+#include "logging.h"
+
+namespace trace {
+
+namespace {
+
+// callback time not yet added to the window of its budget
+struct OverheadAccumulator {
+  const OverheadBudget* budget = nullptr;
+  uint64_t window = 0;
+  uint64_t nanoseconds = 0;
+};
+
+thread_local OverheadAccumulator overhead_accumulator;
+
+}  // namespace
+
+void OverheadBudget::Configure(uint64_t max_overhead_ms,
+                               uint64_t max_rewrites) {
+  max_overhead_ns_ = max_overhead_ms * 1000000;
+  max_rewrites_ = max_rewrites;
+
+  if (IsEnabled()) {
+    Info("Overhead budget: ", max_overhead_ms, " ms of callback time and ",
+         max_rewrites, " rewritten methods per second (0 is unlimited).");
+  }
+}
+
+void OverheadBudget::Roll(uint64_t window) {
+  auto current = window_.load(std::memory_order_acquire);
+  if (window <= current ||
+      !window_.compare_exchange_strong(current, window,
+                                       std::memory_order_acq_rel)) {
+    return;
+  }
+
+  // threads still adding to the previous window are counted in either one
+  last_window_overhead_ns_.store(
+      window_overhead_ns_.exchange(0, std::memory_order_relaxed),
+      std::memory_order_relaxed);
+  last_window_rewrites_.store(
+      window_rewrites_.exchange(0, std::memory_order_relaxed),
+      std::memory_order_relaxed);
+  throttled_.store(false, std::memory_order_relaxed);
+}
+
+void OverheadBudget::AddOverhead(uint64_t nanoseconds, uint64_t now_ns) {
+  if (max_overhead_ns_ == 0) {
+    return;
+  }
+
+  const auto window = now_ns / kOverheadBudgetWindowNs;
+  auto& accumulator = overhead_accumulator;
+
+  if (accumulator.budget != this || accumulator.window != window) {
+    // what was left of an older window is dropped: less than the threshold
+    accumulator.budget = this;
+    accumulator.window = window;
+    accumulator.nanoseconds = 0;
+  }
+
+  accumulator.nanoseconds += nanoseconds;
+  if (accumulator.nanoseconds < kOverheadFlushThresholdNs) {
+    return;
+  }
+
+  Roll(window);
+  window_overhead_ns_.fetch_add(accumulator.nanoseconds,
+                                std::memory_order_relaxed);
+  accumulator.nanoseconds = 0;
+}
+
+void OverheadBudget::AddRewrite(uint64_t now_ns) {
+  if (max_rewrites_ == 0) {
+    return;
+  }
+
+  Roll(now_ns / kOverheadBudgetWindowNs);
+  window_rewrites_.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool OverheadBudget::IsThrottled(uint64_t now_ns) {
+  if (!IsEnabled()) {
+    return false;
+  }
+
+  Roll(now_ns / kOverheadBudgetWindowNs);
+
+  const bool over_budget =
+      (max_overhead_ns_ != 0 &&
+       window_overhead_ns_.load(std::memory_order_relaxed) >=
+           max_overhead_ns_) ||
+      (max_rewrites_ != 0 &&
+       window_rewrites_.load(std::memory_order_relaxed) >= max_rewrites_);
+
+  if (over_budget && !throttled_.exchange(true, std::memory_order_relaxed)) {
+    throttled_windows_.fetch_add(1, std::memory_order_relaxed);
+
+    if (!degradation_logged_.exchange(true, std::memory_order_relaxed)) {
+      Warn("Profiler overhead budget exceeded: deferring low-priority "
+           "integrations and skipping non-essential analysis until the load "
+           "drops. This is only logged once.");
+    }
+  }
+
+  return over_budget;
+}
+
+void OverheadBudget::Read(OverheadBudgetStats* stats) const {
+  stats->throttled_windows =
+      throttled_windows_.load(std::memory_order_relaxed);
+  stats->deferred_methods = deferred_methods_.load(std::memory_order_relaxed);
+  stats->skipped_analyses = skipped_analyses_.load(std::memory_order_relaxed);
+  stats->last_window_overhead_ns =
+      last_window_overhead_ns_.load(std::memory_order_relaxed);
+  stats->last_window_rewrites =
+      last_window_rewrites_.load(std::memory_order_relaxed);
+  stats->throttled = throttled_.load(std::memory_order_relaxed) ? 1 : 0;
+}
+
+}  // namespace trace
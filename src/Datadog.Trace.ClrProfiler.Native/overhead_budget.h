@@ -0,0 +1,113 @@
+#ifndef DD_CLR_PROFILER_OVERHEAD_BUDGET_H_
+#define DD_CLR_PROFILER_OVERHEAD_BUDGET_H_
+
+#include <atomic>
+#include <cstdint>
+
+#include "clock.h"
+
+namespace trace {
+
+// Length of the windows the overhead budget is measured over, in
+// nanoseconds. Budgets are set per second.
+const uint64_t kOverheadBudgetWindowNs = 1000000000;
+
+// Overhead a thread accumulates before adding it to the current window, in
+// nanoseconds, so that callbacks don't contend on the shared counters.
+const uint64_t kOverheadFlushThresholdNs = 100000;
+
+// OverheadBudgetStats reports how the profiler degraded to stay within its
+// overhead budget, handed to managed code by GetOverheadBudgetStats in
+// interop.cpp. Counters are running totals since the profiler attached. It
+// is blittable: keep its layout in sync with the managed definition.
+struct OverheadBudgetStats {
+  // windows in which the budget was exceeded
+  uint64_t throttled_windows;
+  // methods whose low-priority integrations were deferred to a ReJIT
+  uint64_t deferred_methods;
+  // analyses skipped while over budget
+  uint64_t skipped_analyses;
+  // callback time and rewrites of the last complete window
+  uint64_t last_window_overhead_ns;
+  uint64_t last_window_rewrites;
+  // 1 while the current window is over budget
+  uint64_t throttled;
+};
+
+// OverheadBudget limits the time the profiler spends in its runtime
+// callbacks and the number of methods it rewrites, per one-second window.
+//
+// Callback time is summed in per-thread accumulators and only added to the
+// shared window counters every kOverheadFlushThresholdNs, so measuring stays
+// cheap under contention, at the cost of a little lag. Once a window is over
+// budget, the profiler defers low-priority work until a later window: the
+// low-priority integrations and ReJIT requests, and skips non-essential
+// analysis. The degradation is logged once.
+class OverheadBudget {
+ private:
+  // 0 when unlimited
+  uint64_t max_overhead_ns_ = 0;
+  uint64_t max_rewrites_ = 0;
+
+  std::atomic<uint64_t> window_{0};
+  std::atomic<uint64_t> window_overhead_ns_{0};
+  std::atomic<uint64_t> window_rewrites_{0};
+  std::atomic<uint64_t> last_window_overhead_ns_{0};
+  std::atomic<uint64_t> last_window_rewrites_{0};
+  std::atomic<bool> throttled_{false};
+  std::atomic<bool> degradation_logged_{false};
+
+  std::atomic<uint64_t> throttled_windows_{0};
+  std::atomic<uint64_t> deferred_methods_{0};
+  std::atomic<uint64_t> skipped_analyses_{0};
+
+  // Roll starts window if it is newer than the current one
+  void Roll(uint64_t window);
+
+ public:
+  OverheadBudget() = default;
+  OverheadBudget(const OverheadBudget&) = delete;
+  OverheadBudget& operator=(const OverheadBudget&) = delete;
+
+  // Configure sets the budget per second. 0 means unlimited.
+  void Configure(uint64_t max_overhead_ms, uint64_t max_rewrites);
+
+  bool IsEnabled() const {
+    return max_overhead_ns_ != 0 || max_rewrites_ != 0;
+  }
+
+  // AddOverhead adds callback time spent by the calling thread.
+  void AddOverhead(uint64_t nanoseconds, uint64_t now_ns);
+  void AddOverhead(uint64_t nanoseconds) {
+    AddOverhead(nanoseconds, MonotonicNanoseconds());
+  }
+
+  // AddRewrite counts a method whose IL was rewritten.
+  void AddRewrite(uint64_t now_ns);
+  void AddRewrite() { AddRewrite(MonotonicNanoseconds()); }
+
+  // IsThrottled returns true while the current window is over budget. Low
+  // priority work should then be deferred.
+  bool IsThrottled(uint64_t now_ns);
+  bool IsThrottled() { return IsThrottled(MonotonicNanoseconds()); }
+
+  // SkipAnalysis returns true, and counts it, if a non-essential analysis
+  // should be skipped.
+  bool SkipAnalysis() {
+    if (!IsThrottled()) {
+      return false;
+    }
+    skipped_analyses_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  void OnMethodDeferred() {
+    deferred_methods_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void Read(OverheadBudgetStats* stats) const;
+};
+
+}  // namespace trace
+
+#endif  // DD_CLR_PROFILER_OVERHEAD_BUDGET_H_
@@ -20,13 +20,9 @@
 
 namespace trace {
 
-inline WSTRING DatadogLogFilePath() {
-  WSTRING path = GetEnvironmentValue(environment::log_path);
-
-  if (path.length() > 0) {
-    return path;
-  }
-
+// DefaultLogFilePath returns the log file path used when DD_TRACE_LOG_PATH is
+// not set.
+inline WSTRING DefaultLogFilePath() {
 #ifdef _WIN32
   char* p_program_data;
   size_t length;
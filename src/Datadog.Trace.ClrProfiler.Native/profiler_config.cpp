@@ -0,0 +1,320 @@
+#include "profiler_config.h"
+
+#include <fstream>
+#include <nlohmann/json.hpp>
+
+#include "environment_variables.h"
+#include "logging.h"
+#include "pal.h"
+#include "util.h"
+
+namespace trace {
+
+using json = nlohmann::json;
+
+namespace {
+
+// ToSetting converts a JSON value to the string an environment variable would
+// hold. Returns false for values that have no such form.
+bool ToSetting(const json& value, WSTRING& setting) {
+  if (value.is_string()) {
+    setting = ToWSTRING(value.get<std::string>());
+    return true;
+  }
+
+  if (value.is_boolean()) {
+    setting = value.get<bool>() ? "true"_W : "false"_W;
+    return true;
+  }
+
+  if (value.is_number()) {
+    setting = ToWSTRING(value.dump());
+    return true;
+  }
+
+  if (value.is_array()) {
+    setting.clear();
+    for (const auto& item : value) {
+      WSTRING item_setting;
+      if (item.is_array() || !ToSetting(item, item_setting)) {
+        return false;
+      }
+      if (!setting.empty()) {
+        setting += ';';
+      }
+      setting += item_setting;
+    }
+    return true;
+  }
+
+  return false;
+}
+
+// the settings CorProfiler::Initialize logs, in that order
+const WSTRING kLoggedSettings[]{
+    environment::tracing_enabled,
+    environment::debug_enabled,
+    environment::config_file,
+    environment::log_path,
+    environment::profiler_home_path,
+    environment::integrations_path,
+    environment::include_process_names,
+    environment::exclude_process_names,
+    environment::agent_host,
+    environment::agent_port,
+    environment::agent_unix_socket,
+    environment::dogstatsd_port,
+    environment::dogstatsd_flush_interval,
+    environment::env,
+    environment::service_name,
+    environment::disabled_integrations,
+    environment::clr_disable_optimizations,
+    environment::clr_disable_rewritten_optimizations,
+    environment::clr_disable_optimizations_methods,
+    environment::overhead_budget_ms,
+    environment::rewrite_budget,
+    environment::low_priority_integrations,
+    environment::module_idle_timeout,
+    environment::azure_app_services,
+    environment::azure_app_services_app_pool_id,
+    environment::azure_app_services_cli_telemetry_profile_value,
+    environment::allocation_profiling_enabled,
+    environment::allocation_sampling_interval,
+    environment::live_heap_enabled,
+    environment::live_heap_max_objects,
+    environment::gc_timeline_enabled,
+    environment::exception_counting_enabled,
+    environment::runtime_metrics_enabled,
+    environment::runtime_metrics_interval,
+    environment::thread_pool_watchdog_enabled,
+    environment::thread_pool_watchdog_interval,
+    environment::jit_statistics_enabled,
+    environment::jit_statistics_top_methods,
+    environment::startup_methods_file,
+    environment::startup_window_ms,
+    environment::runtime_events_enabled,
+    environment::method_timing,
+    environment::method_timing_file};
+
+uint16_t ToPort(uint64_t value, uint16_t default_value) {
+  return value > 0 && value <= UINT16_MAX ? static_cast<uint16_t>(value)
+                                          : default_value;
+}
+
+}  // namespace
+
+bool ConfigurationSource::LoadJson(std::istream& stream) {
+  try {
+    json j;
+    stream >> j;
+
+    if (!j.is_object()) {
+      Warn("Invalid configuration file: expected a JSON object.");
+      return false;
+    }
+
+    for (auto it = j.begin(); it != j.end(); ++it) {
+      WSTRING setting;
+      if (ToSetting(it.value(), setting)) {
+        file_values_[ToWSTRING(it.key())] = Trim(setting);
+      }
+    }
+  } catch (const json::exception& e) {
+    Warn("Invalid configuration file: ", e.what());
+    return false;
+  }
+
+  return true;
+}
+
+bool ConfigurationSource::LoadJsonFile(const WSTRING& file_path) {
+  std::ifstream stream(ToString(file_path));
+
+  if (!stream) {
+    return false;
+  }
+
+  return LoadJson(stream);
+}
+
+WSTRING ConfigurationSource::GetString(const WSTRING& name) const {
+  if (use_environment_) {
+    auto value = GetEnvironmentValue(name);
+    if (!value.empty()) {
+      return value;
+    }
+  }
+
+  const auto it = file_values_.find(name);
+  return it == file_values_.end() ? WSTRING() : it->second;
+}
+
+std::vector<WSTRING> ConfigurationSource::GetStrings(
+    const WSTRING& name) const {
+  std::vector<WSTRING> values;
+  for (const auto& item : Split(GetString(name), ';')) {
+    auto value = Trim(item);
+    if (!value.empty()) {
+      values.push_back(value);
+    }
+  }
+  return values;
+}
+
+bool ConfigurationSource::GetBool(const WSTRING& name,
+                                  bool default_value) const {
+  const auto value = GetString(name);
+
+  if (value == "1"_W || value == "true"_W) {
+    return true;
+  }
+
+  if (value == "0"_W || value == "false"_W) {
+    return false;
+  }
+
+  return default_value;
+}
+
+uint64_t ConfigurationSource::GetUInt64(const WSTRING& name,
+                                        uint64_t default_value) const {
+  uint64_t value;
+  return TryParseUInt64(GetString(name), value) ? value : default_value;
+}
+
+ProfilerConfig LoadProfilerConfig(const ConfigurationSource& source) {
+  ProfilerConfig config;
+
+#ifdef BIT64
+  config.native_profiler_file = source.GetString("CORECLR_PROFILER_PATH_64"_W);
+#else
+  config.native_profiler_file = source.GetString("CORECLR_PROFILER_PATH_32"_W);
+#endif
+  if (config.native_profiler_file.empty()) {
+    config.native_profiler_file = source.GetString("CORECLR_PROFILER_PATH"_W);
+  }
+
+  config.tracing_enabled = source.GetBool(environment::tracing_enabled, true);
+  config.debug_enabled = source.GetBool(environment::debug_enabled, false);
+
+  config.log_path = source.GetString(environment::log_path);
+  if (config.log_path.empty()) {
+    config.log_path = DefaultLogFilePath();
+  }
+
+  config.profiler_home_path = source.GetString(environment::profiler_home_path);
+  config.integrations_paths = source.GetStrings(environment::integrations_path);
+  config.disabled_integrations =
+      source.GetStrings(environment::disabled_integrations);
+  config.include_process_names =
+      source.GetStrings(environment::include_process_names);
+  config.exclude_process_names =
+      source.GetStrings(environment::exclude_process_names);
+  config.disable_optimizations =
+      source.GetBool(environment::clr_disable_optimizations, false);
+  config.disable_rewritten_optimizations =
+      source.GetBool(environment::clr_disable_rewritten_optimizations, false);
+  for (const auto& pattern :
+       source.GetStrings(environment::clr_disable_optimizations_methods)) {
+    config.unoptimized_methods.Add(pattern);
+  }
+
+  config.overhead_budget_ms =
+      source.GetUInt64(environment::overhead_budget_ms, 0);
+  config.rewrite_budget = source.GetUInt64(environment::rewrite_budget, 0);
+  config.low_priority_integrations =
+      source.GetStrings(environment::low_priority_integrations);
+  config.module_idle_timeout =
+      source.GetUInt64(environment::module_idle_timeout, 0);
+
+  config.azure_app_services =
+      source.GetString(environment::azure_app_services) == "1"_W;
+  config.azure_app_services_app_pool_id =
+      source.GetString(environment::azure_app_services_app_pool_id);
+  config.azure_app_services_cli_telemetry_profile_value = source.GetString(
+      environment::azure_app_services_cli_telemetry_profile_value);
+
+  config.allocation_profiling_enabled =
+      source.GetBool(environment::allocation_profiling_enabled, false);
+  config.allocation_sampling_interval =
+      source.GetUInt64(environment::allocation_sampling_interval,
+                       kDefaultAllocationSamplingInterval);
+  config.live_heap_enabled =
+      source.GetBool(environment::live_heap_enabled, false);
+  config.live_heap_max_objects = source.GetUInt64(
+      environment::live_heap_max_objects, kDefaultLiveHeapMaxObjects);
+  config.gc_timeline_enabled =
+      source.GetBool(environment::gc_timeline_enabled, false);
+  config.exception_counting_enabled =
+      source.GetBool(environment::exception_counting_enabled, false);
+  config.runtime_metrics_enabled =
+      source.GetBool(environment::runtime_metrics_enabled, false);
+  config.runtime_metrics_interval = source.GetUInt64(
+      environment::runtime_metrics_interval, kDefaultRuntimeMetricsInterval);
+  config.thread_pool_watchdog_enabled =
+      source.GetBool(environment::thread_pool_watchdog_enabled, false);
+  config.thread_pool_watchdog_interval =
+      source.GetUInt64(environment::thread_pool_watchdog_interval,
+                       kDefaultThreadPoolWatchdogInterval);
+  config.jit_statistics_enabled =
+      source.GetBool(environment::jit_statistics_enabled, false);
+  config.jit_statistics_top_methods = source.GetUInt64(
+      environment::jit_statistics_top_methods, kDefaultJitTopMethods);
+  config.startup_methods_file =
+      source.GetString(environment::startup_methods_file);
+  config.startup_window_ms = source.GetUInt64(environment::startup_window_ms,
+                                              kDefaultStartupWindowMs);
+  config.runtime_events_enabled =
+      source.GetBool(environment::runtime_events_enabled, false);
+
+  for (const auto& pattern : source.GetStrings(environment::method_timing)) {
+    config.timed_methods.Add(pattern);
+  }
+
+  const auto method_timing_file =
+      source.GetString(environment::method_timing_file);
+  if (!method_timing_file.empty() &&
+      !config.timed_methods.AddFromFile(method_timing_file)) {
+    Warn("Unable to read method timing patterns from ", method_timing_file);
+  }
+
+  const auto agent_host = source.GetString(environment::agent_host);
+  if (!agent_host.empty()) {
+    config.agent_endpoint.host = ToString(agent_host);
+  }
+  config.agent_endpoint.port =
+      ToPort(source.GetUInt64(environment::agent_port, 0), kDefaultAgentPort);
+#ifndef _WIN32
+  config.agent_endpoint.unix_socket =
+      ToString(source.GetString(environment::agent_unix_socket));
+#endif
+
+  config.dogstatsd_port = ToPort(
+      source.GetUInt64(environment::dogstatsd_port, 0), kDefaultDogStatsdPort);
+  config.dogstatsd_flush_interval = source.GetUInt64(
+      environment::dogstatsd_flush_interval, kDefaultDogStatsdFlushInterval);
+
+  for (const auto& name : kLoggedSettings) {
+    config.settings.emplace_back(name, source.GetString(name));
+  }
+
+  return config;
+}
+
+ProfilerConfig LoadProfilerConfig() {
+  ConfigurationSource source;
+
+  auto config_file = source.GetString(environment::config_file);
+  if (!config_file.empty()) {
+    if (!source.LoadJsonFile(config_file)) {
+      Warn("Unable to read configuration file ", config_file);
+      config_file.clear();
+    }
+  }
+
+  auto config = LoadProfilerConfig(source);
+  config.config_file = config_file;
+  return config;
+}
+
+}  // namespace trace
@@ -0,0 +1,137 @@
+#ifndef DD_CLR_PROFILER_PROFILER_CONFIG_H_
+#define DD_CLR_PROFILER_PROFILER_CONFIG_H_
+
+#include <cstdint>
+#include <istream>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "agent_transport.h"
+#include "allocation_sampler.h"
+#include "dogstatsd.h"
+#include "jit_statistics.h"
+#include "live_heap.h"
+#include "method_timing.h"
+#include "runtime_metrics.h"
+#include "startup_recorder.h"
+#include "thread_pool_watchdog.h"
+#include "string.h"  // NOLINT
+
+namespace trace {
+
+// ConfigurationSource looks up settings by environment variable name, first
+// in the environment, then in an optional JSON configuration file, the same
+// order as the managed tracer. The file is an object whose keys are
+// environment variable names; strings, booleans, numbers and arrays of
+// strings (joined with ';') are accepted, other values are ignored.
+class ConfigurationSource {
+ private:
+  bool use_environment_;
+  std::map<WSTRING, WSTRING> file_values_;
+
+ public:
+  explicit ConfigurationSource(bool use_environment = true)
+      : use_environment_(use_environment) {}
+
+  // LoadJson reads settings from a JSON object. Returns false if the stream
+  // isn't a valid JSON object, in which case no setting is added.
+  bool LoadJson(std::istream& stream);
+
+  // LoadJsonFile calls LoadJson with the content of the file. Returns false
+  // if the file can't be read or parsed.
+  bool LoadJsonFile(const WSTRING& file_path);
+
+  // GetString returns the trimmed value of the setting, or an empty string.
+  WSTRING GetString(const WSTRING& name) const;
+
+  // GetStrings splits the value of the setting on semicolons and drops empty
+  // items.
+  std::vector<WSTRING> GetStrings(const WSTRING& name) const;
+
+  // GetBool returns true for "1" and "true", false for "0" and "false" and
+  // default_value otherwise.
+  bool GetBool(const WSTRING& name, bool default_value) const;
+
+  // GetUInt64 returns default_value if the setting isn't a base-10 unsigned
+  // integer.
+  uint64_t GetUInt64(const WSTRING& name, uint64_t default_value) const;
+};
+
+// ProfilerConfig is an immutable snapshot of every setting of the native
+// profiler, parsed once in CorProfiler::Initialize and handed to the
+// subsystems, so that nothing reads the environment afterwards.
+struct ProfilerConfig {
+  // path of the JSON configuration file that was loaded, if any
+  WSTRING config_file;
+
+  // the native library as loaded by the runtime, from CORECLR_PROFILER_PATH_64
+  // or CORECLR_PROFILER_PATH_32, then CORECLR_PROFILER_PATH. Not used on
+  // Windows, where the library is found by name.
+  WSTRING native_profiler_file;
+
+  bool tracing_enabled = true;
+  bool debug_enabled = false;
+  WSTRING log_path;
+  WSTRING profiler_home_path;
+
+  std::vector<WSTRING> integrations_paths;
+  std::vector<WSTRING> disabled_integrations;
+  std::vector<WSTRING> include_process_names;
+  std::vector<WSTRING> exclude_process_names;
+  bool disable_optimizations = false;
+  bool disable_rewritten_optimizations = false;
+  MethodPatternList unoptimized_methods;
+
+  // overhead budget per second, 0 when unlimited
+  uint64_t overhead_budget_ms = 0;
+  uint64_t rewrite_budget = 0;
+  std::vector<WSTRING> low_priority_integrations;
+
+  // milliseconds without JIT compilation before a module is compacted, 0 to
+  // never compact
+  uint64_t module_idle_timeout = 0;
+
+  bool azure_app_services = false;
+  WSTRING azure_app_services_app_pool_id;
+  WSTRING azure_app_services_cli_telemetry_profile_value;
+
+  bool allocation_profiling_enabled = false;
+  uint64_t allocation_sampling_interval = kDefaultAllocationSamplingInterval;
+  bool live_heap_enabled = false;
+  uint64_t live_heap_max_objects = kDefaultLiveHeapMaxObjects;
+  bool gc_timeline_enabled = false;
+  bool exception_counting_enabled = false;
+  bool runtime_metrics_enabled = false;
+  uint64_t runtime_metrics_interval = kDefaultRuntimeMetricsInterval;
+  bool thread_pool_watchdog_enabled = false;
+  uint64_t thread_pool_watchdog_interval = kDefaultThreadPoolWatchdogInterval;
+  bool jit_statistics_enabled = false;
+  uint64_t jit_statistics_top_methods = kDefaultJitTopMethods;
+  WSTRING startup_methods_file;
+  uint64_t startup_window_ms = kDefaultStartupWindowMs;
+  bool runtime_events_enabled = false;
+
+  // DD_PROFILER_METHOD_TIMING and DD_PROFILER_METHOD_TIMING_FILE, combined
+  MethodPatternList timed_methods;
+
+  AgentEndpoint agent_endpoint;
+  uint16_t dogstatsd_port = kDefaultDogStatsdPort;
+  uint64_t dogstatsd_flush_interval = kDefaultDogStatsdFlushInterval;
+
+  // the logged settings by environment variable name, with the value they
+  // were resolved to from the environment or the file, empty when not set
+  std::vector<std::pair<WSTRING, WSTRING>> settings;
+};
+
+// LoadProfilerConfig parses every setting from source. Invalid numbers fall
+// back to their defaults.
+ProfilerConfig LoadProfilerConfig(const ConfigurationSource& source);
+
+// LoadProfilerConfig reads the environment and, if
+// DD_DOTNET_TRACER_CONFIG_FILE is set, the JSON file it names.
+ProfilerConfig LoadProfilerConfig();
+
+}  // namespace trace
+
+#endif  // DD_CLR_PROFILER_PROFILER_CONFIG_H_
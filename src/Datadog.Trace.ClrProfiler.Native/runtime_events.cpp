@@ -0,0 +1,273 @@
+#include "runtime_events.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "logging.h"
+#include "string.h"
+
+namespace trace {
+
+namespace {
+
+// Keywords and level of the Microsoft-Windows-DotNETRuntime provider.
+const UINT64 kGCKeyword = 0x1;
+const UINT64 kContentionKeyword = 0x4000;
+const UINT64 kThreadingKeyword = 0x10000;
+const UINT32 kInformationalLevel = 4;
+
+// Gen 2 collections are the ones with depth 2.
+const uint32_t kGen2Depth = 2;
+
+// PayloadReader decodes the fields of an event payload in order. The runtime
+// writes them packed, little-endian, pointers at their native size. Reads
+// past the end fail and return 0.
+class PayloadReader {
+ private:
+  const BYTE* data_;
+  ULONG size_;
+  ULONG offset_ = 0;
+  bool ok_ = true;
+
+ public:
+  PayloadReader(const BYTE* data, ULONG size) : data_(data), size_(size) {}
+
+  template <typename T>
+  T Read() {
+    T value{};
+    if (!ok_ || data_ == nullptr || size_ - offset_ < sizeof(T)) {
+      ok_ = false;
+      return value;
+    }
+
+    memcpy(&value, data_ + offset_, sizeof(T));
+    offset_ += sizeof(T);
+    return value;
+  }
+
+  bool ok() const { return ok_; }
+};
+
+// start of the contention the thread is waiting on, 0 if none
+thread_local uint64_t contention_start_ns = 0;
+
+bool IsInducedGC(uint32_t reason) {
+  // Induced, InducedNotForced, InducedLowMemory and InducedCompacting
+  return reason == 1 || reason == 7 || reason == 9 || reason == 10;
+}
+
+}  // namespace
+
+bool RuntimeEventListener::Start(ICorProfilerInfo12* info, uint64_t now_ns) {
+  info_ = info;
+  start_ns_ = now_ns;
+
+  if (info_ != nullptr) {
+    const auto provider_name = "Microsoft-Windows-DotNETRuntime"_W;
+    COR_PRF_EVENTPIPE_PROVIDER_CONFIG config;
+    config.providerName = provider_name.c_str();
+    config.keywords = kGCKeyword | kContentionKeyword | kThreadingKeyword;
+    config.loggingLevel = kInformationalLevel;
+    config.filterData = nullptr;
+
+    const auto hr = info_->EventPipeStartSession(1, &config, FALSE, &session_);
+    if (FAILED(hr)) {
+      Warn("Unable to start the runtime events session: ", hr);
+      session_ = 0;
+      return false;
+    }
+  }
+
+  std::lock_guard<std::mutex> guard(lock_);
+  stats_.session_active = 1;
+  enabled_ = true;
+
+  Info("Runtime events session started.");
+  return true;
+}
+
+void RuntimeEventListener::Stop() {
+  if (!enabled_) {
+    return;
+  }
+
+  if (info_ != nullptr && session_ != 0) {
+    info_->EventPipeStopSession(session_);
+    session_ = 0;
+  }
+
+  std::lock_guard<std::mutex> guard(lock_);
+  stats_.session_active = 0;
+}
+
+void RuntimeEventListener::OnEvent(DWORD event_id, DWORD version,
+                                   const BYTE* data, ULONG size,
+                                   const UINT_PTR frames[], ULONG frame_count,
+                                   uint64_t now_ns) {
+  switch (event_id) {
+    case kContentionStartEventId:
+      contention_start_ns = now_ns;
+      break;
+    case kContentionStopEventId:
+      OnContentionStop(data, size, version, frames, frame_count, now_ns);
+      return;
+    case kThreadPoolAdjustmentEventId:
+      OnThreadPoolAdjustment(data, size);
+      return;
+    case kGCStartEventId:
+      OnGCStart(data, size, version);
+      return;
+    default:
+      break;
+  }
+
+  std::lock_guard<std::mutex> guard(lock_);
+  stats_.events++;
+}
+
+void RuntimeEventListener::OnContentionStop(const BYTE* data, ULONG size,
+                                            DWORD version,
+                                            const UINT_PTR frames[],
+                                            ULONG frame_count,
+                                            uint64_t now_ns) {
+  PayloadReader reader(data, size);
+  ContentionKey key;
+  key.flags = reader.Read<uint8_t>();
+  reader.Read<uint16_t>();  // ClrInstanceID
+
+  // ContentionStop_V1 carries the duration, ContentionStop has only its
+  // start on this thread
+  uint64_t duration_ns = 0;
+  if (version >= 1) {
+    const auto duration = reader.Read<double>();
+    duration_ns = duration > 0 ? static_cast<uint64_t>(duration) : 0;
+  } else if (contention_start_ns != 0 && now_ns > contention_start_ns) {
+    duration_ns = now_ns - contention_start_ns;
+  }
+  contention_start_ns = 0;
+
+  for (ULONG i = 0;
+       i < frame_count && key.stack.frame_count < kMaxStackFrames; i++) {
+    FunctionID function_id = frames[i];
+    if (info_ != nullptr &&
+        (FAILED(info_->GetFunctionFromIP(
+             reinterpret_cast<LPCBYTE>(frames[i]), &function_id)) ||
+         function_id == 0)) {
+      // native frame
+      continue;
+    }
+    key.stack.frames[key.stack.frame_count++] = function_id;
+  }
+
+  std::lock_guard<std::mutex> guard(lock_);
+  stats_.events++;
+  if (!reader.ok()) {
+    stats_.malformed_events++;
+    return;
+  }
+
+  stats_.contention_count++;
+  stats_.contention_ns += duration_ns;
+
+  auto site = sites_.find(key);
+  if (site == sites_.end()) {
+    if (sites_.size() >= kMaxContentionSites) {
+      stats_.dropped_contentions++;
+      return;
+    }
+
+    ContentionSite entry{};
+    entry.flags = key.flags;
+    entry.frame_count = key.stack.frame_count;
+    for (uint32_t i = 0; i < key.stack.frame_count; i++) {
+      entry.frames[i] = key.stack.frames[i];
+    }
+    site = sites_.emplace(key, entry).first;
+  }
+
+  site->second.count++;
+  site->second.total_ns += duration_ns;
+  site->second.max_ns = std::max(site->second.max_ns, duration_ns);
+}
+
+void RuntimeEventListener::OnThreadPoolAdjustment(const BYTE* data,
+                                                  ULONG size) {
+  PayloadReader reader(data, size);
+  const auto throughput = reader.Read<double>();
+  const auto workers = reader.Read<uint32_t>();
+  const auto reason = reader.Read<uint32_t>();
+
+  std::lock_guard<std::mutex> guard(lock_);
+  stats_.events++;
+  if (!reader.ok()) {
+    stats_.malformed_events++;
+    return;
+  }
+
+  // the first adjustment sets the baseline
+  if (stats_.thread_pool_adjustments > 0 &&
+      workers > stats_.thread_pool_workers) {
+    stats_.thread_pool_injections++;
+    stats_.thread_pool_injected_threads += workers - stats_.thread_pool_workers;
+  }
+
+  if (reason == kThreadPoolAdjustmentStarvation) {
+    stats_.thread_pool_starvation_adjustments++;
+  }
+
+  stats_.thread_pool_adjustments++;
+  stats_.thread_pool_workers = workers;
+  stats_.thread_pool_throughput = throughput;
+}
+
+void RuntimeEventListener::OnGCStart(const BYTE* data, ULONG size,
+                                     DWORD version) {
+  PayloadReader reader(data, size);
+  reader.Read<uint32_t>();  // Count
+  // GCStart has no depth, GCStart_V1 and later do
+  const auto depth = version >= 1 ? reader.Read<uint32_t>() : 0;
+  const auto reason = reader.Read<uint32_t>();
+
+  std::lock_guard<std::mutex> guard(lock_);
+  stats_.events++;
+  if (!reader.ok()) {
+    stats_.malformed_events++;
+    return;
+  }
+
+  stats_.gc_count++;
+  if (depth == kGen2Depth) {
+    stats_.gc_gen2_count++;
+  }
+  if (IsInducedGC(reason)) {
+    stats_.gc_induced_count++;
+  }
+}
+
+size_t RuntimeEventListener::Read(RuntimeEventStats* stats,
+                                  ContentionSite* sites, size_t max_sites,
+                                  uint64_t now_ns) const {
+  std::vector<ContentionSite> all;
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    *stats = stats_;
+    stats->contention_site_count = sites_.size();
+    all.reserve(sites_.size());
+    for (const auto& site : sites_) {
+      all.push_back(site.second);
+    }
+  }
+
+  stats->elapsed_ns = enabled_ && now_ns > start_ns_ ? now_ns - start_ns_ : 0;
+
+  const auto count = std::min(max_sites, all.size());
+  std::partial_sort(all.begin(), all.begin() + count, all.end(),
+                    [](const ContentionSite& a, const ContentionSite& b) {
+                      return a.total_ns > b.total_ns;
+                    });
+  std::copy(all.begin(), all.begin() + count, sites);
+  return count;
+}
+
+}  // namespace trace
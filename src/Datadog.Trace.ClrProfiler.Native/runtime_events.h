@@ -0,0 +1,142 @@
+#ifndef DD_CLR_PROFILER_RUNTIME_EVENTS_H_
+#define DD_CLR_PROFILER_RUNTIME_EVENTS_H_
+
+#include <corhlpr.h>
+#include <corprof.h>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+#include "event_pipe.h"
+#include "stack_walker.h"
+
+namespace trace {
+
+// Maximum number of distinct contention sites aggregated. Contentions at
+// other sites are only counted in the totals.
+const size_t kMaxContentionSites = 1024;
+
+// Event ids of the Microsoft-Windows-DotNETRuntime provider.
+const DWORD kGCStartEventId = 1;
+const DWORD kThreadPoolAdjustmentEventId = 55;
+const DWORD kContentionStartEventId = 81;
+const DWORD kContentionStopEventId = 91;
+
+// Reason of a thread-pool adjustment that injected threads because work
+// items were not making progress.
+const uint32_t kThreadPoolAdjustmentStarvation = 6;
+
+// RuntimeEventStats are the totals of the runtime events received since the
+// session started, handed to managed code by GetRuntimeEvents in interop.cpp.
+// It is blittable: keep its layout in sync with the managed definition.
+struct RuntimeEventStats {
+  // 1 while the EventPipe session runs
+  uint64_t session_active;
+  uint64_t elapsed_ns;
+  uint64_t events;
+  // events too short for their version, ignored
+  uint64_t malformed_events;
+
+  uint64_t contention_count;
+  uint64_t contention_ns;
+  uint64_t contention_site_count;
+  // contentions counted in the totals only, the site table being full
+  uint64_t dropped_contentions;
+
+  uint64_t thread_pool_adjustments;
+  // the worker count set by the last adjustment
+  uint64_t thread_pool_workers;
+  // adjustments that added threads, and how many they added
+  uint64_t thread_pool_injections;
+  uint64_t thread_pool_injected_threads;
+  uint64_t thread_pool_starvation_adjustments;
+  // work items completed per second, as of the last adjustment
+  double thread_pool_throughput;
+
+  uint64_t gc_count;
+  uint64_t gc_gen2_count;
+  uint64_t gc_induced_count;
+};
+
+// ContentionSite is the time spent waiting for locks at one managed stack.
+// It is blittable: keep its layout in sync with the managed definition.
+struct ContentionSite {
+  // ContentionFlags: 0 for managed locks, 1 for native ones
+  uint64_t flags;
+  uint64_t count;
+  uint64_t total_ns;
+  uint64_t max_ns;
+  uint64_t frame_count;
+  uint64_t frames[kMaxStackFrames];
+};
+
+// RuntimeEventListener opens an in-process EventPipe session on the runtime
+// provider (.NET 5 and later) for lock contention, thread-pool adjustment and
+// GC events, and reduces them into contention time by stack and thread-pool
+// injection counts, without an out-of-process diagnostics client.
+//
+// The session is synchronous: events are handed to OnEvent by
+// EventPipeEventDelivered on the thread that raised them, so the start of a
+// contention is kept per thread. Payloads are decoded in place, field by
+// field, and only the fields that are needed are read.
+class RuntimeEventListener {
+ private:
+  struct ContentionKey {
+    uint64_t flags;
+    CompactStack stack;
+
+    bool operator==(const ContentionKey& other) const {
+      return flags == other.flags && stack == other.stack;
+    }
+  };
+
+  struct ContentionKeyHash {
+    size_t operator()(const ContentionKey& key) const {
+      return static_cast<size_t>(key.stack.Hash() ^ key.flags);
+    }
+  };
+
+  ICorProfilerInfo12* info_ = nullptr;
+  EVENTPIPE_SESSION session_ = 0;
+  uint64_t start_ns_ = 0;
+  bool enabled_ = false;
+
+  mutable std::mutex lock_;
+  RuntimeEventStats stats_{};
+  std::unordered_map<ContentionKey, ContentionSite, ContentionKeyHash> sites_;
+
+  void OnContentionStop(const BYTE* data, ULONG size, DWORD version,
+                        const UINT_PTR frames[], ULONG frame_count,
+                        uint64_t now_ns);
+  void OnThreadPoolAdjustment(const BYTE* data, ULONG size);
+  void OnGCStart(const BYTE* data, ULONG size, DWORD version);
+
+ public:
+  RuntimeEventListener() = default;
+  RuntimeEventListener(const RuntimeEventListener&) = delete;
+  RuntimeEventListener& operator=(const RuntimeEventListener&) = delete;
+
+  // Start opens the session. Requires COR_PRF_HIGH_MONITOR_EVENT_PIPE in the
+  // event mask. info may be null in tests: events are then only aggregated,
+  // and stack frames are taken as FunctionIDs. Returns false if the session
+  // could not be opened.
+  bool Start(ICorProfilerInfo12* info, uint64_t now_ns);
+
+  // Stop closes the session. The aggregates can still be read.
+  void Stop();
+
+  bool IsEnabled() const { return enabled_; }
+
+  // OnEvent must be called from EventPipeEventDelivered.
+  void OnEvent(DWORD event_id, DWORD version, const BYTE* data, ULONG size,
+               const UINT_PTR frames[], ULONG frame_count, uint64_t now_ns);
+
+  // Read copies the totals into stats and up to max_sites contention sites,
+  // longest first, into sites. Returns the number of sites copied.
+  size_t Read(RuntimeEventStats* stats, ContentionSite* sites,
+              size_t max_sites, uint64_t now_ns) const;
+};
+
+}  // namespace trace
+
+#endif  // DD_CLR_PROFILER_RUNTIME_EVENTS_H_
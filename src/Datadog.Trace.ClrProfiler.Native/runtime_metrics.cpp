@@ -0,0 +1,168 @@
+#include "runtime_metrics.h"
+
+#include <chrono>
+#include <cstring>
+
+#include "logging.h"
+
+namespace trace {
+
+namespace {
+
+thread_local uint32_t jit_depth = 0;
+thread_local uint64_t jit_start = 0;
+
+// Number of GC pauses read from the timeline per batch.
+const size_t kGcPauseBatchSize = 16;
+
+}  // namespace
+
+RuntimeMetrics::~RuntimeMetrics() { Stop(); }
+
+void RuntimeMetrics::Initialize(const GcTimeline* gc_timeline,
+                                uint64_t interval_ms) {
+  gc_timeline_ = gc_timeline;
+  interval_ms_ = interval_ms > 0 ? interval_ms : kDefaultRuntimeMetricsInterval;
+  enabled_.store(true, std::memory_order_relaxed);
+
+  collector_ = std::thread(&RuntimeMetrics::Collect, this);
+
+  Info("Runtime metrics enabled, sampling every ", interval_ms_, " ms.");
+}
+
+void RuntimeMetrics::Stop() {
+  {
+    std::lock_guard<std::mutex> guard(stop_lock_);
+    stop_requested_ = true;
+  }
+  stop_signal_.notify_all();
+
+  if (collector_.joinable()) {
+    collector_.join();
+  }
+}
+
+void RuntimeMetrics::OnJitStarted() {
+  if (jit_depth++ == 0) {
+    jit_start = MonotonicNanoseconds();
+  }
+}
+
+uint64_t RuntimeMetrics::OnJitFinished() {
+  if (jit_depth == 0) {
+    // started before the profiler attached
+    return 0;
+  }
+
+  if (--jit_depth != 0) {
+    return 0;
+  }
+
+  const auto duration_ns = MonotonicNanoseconds() - jit_start;
+  jit_count_.fetch_add(1, std::memory_order_relaxed);
+  jit_time_ns_.fetch_add(duration_ns, std::memory_order_relaxed);
+  return duration_ns;
+}
+
+void RuntimeMetrics::Collect() {
+  std::unique_lock<std::mutex> lock(stop_lock_);
+
+  while (!stop_requested_) {
+    lock.unlock();
+    Sample();
+    lock.lock();
+
+    stop_signal_.wait_for(lock, std::chrono::milliseconds(interval_ms_),
+                          [this] { return stop_requested_; });
+  }
+}
+
+void RuntimeMetrics::Sample() {
+  RuntimeMetricsSnapshot snapshot{};
+  snapshot.timestamp_unix_ns = UnixNanoseconds();
+
+  if (gc_timeline_ != nullptr && gc_timeline_->IsEnabled()) {
+    // only the most recent pause matters for the generation sizes
+    GcPause pauses[kGcPauseBatchSize];
+    size_t count;
+    while ((count = gc_timeline_->Read(&gc_cursor_, pauses,
+                                       kGcPauseBatchSize)) > 0) {
+      for (size_t i = count; i > 0; i--) {
+        if (pauses[i - 1].generation >= 0) {
+          for (int gen = 0; gen < kGcGenerationCount; gen++) {
+            generation_sizes_[gen] = pauses[i - 1].generation_sizes[gen];
+          }
+          break;
+        }
+      }
+    }
+
+    for (int gen = 0; gen < kGcGenerationCount; gen++) {
+      snapshot.generation_sizes[gen] = generation_sizes_[gen];
+      snapshot.gc_counts[gen] = gc_timeline_->GcCount(gen);
+    }
+    snapshot.gc_pause_count = gc_timeline_->PauseCount();
+    snapshot.gc_pause_total_ns = gc_timeline_->TotalPauseNanoseconds();
+  }
+
+  const auto thread_count = thread_count_.load(std::memory_order_relaxed);
+  const auto module_count = module_count_.load(std::memory_order_relaxed);
+  const auto assembly_count = assembly_count_.load(std::memory_order_relaxed);
+
+  // unload and destroy callbacks can arrive for objects whose creation was
+  // not observed, clamp instead of reporting huge unsigned values
+  snapshot.thread_count = thread_count > 0 ? thread_count : 0;
+  snapshot.module_count = module_count > 0 ? module_count : 0;
+  snapshot.assembly_count = assembly_count > 0 ? assembly_count : 0;
+  snapshot.jit_count = jit_count_.load(std::memory_order_relaxed);
+  snapshot.jit_time_ns = jit_time_ns_.load(std::memory_order_relaxed);
+  snapshot.profiler_overhead_ns = overhead_ns_.load(std::memory_order_relaxed);
+
+  uint64_t words[kRuntimeMetricsSnapshotWords];
+  memcpy(words, &snapshot, sizeof(words));
+
+  // write the buffer readers are not looking at
+  const auto version = version_.load(std::memory_order_relaxed) + 1;
+  auto& buffer = buffers_[version & 1];
+
+  const auto sequence = buffer.sequence.load(std::memory_order_relaxed);
+  buffer.sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  for (size_t i = 0; i < kRuntimeMetricsSnapshotWords; i++) {
+    buffer.words[i].store(words[i], std::memory_order_relaxed);
+  }
+
+  buffer.sequence.store(sequence + 2, std::memory_order_release);
+  version_.store(version, std::memory_order_release);
+}
+
+bool RuntimeMetrics::Read(RuntimeMetricsSnapshot* metrics) const {
+  uint64_t words[kRuntimeMetricsSnapshotWords];
+
+  while (true) {
+    const auto version = version_.load(std::memory_order_acquire);
+    if (version == 0) {
+      return false;
+    }
+
+    const auto& buffer = buffers_[version & 1];
+    const auto sequence = buffer.sequence.load(std::memory_order_acquire);
+    if (sequence & 1) {
+      // the collector is rewriting it, the other buffer is newer
+      continue;
+    }
+
+    for (size_t i = 0; i < kRuntimeMetricsSnapshotWords; i++) {
+      words[i] = buffer.words[i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    if (buffer.sequence.load(std::memory_order_relaxed) == sequence) {
+      memcpy(metrics, words, sizeof(words));
+      return true;
+    }
+  }
+}
+
+}  // namespace trace
@@ -0,0 +1,188 @@
+#ifndef DD_CLR_PROFILER_RUNTIME_METRICS_H_
+#define DD_CLR_PROFILER_RUNTIME_METRICS_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "clock.h"
+#include "gc_timeline.h"
+#include "overhead_budget.h"
+
+namespace trace {
+
+// Default time between two samples of the runtime metrics, in milliseconds.
+const uint64_t kDefaultRuntimeMetricsInterval = 1000;
+
+// RuntimeMetricsSnapshot is one sample of the runtime metrics, handed to
+// managed code by GetRuntimeMetrics in interop.cpp. Counters are running
+// totals since the profiler attached. It is blittable: keep its layout in
+// sync with the managed definition.
+struct RuntimeMetricsSnapshot {
+  // wall-clock time of the sample, nanoseconds since the Unix epoch
+  uint64_t timestamp_unix_ns;
+  // the GC fields are only populated when the GC timeline is enabled, since
+  // monitoring GCs disables concurrent GC
+  uint64_t generation_sizes[kGcGenerationCount];
+  // collections of gens 0 to 2, then those that included the large object
+  // heap, a subset of the gen 2 ones
+  uint64_t gc_counts[kGcGenerationCount];
+  uint64_t gc_pause_count;
+  uint64_t gc_pause_total_ns;
+  // managed threads currently alive
+  uint64_t thread_count;
+  uint64_t jit_count;
+  uint64_t jit_time_ns;
+  // modules and assemblies currently loaded
+  uint64_t module_count;
+  uint64_t assembly_count;
+  // time spent in the profiler's own JIT, module and assembly callbacks
+  uint64_t profiler_overhead_ns;
+};
+
+// Number of 64-bit words in a RuntimeMetricsSnapshot.
+const size_t kRuntimeMetricsSnapshotWords =
+    sizeof(RuntimeMetricsSnapshot) / sizeof(uint64_t);
+static_assert(sizeof(RuntimeMetricsSnapshot) % sizeof(uint64_t) == 0,
+              "RuntimeMetricsSnapshot must be made of 64-bit words");
+
+// RuntimeMetrics keeps cheap counters updated by the profiler callbacks and
+// runs a collector thread that copies them, together with the GC timeline
+// totals, into a double-buffered snapshot at a fixed interval.
+//
+// The collector is the only writer: it fills the buffer readers are not
+// looking at and then flips the published version. Each buffer is a seqlock:
+// its sequence is odd while it is written, and readers copy it word by word
+// with atomic loads and retry if the sequence changed meanwhile, so Read never
+// blocks, never allocates and never returns a torn snapshot.
+class RuntimeMetrics {
+ private:
+  struct Buffer {
+    std::atomic<uint64_t> sequence{0};
+    std::atomic<uint64_t> words[kRuntimeMetricsSnapshotWords];
+  };
+
+  const GcTimeline* gc_timeline_ = nullptr;
+  uint64_t interval_ms_ = kDefaultRuntimeMetricsInterval;
+  std::atomic<bool> enabled_{false};
+
+  std::atomic<int64_t> thread_count_{0};
+  std::atomic<uint64_t> jit_count_{0};
+  std::atomic<uint64_t> jit_time_ns_{0};
+  std::atomic<int64_t> module_count_{0};
+  std::atomic<int64_t> assembly_count_{0};
+  std::atomic<uint64_t> overhead_ns_{0};
+
+  Buffer buffers_[2];
+  std::atomic<uint64_t> version_{0};
+
+  // only touched by the collector thread
+  uint64_t gc_cursor_ = 0;
+  uint64_t generation_sizes_[kGcGenerationCount]{};
+
+  std::thread collector_;
+  std::mutex stop_lock_;
+  std::condition_variable stop_signal_;
+  bool stop_requested_ = false;
+
+  void Collect();
+
+ public:
+  RuntimeMetrics() = default;
+  RuntimeMetrics(const RuntimeMetrics&) = delete;
+  RuntimeMetrics& operator=(const RuntimeMetrics&) = delete;
+  ~RuntimeMetrics();
+
+  // Initialize starts the collector thread. gc_timeline may be disabled.
+  void Initialize(const GcTimeline* gc_timeline, uint64_t interval_ms);
+
+  // Stop signals the collector thread and waits for it to exit.
+  void Stop();
+
+  bool IsEnabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+  void OnThreadCreated() {
+    thread_count_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void OnThreadDestroyed() {
+    thread_count_.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  void OnModuleLoaded() {
+    module_count_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void OnModuleUnloaded() {
+    module_count_.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  void OnAssemblyLoaded() {
+    assembly_count_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void OnAssemblyUnloaded() {
+    assembly_count_.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  // OnJitStarted and OnJitFinished must be called from JITCompilationStarted
+  // and JITCompilationFinished on the compiling thread. Nested compilations
+  // are folded into the outermost one. OnJitFinished returns the duration of
+  // the outermost compilation when it finishes, 0 otherwise.
+  void OnJitStarted();
+  uint64_t OnJitFinished();
+
+  void AddOverhead(uint64_t nanoseconds) {
+    overhead_ns_.fetch_add(nanoseconds, std::memory_order_relaxed);
+  }
+
+  // Sample publishes a snapshot of the counters. Called by the collector
+  // thread: there must be a single caller at a time.
+  void Sample();
+
+  // Read copies the latest snapshot into metrics. Returns false if no
+  // snapshot was published yet.
+  bool Read(RuntimeMetricsSnapshot* metrics) const;
+};
+
+// OverheadScope adds the time between its construction and destruction to
+// the profiler overhead, and to the overhead budget if one is given. Put one
+// at the top of a profiler callback.
+class OverheadScope {
+ private:
+  RuntimeMetrics& metrics_;
+  OverheadBudget* const budget_;
+  const uint64_t start_;
+
+ public:
+  explicit OverheadScope(RuntimeMetrics& metrics,
+                         OverheadBudget* budget = nullptr)
+      : metrics_(metrics),
+        budget_(budget != nullptr && budget->IsEnabled() ? budget : nullptr),
+        start_(metrics.IsEnabled() || budget_ != nullptr
+                   ? MonotonicNanoseconds()
+                   : 0) {}
+
+  OverheadScope(const OverheadScope&) = delete;
+  OverheadScope& operator=(const OverheadScope&) = delete;
+
+  ~OverheadScope() {
+    if (start_ == 0) {
+      return;
+    }
+
+    const auto now = MonotonicNanoseconds();
+    if (metrics_.IsEnabled()) {
+      metrics_.AddOverhead(now - start_);
+    }
+    if (budget_ != nullptr) {
+      budget_->AddOverhead(now - start_, now);
+    }
+  }
+};
+
+}  // namespace trace
+
+#endif  // DD_CLR_PROFILER_RUNTIME_METRICS_H_
@@ -0,0 +1,198 @@
+#include "span_context.h"
+
+#include <new>
+
+#include "logging.h"
+
+namespace trace {
+
+namespace {
+
+// Times Get retries while the owner is writing the ids.
+const int kSpanContextReadAttempts = 4;
+
+// Owner of a slot that is being cleared by the thread that acquired it.
+// ThreadIDs are pointers and never take this value.
+const ThreadID kAcquiringOwner = ~static_cast<ThreadID>(0);
+
+// the slot of the calling thread, valid while it is still owned by owner
+struct CachedSlot {
+  SpanContextSlot* slot = nullptr;
+  ThreadID owner = 0;
+  // the table the thread found full, and its release count at the time
+  const SpanContextTable* full_table = nullptr;
+  uint64_t full_release_count = 0;
+};
+
+thread_local CachedSlot cached_slot;
+
+}  // namespace
+
+void SpanContextSlot::Set(uint64_t trace_id, uint64_t span_id) {
+  const auto sequence = sequence_.load(std::memory_order_relaxed);
+  sequence_.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  trace_id_.store(trace_id, std::memory_order_relaxed);
+  span_id_.store(span_id, std::memory_order_relaxed);
+  jit_count_.store(0, std::memory_order_relaxed);
+  jit_time_ns_.store(0, std::memory_order_relaxed);
+  module_loads_.store(0, std::memory_order_relaxed);
+  warnings_.store(0, std::memory_order_relaxed);
+
+  sequence_.store(sequence + 2, std::memory_order_release);
+}
+
+bool SpanContextSlot::Get(SpanContext* context) const {
+  for (int attempt = 0; attempt < kSpanContextReadAttempts; attempt++) {
+    const auto before = sequence_.load(std::memory_order_acquire);
+    if ((before & 1) != 0) {
+      continue;
+    }
+
+    context->trace_id = trace_id_.load(std::memory_order_relaxed);
+    context->span_id = span_id_.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    if (sequence_.load(std::memory_order_relaxed) == before) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void SpanContextSlot::ReadCost(SpanNativeCost* cost) const {
+  cost->trace_id = trace_id_.load(std::memory_order_relaxed);
+  cost->span_id = span_id_.load(std::memory_order_relaxed);
+  cost->jit_count = jit_count_.load(std::memory_order_relaxed);
+  cost->jit_time_ns = jit_time_ns_.load(std::memory_order_relaxed);
+  cost->module_loads = module_loads_.load(std::memory_order_relaxed);
+  cost->warnings = warnings_.load(std::memory_order_relaxed);
+}
+
+SpanContextSlot* CurrentSpanContextSlot() {
+  const auto& cached = cached_slot;
+
+  if (cached.slot == nullptr || cached.slot->Owner() != cached.owner) {
+    return nullptr;
+  }
+  return cached.slot;
+}
+
+SpanContextTable::~SpanContextTable() {
+  auto& cached = cached_slot;
+  if (cached.slot >= slots_ && cached.slot < slots_ + capacity_) {
+    cached.slot = nullptr;
+  }
+  if (cached.full_table == this) {
+    cached.full_table = nullptr;
+  }
+
+  for (size_t i = 0; i < capacity_; i++) {
+    slots_[i].~SpanContextSlot();
+  }
+}
+
+void SpanContextTable::Initialize(size_t capacity) {
+  storage_.reset(
+      new char[capacity * sizeof(SpanContextSlot) + kCacheLineSize]);
+
+  auto address = reinterpret_cast<uintptr_t>(storage_.get());
+  address = (address + kCacheLineSize - 1) & ~(kCacheLineSize - 1);
+  slots_ = reinterpret_cast<SpanContextSlot*>(address);
+
+  for (size_t i = 0; i < capacity; i++) {
+    new (&slots_[i]) SpanContextSlot();
+  }
+  capacity_ = capacity;
+}
+
+SpanContextSlot* SpanContextTable::Acquire(ThreadID thread_id) {
+  auto& cached = cached_slot;
+  const auto release_count = release_count_.load(std::memory_order_acquire);
+
+  if (cached.full_table == this &&
+      cached.full_release_count == release_count) {
+    return nullptr;
+  }
+
+  for (size_t i = 0; i < capacity_; i++) {
+    auto& slot = slots_[i];
+    ThreadID free = 0;
+
+    if (!slot.owner_.compare_exchange_strong(free, kAcquiringOwner,
+                                             std::memory_order_acq_rel)) {
+      continue;
+    }
+
+    // the previous owner is gone: clear its span before anyone can find the
+    // slot under the new owner
+    slot.Set(0, 0);
+    slot.owner_.store(thread_id, std::memory_order_release);
+
+    auto used = used_slots_.load(std::memory_order_relaxed);
+    while (used < i + 1 && !used_slots_.compare_exchange_weak(
+                               used, i + 1, std::memory_order_release)) {
+    }
+
+    cached.slot = &slot;
+    cached.owner = thread_id;
+    cached.full_table = nullptr;
+    return &slot;
+  }
+
+  cached.full_table = this;
+  cached.full_release_count = release_count;
+
+  if (capacity_ > 0 &&
+      !full_logged_.exchange(true, std::memory_order_relaxed)) {
+    Warn("Span context table full: threads beyond the first ", capacity_,
+         " are not tagged with their span.");
+  }
+  return nullptr;
+}
+
+void SpanContextTable::Release(ThreadID thread_id) {
+  const auto used = used_slots_.load(std::memory_order_acquire);
+
+  for (size_t i = 0; i < used; i++) {
+    auto& slot = slots_[i];
+
+    auto owner = thread_id;
+    if (slot.owner_.compare_exchange_strong(owner, 0,
+                                            std::memory_order_acq_rel)) {
+      release_count_.fetch_add(1, std::memory_order_release);
+      return;
+    }
+  }
+}
+
+bool SpanContextTable::Find(ThreadID thread_id, SpanContext* context) const {
+  const auto used = used_slots_.load(std::memory_order_acquire);
+
+  for (size_t i = 0; i < used; i++) {
+    const auto& slot = slots_[i];
+
+    if (slot.Owner() == thread_id) {
+      return slot.Get(context) && slot.Owner() == thread_id;
+    }
+  }
+
+  return false;
+}
+
+size_t SpanContextTable::SlotCount() const {
+  size_t count = 0;
+  const auto used = used_slots_.load(std::memory_order_acquire);
+
+  for (size_t i = 0; i < used; i++) {
+    if (slots_[i].Owner() != 0) {
+      count++;
+    }
+  }
+
+  return count;
+}
+
+}  // namespace trace
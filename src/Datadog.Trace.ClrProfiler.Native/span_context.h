@@ -0,0 +1,143 @@
+#ifndef DD_CLR_PROFILER_SPAN_CONTEXT_H_
+#define DD_CLR_PROFILER_SPAN_CONTEXT_H_
+
+#include <corhlpr.h>
+#include <corprof.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace trace {
+
+// Size of a cache line. Slots are aligned on it so that threads writing their
+// own slot never share a line.
+const size_t kCacheLineSize = 64;
+
+// Default number of threads that can have a span context at the same time.
+// Threads beyond it are not tagged.
+const size_t kDefaultSpanContextSlots = 1024;
+
+struct SpanContext {
+  uint64_t trace_id = 0;
+  uint64_t span_id = 0;
+};
+
+// SpanNativeCost is what the profiler observed on a thread since its current
+// span was set, handed to managed code by GetCurrentSpanNativeCost in
+// interop.cpp. It is blittable: keep its layout in sync with the managed
+// definition.
+struct SpanNativeCost {
+  uint64_t trace_id;
+  uint64_t span_id;
+  uint64_t jit_count;
+  uint64_t jit_time_ns;
+  uint64_t module_loads;
+  uint64_t warnings;
+};
+
+// SpanContextSlot holds the span a managed thread is working on, set by the
+// managed scope manager on every scope change, and the native cost observed
+// on the thread since.
+//
+// Only the owning thread writes it. The ids are published with a sequence
+// counter, so other threads, e.g. a sampler that suspended the owner, read
+// them without locks and never see a torn pair.
+class alignas(kCacheLineSize) SpanContextSlot {
+ private:
+  std::atomic<ThreadID> owner_{0};
+  // odd while the ids are being written
+  std::atomic<uint32_t> sequence_{0};
+  std::atomic<uint64_t> trace_id_{0};
+  std::atomic<uint64_t> span_id_{0};
+  std::atomic<uint64_t> jit_count_{0};
+  std::atomic<uint64_t> jit_time_ns_{0};
+  std::atomic<uint64_t> module_loads_{0};
+  std::atomic<uint64_t> warnings_{0};
+
+  friend class SpanContextTable;
+
+  static void Add(std::atomic<uint64_t>& counter, uint64_t value) {
+    // single writer: no read-modify-write needed
+    counter.store(counter.load(std::memory_order_relaxed) + value,
+                  std::memory_order_relaxed);
+  }
+
+ public:
+  ThreadID Owner() const { return owner_.load(std::memory_order_acquire); }
+
+  // Set switches the slot to another span and resets its cost. Pass zeros
+  // when the thread leaves its last span. Called by the owning thread only.
+  void Set(uint64_t trace_id, uint64_t span_id);
+
+  // Get reads the ids from any thread. Returns false if the owner kept
+  // writing them, or is suspended while writing them.
+  bool Get(SpanContext* context) const;
+
+  void AddJit(uint64_t duration_ns) {
+    Add(jit_count_, 1);
+    Add(jit_time_ns_, duration_ns);
+  }
+
+  void AddModuleLoad() { Add(module_loads_, 1); }
+
+  void AddWarning() { Add(warnings_, 1); }
+
+  // ReadCost is only consistent when called by the owning thread.
+  void ReadCost(SpanNativeCost* cost) const;
+};
+
+static_assert(sizeof(SpanContextSlot) == kCacheLineSize,
+              "a SpanContextSlot must fill exactly one cache line");
+
+// CurrentSpanContextSlot returns the slot of the calling thread, or nullptr if
+// the thread never set a span context or its slot was released. Lock-free.
+SpanContextSlot* CurrentSpanContextSlot();
+
+// SpanContextTable owns a fixed array of slots, one per managed thread that
+// set a span context. A thread acquires its slot the first time it sets a
+// context and caches it in thread-local storage; the slot is released when
+// the runtime destroys the thread.
+class SpanContextTable {
+ private:
+  // raw storage, aligned by hand: new doesn't honor alignas before C++17
+  std::unique_ptr<char[]> storage_;
+  SpanContextSlot* slots_ = nullptr;
+  size_t capacity_ = 0;
+  // slots past this index were never used
+  std::atomic<size_t> used_slots_{0};
+  // incremented by Release, so that threads that found the table full only
+  // scan it again once a slot may be free
+  std::atomic<uint64_t> release_count_{0};
+  std::atomic<bool> full_logged_{false};
+
+ public:
+  SpanContextTable() = default;
+  SpanContextTable(const SpanContextTable&) = delete;
+  SpanContextTable& operator=(const SpanContextTable&) = delete;
+  ~SpanContextTable();
+
+  void Initialize(size_t capacity = kDefaultSpanContextSlots);
+
+  bool IsEnabled() const { return slots_ != nullptr; }
+
+  // Acquire claims a free slot for thread_id, the calling thread, clears it
+  // and makes it the current slot of the thread. Returns nullptr if none is
+  // free; the calling thread then doesn't scan the table again until a slot
+  // is released.
+  SpanContextSlot* Acquire(ThreadID thread_id);
+
+  // Release frees the slot of thread_id, if any, from any thread. Called from
+  // ThreadDestroyed. The slot is only cleared by its next owner.
+  void Release(ThreadID thread_id);
+
+  // Find reads the span context of thread_id from any thread. Returns false
+  // if the thread has no slot or its ids couldn't be read.
+  bool Find(ThreadID thread_id, SpanContext* context) const;
+
+  size_t SlotCount() const;
+};
+
+}  // namespace trace
+
+#endif  // DD_CLR_PROFILER_SPAN_CONTEXT_H_
@@ -0,0 +1,370 @@
+#include "sql_obfuscator.h"
+
+#include <cstring>
+
+#include "util.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DD_SQL_SSE2 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+namespace trace {
+
+namespace {
+
+inline bool IsSpace(WCHAR c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f' ||
+         c == '\v';
+}
+
+inline bool IsDigit(WCHAR c) { return c >= '0' && c <= '9'; }
+
+inline bool IsHexDigit(WCHAR c) {
+  return IsDigit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+// '#' starts SQL Server temporary table names, anything outside ASCII is
+// assumed to be a letter
+inline bool IsIdentifierStart(WCHAR c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' ||
+         c == '#' || c >= 0x80;
+}
+
+inline bool IsIdentifierPart(WCHAR c) {
+  return IsIdentifierStart(c) || IsDigit(c) || c == '$' || c == '@';
+}
+
+// EqualsIgnoreCase compares a token with an upper-case ASCII keyword.
+bool EqualsIgnoreCase(const WCHAR* token, size_t length, const char* keyword) {
+  for (size_t i = 0; i < length; i++) {
+    if (keyword[i] == 0) {
+      return false;
+    }
+    WCHAR c = token[i];
+    if (c >= 'a' && c <= 'z') {
+      c = static_cast<WCHAR>(c - 'a' + 'A');
+    }
+    if (c != static_cast<WCHAR>(keyword[i])) {
+      return false;
+    }
+  }
+  return keyword[length] == 0;
+}
+
+// FindChar returns the position of the first c in str[from, length), or
+// length if there is none.
+size_t FindChar(const WCHAR* str, size_t from, size_t length, WCHAR c) {
+  size_t i = from;
+
+#ifdef DD_SQL_SSE2
+  const __m128i needle = _mm_set1_epi16(static_cast<short>(c));
+
+  for (; i + 8 <= length; i += 8) {
+    const __m128i chars =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i));
+    const int mask = _mm_movemask_epi8(_mm_cmpeq_epi16(chars, needle));
+    if (mask != 0) {
+      // two mask bits per code unit
+#ifdef _MSC_VER
+      unsigned long bit;
+      _BitScanForward(&bit, static_cast<unsigned long>(mask));
+      return i + bit / 2;
+#else
+      return i + static_cast<size_t>(__builtin_ctz(mask)) / 2;
+#endif
+    }
+  }
+#endif
+
+  for (; i < length; i++) {
+    if (str[i] == c) {
+      return i;
+    }
+  }
+
+  return length;
+}
+
+// SkipQuoted returns the position after the quote closing a token that
+// started before from, a doubled quote being an escaped one.
+size_t SkipQuoted(const WCHAR* str, size_t from, size_t length, WCHAR quote) {
+  while (true) {
+    const auto end = FindChar(str, from, length, quote);
+    if (end == length) {
+      return length;
+    }
+
+    if (end + 1 < length && str[end + 1] == quote) {
+      from = end + 2;
+      continue;
+    }
+
+    return end + 1;
+  }
+}
+
+// SkipBlockComment returns the position after the "*/" closing a comment
+// whose content starts at from.
+size_t SkipBlockComment(const WCHAR* str, size_t from, size_t length) {
+  while (true) {
+    const auto star = FindChar(str, from, length, '*');
+    if (star + 1 >= length) {
+      return length;
+    }
+
+    if (str[star + 1] == '/') {
+      return star + 2;
+    }
+
+    from = star + 1;
+  }
+}
+
+size_t SkipIdentifier(const WCHAR* str, size_t from, size_t length) {
+  while (from < length && IsIdentifierPart(str[from])) {
+    from++;
+  }
+  return from;
+}
+
+size_t SkipDigits(const WCHAR* str, size_t from, size_t length) {
+  while (from < length && IsDigit(str[from])) {
+    from++;
+  }
+  return from;
+}
+
+size_t SkipNumber(const WCHAR* str, size_t from, size_t length) {
+  if (str[from] == '0' && from + 1 < length &&
+      (str[from + 1] == 'x' || str[from + 1] == 'X')) {
+    from += 2;
+    while (from < length && IsHexDigit(str[from])) {
+      from++;
+    }
+    return from;
+  }
+
+  from = SkipDigits(str, from, length);
+  if (from < length && str[from] == '.') {
+    from = SkipDigits(str, from + 1, length);
+  }
+
+  if (from < length && (str[from] == 'e' || str[from] == 'E')) {
+    auto exponent = from + 1;
+    if (exponent < length && (str[exponent] == '+' || str[exponent] == '-')) {
+      exponent++;
+    }
+    if (exponent < length && IsDigit(str[exponent])) {
+      from = SkipDigits(str, exponent, length);
+    }
+  }
+
+  return from;
+}
+
+// SkipDollarQuoted returns the position after a PostgreSQL dollar-quoted
+// string ($$...$$ or $tag$...$tag$) starting at from, or from if there is
+// none.
+size_t SkipDollarQuoted(const WCHAR* str, size_t from, size_t length) {
+  auto tag_end = from + 1;
+  while (tag_end < length && str[tag_end] != '$') {
+    if (!IsIdentifierPart(str[tag_end])) {
+      return from;
+    }
+    tag_end++;
+  }
+
+  if (tag_end == length) {
+    return from;
+  }
+
+  const auto tag_length = tag_end - from + 1;
+  auto search = tag_end + 1;
+
+  while (true) {
+    const auto end = FindChar(str, search, length, '$');
+    if (end == length) {
+      return length;
+    }
+
+    if (end + tag_length <= length &&
+        std::memcmp(str + end, str + from, tag_length * sizeof(WCHAR)) == 0) {
+      return end + tag_length;
+    }
+
+    search = end + 1;
+  }
+}
+
+}  // namespace
+
+size_t ObfuscateSql(const WCHAR* sql, size_t length, WCHAR* output) {
+  size_t i = 0;
+  size_t o = 0;
+
+  // whitespace or a comment was skipped since the last token
+  bool space = false;
+  // the last token was the keyword IN
+  bool after_in = false;
+  // inside the parentheses after IN, having only seen literals and commas
+  bool in_list = false;
+  bool list_has_literal = false;
+  // output position right after the list's opening parenthesis
+  size_t list_start = 0;
+
+  while (i < length) {
+    const WCHAR c = sql[i];
+    const WCHAR next = i + 1 < length ? sql[i + 1] : 0;
+
+    if (IsSpace(c)) {
+      i++;
+      space = true;
+      continue;
+    }
+
+    if (c == '-' && next == '-') {
+      i = FindChar(sql, i + 2, length, '\n');
+      space = true;
+      continue;
+    }
+
+    if (c == '/' && next == '*') {
+      i = SkipBlockComment(sql, i + 2, length);
+      space = true;
+      continue;
+    }
+
+    const size_t start = i;
+    bool literal = false;
+
+    if (c == '\'') {
+      i = SkipQuoted(sql, i + 1, length, '\'');
+      literal = true;
+    } else if (next == '\'' && (c == 'N' || c == 'n' || c == 'E' ||
+                                c == 'e' || c == 'B' || c == 'b' ||
+                                c == 'X' || c == 'x')) {
+      // N'unicode', E'escaped', B'0101' and X'1F' strings
+      i = SkipQuoted(sql, i + 2, length, '\'');
+      literal = true;
+    } else if (IsDigit(c) || (c == '.' && IsDigit(next))) {
+      i = SkipNumber(sql, i, length);
+      literal = true;
+    } else if (c == '?') {
+      i++;
+      literal = true;
+    } else if (c == '@' && next == '@') {
+      // system functions such as @@ROWCOUNT
+      i = SkipIdentifier(sql, i + 2, length);
+    } else if (c == '@' && IsIdentifierStart(next)) {
+      i = SkipIdentifier(sql, i + 1, length);
+      literal = true;
+    } else if (c == ':' && IsIdentifierStart(next) &&
+               (start == 0 || sql[start - 1] != ':')) {
+      // ":name" but not the "::type" cast
+      i = SkipIdentifier(sql, i + 1, length);
+      literal = true;
+    } else if (c == '$' && IsDigit(next)) {
+      i = SkipDigits(sql, i + 1, length);
+      literal = true;
+    } else if (c == '$' && (i = SkipDollarQuoted(sql, i, length)) != start) {
+      literal = true;
+    } else if (c == '"' || c == '`') {
+      i = SkipQuoted(sql, i + 1, length, c);
+    } else if (c == '[' && IsIdentifierStart(next)) {
+      i = FindChar(sql, i + 1, length, ']');
+      i = i < length ? i + 1 : length;
+    } else if (IsIdentifierStart(c)) {
+      i = SkipIdentifier(sql, i, length);
+      literal = EqualsIgnoreCase(sql + start, i - start, "NULL") ||
+                EqualsIgnoreCase(sql + start, i - start, "TRUE") ||
+                EqualsIgnoreCase(sql + start, i - start, "FALSE");
+    } else {
+      i++;
+    }
+
+    if (literal) {
+      list_has_literal = list_has_literal || in_list;
+      if (space && o > 0) {
+        output[o++] = ' ';
+      }
+      space = false;
+      output[o++] = '?';
+      after_in = false;
+      continue;
+    }
+
+    if (in_list) {
+      if (c == ')' && list_has_literal) {
+        o = list_start;
+        output[o++] = '?';
+        output[o++] = ')';
+        in_list = false;
+        space = false;
+        after_in = false;
+        continue;
+      }
+
+      in_list = c == ',';
+    }
+
+    if (space && o > 0) {
+      output[o++] = ' ';
+    }
+    space = false;
+
+    std::memcpy(output + o, sql + start, (i - start) * sizeof(WCHAR));
+    o += i - start;
+
+    if (c == '(' && after_in) {
+      in_list = true;
+      list_has_literal = false;
+      list_start = o;
+    }
+
+    after_in = EqualsIgnoreCase(sql + start, i - start, "IN");
+  }
+
+  return o;
+}
+
+SqlObfuscationCache::SqlObfuscationCache()
+    : entries_(new Entry[kSqlCacheCapacity]) {}
+
+size_t SqlObfuscationCache::Obfuscate(const WCHAR* sql, size_t length,
+                                      WCHAR* output) {
+  if (length > kMaxCachedSqlLength) {
+    return ObfuscateSql(sql, length, output);
+  }
+
+  const auto hash = HashUtf16(sql, length);
+  const auto slot = hash & (kSqlCacheCapacity - 1);
+  auto& entry = entries_[slot];
+  auto& lock = locks_[slot % kLockCount];
+
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    if (entry.hash == hash && entry.sql.length() == length &&
+        std::memcmp(entry.sql.data(), sql, length * sizeof(WCHAR)) == 0) {
+      std::memcpy(output, entry.obfuscated.data(),
+                  entry.obfuscated.length() * sizeof(WCHAR));
+      hits_.fetch_add(1, std::memory_order_relaxed);
+      return entry.obfuscated.length();
+    }
+  }
+
+  const auto obfuscated_length = ObfuscateSql(sql, length, output);
+  misses_.fetch_add(1, std::memory_order_relaxed);
+
+  std::lock_guard<std::mutex> guard(lock);
+  entry.hash = hash;
+  entry.sql.assign(sql, length);
+  entry.obfuscated.assign(output, obfuscated_length);
+  return obfuscated_length;
+}
+
+}  // namespace trace
@@ -0,0 +1,70 @@
+#ifndef DD_CLR_PROFILER_SQL_OBFUSCATOR_H_
+#define DD_CLR_PROFILER_SQL_OBFUSCATOR_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+#include "string.h"
+
+namespace trace {
+
+// Number of statements kept by SqlObfuscationCache. Must be a power of two.
+const size_t kSqlCacheCapacity = 1024;
+
+// Longer statements are obfuscated on every call rather than cached.
+const size_t kMaxCachedSqlLength = 4096;
+
+// ObfuscateSql turns a SQL statement into a low-cardinality resource name in a
+// single pass, writing it to output, and returns its length. The output is
+// never longer than the input, so output must hold length code units; it may
+// not overlap sql.
+//
+//  - string, numeric, boolean and NULL literals, bind variables (@p, :p, $1)
+//    and dollar-quoted strings are replaced with '?'
+//  - lists of literals after IN are collapsed to "(?)"
+//  - comments are removed and runs of whitespace become a single space
+//
+// Identifiers, including quoted ones ("a", [a], `a`), are kept as they are.
+// Scanning for the end of string literals and comments is done 8 code units
+// at a time with SSE2 when available.
+size_t ObfuscateSql(const WCHAR* sql, size_t length, WCHAR* output);
+
+// SqlObfuscationCache remembers the obfuscated form of recently seen
+// statements, which repeat a lot in practice, in a direct-mapped table keyed
+// by HashUtf16. Lookups compare the full statement, so collisions only cost a
+// miss. Slots are guarded by striped locks held just long enough to compare
+// or copy.
+class SqlObfuscationCache {
+ private:
+  struct Entry {
+    uint64_t hash = 0;
+    WSTRING sql;
+    WSTRING obfuscated;
+  };
+
+  static const size_t kLockCount = 64;
+
+  std::unique_ptr<Entry[]> entries_;
+  std::mutex locks_[kLockCount];
+
+  std::atomic<uint64_t> hits_{0};
+  std::atomic<uint64_t> misses_{0};
+
+ public:
+  SqlObfuscationCache();
+  SqlObfuscationCache(const SqlObfuscationCache&) = delete;
+  SqlObfuscationCache& operator=(const SqlObfuscationCache&) = delete;
+
+  // Obfuscate has the same contract as ObfuscateSql.
+  size_t Obfuscate(const WCHAR* sql, size_t length, WCHAR* output);
+
+  uint64_t Hits() const { return hits_.load(std::memory_order_relaxed); }
+  uint64_t Misses() const { return misses_.load(std::memory_order_relaxed); }
+};
+
+}  // namespace trace
+
+#endif  // DD_CLR_PROFILER_SQL_OBFUSCATOR_H_
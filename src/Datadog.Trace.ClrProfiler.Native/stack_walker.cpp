@@ -0,0 +1,67 @@
+#include "stack_walker.h"
+
+namespace trace {
+
+uint64_t CompactStack::Hash() const {
+  // FNV-1a over the frame pointers
+  uint64_t hash = 14695981039346656037ULL;
+  for (uint32_t i = 0; i < frame_count; i++) {
+    hash ^= static_cast<uint64_t>(frames[i]);
+    hash *= 1099511628211ULL;
+  }
+  return hash ^ frame_count;
+}
+
+bool CompactStack::operator==(const CompactStack& other) const {
+  if (frame_count != other.frame_count) {
+    return false;
+  }
+
+  for (uint32_t i = 0; i < frame_count; i++) {
+    if (frames[i] != other.frames[i]) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+namespace {
+
+HRESULT STDMETHODCALLTYPE CaptureFrame(FunctionID function_id, UINT_PTR ip,
+                                       COR_PRF_FRAME_INFO frame_info,
+                                       ULONG32 context_size, BYTE context[],
+                                       void* client_data) {
+  auto stack = static_cast<CompactStack*>(client_data);
+
+  if (function_id == 0) {
+    // native frame
+    return S_OK;
+  }
+
+  stack->frames[stack->frame_count++] = function_id;
+
+  // stop the walk once the buffer is full
+  return stack->frame_count < kMaxStackFrames ? S_OK : S_FALSE;
+}
+
+}  // namespace
+
+HRESULT CaptureStack(ICorProfilerInfo3* info, ThreadID thread_id,
+                     CompactStack* stack) {
+  stack->frame_count = 0;
+
+  const auto hr = info->DoStackSnapshot(thread_id, CaptureFrame,
+                                        COR_PRF_SNAPSHOT_DEFAULT, stack,
+                                        nullptr, 0);
+
+  // CORPROF_E_STACKSNAPSHOT_ABORTED is returned when we stop the walk early,
+  // the frames collected so far are still valid
+  if (FAILED(hr) && stack->frame_count == 0) {
+    return hr;
+  }
+
+  return S_OK;
+}
+
+}  // namespace trace
@@ -0,0 +1,41 @@
+#ifndef DD_CLR_PROFILER_STACK_WALKER_H_
+#define DD_CLR_PROFILER_STACK_WALKER_H_
+
+#include <corhlpr.h>
+#include <corprof.h>
+#include <cstdint>
+
+namespace trace {
+
+// Maximum number of managed frames kept in a CompactStack. Deeper stacks are
+// truncated, keeping the frames closest to the top of the stack.
+const uint32_t kMaxStackFrames = 32;
+
+// CompactStack is a fixed-size list of managed FunctionIDs, innermost first.
+// Native frames are skipped. It is cheap to copy, hash and compare so it can
+// be used directly as an aggregation key.
+struct CompactStack {
+  uint32_t frame_count = 0;
+  FunctionID frames[kMaxStackFrames]{};
+
+  uint64_t Hash() const;
+
+  bool operator==(const CompactStack& other) const;
+};
+
+struct CompactStackHash {
+  size_t operator()(const CompactStack& stack) const {
+    return static_cast<size_t>(stack.Hash());
+  }
+};
+
+// CaptureStack walks the managed stack of thread_id with DoStackSnapshot.
+// Pass 0 to walk the current thread, which is allowed from within profiler
+// callbacks. Walking another thread requires it to be suspended by the caller
+// or the runtime. Requires COR_PRF_ENABLE_STACK_SNAPSHOT in the event mask.
+HRESULT CaptureStack(ICorProfilerInfo3* info, ThreadID thread_id,
+                     CompactStack* stack);
+
+}  // namespace trace
+
+#endif  // DD_CLR_PROFILER_STACK_WALKER_H_
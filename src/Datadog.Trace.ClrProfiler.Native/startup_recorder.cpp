@@ -0,0 +1,177 @@
+#include "startup_recorder.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+#include "logging.h"
+#include "symbol_cache.h"
+
+namespace trace {
+
+void StartupRecorder::Initialize(SymbolCache* symbols, const WSTRING& path,
+                                 uint64_t window_ms, uint64_t start_ns) {
+  symbols_ = symbols;
+  path_ = path;
+  start_ns_ = start_ns;
+  window_ns_ = (window_ms > 0 ? window_ms : kDefaultStartupWindowMs) * 1000000;
+  recording_ = true;
+  enabled_ = true;
+
+  Info("Recording the methods compiled in the first ", window_ns_ / 1000000,
+       " ms to ", path_);
+}
+
+void StartupRecorder::OnModuleLoaded(ModuleID module_id,
+                                     const WSTRING& assembly_name,
+                                     const WSTRING& path, uint64_t now_ns) {
+  std::lock_guard<std::mutex> guard(lock_);
+  if (!recording_ || now_ns - start_ns_ >= window_ns_) {
+    return;
+  }
+
+  modules_.push_back({module_id, assembly_name, path});
+}
+
+void StartupRecorder::OnJitStarted(FunctionID function_id, ModuleID module_id,
+                                   uint64_t now_ns) {
+  std::lock_guard<std::mutex> guard(lock_);
+  if (!recording_) {
+    return;
+  }
+
+  const auto offset_ns = now_ns - start_ns_;
+  if (offset_ns >= window_ns_) {
+    recording_ = false;
+    return;
+  }
+
+  if (methods_.size() >= kMaxStartupMethods) {
+    dropped_methods_++;
+  } else if (seen_.insert(function_id).second) {
+    methods_.push_back({function_id, module_id, offset_ns});
+  }
+}
+
+void StartupRecorder::EvictModule(ModuleID module_id) {
+  std::lock_guard<std::mutex> guard(lock_);
+
+  // the module stays in modules_, so that the indices written for the other
+  // methods do not shift
+  const auto end = std::remove_if(
+      methods_.begin(), methods_.end(), [&](const Method& method) {
+        if (method.module_id != module_id) {
+          return false;
+        }
+        // the FunctionID may be reused for another method
+        seen_.erase(method.function_id);
+        return true;
+      });
+  methods_.erase(end, methods_.end());
+}
+
+bool StartupRecorder::Write() {
+  std::lock_guard<std::mutex> write_guard(write_lock_);
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (written_) {
+      return true;
+    }
+  }
+
+  // written_ is only set by WriteTo, so that a later call tries again if the
+  // file cannot be opened now
+  std::ofstream out(ToString(path_), std::ios::trunc);
+  if (!out.is_open()) {
+    Warn("Unable to write the startup methods to ", path_);
+    return false;
+  }
+
+  const auto written = WriteTo(out);
+  Info("Wrote ", written, " startup methods to ", path_);
+  return true;
+}
+
+size_t StartupRecorder::WriteTo(std::ostream& out) {
+  std::vector<Method> methods;
+  std::vector<Module> modules;
+  uint64_t dropped_methods;
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    recording_ = false;
+    written_ = true;
+    methods.swap(methods_);
+    modules.swap(modules_);
+    seen_.clear();
+    dropped_methods = dropped_methods_;
+  }
+
+  out << "# methods JIT-compiled in the first " << window_ns_ / 1000000
+      << " ms, in order\n";
+  if (dropped_methods > 0) {
+    out << "# " << dropped_methods << " more methods were not recorded\n";
+  }
+
+  // a ModuleID may be reused after an unload: the last load wins, the
+  // methods of the unloaded module were evicted
+  std::unordered_map<ModuleID, int64_t> module_indices;
+  out << "[modules]\n";
+  for (size_t i = 0; i < modules.size(); i++) {
+    module_indices[modules[i].module_id] = static_cast<int64_t>(i);
+    out << ToString(modules[i].assembly_name) << '\t'
+        << ToString(modules[i].path) << '\n';
+  }
+
+  out << "[methods]\n";
+  size_t written = 0;
+  for (const auto& method : methods) {
+    if (WriteMethod(out, method, module_indices)) {
+      written++;
+    }
+  }
+
+  out.flush();
+  return written;
+}
+
+bool StartupRecorder::WriteMethod(
+    std::ostream& out, const Method& method,
+    const std::unordered_map<ModuleID, int64_t>& module_indices) {
+  if (symbols_ == nullptr) {
+    return false;
+  }
+
+  const auto symbol = symbols_->GetOrResolve(method.function_id);
+  if (symbol == nullptr || symbol->name == nullptr) {
+    return false;
+  }
+
+  // -1 if the module was not recorded
+  const auto module = module_indices.find(method.module_id);
+  const int64_t module_index =
+      module != module_indices.end() ? module->second : -1;
+
+  out << method.offset_ns / 1000000 << '\t' << module_index << '\t'
+      << std::hex << std::setfill('0') << std::setw(8) << symbol->token
+      << std::dec << std::setfill(' ') << '\t' << ToString(*symbol->name);
+
+  const auto& type_args = symbol->type_args;
+  if (!type_args.empty()) {
+    out << '[';
+    for (size_t i = 0; i < type_args.size(); i++) {
+      const auto name = symbols_->GetOrResolveClassName(type_args[i]);
+      out << (i > 0 ? "," : "") << (name != nullptr ? ToString(*name) : "?");
+    }
+    out << ']';
+  }
+
+  out << '\n';
+  return true;
+}
+
+size_t StartupRecorder::MethodCount() {
+  std::lock_guard<std::mutex> guard(lock_);
+  return methods_.size();
+}
+
+}  // namespace trace
@@ -0,0 +1,128 @@
+#ifndef DD_CLR_PROFILER_STARTUP_RECORDER_H_
+#define DD_CLR_PROFILER_STARTUP_RECORDER_H_
+
+#include <corhlpr.h>
+#include <corprof.h>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "string.h"
+
+namespace trace {
+
+class SymbolCache;
+
+// Default length of the recorded startup window in milliseconds.
+const uint64_t kDefaultStartupWindowMs = 30000;
+
+// Maximum number of methods recorded. Startup rarely compiles more.
+const size_t kMaxStartupMethods = 256 * 1024;
+
+// StartupRecorder records the methods JIT-compiled during the first
+// milliseconds of the process, in the order they were first compiled, and
+// the modules loaded meanwhile. The list is meant to pick the methods to
+// precompile with ReadyToRun (crossgen), to cut cold-start time.
+//
+// Recording is a hash set lookup and an append under a lock: names are only
+// resolved, through the SymbolCache, when the list is written. Nothing is
+// written from JIT callbacks; the list is written once, by Write, from
+// Shutdown or from the managed side through WriteStartupMethods.
+//
+// The file has a [modules] section, one "assembly<TAB>path" per line, and a
+// [methods] section, one
+// "offset_ms<TAB>module<TAB>token<TAB>Assembly!Namespace.Type.Method" per
+// line, where module is the index of the method's module in [modules] and
+// token its hexadecimal mdMethodDef token, which tells overloads apart.
+// Generic instantiations are followed by their type arguments,
+// "[Arg1,Arg2]", those of the type first. Lines starting with '#' are
+// comments.
+//
+// Methods of unloaded modules are left out: their FunctionIDs are no longer
+// valid by the time the list is written.
+class StartupRecorder {
+ private:
+  struct Method {
+    FunctionID function_id;
+    ModuleID module_id;
+    uint64_t offset_ns;
+  };
+
+  struct Module {
+    ModuleID module_id;
+    WSTRING assembly_name;
+    WSTRING path;
+  };
+
+  SymbolCache* symbols_ = nullptr;
+  WSTRING path_;
+  uint64_t start_ns_ = 0;
+  uint64_t window_ns_ = 0;
+  bool enabled_ = false;
+
+  // held by Write, so that the file is only opened once
+  std::mutex write_lock_;
+
+  std::mutex lock_;
+  // read without the lock by IsRecording
+  std::atomic<bool> recording_{false};
+  bool written_ = false;
+  std::vector<Method> methods_;
+  std::unordered_set<FunctionID> seen_;
+  std::vector<Module> modules_;
+  uint64_t dropped_methods_ = 0;
+
+  // WriteMethod writes the line of one method. Returns false if it cannot be
+  // resolved.
+  bool WriteMethod(
+      std::ostream& out, const Method& method,
+      const std::unordered_map<ModuleID, int64_t>& module_indices);
+
+ public:
+  StartupRecorder() = default;
+  StartupRecorder(const StartupRecorder&) = delete;
+  StartupRecorder& operator=(const StartupRecorder&) = delete;
+
+  // Initialize starts recording at start_ns. symbols may be null in tests:
+  // methods are then not named.
+  void Initialize(SymbolCache* symbols, const WSTRING& path,
+                  uint64_t window_ms, uint64_t start_ns);
+
+  bool IsEnabled() const { return enabled_; }
+
+  // IsRecording is false once the window is over or the list was written.
+  bool IsRecording() const {
+    return recording_.load(std::memory_order_relaxed);
+  }
+
+  // OnModuleLoaded must be called from ModuleLoadFinished.
+  void OnModuleLoaded(ModuleID module_id, const WSTRING& assembly_name,
+                      const WSTRING& path, uint64_t now_ns);
+
+  // OnJitStarted must be called from JITCompilationStarted. Recording stops
+  // with the first compilation after the window.
+  void OnJitStarted(FunctionID function_id, ModuleID module_id,
+                    uint64_t now_ns);
+
+  // EvictModule must be called from ModuleUnloadStarted: it forgets the
+  // methods of the module.
+  void EvictModule(ModuleID module_id);
+
+  // Write stops recording and writes the list to the configured path, if it
+  // was not written yet. Returns false if it could not be written now.
+  bool Write();
+
+  // WriteTo stops recording and writes the list to out. Returns the number of
+  // methods written.
+  size_t WriteTo(std::ostream& out);
+
+  size_t MethodCount();
+};
+
+}  // namespace trace
+
+#endif  // DD_CLR_PROFILER_STARTUP_RECORDER_H_
@@ -0,0 +1,569 @@
+#include "symbol_cache.h"
+
+#include <algorithm>
+
+#include "clr_helpers.h"
+#include "logging.h"
+
+namespace trace {
+
+namespace {
+
+// Key of a slot left behind by an evicted symbol. FunctionIDs are aligned
+// pointers, so it never collides with one. Lookups probe past such slots and
+// inserts reuse them.
+const FunctionID kEvictedFunctionId = 1;
+
+// The code range index is rebuilt once the pending ranges reach this
+// fraction of it, so rebuilds stay amortized O(1) per range.
+const size_t kCodeRangeRebuildRatio = 8;
+
+}  // namespace
+
+void SymbolCache::Initialize(ICorProfilerInfo3* info, size_t capacity) {
+  std::lock_guard<std::mutex> guard(lock_);
+
+  size_t size = 1;
+  while (size < capacity) {
+    size <<= 1;
+  }
+
+  info_ = info;
+  slots_.reset(new Slot[size]);
+  for (size_t i = 0; i < size; i++) {
+    slots_[i].function_id.store(0, std::memory_order_relaxed);
+    slots_[i].symbol.store(nullptr, std::memory_order_relaxed);
+  }
+  mask_ = size - 1;
+  used_slots_ = 0;
+  evicted_slots_ = 0;
+}
+
+size_t SymbolCache::SlotIndex(FunctionID function_id) const {
+  // FunctionIDs are aligned pointers: drop the low bits and use a
+  // multiplicative hash to spread them over the table
+  const uint64_t hash =
+      static_cast<uint64_t>(function_id >> 3) * 0x9E3779B97F4A7C15ULL;
+  return static_cast<size_t>(hash >> 32) & mask_;
+}
+
+const MethodSymbol* SymbolCache::Find(FunctionID function_id) const {
+  if (!slots_ || function_id == 0) {
+    return nullptr;
+  }
+
+  for (size_t i = SlotIndex(function_id), probes = 0; probes <= mask_;
+       i = (i + 1) & mask_, probes++) {
+    const auto key = slots_[i].function_id.load(std::memory_order_acquire);
+    if (key == function_id) {
+      // the slot may have been evicted and reused since its key was read
+      const auto symbol = slots_[i].symbol.load(std::memory_order_acquire);
+      return symbol != nullptr && symbol->function_id == function_id ? symbol
+                                                                     : nullptr;
+    }
+    if (key == 0) {
+      return nullptr;
+    }
+  }
+
+  return nullptr;
+}
+
+const MethodSymbol* SymbolCache::GetOrResolve(FunctionID function_id) {
+  const auto cached = Find(function_id);
+  if (cached != nullptr) {
+    return cached;
+  }
+
+  std::lock_guard<std::mutex> guard(lock_);
+  return ResolveLocked(function_id);
+}
+
+const MethodSymbol* SymbolCache::GetOrResolveFromIP(UINT_PTR ip) {
+  FunctionID function_id = 0;
+
+  // seq_cst pairs with the load of code_range_readers_ in
+  // PublishCodeRangesLocked: an index retired after this load is not freed
+  // until the count drops
+  code_range_readers_.fetch_add(1);
+  const auto index = code_range_index_.load();
+  if (index != nullptr) {
+    const auto range = FindCodeRange(*index, ip);
+    if (range != nullptr) {
+      function_id = range->function_id;
+    }
+  }
+  code_range_readers_.fetch_sub(1);
+
+  if (function_id != 0) {
+    const auto cached = Find(function_id);
+    if (cached != nullptr) {
+      return cached;
+    }
+  }
+
+  std::lock_guard<std::mutex> guard(lock_);
+
+  if (function_id == 0) {
+    auto it = pending_ranges_.upper_bound(ip);
+    if (it != pending_ranges_.begin()) {
+      --it;
+      if (ip < it->second.end) {
+        function_id = it->second.function_id;
+      }
+    }
+  }
+
+  if (function_id == 0) {
+    function_id = IndexCodeRangesLocked(ip);
+    if (function_id == 0) {
+      return nullptr;
+    }
+  }
+
+  return ResolveLocked(function_id);
+}
+
+const WSTRING* SymbolCache::GetOrResolveClassName(ClassID class_id) {
+  std::lock_guard<std::mutex> guard(lock_);
+
+  const auto symbol = ResolveClassLocked(class_id);
+  return symbol == nullptr ? nullptr : &symbol->name;
+}
+
+const MethodSymbol* SymbolCache::Add(FunctionID function_id,
+                                     ModuleID module_id, mdToken token,
+                                     const WSTRING& name,
+                                     const std::vector<ClassID>& type_args) {
+  std::lock_guard<std::mutex> guard(lock_);
+
+  auto& module = modules_[module_id];
+  if (module == nullptr) {
+    module.reset(new ModuleSymbols());
+  }
+
+  const auto interned = &*module->names.insert(name).first;
+  module->names_by_token[token] = interned;
+  return AddLocked(module.get(), function_id, module_id, token, interned,
+                   type_args);
+}
+
+void SymbolCache::AddClass(ClassID class_id, ModuleID module_id,
+                           const WSTRING& name) {
+  std::lock_guard<std::mutex> guard(lock_);
+
+  auto& symbol = classes_[class_id];
+  if (symbol != nullptr) {
+    retired_classes_.push_back(std::move(symbol));
+  }
+  symbol.reset(new ClassSymbol{name, module_id});
+}
+
+void SymbolCache::AddCodeRange(UINT_PTR start, UINT_PTR size,
+                               FunctionID function_id, ModuleID module_id) {
+  std::lock_guard<std::mutex> guard(lock_);
+  AddCodeRangeLocked({start, start + size, function_id, module_id});
+}
+
+void SymbolCache::EvictModule(ModuleID module_id) {
+  std::lock_guard<std::mutex> guard(lock_);
+
+  for (auto it = classes_.begin(); it != classes_.end();) {
+    if (it->second->module_id == module_id) {
+      retired_classes_.push_back(std::move(it->second));
+      it = classes_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  for (auto it = pending_ranges_.begin(); it != pending_ranges_.end();) {
+    if (it->second.module_id == module_id) {
+      it = pending_ranges_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  if (published_ranges_ != nullptr) {
+    PublishCodeRangesLocked(module_id);
+  }
+
+  const auto module = modules_.find(module_id);
+  if (module == modules_.end()) {
+    return;
+  }
+
+  for (auto& symbol : module->second->symbols) {
+    if (overflow_.erase(symbol->function_id) > 0) {
+      continue;
+    }
+
+    for (size_t i = SlotIndex(symbol->function_id), probes = 0;
+         probes <= mask_; i = (i + 1) & mask_, probes++) {
+      const auto key = slots_[i].function_id.load(std::memory_order_relaxed);
+      if (key == symbol->function_id &&
+          slots_[i].symbol.load(std::memory_order_relaxed) == symbol.get()) {
+        // keep the slot non-empty so the probe chains through it stay intact
+        slots_[i].function_id.store(kEvictedFunctionId,
+                                    std::memory_order_release);
+        slots_[i].symbol.store(nullptr, std::memory_order_release);
+        used_slots_--;
+        evicted_slots_++;
+
+        // evicted slots that end a chain hold no chain together: empty them,
+        // back to the previous live or empty slot
+        const auto next = (i + 1) & mask_;
+        if (slots_[next].function_id.load(std::memory_order_relaxed) == 0) {
+          size_t j = i;
+          while (slots_[j].function_id.load(std::memory_order_relaxed) ==
+                 kEvictedFunctionId) {
+            slots_[j].function_id.store(0, std::memory_order_release);
+            evicted_slots_--;
+            j = (j - 1) & mask_;
+          }
+        }
+        break;
+      }
+      if (key == 0) {
+        break;
+      }
+    }
+  }
+
+  Debug("SymbolCache evicted ", module->second->symbols.size(),
+        " symbols for module ", module_id);
+
+  // lock-free readers may still hold the symbols and their names: keep them,
+  // but release what only resolution needs
+  module->second->metadata_import.Reset();
+  module->second->names_by_token.clear();
+  retired_modules_.push_back(std::move(module->second));
+  modules_.erase(module);
+}
+
+SymbolCache::ModuleSymbols* SymbolCache::GetModuleSymbols(ModuleID module_id) {
+  const auto existing = modules_.find(module_id);
+  if (existing != modules_.end()) {
+    return existing->second.get();
+  }
+
+  ComPtr<IUnknown> metadata_interfaces;
+  auto hr = info_->GetModuleMetaData(module_id, ofRead, IID_IMetaDataImport2,
+                                     metadata_interfaces.GetAddressOf());
+  if (FAILED(hr)) {
+    return nullptr;
+  }
+
+  const auto module_info = GetModuleInfo(info_, module_id);
+
+  std::unique_ptr<ModuleSymbols> module(new ModuleSymbols());
+  module->metadata_import =
+      metadata_interfaces.As<IMetaDataImport2>(IID_IMetaDataImport);
+  module->assembly_name = module_info.assembly.name;
+
+  const auto result = module.get();
+  modules_[module_id] = std::move(module);
+  return result;
+}
+
+const MethodSymbol* SymbolCache::ResolveLocked(FunctionID function_id) {
+  if (function_id == 0) {
+    return nullptr;
+  }
+
+  // another thread may have resolved it while we waited for the lock
+  const auto cached = Find(function_id);
+  if (cached != nullptr) {
+    return cached;
+  }
+
+  const auto overflow = overflow_.find(function_id);
+  if (overflow != overflow_.end()) {
+    return overflow->second;
+  }
+
+  if (info_ == nullptr) {
+    return nullptr;
+  }
+
+  ClassID class_id = 0;
+  ModuleID module_id = 0;
+  mdToken token = mdTokenNil;
+  auto hr = info_->GetFunctionInfo(function_id, &class_id, &module_id, &token);
+  if (FAILED(hr) || module_id == 0) {
+    return nullptr;
+  }
+
+  const auto module = GetModuleSymbols(module_id);
+  if (module == nullptr) {
+    return nullptr;
+  }
+
+  const WSTRING* name = nullptr;
+  const auto interned = module->names_by_token.find(token);
+
+  if (interned != module->names_by_token.end()) {
+    name = interned->second;
+  } else {
+    const auto function_info = GetFunctionInfo(module->metadata_import, token);
+    if (!function_info.IsValid()) {
+      return nullptr;
+    }
+
+    const auto full_name = module->assembly_name + "!"_W +
+                           function_info.type.name + "."_W +
+                           function_info.name;
+    name = &*module->names.insert(full_name).first;
+    module->names_by_token[token] = name;
+  }
+
+  return AddLocked(module, function_id, module_id, token, name,
+                   ReadTypeArgs(function_id));
+}
+
+const MethodSymbol* SymbolCache::AddLocked(
+    ModuleSymbols* module, FunctionID function_id, ModuleID module_id,
+    mdToken token, const WSTRING* name,
+    const std::vector<ClassID>& type_args) {
+  module->symbols.emplace_back(
+      new MethodSymbol(function_id, module_id, token, name, type_args));
+  const MethodSymbol* symbol = module->symbols.back().get();
+  Publish(symbol);
+  return symbol;
+}
+
+std::vector<ClassID> SymbolCache::ReadTypeArgs(FunctionID function_id) {
+  std::vector<ClassID> type_args;
+
+  ClassID class_id = 0;
+  ModuleID module_id = 0;
+  mdToken token = mdTokenNil;
+  ULONG32 method_arg_count = 0;
+  ClassID method_args[kMaxTypeArgs];
+  if (FAILED(info_->GetFunctionInfo2(function_id, 0, &class_id, &module_id,
+                                     &token, kMaxTypeArgs, &method_arg_count,
+                                     method_args))) {
+    return type_args;
+  }
+
+  ULONG32 class_arg_count = 0;
+  ClassID class_args[kMaxTypeArgs];
+  mdTypeDef type_def = mdTokenNil;
+  ClassID parent_class_id = 0;
+  if (class_id != 0 &&
+      SUCCEEDED(info_->GetClassIDInfo2(class_id, &module_id, &type_def,
+                                       &parent_class_id, kMaxTypeArgs,
+                                       &class_arg_count, class_args))) {
+    type_args.assign(class_args,
+                     class_args + std::min(class_arg_count, kMaxTypeArgs));
+  }
+
+  type_args.insert(type_args.end(), method_args,
+                   method_args + std::min(method_arg_count, kMaxTypeArgs));
+  return type_args;
+}
+
+void SymbolCache::Publish(const MethodSymbol* symbol) {
+  size_t evicted = mask_ + 1;
+  size_t empty = mask_ + 1;
+
+  for (size_t i = SlotIndex(symbol->function_id), probes = 0; probes <= mask_;
+       i = (i + 1) & mask_, probes++) {
+    const auto key = slots_[i].function_id.load(std::memory_order_relaxed);
+    if (key == kEvictedFunctionId && evicted > mask_) {
+      evicted = i;
+    }
+    if (key == 0) {
+      empty = i;
+      break;
+    }
+  }
+
+  if (evicted <= mask_) {
+    // the first evicted slot of the chain, readers probing past it for other
+    // keys are not affected
+    slots_[evicted].symbol.store(symbol, std::memory_order_release);
+    slots_[evicted].function_id.store(symbol->function_id,
+                                      std::memory_order_release);
+    used_slots_++;
+    evicted_slots_--;
+    return;
+  }
+
+  // keep the load factor, evicted slots included, under 3/4 so misses stay
+  // short
+  if (empty <= mask_ &&
+      (used_slots_ + evicted_slots_ + 1) * 4 <= (mask_ + 1) * 3) {
+    slots_[empty].symbol.store(symbol, std::memory_order_relaxed);
+    slots_[empty].function_id.store(symbol->function_id,
+                                    std::memory_order_release);
+    used_slots_++;
+    return;
+  }
+
+  overflow_[symbol->function_id] = symbol;
+}
+
+const SymbolCache::ClassSymbol* SymbolCache::ResolveClassLocked(
+    ClassID class_id) {
+  if (class_id == 0) {
+    return nullptr;
+  }
+
+  const auto cached = classes_.find(class_id);
+  if (cached != classes_.end()) {
+    return cached->second.get();
+  }
+
+  if (info_ == nullptr) {
+    return nullptr;
+  }
+
+  CorElementType element_type;
+  ClassID element_class_id = 0;
+  ULONG rank = 0;
+  if (info_->IsArrayClass(class_id, &element_type, &element_class_id, &rank) ==
+      S_OK) {
+    // arrays have no TypeDef of their own, name them after the element type
+    // and let them live as long as the element type's module
+    const auto element = ResolveClassLocked(element_class_id);
+    if (element == nullptr) {
+      return nullptr;
+    }
+
+    const auto dimensions = rank > 1 ? WSTRING(rank - 1, ','_W) : ""_W;
+    auto& symbol = classes_[class_id];
+    symbol.reset(new ClassSymbol{element->name + "["_W + dimensions + "]"_W,
+                                 element->module_id});
+    return symbol.get();
+  }
+
+  ModuleID module_id = 0;
+  mdTypeDef type_def = mdTokenNil;
+  auto hr = info_->GetClassIDInfo(class_id, &module_id, &type_def);
+  if (FAILED(hr) || module_id == 0 || type_def == mdTokenNil) {
+    return nullptr;
+  }
+
+  const auto module = GetModuleSymbols(module_id);
+  if (module == nullptr) {
+    return nullptr;
+  }
+
+  // generic instantiations share the name of their open type, e.g.
+  // "System.Collections.Generic.List`1"
+  const auto type_info = GetTypeInfo(module->metadata_import, type_def);
+  if (!type_info.IsValid()) {
+    return nullptr;
+  }
+
+  auto& symbol = classes_[class_id];
+  symbol.reset(new ClassSymbol{type_info.name, module_id});
+  return symbol.get();
+}
+
+FunctionID SymbolCache::IndexCodeRangesLocked(UINT_PTR ip) {
+  if (info_ == nullptr) {
+    return 0;
+  }
+
+  FunctionID function_id = 0;
+  auto hr = info_->GetFunctionFromIP(reinterpret_cast<LPCBYTE>(ip),
+                                     &function_id);
+  if (FAILED(hr) || function_id == 0) {
+    return 0;
+  }
+
+  ClassID class_id = 0;
+  ModuleID module_id = 0;
+  mdToken token = mdTokenNil;
+  hr = info_->GetFunctionInfo(function_id, &class_id, &module_id, &token);
+  if (FAILED(hr)) {
+    return function_id;
+  }
+
+  ULONG32 range_count = 0;
+  hr = info_->GetCodeInfo2(function_id, 0, &range_count, nullptr);
+  if (FAILED(hr) || range_count == 0) {
+    return function_id;
+  }
+
+  std::vector<COR_PRF_CODE_INFO> ranges(range_count);
+  hr = info_->GetCodeInfo2(function_id, range_count, &range_count,
+                           ranges.data());
+  if (FAILED(hr)) {
+    return function_id;
+  }
+
+  for (ULONG32 i = 0; i < range_count; i++) {
+    AddCodeRangeLocked({ranges[i].startAddress,
+                        ranges[i].startAddress + ranges[i].size, function_id,
+                        module_id});
+  }
+
+  return function_id;
+}
+
+void SymbolCache::AddCodeRangeLocked(const CodeRange& range) {
+  pending_ranges_[range.start] = range;
+
+  const auto published =
+      published_ranges_ == nullptr ? 0 : published_ranges_->size();
+  if (pending_ranges_.size() * kCodeRangeRebuildRatio >= published) {
+    PublishCodeRangesLocked(0);
+  }
+}
+
+void SymbolCache::PublishCodeRangesLocked(ModuleID evicted_module_id) {
+  std::unique_ptr<CodeRangeIndex> index(new CodeRangeIndex());
+  index->reserve((published_ranges_ == nullptr ? 0
+                                               : published_ranges_->size()) +
+                 pending_ranges_.size());
+
+  if (published_ranges_ != nullptr) {
+    for (const auto& range : *published_ranges_) {
+      if (evicted_module_id == 0 || range.module_id != evicted_module_id) {
+        index->push_back(range);
+      }
+    }
+  }
+
+  // both halves are sorted by start address
+  const auto middle = index->size();
+  for (const auto& range : pending_ranges_) {
+    index->push_back(range.second);
+  }
+  std::inplace_merge(index->begin(), index->begin() + middle, index->end(),
+                     [](const CodeRange& a, const CodeRange& b) {
+                       return a.start < b.start;
+                     });
+  pending_ranges_.clear();
+
+  code_range_index_.store(index.get());
+  if (published_ranges_ != nullptr) {
+    retired_ranges_.push_back(std::move(published_ranges_));
+  }
+  published_ranges_ = std::move(index);
+
+  // readers that loaded a retired index have left once the count is zero,
+  // later ones load the new index
+  if (code_range_readers_.load() == 0) {
+    retired_ranges_.clear();
+  }
+}
+
+const SymbolCache::CodeRange* SymbolCache::FindCodeRange(
+    const CodeRangeIndex& index, UINT_PTR ip) {
+  auto it = std::upper_bound(index.begin(), index.end(), ip,
+                             [](UINT_PTR value, const CodeRange& range) {
+                               return value < range.start;
+                             });
+  if (it == index.begin()) {
+    return nullptr;
+  }
+
+  --it;
+  return ip < it->end ? &*it : nullptr;
+}
+
+}  // namespace trace
@@ -0,0 +1,188 @@
+#ifndef DD_CLR_PROFILER_SYMBOL_CACHE_H_
+#define DD_CLR_PROFILER_SYMBOL_CACHE_H_
+
+#include <corhlpr.h>
+#include <corprof.h>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "com_ptr.h"
+#include "string.h"
+
+namespace trace {
+
+// Default number of slots in the FunctionID table. Must be a power of two.
+const size_t kSymbolCacheCapacity = 1 << 16;
+
+// Maximum number of type arguments read for a generic type or method.
+const ULONG32 kMaxTypeArgs = 16;
+
+// MethodSymbol is the resolved name of a jitted method, formatted as
+// "Assembly!Namespace.Type.Method".
+struct MethodSymbol {
+  const FunctionID function_id;
+  const ModuleID module_id;
+  const mdToken token;
+  // interned in the owning module's name table, shared by every FunctionID
+  // (e.g. generic instantiations) that maps to the same method token
+  const WSTRING* const name;
+  // the type arguments of a generic instantiation, those of the declaring
+  // type first, then those of the method
+  const std::vector<ClassID> type_args;
+
+  MethodSymbol(FunctionID function_id, ModuleID module_id, mdToken token,
+               const WSTRING* name, const std::vector<ClassID>& type_args)
+      : function_id(function_id),
+        module_id(module_id),
+        token(token),
+        name(name),
+        type_args(type_args) {}
+};
+
+// SymbolCache maps FunctionIDs and instruction pointers to method names.
+//
+// Lookups of FunctionIDs that were already resolved are lock-free: the table is
+// an open-addressed array of atomics that is only written under lock_.
+// Misses are resolved once through ICorProfilerInfo and the module's metadata,
+// then published. Instruction pointers are mapped to FunctionIDs through an
+// index of jitted code ranges fed by GetFunctionFromIP and GetCodeInfo2. The
+// index is an immutable sorted array, searched without a lock and rebuilt as
+// new ranges accumulate, so only ranges found since the last rebuild are
+// looked up under lock_.
+//
+// EvictModule, which must be called from ModuleUnloadStarted, drops the
+// symbols of a module from the lookups. Their slots are marked evicted and
+// reused by later inserts. Returned symbols and names are never freed while
+// the cache lives, since lock-free readers may still hold them: evicted ones
+// are retired along with their names.
+class SymbolCache {
+ private:
+  struct Slot {
+    std::atomic<FunctionID> function_id;
+    std::atomic<const MethodSymbol*> symbol;
+  };
+
+  struct CodeRange {
+    UINT_PTR start;
+    UINT_PTR end;
+    FunctionID function_id;
+    ModuleID module_id;
+  };
+
+  // sorted by start address, never modified once published
+  typedef std::vector<CodeRange> CodeRangeIndex;
+
+  struct ClassSymbol {
+    WSTRING name;
+    ModuleID module_id;
+  };
+
+  struct ModuleSymbols {
+    ComPtr<IMetaDataImport2> metadata_import;
+    WSTRING assembly_name;
+    std::unordered_set<WSTRING> names;
+    std::unordered_map<mdToken, const WSTRING*> names_by_token;
+    std::vector<std::unique_ptr<MethodSymbol>> symbols;
+  };
+
+  ICorProfilerInfo3* info_ = nullptr;
+  std::unique_ptr<Slot[]> slots_;
+  size_t mask_ = 0;
+  // slots holding a symbol, and slots left behind by an evicted one
+  size_t used_slots_ = 0;
+  size_t evicted_slots_ = 0;
+
+  std::atomic<const CodeRangeIndex*> code_range_index_{nullptr};
+  // threads searching code_range_index_, retired indexes are freed once
+  // there are none
+  std::atomic<uint32_t> code_range_readers_{0};
+
+  // serializes writers: resolution, range indexing and eviction
+  std::mutex lock_;
+  std::unordered_map<ModuleID, std::unique_ptr<ModuleSymbols>> modules_;
+  // symbols that did not fit in the table once it reached its load limit
+  std::unordered_map<FunctionID, const MethodSymbol*> overflow_;
+  // the published index, and the ones replaced since readers last drained
+  std::unique_ptr<CodeRangeIndex> published_ranges_;
+  std::vector<std::unique_ptr<CodeRangeIndex>> retired_ranges_;
+  // ranges found since the index was last rebuilt, keyed by start address
+  std::map<UINT_PTR, CodeRange> pending_ranges_;
+  std::unordered_map<ClassID, std::unique_ptr<ClassSymbol>> classes_;
+  // evicted modules and classes, kept for the readers that hold their names
+  std::vector<std::unique_ptr<ModuleSymbols>> retired_modules_;
+  std::vector<std::unique_ptr<ClassSymbol>> retired_classes_;
+
+  size_t SlotIndex(FunctionID function_id) const;
+  ModuleSymbols* GetModuleSymbols(ModuleID module_id);
+  const MethodSymbol* ResolveLocked(FunctionID function_id);
+  const MethodSymbol* AddLocked(ModuleSymbols* module, FunctionID function_id,
+                                ModuleID module_id, mdToken token,
+                                const WSTRING* name,
+                                const std::vector<ClassID>& type_args);
+  std::vector<ClassID> ReadTypeArgs(FunctionID function_id);
+  void Publish(const MethodSymbol* symbol);
+  FunctionID IndexCodeRangesLocked(UINT_PTR ip);
+  void AddCodeRangeLocked(const CodeRange& range);
+  // PublishCodeRangesLocked rebuilds the index from the published and
+  // pending ranges, leaving out those of evicted_module_id if not 0.
+  void PublishCodeRangesLocked(ModuleID evicted_module_id);
+  static const CodeRange* FindCodeRange(const CodeRangeIndex& index,
+                                        UINT_PTR ip);
+  const ClassSymbol* ResolveClassLocked(ClassID class_id);
+
+ public:
+  SymbolCache() = default;
+  SymbolCache(const SymbolCache&) = delete;
+  SymbolCache& operator=(const SymbolCache&) = delete;
+
+  // Initialize allocates the FunctionID table. capacity is rounded up to a
+  // power of two. info may be null in tests: symbols are then only added
+  // through Add and AddCodeRange.
+  void Initialize(ICorProfilerInfo3* info,
+                  size_t capacity = kSymbolCacheCapacity);
+
+  // Find returns the cached symbol for function_id, or nullptr on a miss.
+  // Lock-free and allocation-free; safe to call from any thread.
+  const MethodSymbol* Find(FunctionID function_id) const;
+
+  // GetOrResolve returns the cached symbol for function_id, resolving and
+  // caching it on a miss. Returns nullptr if the function cannot be resolved.
+  const MethodSymbol* GetOrResolve(FunctionID function_id);
+
+  // GetOrResolveFromIP maps an instruction pointer inside jitted code to its
+  // method symbol. Returns nullptr for native or unknown code. Lock-free for
+  // code ranges and symbols already published.
+  const MethodSymbol* GetOrResolveFromIP(UINT_PTR ip);
+
+  // GetOrResolveClassName returns the "Namespace.Type" name of class_id,
+  // resolving and caching it on a miss. Arrays are formatted as
+  // "ElementType[]". Returns nullptr if the class cannot be resolved.
+  const WSTRING* GetOrResolveClassName(ClassID class_id);
+
+  // Add caches the symbol of a method resolved elsewhere, named name in the
+  // "Assembly!Namespace.Type.Method" form.
+  const MethodSymbol* Add(FunctionID function_id, ModuleID module_id,
+                          mdToken token, const WSTRING& name,
+                          const std::vector<ClassID>& type_args =
+                              std::vector<ClassID>());
+
+  // AddClass caches the name of a class resolved elsewhere.
+  void AddClass(ClassID class_id, ModuleID module_id, const WSTRING& name);
+
+  // AddCodeRange indexes the native code of a method resolved elsewhere.
+  void AddCodeRange(UINT_PTR start, UINT_PTR size, FunctionID function_id,
+                    ModuleID module_id);
+
+  // EvictModule drops every symbol, class name and code range that belongs
+  // to module_id from the lookups.
+  void EvictModule(ModuleID module_id);
+};
+
+}  // namespace trace
+
+#endif  // DD_CLR_PROFILER_SYMBOL_CACHE_H_
@@ -0,0 +1,362 @@
+#include "thread_pool_watchdog.h"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+#include "clock.h"
+#include "logging.h"
+#include "symbol_cache.h"
+
+namespace trace {
+
+namespace {
+
+// the names of the thread-pool workers, ".NET TP Worker" since .NET 7
+bool IsThreadPoolWorkerName(const WSTRING& name) {
+  return name == ".NET ThreadPool Worker"_W || name == ".NET TP Worker"_W;
+}
+
+}  // namespace
+
+ThreadPoolWatchdog::ThreadPoolWatchdog()
+    : events_(kStarvationEventCapacity) {
+  // Methods a thread blocks in while it waits for another thread, matched
+  // against Type.Method. Task.Wait, Task.Result and GetResult are how
+  // sync-over-async code blocks.
+  WSTRING blocking_methods[]{
+      "System.Threading.Monitor.*"_W,
+      "System.Threading.WaitHandle.*"_W,
+      "System.Threading.ManualResetEventSlim.Wait"_W,
+      "System.Threading.SemaphoreSlim.Wait"_W,
+      "System.Threading.SpinWait.*"_W,
+      "System.Threading.Thread.Sleep"_W,
+      "System.Threading.Thread.Join"_W,
+      "System.Threading.Tasks.Task.*Wait*"_W,
+      "System.Threading.Tasks.Task`1.get_Result"_W,
+      "System.Threading.Tasks.Task`1.GetResultCore"_W,
+      "System.Runtime.CompilerServices.*TaskAwaiter*.GetResult"_W,
+      "System.Runtime.CompilerServices.TaskAwaiter.*NonSuccess*"_W,
+  };
+
+  for (const auto& pattern : blocking_methods) {
+    blocking_methods_.Add(pattern);
+  }
+}
+
+ThreadPoolWatchdog::~ThreadPoolWatchdog() { Stop(); }
+
+void ThreadPoolWatchdog::Initialize(ICorProfilerInfo3* info,
+                                    ICorProfilerInfo10* info10,
+                                    SymbolCache* symbols,
+                                    uint64_t interval_ms) {
+  info_ = info;
+  info10_ = info10;
+  symbols_ = symbols;
+  interval_ms_ =
+      interval_ms > 0 ? interval_ms : kDefaultThreadPoolWatchdogInterval;
+
+  worker_ = std::thread(&ThreadPoolWatchdog::Run, this);
+
+  if (info10_ == nullptr) {
+    Warn("Thread-pool watchdog: ICorProfilerInfo10 not found. Blocked "
+         "threads can't be sampled, only thread injection is detected.");
+  }
+
+  Info("Thread-pool watchdog enabled, checking every ", interval_ms_, " ms.");
+}
+
+void ThreadPoolWatchdog::Stop() {
+  {
+    std::lock_guard<std::mutex> guard(stop_lock_);
+    stop_requested_ = true;
+  }
+  stop_signal_.notify_all();
+
+  if (worker_.joinable()) {
+    worker_.join();
+  }
+}
+
+void ThreadPoolWatchdog::OnThreadCreated(ThreadID thread_id) {
+  std::lock_guard<std::mutex> guard(threads_lock_);
+  ThreadState state;
+  state.created_ns = MonotonicNanoseconds();
+  threads_[thread_id] = state;
+  threads_created_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ThreadPoolWatchdog::OnThreadDestroyed(ThreadID thread_id) {
+  std::lock_guard<std::mutex> guard(threads_lock_);
+
+  // threads created before the profiler attached were never counted
+  const auto thread = threads_.find(thread_id);
+  if (thread == threads_.end()) {
+    return;
+  }
+
+  if (thread->second.pool_worker) {
+    pool_workers_destroyed_.fetch_add(1, std::memory_order_relaxed);
+  }
+  threads_.erase(thread);
+  threads_destroyed_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ThreadPoolWatchdog::OnThreadAssignedToOSThread(ThreadID thread_id,
+                                                    DWORD os_thread_id) {
+  std::lock_guard<std::mutex> guard(threads_lock_);
+  const auto thread = threads_.find(thread_id);
+
+  if (thread != threads_.end()) {
+    thread->second.os_thread_id = os_thread_id;
+  }
+}
+
+void ThreadPoolWatchdog::OnThreadNameChanged(ThreadID thread_id,
+                                             const WSTRING& name) {
+  if (!IsThreadPoolWorkerName(name)) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> guard(threads_lock_);
+  const auto thread = threads_.find(thread_id);
+
+  if (thread != threads_.end() && !thread->second.pool_worker) {
+    thread->second.pool_worker = true;
+    pool_workers_started_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+size_t ThreadPoolWatchdog::ThreadCount() const {
+  std::lock_guard<std::mutex> guard(threads_lock_);
+  return threads_.size();
+}
+
+void ThreadPoolWatchdog::Run() {
+  std::unique_lock<std::mutex> lock(stop_lock_);
+
+  while (!stop_requested_) {
+    stop_signal_.wait_for(lock, std::chrono::milliseconds(interval_ms_),
+                          [this] { return stop_requested_; });
+    if (stop_requested_) {
+      break;
+    }
+
+    lock.unlock();
+    Detect();
+    lock.lock();
+  }
+}
+
+uint32_t ThreadPoolWatchdog::Evaluate() {
+  const auto started = pool_workers_started_.load(std::memory_order_relaxed);
+  const auto destroyed =
+      pool_workers_destroyed_.load(std::memory_order_relaxed);
+  const auto added = started - last_started_;
+  const auto removed = destroyed - last_destroyed_;
+  last_started_ = started;
+  last_destroyed_ = destroyed;
+
+  if (added <= removed) {
+    growth_streak_ = 0;
+    injected_threads_ = 0;
+    return 0;
+  }
+
+  growth_streak_++;
+  injected_threads_ += added - removed;
+
+  // report again every kStarvationGrowthIntervals while the growth goes on
+  if (growth_streak_ < kStarvationGrowthIntervals ||
+      growth_streak_ % kStarvationGrowthIntervals != 0) {
+    return 0;
+  }
+
+  return kStarvationThreadInjection;
+}
+
+void ThreadPoolWatchdog::Sample(std::vector<CompactStack>* stacks) {
+  if (info10_ == nullptr) {
+    return;
+  }
+
+  std::vector<std::pair<uint64_t, ThreadID>> candidates;
+  stacks->reserve(kMaxWatchdogSampledThreads);
+
+  const auto hr = info10_->SuspendRuntime();
+  if (FAILED(hr)) {
+    if (debug_logging_enabled) {
+      Debug("Thread-pool watchdog: SuspendRuntime failed: ", hr);
+    }
+    return;
+  }
+
+  {
+    // once the runtime is suspended no thread holds the lock for long, and
+    // threads can't be destroyed while their stack is walked
+    std::lock_guard<std::mutex> guard(threads_lock_);
+    candidates.reserve(threads_.size());
+
+    for (const auto& thread : threads_) {
+      // not started yet: there is no stack to walk
+      if (thread.second.pool_worker && thread.second.os_thread_id != 0) {
+        candidates.emplace_back(thread.second.created_ns, thread.first);
+      }
+    }
+
+    // the thread pool injected the newest workers
+    const auto count = std::min(candidates.size(), kMaxWatchdogSampledThreads);
+    std::partial_sort(candidates.begin(), candidates.begin() + count,
+                      candidates.end(),
+                      [](const std::pair<uint64_t, ThreadID>& a,
+                         const std::pair<uint64_t, ThreadID>& b) {
+                        return a.first > b.first;
+                      });
+
+    for (size_t i = 0; i < count; i++) {
+      CompactStack stack;
+      if (SUCCEEDED(CaptureStack(info_, candidates[i].second, &stack)) &&
+          stack.frame_count > 0) {
+        stacks->push_back(stack);
+      }
+    }
+  }
+
+  info10_->ResumeRuntime();
+}
+
+FunctionID ThreadPoolWatchdog::BlockingCaller(const CompactStack& stack) {
+  uint32_t frame = 0;
+
+  for (; frame < stack.frame_count; frame++) {
+    const auto symbol = symbols_ != nullptr
+                            ? symbols_->GetOrResolve(stack.frames[frame])
+                            : nullptr;
+
+    if (symbol == nullptr || !blocking_methods_.Matches(*symbol->name)) {
+      break;
+    }
+  }
+
+  if (frame == 0) {
+    // the innermost frame is not a wait: the thread is running
+    return 0;
+  }
+
+  // truncated inside the wait primitives: report the outermost one
+  return frame < stack.frame_count ? stack.frames[frame]
+                                   : stack.frames[frame - 1];
+}
+
+void ThreadPoolWatchdog::Detect() {
+  auto reason = Evaluate();
+  if (reason == 0) {
+    return;
+  }
+
+  std::vector<CompactStack> stacks;
+  Sample(&stacks);
+
+  std::unordered_map<FunctionID, uint64_t> callers;
+  uint32_t blocked = 0;
+
+  for (const auto& stack : stacks) {
+    const auto caller = BlockingCaller(stack);
+    if (caller != 0) {
+      callers[caller]++;
+      blocked++;
+    }
+  }
+
+  if (!stacks.empty() && blocked * 2 >= stacks.size()) {
+    reason |= kStarvationBlockedThreads;
+  }
+
+  std::vector<std::pair<uint64_t, FunctionID>> ranked;
+  ranked.reserve(callers.size());
+  for (const auto& caller : callers) {
+    ranked.emplace_back(caller.second, caller.first);
+  }
+  std::sort(ranked.begin(), ranked.end(),
+            [](const std::pair<uint64_t, FunctionID>& a,
+               const std::pair<uint64_t, FunctionID>& b) {
+              return a.first > b.first;
+            });
+
+  StarvationEvent event{};
+  event.timestamp_unix_ns = UnixNanoseconds();
+  event.reason = reason;
+  event.thread_count = static_cast<uint32_t>(ThreadCount());
+  event.injected_thread_count = static_cast<uint32_t>(injected_threads_);
+  event.sampled_thread_count = static_cast<uint32_t>(stacks.size());
+  event.blocked_thread_count = blocked;
+
+  for (size_t i = 0; i < ranked.size() && i < kStarvationEventFrames; i++) {
+    event.blocking_function_ids[i] = ranked[i].second;
+    event.blocking_thread_counts[i] = ranked[i].first;
+  }
+
+  detections_.fetch_add(1, std::memory_order_relaxed);
+  sampled_threads_.fetch_add(stacks.size(), std::memory_order_relaxed);
+  blocked_threads_.fetch_add(blocked, std::memory_order_relaxed);
+  Publish(&event);
+
+  WSTRING top_frame = "unknown"_W;
+  if (!ranked.empty() && symbols_ != nullptr) {
+    const auto symbol = symbols_->GetOrResolve(ranked[0].second);
+    if (symbol != nullptr) {
+      top_frame = *symbol->name;
+    }
+  }
+
+  if (!detection_logged_) {
+    detection_logged_ = true;
+    Warn("Thread-pool starvation suspected: ", event.injected_thread_count,
+         " workers added in ", growth_streak_, " intervals, ", blocked, " of ",
+         stacks.size(), " sampled threads blocked, mostly in ", top_frame,
+         ". Further detections are logged at debug level.");
+  } else if (debug_logging_enabled) {
+    Debug("Thread-pool starvation suspected: ", event.injected_thread_count,
+          " workers added, ", blocked, " of ", stacks.size(),
+          " sampled threads blocked, mostly in ", top_frame);
+  }
+}
+
+void ThreadPoolWatchdog::Publish(StarvationEvent* event) {
+  std::lock_guard<std::mutex> guard(events_lock_);
+  event->sequence = ++last_sequence_;
+  events_[(event->sequence - 1) % kStarvationEventCapacity] = *event;
+}
+
+size_t ThreadPoolWatchdog::Read(uint64_t* cursor, StarvationEvent* events,
+                                size_t max_events) const {
+  std::lock_guard<std::mutex> guard(events_lock_);
+  const auto last = last_sequence_;
+  auto next = *cursor + 1;
+
+  // skip events that were already overwritten
+  if (last >= kStarvationEventCapacity &&
+      next <= last - kStarvationEventCapacity) {
+    next = last - kStarvationEventCapacity + 1;
+  }
+
+  size_t copied = 0;
+  for (; next <= last && copied < max_events; next++) {
+    events[copied++] = events_[(next - 1) % kStarvationEventCapacity];
+  }
+
+  *cursor = next - 1;
+  return copied;
+}
+
+void ThreadPoolWatchdog::GetStats(ThreadPoolWatchdogStats* stats) const {
+  stats->thread_count = ThreadCount();
+  stats->threads_created = threads_created_.load(std::memory_order_relaxed);
+  stats->threads_destroyed =
+      threads_destroyed_.load(std::memory_order_relaxed);
+  stats->detections = detections_.load(std::memory_order_relaxed);
+  stats->sampled_threads = sampled_threads_.load(std::memory_order_relaxed);
+  stats->blocked_threads = blocked_threads_.load(std::memory_order_relaxed);
+}
+
+}  // namespace trace
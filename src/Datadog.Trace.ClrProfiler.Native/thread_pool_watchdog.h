@@ -0,0 +1,199 @@
+#ifndef DD_CLR_PROFILER_THREAD_POOL_WATCHDOG_H_
+#define DD_CLR_PROFILER_THREAD_POOL_WATCHDOG_H_
+
+#include <corhlpr.h>
+#include <corprof.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "method_timing.h"
+#include "stack_walker.h"
+#include "string.h"
+
+namespace trace {
+
+class SymbolCache;
+
+// Default time between two evaluations of the starvation heuristics, in
+// milliseconds.
+const uint64_t kDefaultThreadPoolWatchdogInterval = 1000;
+
+// Number of consecutive intervals the thread pool must add workers before
+// starvation is suspected. The thread pool injects threads about once per
+// interval while its work items don't complete.
+const uint32_t kStarvationGrowthIntervals = 3;
+
+// Maximum number of thread-pool workers whose stacks are sampled per
+// detection, newest first, since those are the ones the thread pool injected.
+const size_t kMaxWatchdogSampledThreads = 64;
+
+// Number of starvation events kept. Readers that fall further behind lose the
+// oldest events.
+const size_t kStarvationEventCapacity = 256;
+
+// Number of blocking frames reported per starvation event.
+const size_t kStarvationEventFrames = 4;
+
+// Reasons of a StarvationEvent, combined with |.
+// workers were added for kStarvationGrowthIntervals intervals in a row
+const uint32_t kStarvationThreadInjection = 1;
+// at least half of the sampled threads were blocked in a wait
+const uint32_t kStarvationBlockedThreads = 2;
+
+// StarvationEvent is one detection of the watchdog, handed to managed code by
+// GetThreadPoolStarvationEvents in interop.cpp. Function names are resolved
+// on demand with ResolveFunctionName. It is blittable: keep its layout in
+// sync with the managed definition.
+struct StarvationEvent {
+  // position of this event, starting at 1
+  uint64_t sequence;
+  // wall-clock time of the detection, nanoseconds since the Unix epoch
+  uint64_t timestamp_unix_ns;
+  // kStarvation* flags
+  uint32_t reason;
+  // managed threads alive
+  uint32_t thread_count;
+  // workers added since the thread pool started adding workers
+  uint32_t injected_thread_count;
+  uint32_t sampled_thread_count;
+  uint32_t blocked_thread_count;
+  uint32_t reserved;
+  // the frames that called into a wait on most of the blocked threads, and
+  // on how many threads each, most frequent first; 0 past the last one
+  uint64_t blocking_function_ids[kStarvationEventFrames];
+  uint64_t blocking_thread_counts[kStarvationEventFrames];
+};
+
+// ThreadPoolWatchdogStats are running totals since the profiler attached,
+// handed to managed code by GetThreadPoolWatchdogStats in interop.cpp. It is
+// blittable: keep its layout in sync with the managed definition.
+struct ThreadPoolWatchdogStats {
+  uint64_t thread_count;
+  uint64_t threads_created;
+  uint64_t threads_destroyed;
+  uint64_t detections;
+  uint64_t sampled_threads;
+  uint64_t blocked_threads;
+};
+
+// ThreadPoolWatchdog detects thread-pool starvation, typically caused by
+// sync-over-async code blocking thread-pool threads, from a thread of its
+// own.
+//
+// Managed threads are tracked through ThreadCreated, ThreadDestroyed and
+// ThreadAssignedToOSThread, and thread-pool workers are told apart by the
+// name the runtime gives them, reported by ThreadNameChanged (.NET 6 and
+// later; the workers of earlier runtimes are not named, so their injection
+// is not detected). At each interval the watchdog checks whether the thread
+// pool kept adding workers, which is how it reacts to work items that don't
+// complete: other threads, started at startup or dedicated to long-running
+// work, are not counted. When it does, the watchdog suspends the runtime
+// with ICorProfilerInfo10::SuspendRuntime, samples the stacks of the newest
+// workers and looks for the frames that called into a wait: Monitor,
+// WaitHandle, Task.Wait, Task.Result and the like.
+class ThreadPoolWatchdog {
+ private:
+  struct ThreadState {
+    DWORD os_thread_id = 0;
+    uint64_t created_ns = 0;
+    bool pool_worker = false;
+  };
+
+  ICorProfilerInfo3* info_ = nullptr;
+  ICorProfilerInfo10* info10_ = nullptr;
+  SymbolCache* symbols_ = nullptr;
+  uint64_t interval_ms_ = kDefaultThreadPoolWatchdogInterval;
+  MethodPatternList blocking_methods_;
+
+  mutable std::mutex threads_lock_;
+  std::unordered_map<ThreadID, ThreadState> threads_;
+
+  std::atomic<uint64_t> threads_created_{0};
+  std::atomic<uint64_t> threads_destroyed_{0};
+  std::atomic<uint64_t> pool_workers_started_{0};
+  std::atomic<uint64_t> pool_workers_destroyed_{0};
+  std::atomic<uint64_t> detections_{0};
+  std::atomic<uint64_t> sampled_threads_{0};
+  std::atomic<uint64_t> blocked_threads_{0};
+
+  // only touched by Evaluate
+  uint64_t last_started_ = 0;
+  uint64_t last_destroyed_ = 0;
+  uint32_t growth_streak_ = 0;
+  uint64_t injected_threads_ = 0;
+  bool detection_logged_ = false;
+
+  mutable std::mutex events_lock_;
+  std::vector<StarvationEvent> events_;
+  uint64_t last_sequence_ = 0;
+
+  std::thread worker_;
+  std::mutex stop_lock_;
+  std::condition_variable stop_signal_;
+  bool stop_requested_ = false;
+
+  void Run();
+
+  // Sample suspends the runtime and captures the stacks of the newest
+  // thread-pool workers.
+  void Sample(std::vector<CompactStack>* stacks);
+
+  // BlockingCaller returns the outermost frame below the wait primitives of
+  // the stack, 0 if the stack isn't in a wait.
+  FunctionID BlockingCaller(const CompactStack& stack);
+
+  void Publish(StarvationEvent* event);
+
+ public:
+  ThreadPoolWatchdog();
+  ThreadPoolWatchdog(const ThreadPoolWatchdog&) = delete;
+  ThreadPoolWatchdog& operator=(const ThreadPoolWatchdog&) = delete;
+  ~ThreadPoolWatchdog();
+
+  // Initialize starts the watchdog thread. info10 is optional: stacks are only
+  // sampled with it. Requires COR_PRF_MONITOR_THREADS and
+  // COR_PRF_ENABLE_STACK_SNAPSHOT in the event mask.
+  void Initialize(ICorProfilerInfo3* info, ICorProfilerInfo10* info10,
+                  SymbolCache* symbols, uint64_t interval_ms);
+
+  // Stop signals the watchdog thread and waits for it to exit.
+  void Stop();
+
+  bool IsEnabled() const { return info_ != nullptr; }
+
+  void OnThreadCreated(ThreadID thread_id);
+  void OnThreadDestroyed(ThreadID thread_id);
+  void OnThreadAssignedToOSThread(ThreadID thread_id, DWORD os_thread_id);
+
+  // OnThreadNameChanged must be called from ThreadNameChanged: the thread
+  // pool names its workers when they start.
+  void OnThreadNameChanged(ThreadID thread_id, const WSTRING& name);
+
+  size_t ThreadCount() const;
+
+  // Evaluate updates the heuristics with the thread-pool workers started and
+  // destroyed since its last call, once per interval. Returns the
+  // kStarvation* flags that fired, 0 if none.
+  uint32_t Evaluate();
+
+  // Detect evaluates the heuristics and, if starvation is suspected, samples
+  // the threads and publishes an event. Called by the watchdog thread.
+  void Detect();
+
+  // Read copies the events that follow *cursor (a sequence number, 0 to start
+  // from the oldest retained event) into events and advances *cursor past the
+  // last one copied. Returns the number of events copied.
+  size_t Read(uint64_t* cursor, StarvationEvent* events,
+              size_t max_events) const;
+
+  void GetStats(ThreadPoolWatchdogStats* stats) const;
+};
+
+}  // namespace trace
+
+#endif  // DD_CLR_PROFILER_THREAD_POOL_WATCHDOG_H_
@@ -0,0 +1,147 @@
+#include "trace_serializer.h"
+
+#include <cstring>
+
+namespace trace {
+
+namespace {
+
+void WriteKey(MessagePackWriter& writer, const char* key) {
+  writer.WriteString(key, std::strlen(key));
+}
+
+}  // namespace
+
+TraceSerializer::TraceSerializer() { ResetCache(); }
+
+void TraceSerializer::ResetCache() {
+  std::memset(cache_, 0, sizeof(cache_));
+}
+
+void TraceSerializer::WriteString(const NativeString& str) {
+  if (str.chars == nullptr || str.length < 0) {
+    writer_.WriteNil();
+    return;
+  }
+
+  const auto address = reinterpret_cast<uintptr_t>(str.chars);
+  auto& entry =
+      cache_[((address >> 3) ^ static_cast<uint32_t>(str.length)) &
+             (kStringCacheSize - 1)];
+
+  if (entry.chars == str.chars && entry.length == str.length) {
+    writer_.CopyWithin(entry.offset, entry.size);
+    return;
+  }
+
+  const auto offset = writer_.Size();
+  writer_.WriteString(str.chars, static_cast<size_t>(str.length));
+
+  entry.chars = str.chars;
+  entry.length = str.length;
+  entry.offset = static_cast<uint32_t>(offset);
+  entry.size = static_cast<uint32_t>(writer_.Size() - offset);
+}
+
+void TraceSerializer::WriteSpan(const NativeSpan& span) {
+  uint32_t field_count = 8;
+  if (span.parent_id != 0) {
+    field_count++;
+  }
+  if (span.error != 0) {
+    field_count++;
+  }
+  if (span.tag_count > 0) {
+    field_count++;
+  }
+  if (span.metric_count > 0) {
+    field_count++;
+  }
+
+  writer_.WriteMapHeader(field_count);
+
+  WriteKey(writer_, "trace_id");
+  writer_.WriteUInt64(span.trace_id);
+  WriteKey(writer_, "span_id");
+  writer_.WriteUInt64(span.span_id);
+  WriteKey(writer_, "name");
+  WriteString(span.name);
+  WriteKey(writer_, "resource");
+  WriteString(span.resource);
+  WriteKey(writer_, "service");
+  WriteString(span.service);
+  WriteKey(writer_, "type");
+  WriteString(span.type);
+  WriteKey(writer_, "start");
+  writer_.WriteInt64(span.start);
+  WriteKey(writer_, "duration");
+  writer_.WriteInt64(span.duration);
+
+  if (span.parent_id != 0) {
+    WriteKey(writer_, "parent_id");
+    writer_.WriteUInt64(span.parent_id);
+  }
+
+  if (span.error != 0) {
+    WriteKey(writer_, "error");
+    writer_.WriteInt64(1);
+  }
+
+  if (span.tag_count > 0) {
+    WriteKey(writer_, "meta");
+    writer_.WriteMapHeader(static_cast<uint32_t>(span.tag_count));
+    for (int32_t i = 0; i < span.tag_count; i++) {
+      WriteString(span.tags[i].key);
+      WriteString(span.tags[i].value);
+    }
+  }
+
+  if (span.metric_count > 0) {
+    WriteKey(writer_, "metrics");
+    writer_.WriteMapHeader(static_cast<uint32_t>(span.metric_count));
+    for (int32_t i = 0; i < span.metric_count; i++) {
+      WriteString(span.metrics[i].key);
+      writer_.WriteDouble(span.metrics[i].value);
+    }
+  }
+}
+
+bool TraceSerializer::Serialize(const NativeSpan* spans,
+                                const int32_t* trace_sizes,
+                                int32_t trace_count) {
+  writer_.Clear();
+  ResetCache();
+
+  if (trace_count < 0 || (trace_count > 0 && trace_sizes == nullptr)) {
+    return false;
+  }
+
+  for (int32_t i = 0; i < trace_count; i++) {
+    if (trace_sizes[i] < 0 || (trace_sizes[i] > 0 && spans == nullptr)) {
+      return false;
+    }
+  }
+
+  writer_.WriteArrayHeader(static_cast<uint32_t>(trace_count));
+
+  for (int32_t i = 0; i < trace_count; i++) {
+    writer_.WriteArrayHeader(static_cast<uint32_t>(trace_sizes[i]));
+
+    for (int32_t j = 0; j < trace_sizes[i]; j++) {
+      const auto& span = *spans++;
+
+      if (span.tag_count < 0 || span.metric_count < 0 ||
+          (span.tag_count > 0 && span.tags == nullptr) ||
+          (span.metric_count > 0 && span.metrics == nullptr)) {
+        writer_.Clear();
+        return false;
+      }
+
+      WriteSpan(span);
+    }
+  }
+
+  return true;
+}
+
+}  // namespace trace
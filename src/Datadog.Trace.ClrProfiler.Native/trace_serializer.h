@@ -0,0 +1,103 @@
+#ifndef DD_CLR_PROFILER_TRACE_SERIALIZER_H_
+#define DD_CLR_PROFILER_TRACE_SERIALIZER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "msgpack_writer.h"
+#include "string.h"
+
+namespace trace {
+
+// The structs below are filled by managed code and passed by pointer to
+// SerializeTraces in interop.cpp. They are blittable: keep their layout in
+// sync with the managed definitions. Strings point to pinned managed
+// character data and are only read during the call.
+
+// NativeString is a UTF-16 string that is not null terminated. A null chars
+// pointer (or a negative length) is serialized as nil.
+struct NativeString {
+  const WCHAR* chars;
+  int32_t length;
+  int32_t reserved;
+};
+
+struct NativeTag {
+  NativeString key;
+  NativeString value;
+};
+
+struct NativeMetric {
+  NativeString key;
+  double value;
+};
+
+struct NativeSpan {
+  uint64_t trace_id;
+  uint64_t span_id;
+  // 0 for root spans
+  uint64_t parent_id;
+  // nanoseconds since the Unix epoch
+  int64_t start;
+  int64_t duration;
+  NativeString name;
+  NativeString resource;
+  NativeString service;
+  NativeString type;
+  const NativeTag* tags;
+  const NativeMetric* metrics;
+  int32_t tag_count;
+  int32_t metric_count;
+  int32_t error;
+  int32_t reserved;
+};
+
+// Number of entries in the string deduplication cache. Must be a power of
+// two.
+const size_t kStringCacheSize = 256;
+
+// TraceSerializer encodes traces into the v0.4 MessagePack payload accepted
+// by the agent's /v0.4/traces endpoint: an array of traces, each an array of
+// span maps, with the same fields as the managed SpanMessagePackSerializer.
+//
+// Span data repeats a small set of strings (service and operation names, tag
+// keys) that managed code passes as the same interned string objects. The
+// serializer remembers where each string pointer was last encoded in the
+// current payload and copies those bytes instead of transcoding the string
+// again. Pointers are only compared within one payload, while the caller
+// keeps them pinned.
+class TraceSerializer {
+ private:
+  struct CachedString {
+    const WCHAR* chars;
+    int32_t length;
+    uint32_t offset;
+    uint32_t size;
+  };
+
+  MessagePackWriter writer_;
+  CachedString cache_[kStringCacheSize];
+
+  void ResetCache();
+  void WriteString(const NativeString& str);
+  void WriteSpan(const NativeSpan& span);
+
+ public:
+  TraceSerializer();
+  TraceSerializer(const TraceSerializer&) = delete;
+  TraceSerializer& operator=(const TraceSerializer&) = delete;
+
+  // Serialize encodes trace_count traces whose spans are laid out one trace
+  // after the other in spans, trace i having trace_sizes[i] spans. Returns
+  // false if the input is invalid. The payload replaces the previous one and
+  // stays valid until the next call.
+  bool Serialize(const NativeSpan* spans, const int32_t* trace_sizes,
+                 int32_t trace_count);
+
+  const uint8_t* Data() const { return writer_.Data(); }
+  size_t Size() const { return writer_.Size(); }
+};
+
+}  // namespace trace
+
+#endif  // DD_CLR_PROFILER_TRACE_SERIALIZER_H_
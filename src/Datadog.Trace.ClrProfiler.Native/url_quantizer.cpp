@@ -0,0 +1,164 @@
+#include "url_quantizer.h"
+
+#include <cstring>
+
+#include "util.h"
+
+namespace trace {
+
+namespace {
+
+inline bool IsDigit(WCHAR c) { return c >= '0' && c <= '9'; }
+
+inline bool IsHexDigit(WCHAR c) {
+  return IsDigit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+inline WCHAR ToLowerAscii(WCHAR c) {
+  return c >= 'A' && c <= 'Z' ? static_cast<WCHAR>(c - 'A' + 'a') : c;
+}
+
+bool IsGuidWithDashes(const WCHAR* segment, size_t length) {
+  if (length != 36) {
+    return false;
+  }
+
+  for (size_t i = 0; i < length; i++) {
+    const bool dash = i == 8 || i == 13 || i == 18 || i == 23;
+    if (dash ? segment[i] != '-' : !IsHexDigit(segment[i])) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// IsIdSegment returns true if a path segment looks like an id: an integer, a
+// GUID or a hexadecimal string of at least 8 digits with a decimal digit.
+bool IsIdSegment(const WCHAR* segment, size_t length) {
+  if (length == 0) {
+    return false;
+  }
+
+  bool all_digits = true;
+  bool all_hex = true;
+  for (size_t i = 0; i < length && all_hex; i++) {
+    all_digits = all_digits && IsDigit(segment[i]);
+    all_hex = IsHexDigit(segment[i]);
+  }
+
+  if (all_digits) {
+    return true;
+  }
+
+  if (all_hex) {
+    // this also covers GUIDs without dashes
+    if (length >= 8) {
+      for (size_t i = 0; i < length; i++) {
+        if (IsDigit(segment[i])) {
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  return IsGuidWithDashes(segment, length);
+}
+
+}  // namespace
+
+size_t QuantizeUrl(WCHAR* url, size_t length) {
+  size_t end = 0;
+  while (end < length && url[end] != '?' && url[end] != '#') {
+    end++;
+  }
+
+  // keep "scheme://authority" of absolute URLs, only lowercased
+  size_t path_start = 0;
+  for (size_t i = 0; i < end && url[i] != '/'; i++) {
+    if (url[i] == ':' && i + 2 < end && url[i + 1] == '/' &&
+        url[i + 2] == '/') {
+      path_start = i + 3;
+      while (path_start < end && url[path_start] != '/') {
+        path_start++;
+      }
+      break;
+    }
+  }
+
+  for (size_t i = 0; i < path_start; i++) {
+    url[i] = ToLowerAscii(url[i]);
+  }
+
+  // segments are written back in place, never longer than they were
+  size_t out = path_start;
+  size_t i = path_start;
+
+  while (i < end) {
+    if (url[i] == '/') {
+      url[out++] = '/';
+      i++;
+      continue;
+    }
+
+    const auto segment = i;
+    while (i < end && url[i] != '/') {
+      i++;
+    }
+
+    if (IsIdSegment(url + segment, i - segment)) {
+      url[out++] = '?';
+      continue;
+    }
+
+    for (auto c = segment; c < i; c++) {
+      url[out++] = ToLowerAscii(url[c]);
+    }
+  }
+
+  return out;
+}
+
+UrlQuantizationCache::UrlQuantizationCache()
+    : entries_(new Entry[kUrlCacheCapacity]) {}
+
+size_t UrlQuantizationCache::Quantize(WCHAR* url, size_t length) {
+  if (length > kMaxCachedUrlLength) {
+    return QuantizeUrl(url, length);
+  }
+
+  const auto hash = HashUtf16(url, length);
+  clock_++;
+
+  Entry* victim = &entries_[0];
+  for (size_t i = 0; i < kUrlCacheCapacity; i++) {
+    auto& entry = entries_[i];
+
+    if (entry.last_used != 0 && entry.hash == hash &&
+        entry.url.length() == length &&
+        std::memcmp(entry.url.data(), url, length * sizeof(WCHAR)) == 0) {
+      std::memcpy(url, entry.quantized.data(),
+                  entry.quantized.length() * sizeof(WCHAR));
+      entry.last_used = clock_;
+      hits_++;
+      return entry.quantized.length();
+    }
+
+    if (entry.last_used < victim->last_used) {
+      victim = &entry;
+    }
+  }
+
+  misses_++;
+
+  victim->hash = hash;
+  victim->last_used = clock_;
+  victim->url.assign(url, length);
+
+  const auto quantized_length = QuantizeUrl(url, length);
+  victim->quantized.assign(url, quantized_length);
+  return quantized_length;
+}
+
+}  // namespace trace
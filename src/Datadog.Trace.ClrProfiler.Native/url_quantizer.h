@@ -0,0 +1,64 @@
+#ifndef DD_CLR_PROFILER_URL_QUANTIZER_H_
+#define DD_CLR_PROFILER_URL_QUANTIZER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "string.h"
+
+namespace trace {
+
+// Number of URLs kept by UrlQuantizationCache. Lookups scan every entry, so
+// it must stay small.
+const size_t kUrlCacheCapacity = 64;
+
+// Longer URLs are quantized on every call rather than cached.
+const size_t kMaxCachedUrlLength = 512;
+
+// QuantizeUrl turns a URL or a path into a low-cardinality resource name, in
+// place, and returns its new length, which is never more than length:
+//
+//  - the query string and fragment are removed
+//  - path segments that look like ids are replaced with '?': integers, GUIDs
+//    with or without dashes, and hexadecimal strings of at least 8 digits
+//    that contain a decimal digit (so words like "deadbeef" are kept)
+//  - ASCII letters are lowercased
+//
+// The scheme and authority of absolute URLs are kept, lowercased.
+size_t QuantizeUrl(WCHAR* url, size_t length);
+
+// UrlQuantizationCache remembers the quantized form of the most recently used
+// URLs. It is not thread-safe: keep one per thread.
+class UrlQuantizationCache {
+ private:
+  struct Entry {
+    uint64_t hash = 0;
+    // 0 for unused entries
+    uint64_t last_used = 0;
+    WSTRING url;
+    WSTRING quantized;
+  };
+
+  std::unique_ptr<Entry[]> entries_;
+  uint64_t clock_ = 0;
+  uint64_t hits_ = 0;
+  uint64_t misses_ = 0;
+
+ public:
+  UrlQuantizationCache();
+  UrlQuantizationCache(const UrlQuantizationCache&) = delete;
+  UrlQuantizationCache& operator=(const UrlQuantizationCache&) = delete;
+
+  // Quantize has the same contract as QuantizeUrl. On a miss, the least
+  // recently used entry is replaced; entries reuse their buffers, so the
+  // cache stops allocating once warm.
+  size_t Quantize(WCHAR* url, size_t length);
+
+  uint64_t Hits() const { return hits_; }
+  uint64_t Misses() const { return misses_; }
+};
+
+}  // namespace trace
+
+#endif  // DD_CLR_PROFILER_URL_QUANTIZER_H_
@@ -0,0 +1,107 @@
+#include "utf8.h"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DD_UTF8_SSE2 1
+#endif
+
+namespace trace {
+
+namespace {
+
+inline bool IsHighSurrogate(uint32_t c) { return c >= 0xD800 && c <= 0xDBFF; }
+
+inline bool IsLowSurrogate(uint32_t c) { return c >= 0xDC00 && c <= 0xDFFF; }
+
+// AsciiPrefix converts the longest run of ASCII code units at the start of
+// source, stopping at the first block that contains anything else, and
+// returns how many code units it consumed.
+size_t AsciiPrefix(const WCHAR* source, size_t length, uint8_t* destination) {
+  size_t i = 0;
+
+#ifdef DD_UTF8_SSE2
+  const __m128i non_ascii_mask = _mm_set1_epi16(static_cast<short>(0xFF80));
+  const __m128i zero = _mm_setzero_si128();
+
+  for (; i + 8 <= length; i += 8) {
+    const __m128i chars =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+    const __m128i non_ascii = _mm_and_si128(chars, non_ascii_mask);
+    if (_mm_movemask_epi8(_mm_cmpeq_epi16(non_ascii, zero)) != 0xFFFF) {
+      break;
+    }
+
+    // every code unit is < 0x80, so saturating packing keeps them unchanged
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(destination + i),
+                     _mm_packus_epi16(chars, chars));
+  }
+#else
+  for (; i + 4 <= length; i += 4) {
+    uint64_t chars;
+    std::memcpy(&chars, source + i, sizeof(chars));
+    if ((chars & 0xFF80FF80FF80FF80ULL) != 0) {
+      break;
+    }
+
+    for (size_t j = 0; j < 4; j++) {
+      destination[i + j] = static_cast<uint8_t>(source[i + j]);
+    }
+  }
+#endif
+
+  return i;
+}
+
+}  // namespace
+
+size_t Utf16ToUtf8(const WCHAR* source, size_t length, uint8_t* destination) {
+  size_t in = 0;
+  size_t out = 0;
+
+  while (in < length) {
+    const auto ascii = AsciiPrefix(source + in, length - in, destination + out);
+    in += ascii;
+    out += ascii;
+
+    // finish the current block one code unit at a time, then try the fast
+    // path again
+    const auto block_end = in + 8 < length ? in + 8 : length;
+    while (in < block_end) {
+      uint32_t c = static_cast<uint16_t>(source[in++]);
+
+      if (c < 0x80) {
+        destination[out++] = static_cast<uint8_t>(c);
+      } else if (c < 0x800) {
+        destination[out++] = static_cast<uint8_t>(0xC0 | (c >> 6));
+        destination[out++] = static_cast<uint8_t>(0x80 | (c & 0x3F));
+      } else {
+        if (IsHighSurrogate(c) && in < length &&
+            IsLowSurrogate(static_cast<uint16_t>(source[in]))) {
+          const uint32_t low = static_cast<uint16_t>(source[in++]);
+          c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+
+          destination[out++] = static_cast<uint8_t>(0xF0 | (c >> 18));
+          destination[out++] = static_cast<uint8_t>(0x80 | ((c >> 12) & 0x3F));
+          destination[out++] = static_cast<uint8_t>(0x80 | ((c >> 6) & 0x3F));
+          destination[out++] = static_cast<uint8_t>(0x80 | (c & 0x3F));
+          continue;
+        }
+
+        if (IsHighSurrogate(c) || IsLowSurrogate(c)) {
+          c = 0xFFFD;
+        }
+
+        destination[out++] = static_cast<uint8_t>(0xE0 | (c >> 12));
+        destination[out++] = static_cast<uint8_t>(0x80 | ((c >> 6) & 0x3F));
+        destination[out++] = static_cast<uint8_t>(0x80 | (c & 0x3F));
+      }
+    }
+  }
+
+  return out;
+}
+
+}  // namespace trace
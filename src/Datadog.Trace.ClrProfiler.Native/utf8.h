@@ -0,0 +1,26 @@
+#ifndef DD_CLR_PROFILER_UTF8_H_
+#define DD_CLR_PROFILER_UTF8_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "string.h"
+
+namespace trace {
+
+// Utf8MaxLength returns the size of the buffer Utf16ToUtf8 needs for
+// length UTF-16 code units.
+inline size_t Utf8MaxLength(size_t length) { return length * 3; }
+
+// Utf16ToUtf8 encodes length UTF-16 code units from source into destination,
+// which must hold at least Utf8MaxLength(length) bytes, and returns the number
+// of bytes written. Unpaired surrogates are replaced with U+FFFD.
+//
+// Runs of ASCII characters, the common case for span data, are converted
+// 8 code units at a time with SSE2 when available, or 4 at a time with
+// 64-bit word operations otherwise.
+size_t Utf16ToUtf8(const WCHAR* source, size_t length, uint8_t* destination);
+
+}  // namespace trace
+
+#endif  // DD_CLR_PROFILER_UTF8_H_
@@ -1,5 +1,7 @@
 #include "util.h"
 
+#include <cstdint>
+#include <cstring>
 #include <cwctype>
 #include <iterator>
 #include <sstream>
@@ -29,23 +31,13 @@ std::vector<WSTRING> Split(const WSTRING &s, wchar_t delim) {
 }
 
 WSTRING Trim(const WSTRING &str) {
-  if (str.length() == 0) {
+  const auto lpos = str.find_first_not_of(" \t"_W);
+  if (lpos == WSTRING::npos) {
     return ""_W;
   }
 
-  WSTRING trimmed = str;
-
-  auto lpos = trimmed.find_first_not_of(" \t"_W);
-  if (lpos != WSTRING::npos && lpos > 0) {
-    trimmed = trimmed.substr(lpos);
-  }
-
-  auto rpos = trimmed.find_last_not_of(" \t"_W);
-  if (rpos != WSTRING::npos) {
-    trimmed = trimmed.substr(0, rpos + 1);
-  }
-
-  return trimmed;
+  const auto rpos = str.find_last_not_of(" \t"_W);
+  return str.substr(lpos, rpos - lpos + 1);
 }
 
 WSTRING GetEnvironmentValue(const WSTRING &name) {
@@ -82,4 +74,86 @@ std::vector<WSTRING> GetEnvironmentValues(const WSTRING &name) {
   return GetEnvironmentValues(name, L';');
 }
 
+bool TryParseUInt64(const WSTRING &str, uint64_t &value) {
+  if (str.empty()) {
+    return false;
+  }
+
+  uint64_t result = 0;
+  for (const auto c : str) {
+    if (c < '0'_W || c > '9'_W) {
+      return false;
+    }
+
+    const uint64_t digit = c - '0'_W;
+    if (result > (UINT64_MAX - digit) / 10) {
+      return false;
+    }
+
+    result = result * 10 + digit;
+  }
+
+  value = result;
+  return true;
+}
+
+bool WildcardMatch(const WSTRING &pattern, const WSTRING &text) {
+  size_t p = 0;
+  size_t t = 0;
+
+  // position of the last '*' seen and of the text it is currently matching,
+  // to backtrack to when the rest of the pattern fails
+  size_t star = WSTRING::npos;
+  size_t star_text = 0;
+
+  while (t < text.size()) {
+    if (p < pattern.size() &&
+        (pattern[p] == '?'_W || pattern[p] == text[t])) {
+      p++;
+      t++;
+    } else if (p < pattern.size() && pattern[p] == '*'_W) {
+      star = p++;
+      star_text = t;
+    } else if (star != WSTRING::npos) {
+      p = star + 1;
+      t = ++star_text;
+    } else {
+      return false;
+    }
+  }
+
+  while (p < pattern.size() && pattern[p] == '*'_W) {
+    p++;
+  }
+
+  return p == pattern.size();
+}
+
+uint64_t HashUtf16(const WCHAR *str, size_t length) {
+  const uint64_t kMultiplier = 0x9E3779B97F4A7C15ULL;
+
+  uint64_t hash = length * kMultiplier;
+  size_t i = 0;
+
+  // 4 code units at a time
+  for (; i + 4 <= length; i += 4) {
+    uint64_t chunk;
+    std::memcpy(&chunk, str + i, sizeof(chunk));
+    hash = (hash ^ chunk) * kMultiplier;
+    hash ^= hash >> 29;
+  }
+
+  for (; i < length; i++) {
+    hash = (hash ^ static_cast<uint16_t>(str[i])) * kMultiplier;
+  }
+
+  // final avalanche, from MurmurHash3
+  hash ^= hash >> 33;
+  hash *= 0xFF51AFD7ED558CCDULL;
+  hash ^= hash >> 33;
+  hash *= 0xC4CEB9FE1A85EC53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
 }  // namespace trace
@@ -31,6 +31,19 @@ std::vector<WSTRING> GetEnvironmentValues(const WSTRING &name,
 // GetEnvironmentValues calls GetEnvironmentValues with a semicolon delimiter.
 std::vector<WSTRING> GetEnvironmentValues(const WSTRING &name);
 
+// TryParseUInt64 parses a base-10 unsigned integer. Returns false if str is
+// empty, contains anything but digits or does not fit in 64 bits.
+bool TryParseUInt64(const WSTRING &str, uint64_t &value);
+
+// WildcardMatch returns true if text matches pattern, where '*' matches any
+// sequence of characters (including none) and '?' matches any single
+// character. Matching is case-sensitive.
+bool WildcardMatch(const WSTRING &pattern, const WSTRING &text);
+
+// HashUtf16 returns a 64-bit hash of length UTF-16 code units, for hash tables
+// and caches keyed by string contents.
+uint64_t HashUtf16(const WCHAR *str, size_t length);
+
 template <class Container>
 bool Contains(const Container &items,
               const typename Container::value_type &value) {
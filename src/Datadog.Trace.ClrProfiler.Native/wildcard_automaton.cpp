@@ -0,0 +1,230 @@
+#include "wildcard_automaton.h"
+
+#include <algorithm>
+#include <map>
+
+#include "memory_usage.h"
+
+namespace trace {
+
+namespace {
+
+// classes 0 and 1 are reserved for characters no pattern uses and for the
+// separator
+const uint16_t kOtherClass = 0;
+const uint16_t kSeparatorClass = 1;
+
+// an NFA state: a pattern id in the high half and the position of the next
+// pattern character to match in the low half
+typedef uint64_t NfaState;
+
+inline NfaState MakeNfaState(uint32_t id, uint32_t position) {
+  return (static_cast<uint64_t>(id) << 32) | position;
+}
+
+inline uint32_t NfaPattern(NfaState state) {
+  return static_cast<uint32_t>(state >> 32);
+}
+
+inline uint32_t NfaPosition(NfaState state) {
+  return static_cast<uint32_t>(state);
+}
+
+}  // namespace
+
+const uint32_t WildcardAutomaton::kDeadState;
+
+void WildcardAutomaton::Reset() {
+  std::fill(std::begin(ascii_classes_), std::end(ascii_classes_), kOtherClass);
+  other_classes_.clear();
+  class_count_ = 1;
+  transitions_.assign(1, kDeadState);
+  matches_.assign(1, std::vector<uint32_t>());
+  compiled_ = false;
+}
+
+uint32_t WildcardAutomaton::Add(const WSTRING& pattern) {
+  const auto it = pattern_ids_.find(pattern);
+  if (it != pattern_ids_.end()) {
+    return it->second;
+  }
+
+  const auto id = static_cast<uint32_t>(patterns_.size());
+  patterns_.push_back(pattern);
+  pattern_ids_[pattern] = id;
+  return id;
+}
+
+size_t WildcardAutomaton::MemoryUsage() const {
+  size_t bytes = HeapBytes(patterns_) + HashTableBytes(pattern_ids_) +
+                 HeapBytes(other_classes_) + HeapBytes(transitions_) +
+                 HeapBytes(matches_);
+  for (const auto& pattern : patterns_) {
+    // once in patterns_, once in pattern_ids_
+    bytes += 2 * HeapBytes(pattern);
+  }
+  for (const auto& matches : matches_) {
+    bytes += HeapBytes(matches);
+  }
+  return bytes;
+}
+
+uint16_t WildcardAutomaton::ClassOf(WCHAR c) const {
+  if (c < 128) {
+    return ascii_classes_[c];
+  }
+
+  const auto it = std::lower_bound(
+      other_classes_.begin(), other_classes_.end(),
+      std::make_pair(c, static_cast<uint16_t>(0)));
+  return it != other_classes_.end() && it->first == c ? it->second
+                                                      : kOtherClass;
+}
+
+bool WildcardAutomaton::Matches(uint32_t state, uint32_t id) const {
+  const auto& ids = matches_[state];
+  return std::binary_search(ids.begin(), ids.end(), id);
+}
+
+bool WildcardAutomaton::Compile(WCHAR separator, size_t max_states) {
+  Reset();
+  separator_ = separator;
+
+  // give every character used literally its own class
+  std::vector<WCHAR> literals;
+  literals.push_back(separator);
+  for (const auto& pattern : patterns_) {
+    for (const auto c : pattern) {
+      if (c != '*'_W && c != '?'_W) {
+        literals.push_back(c);
+      }
+    }
+  }
+  std::sort(literals.begin(), literals.end());
+  literals.erase(std::unique(literals.begin(), literals.end()),
+                 literals.end());
+
+  uint16_t next_class = kSeparatorClass + 1;
+  for (const auto c : literals) {
+    const uint16_t character_class =
+        c == separator ? kSeparatorClass : next_class++;
+    if (c < 128) {
+      ascii_classes_[c] = character_class;
+    } else {
+      other_classes_.emplace_back(c, character_class);
+    }
+  }
+  class_count_ = next_class;
+
+  // Closure adds the positions reachable by skipping '*'s, which can match
+  // nothing
+  const auto closure = [this](std::vector<NfaState>& states) {
+    const auto size = states.size();
+    for (size_t i = 0; i < size; i++) {
+      const auto& pattern = patterns_[NfaPattern(states[i])];
+      auto position = NfaPosition(states[i]);
+      while (position < pattern.size() && pattern[position] == '*'_W) {
+        states.push_back(MakeNfaState(NfaPattern(states[i]), ++position));
+      }
+    }
+    std::sort(states.begin(), states.end());
+    states.erase(std::unique(states.begin(), states.end()), states.end());
+  };
+
+  std::map<std::vector<NfaState>, uint32_t> state_ids;
+  std::vector<std::vector<NfaState>> queue;
+
+  const auto add_state = [&](std::vector<NfaState>& states) -> uint32_t {
+    const auto it = state_ids.find(states);
+    if (it != state_ids.end()) {
+      return it->second;
+    }
+
+    const auto id = static_cast<uint32_t>(matches_.size());
+    std::vector<uint32_t> matched;
+    for (const auto state : states) {
+      if (NfaPosition(state) == patterns_[NfaPattern(state)].size()) {
+        matched.push_back(NfaPattern(state));
+      }
+    }
+    matches_.push_back(matched);
+    transitions_.resize(matches_.size() * class_count_, kDeadState);
+    state_ids[states] = id;
+    queue.push_back(states);
+    return id;
+  };
+
+  // the dead state is the empty set
+  transitions_.assign(class_count_, kDeadState);
+  state_ids[std::vector<NfaState>()] = kDeadState;
+
+  std::vector<NfaState> start;
+  for (uint32_t id = 0; id < patterns_.size(); id++) {
+    start.push_back(MakeNfaState(id, 0));
+  }
+  closure(start);
+  add_state(start);
+
+  // a representative character for each class, to test literals against
+  std::vector<WCHAR> class_characters(class_count_, 0);
+  for (const auto c : literals) {
+    class_characters[ClassOf(c)] = c;
+  }
+
+  for (size_t next = 0; next < queue.size(); next++) {
+    if (matches_.size() > max_states) {
+      Reset();
+      return false;
+    }
+
+    // copied: add_state grows the queue
+    const auto states = queue[next];
+    const auto from = state_ids[states];
+
+    for (uint16_t character_class = 0; character_class < class_count_;
+         character_class++) {
+      std::vector<NfaState> targets;
+
+      for (const auto state : states) {
+        const auto& pattern = patterns_[NfaPattern(state)];
+        const auto position = NfaPosition(state);
+        if (position >= pattern.size()) {
+          continue;
+        }
+
+        const auto c = pattern[position];
+        if (c == '*'_W) {
+          if (character_class != kSeparatorClass) {
+            targets.push_back(state);
+          }
+        } else if (c == '?'_W) {
+          if (character_class != kSeparatorClass) {
+            targets.push_back(state + 1);
+          }
+        } else if (character_class != kOtherClass &&
+                   class_characters[character_class] == c) {
+          targets.push_back(state + 1);
+        }
+      }
+
+      if (targets.empty()) {
+        continue;
+      }
+
+      closure(targets);
+      const auto to = add_state(targets);
+      transitions_[static_cast<size_t>(from) * class_count_ +
+                   character_class] = to;
+    }
+  }
+
+  if (matches_.size() > max_states) {
+    Reset();
+    return false;
+  }
+
+  compiled_ = true;
+  return true;
+}
+
+}  // namespace trace
@@ -0,0 +1,100 @@
+#ifndef DD_CLR_PROFILER_WILDCARD_AUTOMATON_H_
+#define DD_CLR_PROFILER_WILDCARD_AUTOMATON_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "string.h"  // NOLINT
+
+namespace trace {
+
+// Maximum number of DFA states Compile builds before giving up.
+const size_t kMaxWildcardAutomatonStates = 4096;
+
+// WildcardAutomaton matches a text against many wildcard patterns at once,
+// with the syntax of WildcardMatch: '*' matches any sequence of characters
+// and '?' any single character.
+//
+// Compile turns all the patterns into a single DFA by subset construction,
+// so matching costs one table lookup per character however many patterns
+// there are, and never allocates. Characters are mapped to classes first:
+// one per character used literally by a pattern, and one for all others.
+//
+// An optional separator character is never matched by wildcards, so texts
+// made of several fields, like "Type\nMethod", are matched field by field.
+class WildcardAutomaton {
+ public:
+  // the state no text can leave: nothing matches
+  static const uint32_t kDeadState = 0;
+
+ private:
+  std::vector<WSTRING> patterns_;
+  std::unordered_map<WSTRING, uint32_t> pattern_ids_;
+
+  WCHAR separator_ = 0;
+  uint16_t ascii_classes_[128]{};
+  // classes of the other characters used by patterns, sorted
+  std::vector<std::pair<WCHAR, uint16_t>> other_classes_;
+  uint16_t class_count_ = 0;
+
+  std::vector<uint32_t> transitions_;
+  // pattern ids matched in each state, sorted
+  std::vector<std::vector<uint32_t>> matches_;
+  bool compiled_ = false;
+
+  uint16_t ClassOf(WCHAR c) const;
+
+  // Reset leaves only the dead state, so matching an uncompiled automaton
+  // finds nothing
+  void Reset();
+
+ public:
+  WildcardAutomaton() { Reset(); }
+
+  // Add returns the id of the pattern, the same for identical patterns.
+  // Patterns added after Compile are ignored until it is called again.
+  uint32_t Add(const WSTRING& pattern);
+
+  // Compile builds the DFA. Returns false, leaving the automaton unusable,
+  // if it would need more than max_states states.
+  bool Compile(WCHAR separator = 0,
+               size_t max_states = kMaxWildcardAutomatonStates);
+
+  bool IsCompiled() const { return compiled_; }
+  size_t PatternCount() const { return patterns_.size(); }
+  size_t StateCount() const { return matches_.size(); }
+  const WSTRING& GetPattern(uint32_t id) const { return patterns_[id]; }
+
+  uint32_t Start() const { return compiled_ ? 1 : kDeadState; }
+
+  uint32_t Step(uint32_t state, WCHAR c) const {
+    return transitions_[static_cast<size_t>(state) * class_count_ +
+                        ClassOf(c)];
+  }
+
+  // Run feeds text to the automaton from state and returns the final state.
+  uint32_t Run(uint32_t state, const WSTRING& text) const {
+    for (size_t i = 0; i < text.size() && state != kDeadState; i++) {
+      state = Step(state, text[i]);
+    }
+    return state;
+  }
+
+  // Matches returns the ids of the patterns matching the text that led to
+  // state, in increasing order.
+  const std::vector<uint32_t>& Matches(uint32_t state) const {
+    return matches_[state];
+  }
+
+  bool Matches(uint32_t state, uint32_t id) const;
+
+  // MemoryUsage estimates the memory allocated by the automaton.
+  size_t MemoryUsage() const;
+};
+
+}  // namespace trace
+
+#endif  // DD_CLR_PROFILER_WILDCARD_AUTOMATON_H_
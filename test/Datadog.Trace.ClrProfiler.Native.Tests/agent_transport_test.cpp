@@ -0,0 +1,411 @@
+#include "pch.h"
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/agent_transport.h"
+
+using namespace trace;
+
+namespace {
+
+#ifdef _WIN32
+typedef SOCKET socket_t;
+const socket_t kNoSocket = INVALID_SOCKET;
+void CloseSocket(socket_t socket) { closesocket(socket); }
+int Poll(socket_t socket, int timeout_ms) {
+  WSAPOLLFD fd = {socket, POLLIN, 0};
+  return WSAPoll(&fd, 1, timeout_ms);
+}
+#else
+typedef int socket_t;
+const socket_t kNoSocket = -1;
+void CloseSocket(socket_t socket) { close(socket); }
+int Poll(socket_t socket, int timeout_ms) {
+  pollfd fd = {socket, POLLIN, 0};
+  return poll(&fd, 1, timeout_ms);
+}
+#endif
+
+struct AgentRequest {
+  std::string headers;
+  std::string body;
+};
+
+// FakeAgent is a stand-in for the agent's /v0.4/traces endpoint on a loopback
+// port. It answers every request with the next status of statuses, the last
+// one being repeated. With chunked set, the responses use chunked transfer
+// encoding instead of a content length.
+class FakeAgent {
+ private:
+  socket_t listener_ = kNoSocket;
+  uint16_t port_ = 0;
+  std::vector<int> statuses_;
+  bool chunked_;
+  std::thread thread_;
+  std::atomic<bool> stop_{false};
+
+  std::mutex lock_;
+  std::vector<AgentRequest> requests_;
+  int connections_ = 0;
+
+  void Serve() {
+    while (!stop_) {
+      if (Poll(listener_, 50) != 1) {
+        continue;
+      }
+
+      const auto connection = accept(listener_, nullptr, nullptr);
+      if (connection == kNoSocket) {
+        continue;
+      }
+
+      {
+        std::lock_guard<std::mutex> guard(lock_);
+        connections_++;
+      }
+
+      std::string pending;
+      while (!stop_) {
+        AgentRequest request;
+        if (!Read(connection, pending, &request)) {
+          break;
+        }
+
+        int status;
+        {
+          std::lock_guard<std::mutex> guard(lock_);
+          status = statuses_[std::min(requests_.size(), statuses_.size() - 1)];
+          requests_.push_back(request);
+        }
+
+        const std::string body = R"({"rate_by_service":{}})";
+        auto response = "HTTP/1.1 " + std::to_string(status) +
+                        " Status\r\nContent-Type: application/json\r\n";
+        if (chunked_) {
+          // split in two chunks, the first one with an extension
+          response += "Transfer-Encoding: chunked\r\n\r\n"
+                      "5;name=value\r\n" +
+                      body.substr(0, 5) + "\r\n" + "11\r\n" + body.substr(5) +
+                      "\r\n0\r\n\r\n";
+        } else {
+          response += "Content-Length: " + std::to_string(body.size()) +
+                      "\r\n\r\n" + body;
+        }
+        send(connection, response.data(), static_cast<int>(response.size()),
+             0);
+      }
+
+      CloseSocket(connection);
+    }
+  }
+
+  bool Read(socket_t connection, std::string& pending,
+            AgentRequest* request) {
+    char buffer[4096];
+    size_t headers_end;
+    while ((headers_end = pending.find("\r\n\r\n")) == std::string::npos) {
+      if (Poll(connection, 50) != 1) {
+        if (stop_) {
+          return false;
+        }
+        continue;
+      }
+      const auto received = recv(connection, buffer, sizeof(buffer), 0);
+      if (received <= 0) {
+        return false;
+      }
+      pending.append(buffer, static_cast<size_t>(received));
+    }
+
+    request->headers = pending.substr(0, headers_end + 2);
+    const auto length_start = request->headers.find("Content-Length: ");
+    const size_t length =
+        length_start == std::string::npos
+            ? 0
+            : std::stoul(request->headers.substr(length_start + 16));
+
+    const auto body_start = headers_end + 4;
+    while (pending.size() < body_start + length) {
+      const auto received = recv(connection, buffer, sizeof(buffer), 0);
+      if (received <= 0) {
+        return false;
+      }
+      pending.append(buffer, static_cast<size_t>(received));
+    }
+
+    request->body = pending.substr(body_start, length);
+    pending.erase(0, body_start + length);
+    return true;
+  }
+
+ public:
+  explicit FakeAgent(std::vector<int> statuses, bool chunked = false)
+      : statuses_(statuses), chunked_(chunked) {
+#ifdef _WIN32
+    WSADATA wsa_data;
+    WSAStartup(MAKEWORD(2, 2), &wsa_data);
+#endif
+
+    listener_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    bind(listener_, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    listen(listener_, 4);
+
+    socklen_t length = sizeof(address);
+    getsockname(listener_, reinterpret_cast<sockaddr*>(&address), &length);
+    port_ = ntohs(address.sin_port);
+
+    thread_ = std::thread(&FakeAgent::Serve, this);
+  }
+
+  ~FakeAgent() {
+    stop_ = true;
+    thread_.join();
+    CloseSocket(listener_);
+  }
+
+  AgentEndpoint Endpoint() const {
+    AgentEndpoint endpoint;
+    endpoint.host = "127.0.0.1";
+    endpoint.port = port_;
+    return endpoint;
+  }
+
+  std::vector<AgentRequest> Requests() {
+    std::lock_guard<std::mutex> guard(lock_);
+    return requests_;
+  }
+
+  int Connections() {
+    std::lock_guard<std::mutex> guard(lock_);
+    return connections_;
+  }
+};
+
+// a payload of trace_count empty traces
+std::vector<uint8_t> Payload(uint8_t trace_count) {
+  std::vector<uint8_t> payload(1 + trace_count, 0x90);
+  payload[0] = static_cast<uint8_t>(0x90 | trace_count);
+  return payload;
+}
+
+template <typename Predicate>
+bool WaitFor(Predicate predicate) {
+  for (int i = 0; i < 500; i++) {
+    if (predicate()) {
+      return true;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return false;
+}
+
+}  // namespace
+
+TEST(AgentTransportTest, ReadsArrayHeaders) {
+  const uint8_t fixarray[] = {0x93};
+  const uint8_t array16[] = {0xDC, 0x01, 0x00};
+  const uint8_t array32[] = {0xDD, 0x00, 0x01, 0x00, 0x02};
+  const uint8_t map[] = {0x80};
+
+  uint32_t count = 0;
+  EXPECT_EQ(1u, ReadMessagePackArrayHeader(fixarray, sizeof(fixarray), &count));
+  EXPECT_EQ(3u, count);
+  EXPECT_EQ(3u, ReadMessagePackArrayHeader(array16, sizeof(array16), &count));
+  EXPECT_EQ(256u, count);
+  EXPECT_EQ(5u, ReadMessagePackArrayHeader(array32, sizeof(array32), &count));
+  EXPECT_EQ(65538u, count);
+  EXPECT_EQ(0u, ReadMessagePackArrayHeader(array32, 3, &count));
+  EXPECT_EQ(0u, ReadMessagePackArrayHeader(map, sizeof(map), &count));
+  EXPECT_EQ(0u, ReadMessagePackArrayHeader(nullptr, 0, &count));
+}
+
+TEST(AgentTransportTest, MergesQueuedPayloadsIntoOneRequest) {
+  FakeAgent agent({200});
+  AgentTransport transport;
+  transport.Configure(agent.Endpoint());
+
+  const auto first = Payload(1);
+  const auto second = Payload(2);
+  EXPECT_TRUE(transport.Enqueue(first.data(), first.size()));
+  EXPECT_TRUE(transport.Enqueue(second.data(), second.size()));
+  transport.Stop();
+
+  const auto requests = agent.Requests();
+  ASSERT_EQ(1u, requests.size());
+  EXPECT_EQ(0u, requests[0].headers.find("POST /v0.4/traces HTTP/1.1\r\n"));
+  EXPECT_NE(std::string::npos,
+            requests[0].headers.find("X-Datadog-Trace-Count: 3\r\n"));
+  EXPECT_NE(std::string::npos,
+            requests[0].headers.find("Content-Type: application/msgpack\r\n"));
+  EXPECT_EQ(std::string("\x93\x90\x90\x90"), requests[0].body);
+
+  const auto stats = transport.GetStats();
+  EXPECT_EQ(3u, stats.sent_traces);
+  EXPECT_EQ(1u, stats.requests);
+  EXPECT_EQ(0u, stats.queued_traces);
+  EXPECT_EQ(0u, stats.queued_bytes);
+  EXPECT_EQ(200, stats.last_status_code);
+  EXPECT_EQ(R"({"rate_by_service":{}})", transport.LastResponse());
+}
+
+TEST(AgentTransportTest, ReusesConnection) {
+  FakeAgent agent({200});
+  AgentTransport transport;
+  transport.Configure(agent.Endpoint());
+
+  const auto payload = Payload(1);
+  for (uint64_t i = 1; i <= 3; i++) {
+    transport.Enqueue(payload.data(), payload.size());
+    transport.Flush();
+    EXPECT_TRUE(
+        WaitFor([&] { return transport.GetStats().sent_traces == i; }));
+  }
+  transport.Stop();
+
+  EXPECT_EQ(3u, agent.Requests().size());
+  EXPECT_EQ(1, agent.Connections());
+}
+
+TEST(AgentTransportTest, DecodesChunkedResponses) {
+  FakeAgent agent({200}, true);
+  AgentTransport transport;
+  transport.Configure(agent.Endpoint());
+
+  const auto payload = Payload(1);
+  for (uint64_t i = 1; i <= 2; i++) {
+    const auto start = std::chrono::steady_clock::now();
+    transport.Enqueue(payload.data(), payload.size());
+    transport.Flush();
+    EXPECT_TRUE(
+        WaitFor([&] { return transport.GetStats().sent_traces == i; }));
+    // the end of the body is found without waiting for the timeout
+    EXPECT_LT(std::chrono::steady_clock::now() - start,
+              std::chrono::milliseconds(kAgentTimeout));
+  }
+  transport.Stop();
+
+  EXPECT_EQ(R"({"rate_by_service":{}})", transport.LastResponse());
+  EXPECT_EQ(2u, agent.Requests().size());
+  EXPECT_EQ(1, agent.Connections());
+}
+
+TEST(AgentTransportTest, RetriesFailedRequests) {
+  FakeAgent agent({500, 503, 200});
+  AgentTransport transport;
+  transport.Configure(agent.Endpoint());
+
+  const auto payload = Payload(1);
+  transport.Enqueue(payload.data(), payload.size());
+  transport.Flush();
+  EXPECT_TRUE(WaitFor([&] { return transport.GetStats().sent_traces == 1; }));
+  transport.Stop();
+
+  const auto stats = transport.GetStats();
+  EXPECT_EQ(3u, agent.Requests().size());
+  EXPECT_EQ(2u, stats.retries);
+  EXPECT_EQ(0u, stats.failed_traces);
+  EXPECT_EQ(200, stats.last_status_code);
+}
+
+TEST(AgentTransportTest, RetriesRateLimitedRequests) {
+  FakeAgent agent({429, 408, 200});
+  AgentTransport transport;
+  transport.Configure(agent.Endpoint());
+
+  const auto payload = Payload(1);
+  transport.Enqueue(payload.data(), payload.size());
+  transport.Flush();
+  EXPECT_TRUE(WaitFor([&] { return transport.GetStats().sent_traces == 1; }));
+  transport.Stop();
+
+  EXPECT_EQ(3u, agent.Requests().size());
+  EXPECT_EQ(2u, transport.GetStats().retries);
+}
+
+TEST(AgentTransportTest, DropsRejectedRequestsWithoutRetrying) {
+  FakeAgent agent({400, 200});
+  AgentTransport transport;
+  transport.Configure(agent.Endpoint());
+
+  const auto payload = Payload(2);
+  transport.Enqueue(payload.data(), payload.size());
+  transport.Flush();
+  EXPECT_TRUE(
+      WaitFor([&] { return transport.GetStats().failed_traces == 2; }));
+  transport.Stop();
+
+  const auto stats = transport.GetStats();
+  EXPECT_EQ(1u, agent.Requests().size());
+  EXPECT_EQ(0u, stats.retries);
+  EXPECT_EQ(0u, stats.sent_traces);
+  EXPECT_EQ(0u, stats.queued_traces);
+  EXPECT_EQ(400, stats.last_status_code);
+  EXPECT_EQ("", transport.LastResponse());
+}
+
+TEST(AgentTransportTest, DropsPayloadsWhenQueueIsFull) {
+  FakeAgent agent({500});
+  AgentTransport transport;
+  transport.Configure(agent.Endpoint());
+
+  // a little over half the queue: the second one does not fit, even while
+  // the first one is being sent
+  std::vector<uint8_t> payload(kMaxQueuedTraceBytes / 2 + 16, 0x90);
+  payload[0] = 0xDD;
+  payload[1] = 0;
+  payload[2] = 0;
+  payload[3] = 0;
+  payload[4] = 1;
+
+  EXPECT_TRUE(transport.Enqueue(payload.data(), payload.size()));
+  EXPECT_FALSE(transport.Enqueue(payload.data(), payload.size()));
+  transport.Stop();
+
+  const auto stats = transport.GetStats();
+  EXPECT_EQ(1u, stats.dropped_traces);
+  EXPECT_EQ(1u, stats.failed_traces);
+  EXPECT_EQ(0u, stats.sent_traces);
+  EXPECT_EQ(0u, stats.queued_bytes);
+  EXPECT_EQ(500, stats.last_status_code);
+}
+
+TEST(AgentTransportTest, RejectsPayloadsThatAreNotArrays) {
+  AgentTransport transport;
+
+  const uint8_t map[] = {0x81, 0xA1, 'a', 0x01};
+  EXPECT_FALSE(transport.Enqueue(map, sizeof(map)));
+  // a truncated array 16 header
+  const uint8_t truncated[] = {0xDC, 0x00};
+  EXPECT_FALSE(transport.Enqueue(truncated, sizeof(truncated)));
+
+  const auto stats = transport.GetStats();
+  EXPECT_EQ(0u, stats.queued_traces);
+  EXPECT_EQ(0u, stats.queued_bytes);
+}
+
+TEST(AgentTransportTest, RejectsPayloadsAfterStop) {
+  AgentTransport transport;
+  transport.Stop();
+
+  const auto payload = Payload(1);
+  EXPECT_FALSE(transport.Enqueue(payload.data(), payload.size()));
+  EXPECT_EQ(1u, transport.GetStats().dropped_traces);
+}
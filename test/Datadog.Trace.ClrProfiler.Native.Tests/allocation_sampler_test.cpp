@@ -0,0 +1,112 @@
+#include "pch.h"
+
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/allocation_sampler.h"
+
+using namespace trace;
+
+namespace {
+
+AllocationSite Site(ClassID class_id, FunctionID frame) {
+  AllocationSite site;
+  site.class_id = class_id;
+  site.stack.frame_count = 1;
+  site.stack.frames[0] = frame;
+  return site;
+}
+
+}  // namespace
+
+TEST(AllocationSamplerTest, WeighsSamplesByTheirProbability) {
+  // small objects stand for about one interval
+  EXPECT_NEAR(1024.0, SampleWeight(1, 1024), 1.0);
+  EXPECT_NEAR(1024.0 + 8.0, SampleWeight(16, 1024), 1.0);
+
+  // an object of one interval is sampled with probability 1 - 1/e
+  EXPECT_NEAR(1024.0 / (1.0 - std::exp(-1.0)), SampleWeight(1024, 1024),
+              1e-6);
+
+  // huge objects are always sampled and stand for themselves
+  EXPECT_NEAR(100.0 * 1024, SampleWeight(100 * 1024, 1024), 1e-6);
+
+  EXPECT_EQ(1024.0, SampleWeight(0, 1024));
+}
+
+TEST(AllocationSamplerTest, DrawsExponentialDistances) {
+  EXPECT_EQ(1, SampleDistance(1.0, 1024));
+  EXPECT_EQ(1024, SampleDistance(std::exp(-1.0), 1024));
+  EXPECT_EQ(2048, SampleDistance(std::exp(-2.0), 1024));
+  EXPECT_GT(SampleDistance(1e-300, 1024), 1024 * 600);
+}
+
+TEST(AllocationSamplerTest, SamplesOncePerIntervalOnAverage) {
+  AllocationSampler sampler;
+  sampler.Initialize(nullptr, 4096);
+
+  // the distance to the next sample is per thread: start from a fresh one
+  uint64_t samples = 0;
+  double estimated_bytes = 0;
+  std::thread thread([&]() {
+    for (int i = 0; i < 1000000; i++) {
+      if (sampler.CountAllocation(64)) {
+        samples++;
+        estimated_bytes += SampleWeight(64, 4096);
+      }
+    }
+  });
+  thread.join();
+
+  // 64 MB allocated, 15625 samples expected
+  EXPECT_NEAR(15625.0, static_cast<double>(samples), 15625.0 * 0.05);
+  EXPECT_NEAR(64e6, estimated_bytes, 64e6 * 0.05);
+}
+
+TEST(AllocationSamplerTest, AggregatesSamplesBySite) {
+  AllocationSampler sampler;
+  sampler.Initialize(nullptr, 1024);
+
+  sampler.RecordSample(0x1000, Site(1, 10), 100);
+  sampler.RecordSample(0x1100, Site(1, 10), 200);
+  sampler.RecordSample(0x1200, Site(2, 10), 4000);
+
+  AllocationSample samples[4];
+  ASSERT_EQ(2u, sampler.Drain(samples, 4));
+  const auto& first = samples[0].class_id == 1 ? samples[0] : samples[1];
+  const auto& second = samples[0].class_id == 1 ? samples[1] : samples[0];
+
+  EXPECT_EQ(2u, first.sample_count);
+  EXPECT_EQ(300u, first.sampled_bytes);
+  EXPECT_EQ(static_cast<uint64_t>(SampleWeight(100, 1024) +
+                                  SampleWeight(200, 1024)),
+            first.estimated_bytes);
+  EXPECT_EQ(1u, first.frame_count);
+  EXPECT_EQ(10u, first.frames[0]);
+  EXPECT_EQ(0u, first.frames[1]);
+
+  EXPECT_EQ(1u, second.sample_count);
+  EXPECT_EQ(4000u, second.sampled_bytes);
+
+  EXPECT_EQ(0u, sampler.Drain(samples, 4));
+}
+
+TEST(AllocationSamplerTest, DropsSamplesOnceTheTableIsFull) {
+  AllocationSampler sampler;
+  sampler.Initialize(nullptr, 1024);
+
+  for (ClassID class_id = 1; class_id <= kMaxAllocationSites + 10;
+       class_id++) {
+    sampler.RecordSample(0, Site(class_id, 10), 100);
+  }
+  // known sites are still aggregated
+  sampler.RecordSample(0, Site(1, 10), 100);
+  EXPECT_EQ(10u, sampler.DroppedSamples());
+
+  // sites that do not fit are kept for the next drain
+  std::vector<AllocationSample> samples(kMaxAllocationSites);
+  EXPECT_EQ(100u, sampler.Drain(samples.data(), 100));
+  EXPECT_EQ(kMaxAllocationSites - 100,
+            sampler.Drain(samples.data(), samples.size()));
+}
@@ -0,0 +1,70 @@
+#include "pch.h"
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/codegen_control.h"
+
+using namespace trace;
+
+TEST(CodegenControlTest, QueuesEachMethodOnce) {
+  CodegenControl control;
+  EXPECT_FALSE(control.IsEnabled());
+
+  EXPECT_TRUE(control.Add(1, 0x06000001, kCodegenUnoptimized));
+  EXPECT_TRUE(control.Add(1, 0x06000002, kCodegenRewritten));
+  EXPECT_TRUE(control.Add(2, 0x06000001, kCodegenDeferred));
+  EXPECT_FALSE(control.Add(1, 0x06000001, kCodegenUnoptimized));
+  EXPECT_EQ(3u, control.MethodCount());
+
+  std::vector<ModuleID> modules;
+  std::vector<mdMethodDef> methods;
+  EXPECT_EQ(2u, control.TakePending(&modules, &methods, 2));
+  EXPECT_EQ(std::vector<ModuleID>({1, 1}), modules);
+  EXPECT_EQ(std::vector<mdMethodDef>({0x06000001, 0x06000002}), methods);
+
+  EXPECT_EQ(1u, control.TakePending(&modules, &methods, 2));
+  EXPECT_EQ(0u, control.TakePending(&modules, &methods, 2));
+  EXPECT_EQ(3u, modules.size());
+
+  // requested methods are not queued again
+  EXPECT_FALSE(control.Add(2, 0x06000001, kCodegenDeferred));
+  EXPECT_EQ(0u, control.TakePending(&modules, &methods, 2));
+}
+
+TEST(CodegenControlTest, CombinesMethodFlags) {
+  CodegenControl control;
+  control.Add(1, 0x06000001, kCodegenUnoptimized);
+  control.Add(1, 0x06000002, kCodegenRewritten | kCodegenDeferred);
+
+  uint32_t flags = 0;
+  ASSERT_TRUE(control.Find(1, 0x06000001, &flags));
+  EXPECT_EQ(kCodegenUnoptimized, flags);
+  ASSERT_TRUE(control.Find(1, 0x06000002, &flags));
+  EXPECT_EQ(kCodegenRewritten | kCodegenDeferred, flags);
+  EXPECT_FALSE(control.Find(2, 0x06000001, &flags));
+
+  // a method rewritten after it was queued gets its rewritten IL back
+  control.Add(1, 0x06000001, kCodegenRewritten);
+  ASSERT_TRUE(control.Find(1, 0x06000001, &flags));
+  EXPECT_EQ(kCodegenRewritten | kCodegenUnoptimized, flags);
+
+  control.Add(1, 0x06000002, kCodegenUnoptimized);
+  ASSERT_TRUE(control.Find(1, 0x06000002, &flags));
+  EXPECT_EQ(kCodegenRewritten | kCodegenUnoptimized | kCodegenDeferred, flags);
+}
+
+TEST(CodegenControlTest, EvictsUnloadedModules) {
+  CodegenControl control;
+  control.Add(1, 0x06000001, kCodegenUnoptimized);
+  control.Add(2, 0x06000001, kCodegenUnoptimized);
+  control.Add(1, 0x06000002, kCodegenUnoptimized);
+
+  control.EvictModule(1);
+  EXPECT_EQ(1u, control.MethodCount());
+
+  uint32_t flags;
+  EXPECT_FALSE(control.Find(1, 0x06000001, &flags));
+
+  std::vector<ModuleID> modules;
+  std::vector<mdMethodDef> methods;
+  EXPECT_EQ(1u, control.TakePending(&modules, &methods, kMaxReJITBatchSize));
+  EXPECT_EQ(std::vector<ModuleID>({2}), modules);
+}
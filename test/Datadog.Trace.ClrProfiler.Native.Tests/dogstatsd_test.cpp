@@ -0,0 +1,316 @@
+#include "pch.h"
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/ddsketch.h"
+#include "../../src/Datadog.Trace.ClrProfiler.Native/dogstatsd.h"
+
+using namespace trace;
+
+namespace {
+
+// UdpListener is a stand-in for the agent's DogStatsD server on a loopback
+// port.
+class UdpListener {
+ private:
+#ifdef _WIN32
+  SOCKET socket_;
+#else
+  int socket_;
+#endif
+  uint16_t port_ = 0;
+
+ public:
+  UdpListener() {
+#ifdef _WIN32
+    WSADATA wsa_data;
+    WSAStartup(MAKEWORD(2, 2), &wsa_data);
+#endif
+
+    socket_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    bind(socket_, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+
+    socklen_t length = sizeof(address);
+    getsockname(socket_, reinterpret_cast<sockaddr*>(&address), &length);
+    port_ = ntohs(address.sin_port);
+  }
+
+  ~UdpListener() {
+#ifdef _WIN32
+    closesocket(socket_);
+#else
+    close(socket_);
+#endif
+  }
+
+  uint16_t Port() const { return port_; }
+
+  // Receive returns the datagrams received within timeout_ms of each other.
+  std::vector<std::string> Receive(int timeout_ms = 200) {
+    std::vector<std::string> datagrams;
+    char buffer[65536];
+
+    while (true) {
+#ifdef _WIN32
+      WSAPOLLFD fd = {socket_, POLLIN, 0};
+      if (WSAPoll(&fd, 1, timeout_ms) != 1) {
+        break;
+      }
+#else
+      pollfd fd = {socket_, POLLIN, 0};
+      if (poll(&fd, 1, timeout_ms) != 1) {
+        break;
+      }
+#endif
+      const auto received = recv(socket_, buffer, sizeof(buffer), 0);
+      if (received <= 0) {
+        break;
+      }
+      datagrams.push_back(std::string(buffer, static_cast<size_t>(received)));
+    }
+
+    return datagrams;
+  }
+};
+
+std::vector<std::string> Lines(const std::vector<std::string>& datagrams) {
+  std::vector<std::string> lines;
+  for (const auto& datagram : datagrams) {
+    size_t start = 0;
+    while (start <= datagram.size()) {
+      auto end = datagram.find('\n', start);
+      if (end == std::string::npos) {
+        end = datagram.size();
+      }
+      lines.push_back(datagram.substr(start, end - start));
+      start = end + 1;
+    }
+  }
+  std::sort(lines.begin(), lines.end());
+  return lines;
+}
+
+}  // namespace
+
+TEST(DDSketchTest, QuantilesAreWithinRelativeAccuracy) {
+  DDSketch sketch;
+  for (int i = 1; i <= 10000; i++) {
+    sketch.Add(i);
+  }
+
+  EXPECT_EQ(10000u, sketch.Count());
+  EXPECT_EQ(50005000.0, sketch.Sum());
+  EXPECT_EQ(1.0, sketch.Min());
+  EXPECT_EQ(10000.0, sketch.Max());
+
+  for (const auto q : {0.0, 0.1, 0.5, 0.9, 0.99, 0.999, 1.0}) {
+    const double expected = std::floor(q * 9999) + 1;
+    EXPECT_NEAR(expected, sketch.Quantile(q),
+                expected * kDDSketchRelativeAccuracy)
+        << "q=" << q;
+  }
+}
+
+TEST(DDSketchTest, HandlesNegativeAndZeroValues) {
+  DDSketch sketch;
+  for (int i = -100; i <= 100; i++) {
+    sketch.Add(i);
+  }
+
+  EXPECT_EQ(201u, sketch.Count());
+  EXPECT_EQ(-100.0, sketch.Quantile(0));
+  EXPECT_EQ(0.0, sketch.Quantile(0.5));
+  EXPECT_EQ(100.0, sketch.Quantile(1));
+  EXPECT_NEAR(-50.0, sketch.Quantile(0.25), 0.5);
+  EXPECT_NEAR(50.0, sketch.Quantile(0.75), 0.5);
+}
+
+TEST(DDSketchTest, MergeMatchesSingleSketch) {
+  DDSketch all;
+  DDSketch even;
+  DDSketch odd;
+  for (int i = 0; i < 1000; i++) {
+    const double value = 1.5 * i * i;
+    all.Add(value);
+    (i % 2 == 0 ? even : odd).Add(value);
+  }
+
+  even.Merge(odd);
+
+  EXPECT_EQ(all.Count(), even.Count());
+  EXPECT_EQ(all.Sum(), even.Sum());
+  EXPECT_EQ(all.Min(), even.Min());
+  EXPECT_EQ(all.Max(), even.Max());
+  for (const auto q : {0.0, 0.25, 0.5, 0.75, 0.95, 1.0}) {
+    EXPECT_EQ(all.Quantile(q), even.Quantile(q)) << "q=" << q;
+  }
+}
+
+TEST(DDSketchTest, BinsRebuildTheSketch) {
+  DDSketch sketch;
+  for (int i = 0; i < 500; i++) {
+    sketch.Add(i % 7 == 0 ? -i : i);
+  }
+
+  DDSketch rebuilt;
+  sketch.ForEachBin(
+      [&](double value, uint64_t count) { rebuilt.Add(value, count); });
+
+  EXPECT_EQ(sketch.Count(), rebuilt.Count());
+  for (const auto q : {0.01, 0.1, 0.5, 0.9, 0.99}) {
+    EXPECT_EQ(sketch.Quantile(q), rebuilt.Quantile(q)) << "q=" << q;
+  }
+}
+
+TEST(DDSketchTest, CollapsesLowestBins) {
+  DDSketch sketch;
+  for (int exponent = -300; exponent <= 300; exponent++) {
+    sketch.Add(std::pow(10.0, exponent));
+  }
+
+  EXPECT_EQ(601u, sketch.Count());
+
+  // the highest values keep their accuracy
+  EXPECT_NEAR(1e300, sketch.Quantile(1), 1e300 * kDDSketchRelativeAccuracy);
+  EXPECT_NEAR(1e299, sketch.Quantile(0.999),
+              1e299 * kDDSketchRelativeAccuracy);
+}
+
+TEST(DDSketchTest, IgnoresNonFiniteValues) {
+  DDSketch sketch;
+  sketch.Add(std::nan(""));
+  sketch.Add(HUGE_VAL);
+  EXPECT_TRUE(sketch.IsEmpty());
+  EXPECT_EQ(0.0, sketch.Quantile(0.5));
+}
+
+TEST(DogStatsdTest, AggregatesCountsAcrossThreads) {
+  UdpListener listener;
+  DogStatsd statsd;
+  statsd.Configure("127.0.0.1", listener.Port(), 60000);
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&] {
+      for (int i = 0; i < 1000; i++) {
+        statsd.Count("requests", "env:test,service:web", 1);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  statsd.Flush();
+
+  const auto datagrams = listener.Receive();
+  ASSERT_EQ(1u, datagrams.size());
+  EXPECT_EQ("requests:4000|c|#env:test,service:web", datagrams[0]);
+
+  const auto stats = statsd.GetStats();
+  EXPECT_EQ(4000u, stats.points);
+  EXPECT_EQ(1u, stats.lines);
+  EXPECT_EQ(1u, stats.datagrams);
+  EXPECT_EQ(0u, stats.send_errors);
+}
+
+TEST(DogStatsdTest, PacksMetricsIntoDatagrams) {
+  UdpListener listener;
+  DogStatsd statsd;
+  statsd.Configure("127.0.0.1", listener.Port(), 60000);
+
+  statsd.Gauge("queue.size", "", 3);
+  statsd.Gauge("queue.size", "", 7);
+  statsd.Count("errors", "kind:io", 2.5);
+  statsd.Count("bad|na:me", "", 1);
+  statsd.Flush();
+
+  const auto datagrams = listener.Receive();
+  ASSERT_EQ(1u, datagrams.size());
+  EXPECT_EQ((std::vector<std::string>{"bad_na_me:1|c", "errors:2.5|c|#kind:io",
+                                      "queue.size:7|g"}),
+            Lines(datagrams));
+
+  // nothing new to send
+  statsd.Flush();
+  EXPECT_TRUE(listener.Receive(50).empty());
+}
+
+TEST(DogStatsdTest, SplitsDatagramsAtMaximumSize) {
+  UdpListener listener;
+  DogStatsd statsd;
+  statsd.Configure("127.0.0.1", listener.Port(), 60000);
+
+  for (int i = 0; i < 200; i++) {
+    statsd.Count("metric." + std::to_string(i), "", i);
+  }
+  statsd.Flush();
+
+  const auto datagrams = listener.Receive();
+  EXPECT_GT(datagrams.size(), 1u);
+  for (const auto& datagram : datagrams) {
+    EXPECT_LE(datagram.size(), kMaxDogStatsdDatagramSize);
+  }
+  EXPECT_EQ(200u, Lines(datagrams).size());
+}
+
+TEST(DogStatsdTest, SendsDistributionsAsWeightedBins) {
+  UdpListener listener;
+  DogStatsd statsd;
+  statsd.Configure("127.0.0.1", listener.Port(), 60000);
+
+  for (int i = 0; i < 100; i++) {
+    statsd.Distribution("latency", "route:a", 10);
+  }
+  statsd.Distribution("latency", "route:a", 1000);
+  statsd.Distribution("latency", "route:a", 2000);
+  statsd.Flush();
+
+  const auto lines = Lines(listener.Receive());
+  ASSERT_EQ(2u, lines.size());
+
+  // the agent counts each value 1 / sample rate times
+  EXPECT_EQ(0u, lines[0].find("latency:"));
+  EXPECT_NE(std::string::npos, lines[0].find("|d|@0.01|#route:a"));
+  const auto value = std::stod(lines[0].substr(8));
+  EXPECT_NEAR(10.0, value, 10.0 * kDDSketchRelativeAccuracy);
+
+  EXPECT_EQ(0u, lines[1].find("latency:"));
+  EXPECT_NE(std::string::npos, lines[1].find("|d|#route:a"));
+  // two values, the third ':' is in the tag
+  EXPECT_EQ(3, std::count(lines[1].begin(), lines[1].end(), ':'));
+}
+
+TEST(DogStatsdTest, FlushesOnTimerAndStop) {
+  UdpListener listener;
+  DogStatsd statsd;
+  statsd.Configure("127.0.0.1", listener.Port(), 50);
+
+  statsd.Count("ticks", "", 1);
+  EXPECT_EQ(std::vector<std::string>{"ticks:1|c"}, listener.Receive(1000));
+
+  statsd.Count("ticks", "", 2);
+  statsd.Stop();
+  EXPECT_EQ(std::vector<std::string>{"ticks:2|c"}, listener.Receive());
+
+  // ignored once stopped
+  statsd.Count("ticks", "", 3);
+  EXPECT_EQ(2u, statsd.GetStats().points);
+}
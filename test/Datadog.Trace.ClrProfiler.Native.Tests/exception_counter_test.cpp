@@ -0,0 +1,100 @@
+#include "pch.h"
+
+#include <vector>
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/exception_counter.h"
+
+using namespace trace;
+
+TEST(ExceptionCounterTest, CountsByClassAndMethod) {
+  ExceptionCounter counter;
+  counter.Initialize(nullptr);
+
+  counter.Count(1, 10);
+  counter.Count(1, 10);
+  counter.Count(1, 20);
+  counter.Count(2, 0);
+
+  EXPECT_EQ(4u, counter.TotalCount());
+  EXPECT_EQ(0u, counter.DroppedCount());
+
+  ExceptionCount counts[8];
+  const auto written = counter.Snapshot(counts, 8);
+  ASSERT_EQ(3u, written);
+
+  uint64_t total = 0;
+  for (size_t i = 0; i < written; i++) {
+    total += counts[i].count;
+    if (counts[i].class_id == 1 && counts[i].function_id == 10) {
+      EXPECT_EQ(2u, counts[i].count);
+    } else {
+      EXPECT_EQ(1u, counts[i].count);
+    }
+  }
+  EXPECT_EQ(4u, total);
+
+  // totals are never reset
+  EXPECT_EQ(3u, counter.Snapshot(counts, 8));
+  EXPECT_EQ(1u, counter.Snapshot(counts, 1));
+}
+
+TEST(ExceptionCounterTest, IgnoresSearchesWithoutAnException) {
+  ExceptionCounter counter;
+  counter.Initialize(nullptr);
+
+  // no exception pending on this thread
+  counter.OnExceptionSearchFunctionEnter(10);
+  EXPECT_EQ(0u, counter.TotalCount());
+}
+
+TEST(ExceptionCounterTest, DropsExceptionsOnceTheTableIsFull) {
+  ExceptionCounter counter;
+  counter.Initialize(nullptr);
+
+  const ClassID class_count = kExceptionTableCapacity * 4;
+  for (ClassID class_id = 1; class_id <= class_count; class_id++) {
+    counter.Count(class_id, 0x1000);
+  }
+
+  // pairs that found no slot within the probe limit are dropped
+  std::vector<ExceptionCount> counts(kExceptionTableCapacity);
+  const auto written = counter.Snapshot(counts.data(), counts.size());
+  EXPECT_EQ(class_count, counter.TotalCount());
+  EXPECT_LE(written, kExceptionTableCapacity);
+  EXPECT_EQ(class_count, written + counter.DroppedCount());
+
+  std::vector<bool> counted(class_count + 1);
+  for (size_t i = 0; i < written; i++) {
+    EXPECT_EQ(1u, counts[i].count);
+    counted[counts[i].class_id] = true;
+  }
+
+  // a dropped pair is dropped again, a counted one is still counted
+  ClassID dropped_class_id = 1;
+  while (counted[dropped_class_id]) {
+    dropped_class_id++;
+  }
+  const auto dropped = counter.DroppedCount();
+  counter.Count(dropped_class_id, 0x1000);
+  EXPECT_EQ(dropped + 1, counter.DroppedCount());
+
+  counter.Count(counts[0].class_id, counts[0].function_id);
+  EXPECT_EQ(dropped + 1, counter.DroppedCount());
+  ASSERT_EQ(written, counter.Snapshot(counts.data(), counts.size()));
+
+  uint64_t total = 0;
+  for (size_t i = 0; i < written; i++) {
+    total += counts[i].count;
+  }
+  EXPECT_EQ(written + 1, total);
+}
+
+TEST(ExceptionCounterTest, IgnoresExceptionsWhenDisabled) {
+  ExceptionCounter counter;
+
+  counter.Count(1, 10);
+  EXPECT_EQ(0u, counter.TotalCount());
+
+  ExceptionCount counts[1];
+  EXPECT_EQ(0u, counter.Snapshot(counts, 1));
+}
@@ -0,0 +1,127 @@
+#include "pch.h"
+
+#include <vector>
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/gc_timeline.h"
+
+using namespace trace;
+
+namespace {
+
+void Pause(GcTimeline& timeline, int generation) {
+  timeline.OnRuntimeSuspendStarted(COR_PRF_SUSPEND_FOR_GC);
+  timeline.OnRuntimeSuspendFinished();
+  if (generation >= 0) {
+    BOOL collected[kGcGenerationCount] = {};
+    for (int i = 0; i <= generation; i++) {
+      collected[i] = TRUE;
+    }
+    // as the runtime does, the large object heap goes with gen 2
+    collected[kGcLargeObjectHeap] = generation == 2;
+    timeline.OnGarbageCollectionStarted(kGcGenerationCount, collected,
+                                        COR_PRF_GC_INDUCED);
+    timeline.OnGarbageCollectionFinished();
+  }
+  timeline.OnRuntimeResumeStarted();
+}
+
+}  // namespace
+
+TEST(GcTimelineTest, RecordsPauses) {
+  GcTimeline timeline;
+  timeline.Initialize(nullptr);
+
+  Pause(timeline, 0);
+  Pause(timeline, 2);
+  Pause(timeline, -1);
+
+  // an aborted suspension is not recorded
+  timeline.OnRuntimeSuspendStarted(COR_PRF_SUSPEND_FOR_GC);
+  timeline.OnRuntimeSuspendAborted();
+  timeline.OnRuntimeResumeStarted();
+
+  EXPECT_EQ(3u, timeline.PauseCount());
+  EXPECT_EQ(1u, timeline.GcCount(0));
+  EXPECT_EQ(0u, timeline.GcCount(1));
+  EXPECT_EQ(1u, timeline.GcCount(2));
+  EXPECT_EQ(1u, timeline.GcCount(kGcLargeObjectHeap));
+  EXPECT_EQ(0u, timeline.GcCount(kGcGenerationCount));
+
+  uint64_t cursor = 0;
+  GcPause pauses[8];
+  ASSERT_EQ(3u, timeline.Read(&cursor, pauses, 8));
+  EXPECT_EQ(3u, cursor);
+
+  EXPECT_EQ(1u, pauses[0].sequence);
+  EXPECT_EQ(0, pauses[0].generation);
+  EXPECT_EQ(static_cast<uint32_t>(COR_PRF_GC_INDUCED), pauses[0].gc_reason);
+  EXPECT_EQ(static_cast<uint32_t>(COR_PRF_SUSPEND_FOR_GC),
+            pauses[0].suspend_reason);
+  EXPECT_LE(pauses[0].suspend_ns, pauses[0].pause_ns);
+  EXPECT_GT(pauses[0].start_unix_ns, 0u);
+
+  EXPECT_EQ(2, pauses[1].generation);
+  EXPECT_EQ(-1, pauses[2].generation);
+
+  // nothing new
+  EXPECT_EQ(0u, timeline.Read(&cursor, pauses, 8));
+  EXPECT_EQ(3u, cursor);
+}
+
+TEST(GcTimelineTest, AdvancesTheCursor) {
+  GcTimeline timeline;
+  timeline.Initialize(nullptr);
+
+  for (int i = 0; i < 5; i++) {
+    Pause(timeline, 0);
+  }
+
+  uint64_t cursor = 0;
+  GcPause pauses[2];
+  ASSERT_EQ(2u, timeline.Read(&cursor, pauses, 2));
+  EXPECT_EQ(2u, cursor);
+  EXPECT_EQ(2u, pauses[1].sequence);
+
+  ASSERT_EQ(2u, timeline.Read(&cursor, pauses, 2));
+  EXPECT_EQ(4u, cursor);
+  EXPECT_EQ(3u, pauses[0].sequence);
+
+  Pause(timeline, 0);
+  ASSERT_EQ(2u, timeline.Read(&cursor, pauses, 2));
+  EXPECT_EQ(6u, cursor);
+  EXPECT_EQ(6u, pauses[1].sequence);
+}
+
+TEST(GcTimelineTest, SkipsOverwrittenPauses) {
+  GcTimeline timeline;
+  timeline.Initialize(nullptr);
+
+  const size_t count = kGcTimelineCapacity * 2 + 10;
+  for (size_t i = 0; i < count; i++) {
+    Pause(timeline, 0);
+  }
+  EXPECT_EQ(count, timeline.PauseCount());
+
+  // a reader that fell behind starts from the oldest retained pause
+  uint64_t cursor = 5;
+  std::vector<GcPause> pauses(kGcTimelineCapacity * 2);
+  ASSERT_EQ(kGcTimelineCapacity,
+            timeline.Read(&cursor, pauses.data(), pauses.size()));
+  EXPECT_EQ(count, cursor);
+  EXPECT_EQ(count - kGcTimelineCapacity + 1, pauses[0].sequence);
+  for (size_t i = 1; i < kGcTimelineCapacity; i++) {
+    ASSERT_EQ(pauses[i - 1].sequence + 1, pauses[i].sequence);
+  }
+  EXPECT_EQ(count, pauses[kGcTimelineCapacity - 1].sequence);
+}
+
+TEST(GcTimelineTest, IgnoresCallbacksWhenDisabled) {
+  GcTimeline timeline;
+
+  Pause(timeline, 0);
+
+  uint64_t cursor = 0;
+  GcPause pauses[1];
+  EXPECT_EQ(0u, timeline.PauseCount());
+  EXPECT_EQ(0u, timeline.Read(&cursor, pauses, 1));
+}
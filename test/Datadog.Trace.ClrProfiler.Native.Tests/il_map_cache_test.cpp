@@ -0,0 +1,155 @@
+#include "pch.h"
+
+#include <vector>
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/il_map_cache.h"
+
+using namespace trace;
+
+namespace {
+
+COR_PRF_CODE_INFO CodeRange(UINT_PTR start, SIZE_T size) {
+  COR_PRF_CODE_INFO range;
+  range.startAddress = start;
+  range.size = size;
+  return range;
+}
+
+COR_DEBUG_IL_TO_NATIVE_MAP Entry(ULONG32 il_offset, ULONG32 native_start,
+                                 ULONG32 native_end) {
+  COR_DEBUG_IL_TO_NATIVE_MAP entry;
+  entry.ilOffset = il_offset;
+  entry.nativeStartOffset = native_start;
+  entry.nativeEndOffset = native_end;
+  return entry;
+}
+
+}  // namespace
+
+TEST(ILMapCacheTest, ResolvesInstructionPointers) {
+  ILMapCache cache;
+
+  const COR_PRF_CODE_INFO ranges[] = {CodeRange(0x1000, 0x100)};
+  // unsorted, with the prolog and epilog markers
+  const COR_DEBUG_IL_TO_NATIVE_MAP entries[] = {
+      Entry(0x10, 0x20, 0x40), Entry(static_cast<ULONG32>(-2), 0, 0x10),
+      Entry(0, 0x10, 0x20), Entry(static_cast<ULONG32>(-3), 0x50, 0x60)};
+  ASSERT_TRUE(cache.Add(1, 0, 7, 0x06000010, ranges, 1, entries, 4));
+
+  ILOffsetLocation location{};
+  ASSERT_TRUE(cache.Lookup(1, 0, 0x1025, &location));
+  EXPECT_EQ(1u, location.function_id);
+  EXPECT_EQ(7u, location.module_id);
+  EXPECT_EQ(0x06000010u, location.method_token);
+  EXPECT_EQ(0x10, location.il_offset);
+
+  ASSERT_TRUE(cache.Lookup(1, 0, 0x1000, &location));
+  EXPECT_EQ(-2, location.il_offset);
+  ASSERT_TRUE(cache.Lookup(1, 0, 0x1010, &location));
+  EXPECT_EQ(0, location.il_offset);
+  ASSERT_TRUE(cache.Lookup(1, 0, 0x1055, &location));
+  EXPECT_EQ(-3, location.il_offset);
+
+  // in the gap between 0x40 and 0x50
+  ASSERT_TRUE(cache.Lookup(1, 0, 0x1045, &location));
+  EXPECT_EQ(-1, location.il_offset);
+
+  // outside the method, or another ReJIT version not loaded without info
+  EXPECT_FALSE(cache.Lookup(1, 0, 0x2000, &location));
+  EXPECT_FALSE(cache.Lookup(1, 1, 0x1025, &location));
+}
+
+TEST(ILMapCacheTest, SearchesLargeMapsAcrossCodeRanges) {
+  ILMapCache cache;
+
+  // hot code at 0x10000, cold code at 0x80000 continuing its offsets
+  const COR_PRF_CODE_INFO ranges[] = {CodeRange(0x10000, 0x800),
+                                      CodeRange(0x80000, 0x800)};
+  std::vector<COR_DEBUG_IL_TO_NATIVE_MAP> entries;
+  for (ULONG32 i = 0; i < 256; i++) {
+    // IL offsets going back and forth, as loops reorder them
+    const ULONG32 il_offset = i % 2 == 0 ? i * 3 : 1000 - i;
+    entries.push_back(Entry(il_offset, i * 8, i * 8 + 8));
+  }
+  ASSERT_TRUE(cache.Add(2, 3, 7, 0x06000020, ranges, 2, entries.data(),
+                        static_cast<uint32_t>(entries.size())));
+
+  ILOffsetLocation location{};
+  for (ULONG32 i = 0; i < 256; i++) {
+    const auto native_offset = i * 8 + 4;
+    const UINT_PTR ip = native_offset < 0x800
+                            ? 0x10000 + native_offset
+                            : 0x80000 + (native_offset - 0x800);
+    ASSERT_TRUE(cache.Lookup(2, 3, ip, &location));
+    EXPECT_EQ(static_cast<int32_t>(entries[i].ilOffset), location.il_offset);
+    EXPECT_EQ(3u, location.rejit_id);
+  }
+
+  // compact: a few bytes per entry
+  EXPECT_LT(cache.SizeBytes(), entries.size() * sizeof(entries[0]));
+}
+
+TEST(ILMapCacheTest, EvictsUnloadedModules) {
+  ILMapCache cache;
+
+  const COR_PRF_CODE_INFO ranges[] = {CodeRange(0x1000, 0x100),
+                                      CodeRange(0x2000, 0x100),
+                                      CodeRange(0x3000, 0x100)};
+  const COR_DEBUG_IL_TO_NATIVE_MAP entries[] = {Entry(0, 0, 0x100)};
+  cache.Add(1, 0, 7, 0x06000001, &ranges[0], 1, entries, 1);
+  cache.Add(1, 1, 7, 0x06000001, &ranges[1], 1, entries, 1);
+  cache.Add(2, 0, 8, 0x06000001, &ranges[2], 1, entries, 1);
+  EXPECT_EQ(3u, cache.MapCount());
+
+  cache.EvictModule(7);
+  EXPECT_EQ(1u, cache.MapCount());
+
+  ILOffsetLocation location{};
+  EXPECT_FALSE(cache.Lookup(1, 0, 0x1010, &location));
+  EXPECT_FALSE(cache.LookupIP(0x2010, &location));
+  EXPECT_TRUE(cache.Lookup(2, 0, 0x3010, &location));
+
+  cache.EvictModule(8);
+  EXPECT_EQ(0u, cache.MapCount());
+  EXPECT_EQ(0u, cache.SizeBytes());
+}
+
+TEST(ILMapCacheTest, KeepsOneMapPerNativeBody) {
+  ILMapCache cache;
+
+  // tier-0 and tier-1 code of the same method version
+  const COR_PRF_CODE_INFO tier0[] = {CodeRange(0x1000, 0x100)};
+  const COR_DEBUG_IL_TO_NATIVE_MAP tier0_entries[] = {Entry(0, 0, 0x40),
+                                                      Entry(0x10, 0x40, 0x100)};
+  const COR_PRF_CODE_INFO tier1[] = {CodeRange(0x8000, 0x40)};
+  const COR_DEBUG_IL_TO_NATIVE_MAP tier1_entries[] = {Entry(0, 0, 0x10),
+                                                      Entry(0x10, 0x10, 0x40)};
+  ASSERT_TRUE(cache.Add(1, 0, 7, 0x06000010, tier0, 1, tier0_entries, 2));
+  ASSERT_TRUE(cache.Add(1, 0, 7, 0x06000010, tier1, 1, tier1_entries, 2));
+  EXPECT_EQ(2u, cache.MapCount());
+
+  ILOffsetLocation location{};
+  ASSERT_TRUE(cache.Lookup(1, 0, 0x1020, &location));
+  EXPECT_EQ(0, location.il_offset);
+  ASSERT_TRUE(cache.Lookup(1, 0, 0x8020, &location));
+  EXPECT_EQ(0x10, location.il_offset);
+
+  // resolved from the code ranges alone
+  ASSERT_TRUE(cache.LookupIP(0x1050, &location));
+  EXPECT_EQ(1u, location.function_id);
+  EXPECT_EQ(0x10, location.il_offset);
+  ASSERT_TRUE(cache.LookupIP(0x8005, &location));
+  EXPECT_EQ(0, location.il_offset);
+  EXPECT_FALSE(cache.LookupIP(0x8040, &location));
+
+  // code reused by another method replaces the maps it overlaps
+  const COR_PRF_CODE_INFO reused[] = {CodeRange(0x8020, 0x100)};
+  const COR_DEBUG_IL_TO_NATIVE_MAP reused_entries[] = {Entry(0, 0, 0x100)};
+  ASSERT_TRUE(cache.Add(2, 0, 7, 0x06000020, reused, 1, reused_entries, 1));
+  EXPECT_EQ(2u, cache.MapCount());
+  EXPECT_FALSE(cache.LookupIP(0x8005, &location));
+  ASSERT_TRUE(cache.LookupIP(0x8025, &location));
+  EXPECT_EQ(2u, location.function_id);
+  ASSERT_TRUE(cache.LookupIP(0x1025, &location));
+  EXPECT_EQ(1u, location.function_id);
+}
@@ -223,3 +223,33 @@ TEST(IntegrationLoaderTest, DeserializesSignatureTypeArray) {
   EXPECT_STREQ(L"_", target.signature_types[1].c_str());
   EXPECT_STREQ(L"FakeClient.Pipeline'1<T>", target.signature_types[2].c_str());
 }
+
+TEST(IntegrationLoaderTest, LoadsWildcardCallerAndTargetNames) {
+  std::stringstream str(R"TEXT(
+        [{
+            "name": "test-integration",
+            "method_replacements": [{
+                "caller": { "type": "App.*Controller", "method": "Get?" },
+                "target": { "assembly": "Assembly.One", "type": "Type.*", "method": "Send*", "minimum_major": 0, "maximum_major": 10 },
+                "wrapper": { "assembly": "Assembly.Two", "type": "Type.Two", "method": "Method.Two", "signature": [0, 1, 1, 28] }
+            }, {
+                "target": { "assembly": "Assembly.One", "type": "Type.One", "method": "Method.One", "minimum_major": 0, "maximum_major": 10 },
+                "wrapper": { "assembly": "Assembly.Two", "type": "Type.Two", "method": "Method*", "signature": [0, 1, 1, 28] }
+            }]
+        }]
+    )TEXT");
+
+  auto integrations = LoadIntegrationsFromStream(str);
+  EXPECT_EQ(1, integrations.size());
+
+  // wrapper names can't be patterns
+  EXPECT_EQ(1, integrations[0].method_replacements.size());
+  auto mr = integrations[0].method_replacements[0];
+  EXPECT_STREQ(L"App.*Controller", mr.caller_method.type_name.c_str());
+  EXPECT_STREQ(L"Get?", mr.caller_method.method_name.c_str());
+  EXPECT_TRUE(mr.caller_method.HasNamePattern());
+  EXPECT_STREQ(L"Type.*", mr.target_method.type_name.c_str());
+  EXPECT_STREQ(L"Send*", mr.target_method.method_name.c_str());
+  EXPECT_TRUE(mr.target_method.HasNamePattern());
+  EXPECT_FALSE(mr.wrapper_method.HasNamePattern());
+}
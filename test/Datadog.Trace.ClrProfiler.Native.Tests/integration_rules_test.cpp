@@ -0,0 +1,244 @@
+#include "pch.h"
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/integration_rules.h"
+
+using namespace trace;
+
+namespace {
+
+// static object Wrapper(object, object, int, int, long)
+const std::vector<BYTE> kTwoArgumentWrapper = {0x00, 0x05, 0x1C, 0x1C,
+                                               0x1C, 0x08, 0x08, 0x0A};
+// static object Wrapper(object, int, int, long)
+const std::vector<BYTE> kOneArgumentWrapper = {0x00, 0x04, 0x1C,
+                                               0x1C, 0x08, 0x08, 0x0A};
+
+const Version kMinVersion(0, 0, 0, 0);
+const Version kMaxVersion(USHRT_MAX, USHRT_MAX, USHRT_MAX, USHRT_MAX);
+
+IntegrationMethod Replacement(
+    const WSTRING& name, const WSTRING& target_assembly,
+    const WSTRING& target_type, const WSTRING& target_method,
+    const std::vector<BYTE>& wrapper_signature,
+    const Version& min_version = kMinVersion,
+    const Version& max_version = kMaxVersion,
+    const std::vector<WSTRING>& signature_types = {},
+    const MethodReference& caller = {}) {
+  return {name,
+          {caller,
+           {target_assembly, target_type, target_method,
+            "ReplaceTargetMethod"_W, min_version, max_version, {},
+            signature_types},
+           {"Wrappers"_W, "Wrappers.Type"_W, name, "ReplaceTargetMethod"_W,
+            kMinVersion, kMaxVersion, wrapper_signature, {}}}};
+}
+
+AssemblyMetadata Assembly(const WSTRING& name, USHORT major) {
+  return {1, name, mdTokenNil, major, 0, 0, 0};
+}
+
+std::vector<WSTRING> Names(const std::vector<const IntegrationRule*>& rules) {
+  std::vector<WSTRING> names;
+  for (const auto rule : rules) {
+    names.push_back(rule->integration.integration_name);
+  }
+  return names;
+}
+
+}  // namespace
+
+TEST(IntegrationRulesTest, SelectsRulesByTargetAssemblyVersion) {
+  const IntegrationRuleSet rules(
+      {Replacement("v1"_W, "Lib"_W, "Lib.Client"_W, "Send"_W,
+                   kTwoArgumentWrapper, Version(1, 0, 0, 0),
+                   Version(1, 65535, 65535, 0)),
+       Replacement("v2"_W, "Lib"_W, "Lib.Client"_W, "Send"_W,
+                   kTwoArgumentWrapper, Version(2, 0, 0, 0)),
+       Replacement("other"_W, "Other"_W, "Other.Client"_W, "Send"_W,
+                   kTwoArgumentWrapper)});
+
+  const auto selection =
+      rules.Select("App"_W, {Assembly("App"_W, 1), Assembly("Lib"_W, 2)});
+  EXPECT_FALSE(selection.IsEmpty());
+  EXPECT_EQ(1u, selection.enabled_count);
+
+  const auto integrations = rules.GetIntegrations(selection);
+  ASSERT_EQ(1u, integrations.size());
+  EXPECT_EQ("v2"_W, integrations[0].integration_name);
+
+  EXPECT_TRUE(rules.Select("App"_W, {Assembly("System"_W, 4)}).IsEmpty());
+}
+
+TEST(IntegrationRulesTest, SelectsRulesByCallerAssembly) {
+  MethodReference caller("App"_W, ""_W, ""_W, ""_W, kMinVersion, kMaxVersion,
+                         {}, {});
+  const IntegrationRuleSet rules(
+      {Replacement("app-only"_W, "Lib"_W, "Lib.Client"_W, "Send"_W,
+                   kTwoArgumentWrapper, kMinVersion, kMaxVersion, {}, caller),
+       Replacement("any"_W, "Lib"_W, "Lib.Client"_W, "Receive"_W,
+                   kTwoArgumentWrapper)});
+
+  EXPECT_TRUE(rules.HasCallerRules("Other"_W));
+  EXPECT_EQ(2u, rules.Select("App"_W, {Assembly("Lib"_W, 1)}).enabled_count);
+  EXPECT_EQ(1u,
+            rules.Select("Other"_W, {Assembly("Lib"_W, 1)}).enabled_count);
+
+  const IntegrationRuleSet app_only_rules(
+      {Replacement("app-only"_W, "Lib"_W, "Lib.Client"_W, "Send"_W,
+                   kTwoArgumentWrapper, kMinVersion, kMaxVersion, {},
+                   caller)});
+  EXPECT_TRUE(app_only_rules.HasCallerRules("App"_W));
+  EXPECT_FALSE(app_only_rules.HasCallerRules("Other"_W));
+}
+
+TEST(IntegrationRulesTest, FindsReplacementsByMethodAndArity) {
+  const IntegrationRuleSet rules(
+      {Replacement("send-2"_W, "Lib"_W, "Lib.Client"_W, "Send"_W,
+                   kTwoArgumentWrapper),
+       Replacement("send-1"_W, "Lib"_W, "Lib.Client"_W, "Send"_W,
+                   kOneArgumentWrapper),
+       Replacement("receive"_W, "Lib"_W, "Lib.Client"_W, "Receive"_W,
+                   kTwoArgumentWrapper),
+       Replacement("too-short"_W, "Lib"_W, "Lib.Client"_W, "Send"_W,
+                   {0x00, 0x02, 0x1C, 0x1C, 0x08})});
+  const auto selection = rules.Select("App"_W, {Assembly("Lib"_W, 1)});
+
+  std::vector<const IntegrationRule*> found;
+  rules.FindReplacements(selection, "Lib.Client"_W, "Send"_W, 2, &found);
+  EXPECT_EQ(std::vector<WSTRING>({"send-2"_W}), Names(found));
+
+  found.clear();
+  rules.FindReplacements(selection, "Lib.Client"_W, "Send"_W, 1, &found);
+  EXPECT_EQ(std::vector<WSTRING>({"send-1"_W}), Names(found));
+
+  found.clear();
+  rules.FindReplacements(selection, "Lib.Client"_W, "Send"_W, 3, &found);
+  rules.FindReplacements(selection, "Lib.Client"_W, "Close"_W, 2, &found);
+  rules.FindReplacements(selection, "Lib.Server"_W, "Send"_W, 2, &found);
+  EXPECT_TRUE(found.empty());
+
+  EXPECT_EQ(-1, rules.GetRule(3).arity);
+}
+
+TEST(IntegrationRulesTest, KeepsIntegrationOrderAcrossAssemblies) {
+  const IntegrationRuleSet rules(
+      {Replacement("first"_W, "B"_W, "Shared.Type"_W, "Run"_W,
+                   kTwoArgumentWrapper),
+       Replacement("second"_W, "A"_W, "Shared.Type"_W, "Run"_W,
+                   kTwoArgumentWrapper),
+       Replacement("third"_W, "B"_W, "Shared.Type"_W, "Run"_W,
+                   kTwoArgumentWrapper)});
+  const auto selection =
+      rules.Select("App"_W, {Assembly("A"_W, 1), Assembly("B"_W, 1)});
+
+  std::vector<const IntegrationRule*> found;
+  rules.FindReplacements(selection, "Shared.Type"_W, "Run"_W, 2, &found);
+  EXPECT_EQ(std::vector<WSTRING>({"first"_W, "second"_W, "third"_W}),
+            Names(found));
+}
+
+TEST(IntegrationRulesTest, MatchesCallersAndSignatures) {
+  MethodReference caller(""_W, "App.Controller"_W, ""_W, ""_W, kMinVersion,
+                         kMaxVersion, {}, {});
+  const IntegrationRuleSet rules(
+      {Replacement("send"_W, "Lib"_W, "Lib.Client"_W, "Send"_W,
+                   kTwoArgumentWrapper, kMinVersion, kMaxVersion,
+                   {"System.Void"_W, "_"_W, "System.Int32"_W}, caller)});
+  const auto& rule = rules.GetRule(0);
+
+  EXPECT_TRUE(rule.IsReplacement());
+  EXPECT_TRUE(rule.MatchesCaller("App.Controller"_W, "Index"_W));
+  EXPECT_FALSE(rule.MatchesCaller("App.Other"_W, "Index"_W));
+
+  EXPECT_TRUE(rule.MatchesSignature(
+      {"System.Void"_W, "System.String"_W, "System.Int32"_W}));
+  EXPECT_FALSE(rule.MatchesSignature(
+      {"System.Void"_W, "System.String"_W, "System.Int64"_W}));
+  EXPECT_FALSE(rule.MatchesSignature({"System.Void"_W, "System.String"_W}));
+}
+
+TEST(IntegrationRulesTest, FindsReplacementsByTargetPattern) {
+  const IntegrationRuleSet rules(
+      {Replacement("any-client"_W, "Lib"_W, "Lib.*Client"_W, "Send*"_W,
+                   kTwoArgumentWrapper),
+       Replacement("exact"_W, "Lib"_W, "Lib.HttpClient"_W, "SendAsync"_W,
+                   kTwoArgumentWrapper),
+       Replacement("single"_W, "Lib"_W, "Lib.?Client"_W, "Send"_W,
+                   kTwoArgumentWrapper)});
+  const auto selection = rules.Select("App"_W, {Assembly("Lib"_W, 1)});
+
+  std::vector<const IntegrationRule*> found;
+  rules.FindReplacements(selection, "Lib.HttpClient"_W, "SendAsync"_W, 2,
+                         &found);
+  EXPECT_EQ(std::vector<WSTRING>({"any-client"_W, "exact"_W}), Names(found));
+
+  found.clear();
+  rules.FindReplacements(selection, "Lib.XClient"_W, "Send"_W, 2, &found);
+  EXPECT_EQ(std::vector<WSTRING>({"any-client"_W, "single"_W}), Names(found));
+
+  found.clear();
+  rules.FindReplacements(selection, "Lib.HttpClient"_W, "SendAsync"_W, 1,
+                         &found);
+  rules.FindReplacements(selection, "Lib.HttpServer"_W, "SendAsync"_W, 2,
+                         &found);
+  rules.FindReplacements(selection, "Lib.HttpClient"_W, "Receive"_W, 2,
+                         &found);
+  EXPECT_TRUE(found.empty());
+
+  EXPECT_TRUE(rules.GetRule(0).has_target_pattern);
+  EXPECT_FALSE(rules.GetRule(1).has_target_pattern);
+}
+
+TEST(IntegrationRulesTest, MatchesCallerPatterns) {
+  MethodReference controllers(""_W, "App.*Controller"_W, "Get*"_W, ""_W,
+                              kMinVersion, kMaxVersion, {}, {});
+  MethodReference any_app(""_W, "App.*"_W, ""_W, ""_W, kMinVersion,
+                          kMaxVersion, {}, {});
+  const IntegrationRuleSet rules(
+      {Replacement("controllers"_W, "Lib"_W, "Lib.Client"_W, "Send"_W,
+                   kTwoArgumentWrapper, kMinVersion, kMaxVersion, {},
+                   controllers),
+       Replacement("any-app"_W, "Lib"_W, "Lib.Client"_W, "Send"_W,
+                   kTwoArgumentWrapper, kMinVersion, kMaxVersion, {},
+                   any_app),
+       Replacement("anyone"_W, "Lib"_W, "Lib.Client"_W, "Send"_W,
+                   kTwoArgumentWrapper)});
+  const auto selection = rules.Select("App"_W, {Assembly("Lib"_W, 1)});
+
+  const WSTRING type_name = "App.HomeController"_W;
+  const WSTRING method_name = "GetIndex"_W;
+  const auto caller = rules.MatchCaller(type_name, method_name);
+  EXPECT_TRUE(rules.MatchesCaller(rules.GetRule(0), caller));
+
+  std::vector<const IntegrationRule*> found;
+  rules.FindCallerRules(selection, caller, &found);
+  EXPECT_EQ(std::vector<WSTRING>({"controllers"_W, "any-app"_W, "anyone"_W}),
+            Names(found));
+
+  const WSTRING other_method = "PostIndex"_W;
+  found.clear();
+  rules.FindCallerRules(selection, rules.MatchCaller(type_name, other_method),
+                        &found);
+  EXPECT_EQ(std::vector<WSTRING>({"any-app"_W, "anyone"_W}), Names(found));
+
+  const WSTRING other_type = "Lib.Worker"_W;
+  const auto other = rules.MatchCaller(other_type, method_name);
+  EXPECT_FALSE(rules.MatchesCaller(rules.GetRule(0), other));
+  EXPECT_FALSE(rules.GetRule(1).MatchesCaller(other_type, method_name));
+  EXPECT_TRUE(rules.MatchesCaller(rules.GetRule(2), other));
+}
+
+TEST(IntegrationRulesTest, MarksLowPriorityIntegrations) {
+  const IntegrationRuleSet rules(
+      {Replacement("AdoNet"_W, "Lib"_W, "Lib.Client"_W, "Send"_W,
+                   kTwoArgumentWrapper),
+       Replacement("Wcf"_W, "Lib"_W, "Lib.Client"_W, "Send"_W,
+                   kTwoArgumentWrapper),
+       Replacement("Wcf"_W, "Lib"_W, "Lib.Client"_W, "Receive"_W,
+                   kTwoArgumentWrapper)},
+      {"Wcf"_W});
+
+  EXPECT_FALSE(rules.GetRule(0).low_priority);
+  EXPECT_TRUE(rules.GetRule(1).low_priority);
+  EXPECT_TRUE(rules.GetRule(2).low_priority);
+}
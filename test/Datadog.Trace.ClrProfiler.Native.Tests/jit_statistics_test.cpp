@@ -0,0 +1,110 @@
+#include "pch.h"
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/jit_statistics.h"
+
+using namespace trace;
+
+TEST(JitStatisticsTest, SubtractsNestedCompilations) {
+  JitStatistics statistics;
+  statistics.Initialize(nullptr, 10);
+
+  // 1 starts at 0 and spends 100 instrumenting, 2 compiles from 200 to 500
+  statistics.OnJitStarted(1, 0);
+  statistics.OnInstrumentationFinished(1, 100);
+  statistics.OnJitStarted(2, 200);
+  statistics.OnInstrumentationFinished(2, 250);
+  statistics.OnJitFinished(2, S_OK, 500);
+  statistics.OnJitFinished(1, S_OK, 1000);
+
+  JitSummary summary;
+  statistics.GetSummary(&summary);
+  EXPECT_EQ(2u, summary.method_count);
+  EXPECT_EQ(1000u, summary.total_ns);
+  EXPECT_EQ(150u, summary.instrumentation_ns);
+  EXPECT_EQ(700u, summary.max_ns);
+  EXPECT_EQ(1u, summary.module_count);
+
+  JitMethodTime methods[4];
+  ASSERT_EQ(2u, statistics.GetSlowestMethods(methods, 4));
+  EXPECT_EQ(1u, methods[0].function_id);
+  EXPECT_EQ(700u, methods[0].duration_ns);
+  EXPECT_EQ(100u, methods[0].instrumentation_ns);
+  EXPECT_EQ(2u, methods[1].function_id);
+  EXPECT_EQ(300u, methods[1].duration_ns);
+
+  JitModuleStats modules[2];
+  ASSERT_EQ(1u, statistics.GetModules(modules, 2));
+  EXPECT_EQ(2u, modules[0].method_count);
+  EXPECT_EQ(1000u, modules[0].total_ns);
+  EXPECT_EQ(700u, modules[0].max_ns);
+}
+
+TEST(JitStatisticsTest, KeepsTheSlowestMethods) {
+  JitStatistics statistics;
+  statistics.Initialize(nullptr, 3);
+
+  const uint64_t durations[] = {50, 10, 80, 30, 90, 20, 60};
+  for (size_t i = 0; i < 7; i++) {
+    statistics.OnJitStarted(i + 1, 1000);
+    statistics.OnJitFinished(i + 1, S_OK, 1000 + durations[i]);
+  }
+
+  JitMethodTime methods[5];
+  ASSERT_EQ(3u, statistics.GetSlowestMethods(methods, 5));
+  EXPECT_EQ(90u, methods[0].duration_ns);
+  EXPECT_EQ(5u, methods[0].function_id);
+  EXPECT_EQ(80u, methods[1].duration_ns);
+  EXPECT_EQ(60u, methods[2].duration_ns);
+
+  JitSummary summary;
+  statistics.GetSummary(&summary);
+  EXPECT_EQ(7u, summary.method_count);
+  EXPECT_EQ(340u, summary.total_ns);
+}
+
+TEST(JitStatisticsTest, CountsFailures) {
+  JitStatistics statistics;
+  statistics.Initialize(nullptr, 3);
+
+  // finished without being seen starting
+  statistics.OnJitFinished(1, S_OK, 100);
+
+  statistics.OnJitStarted(2, 0);
+  statistics.OnJitFinished(2, E_FAIL, 100);
+
+  JitSummary summary;
+  statistics.GetSummary(&summary);
+  EXPECT_EQ(0u, summary.method_count);
+  EXPECT_EQ(1u, summary.failed_count);
+
+  JitMethodTime methods[1];
+  EXPECT_EQ(0u, statistics.GetSlowestMethods(methods, 1));
+}
+
+TEST(JitStatisticsTest, ForgetsMethodsOfUnloadedModules) {
+  JitStatistics statistics;
+  // without info, every method is in module 0
+  statistics.Initialize(nullptr, 2);
+
+  statistics.OnJitStarted(1, 0);
+  statistics.OnJitFinished(1, S_OK, 100);
+  statistics.OnJitStarted(2, 0);
+  statistics.OnJitFinished(2, S_OK, 200);
+
+  JitMethodTime methods[2];
+  statistics.EvictModule(1);
+  EXPECT_EQ(2u, statistics.GetSlowestMethods(methods, 2));
+
+  statistics.EvictModule(0);
+  EXPECT_EQ(0u, statistics.GetSlowestMethods(methods, 2));
+
+  // the totals stay, and the heap fills again
+  statistics.OnJitStarted(3, 0);
+  statistics.OnJitFinished(3, S_OK, 50);
+  ASSERT_EQ(1u, statistics.GetSlowestMethods(methods, 2));
+  EXPECT_EQ(3u, methods[0].function_id);
+
+  JitSummary summary;
+  statistics.GetSummary(&summary);
+  EXPECT_EQ(3u, summary.method_count);
+}
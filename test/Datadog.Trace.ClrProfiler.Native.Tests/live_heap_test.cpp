@@ -0,0 +1,126 @@
+#include "pch.h"
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/live_heap.h"
+
+using namespace trace;
+
+namespace {
+
+AllocationSite Site(ClassID class_id, FunctionID frame) {
+  AllocationSite site;
+  site.class_id = class_id;
+  site.stack.frame_count = 1;
+  site.stack.frames[0] = frame;
+  return site;
+}
+
+COR_PRF_GC_GENERATION_RANGE Range(COR_PRF_GC_GENERATION generation,
+                                  ObjectID start, UINT_PTR length) {
+  COR_PRF_GC_GENERATION_RANGE range;
+  range.generation = generation;
+  range.rangeStart = start;
+  range.rangeLength = length;
+  range.rangeLengthReserved = length;
+  return range;
+}
+
+}  // namespace
+
+TEST(LiveHeapTest, DropsCollectedObjects) {
+  LiveHeap live_heap;
+  live_heap.Initialize(1024, 100);
+
+  // gen 0 at 0x1000, gen 2 at 0x8000
+  live_heap.Track(0x1010, Site(1, 10), 100);
+  live_heap.Track(0x1020, Site(1, 10), 100);
+  live_heap.Track(0x1030, Site(2, 20), 200);
+  live_heap.Track(0x8010, Site(3, 30), 300);
+
+  const COR_PRF_GC_GENERATION_RANGE ranges[] = {
+      Range(COR_PRF_GC_GEN_0, 0x1000, 0x1000),
+      Range(COR_PRF_GC_GEN_2, 0x8000, 0x1000)};
+  const BOOL collected[] = {TRUE, FALSE, FALSE, FALSE};
+  live_heap.BeginCollection(4, collected, ranges, 2);
+
+  // the first object moved to gen 1, the second and third died
+  const ObjectID old_starts[] = {0x1000};
+  const ObjectID new_starts[] = {0x4000};
+  const SIZE_T lengths[] = {0x18};
+  live_heap.OnMovedReferences(1, old_starts, new_starts, lengths);
+  live_heap.OnGarbageCollectionFinished(42);
+
+  LiveHeapStats stats{};
+  LiveHeapSite sites[4];
+  ASSERT_EQ(2u, live_heap.Read(&stats, sites, 4));
+  EXPECT_EQ(1u, stats.gc_count);
+  EXPECT_EQ(42u, stats.timestamp_unix_ns);
+  EXPECT_EQ(2u, stats.tracked_objects);
+  EXPECT_EQ(2u, stats.site_count);
+  EXPECT_EQ(400u, stats.sampled_bytes);
+
+  // largest first
+  EXPECT_EQ(3u, sites[0].class_id);
+  EXPECT_EQ(1u, sites[0].live_objects);
+  EXPECT_EQ(300u, sites[0].sampled_bytes);
+  EXPECT_EQ(1u, sites[1].class_id);
+  EXPECT_EQ(1u, sites[1].frame_count);
+  EXPECT_EQ(10u, sites[1].frames[0]);
+  EXPECT_GE(sites[1].estimated_bytes, sites[1].sampled_bytes);
+}
+
+TEST(LiveHeapTest, FollowsMovedObjects) {
+  LiveHeap live_heap;
+  live_heap.Initialize(1024, 100);
+  live_heap.Track(0x1010, Site(1, 10), 100);
+
+  const COR_PRF_GC_GENERATION_RANGE ranges[] = {
+      Range(COR_PRF_GC_GEN_0, 0x1000, 0x1000)};
+  const BOOL collected[] = {TRUE, FALSE, FALSE, FALSE};
+
+  const ObjectID old_starts[] = {0x1000};
+  const ObjectID new_starts[] = {0x2000};
+  const SIZE_T lengths[] = {0x100};
+  live_heap.BeginCollection(4, collected, ranges, 1);
+  live_heap.OnMovedReferences(1, old_starts, new_starts, lengths);
+  live_heap.OnGarbageCollectionFinished(1);
+
+  // reported at its new address by the next collection
+  const COR_PRF_GC_GENERATION_RANGE next_ranges[] = {
+      Range(COR_PRF_GC_GEN_0, 0x2000, 0x1000)};
+  const ObjectID starts[] = {0x2010};
+  const SIZE_T next_lengths[] = {0x8};
+  live_heap.BeginCollection(4, collected, next_ranges, 1);
+  live_heap.OnSurvivingReferences(1, starts, next_lengths);
+  live_heap.OnGarbageCollectionFinished(2);
+
+  LiveHeapStats stats{};
+  LiveHeapSite sites[1];
+  ASSERT_EQ(1u, live_heap.Read(&stats, sites, 1));
+  EXPECT_EQ(2u, stats.gc_count);
+  EXPECT_EQ(1u, stats.tracked_objects);
+
+  // not reported: collected
+  live_heap.BeginCollection(4, collected, next_ranges, 1);
+  live_heap.OnGarbageCollectionFinished(3);
+  EXPECT_EQ(0u, live_heap.Read(&stats, sites, 1));
+  EXPECT_EQ(0u, stats.tracked_objects);
+}
+
+TEST(LiveHeapTest, CountsDroppedObjects) {
+  LiveHeap live_heap;
+  live_heap.Initialize(1024, 2);
+  live_heap.Track(0x1010, Site(1, 10), 100);
+  live_heap.Track(0x1020, Site(1, 10), 100);
+  live_heap.Track(0x1030, Site(1, 10), 100);
+
+  const BOOL collected[] = {FALSE, FALSE, FALSE, FALSE};
+  live_heap.BeginCollection(4, collected, nullptr, 0);
+  live_heap.OnGarbageCollectionFinished(1);
+
+  LiveHeapStats stats{};
+  LiveHeapSite sites[1];
+  ASSERT_EQ(1u, live_heap.Read(&stats, sites, 1));
+  EXPECT_EQ(2u, stats.tracked_objects);
+  EXPECT_EQ(1u, stats.dropped_objects);
+  EXPECT_EQ(2u, sites[0].live_objects);
+}
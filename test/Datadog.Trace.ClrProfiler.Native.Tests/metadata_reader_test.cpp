@@ -0,0 +1,410 @@
+#include "pch.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/metadata_reader.h"
+
+using namespace trace;
+
+namespace {
+
+class Bytes {
+ public:
+  std::vector<uint8_t> data;
+
+  uint32_t Size() const { return static_cast<uint32_t>(data.size()); }
+
+  void U8(uint8_t value) { data.push_back(value); }
+
+  void U16(uint16_t value) {
+    U8(static_cast<uint8_t>(value));
+    U8(static_cast<uint8_t>(value >> 8));
+  }
+
+  void U32(uint32_t value) {
+    U16(static_cast<uint16_t>(value));
+    U16(static_cast<uint16_t>(value >> 16));
+  }
+
+  void U64(uint64_t value) {
+    U32(static_cast<uint32_t>(value));
+    U32(static_cast<uint32_t>(value >> 32));
+  }
+
+  void Append(const std::vector<uint8_t>& bytes) {
+    data.insert(data.end(), bytes.begin(), bytes.end());
+  }
+
+  void Pad(uint32_t alignment) {
+    while (data.size() % alignment != 0) {
+      U8(0);
+    }
+  }
+
+  void Put32(uint32_t offset, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+      data[offset + i] = static_cast<uint8_t>(value >> (i * 8));
+    }
+  }
+
+  // String appends a null-terminated string and returns its offset.
+  uint16_t String(const char* value) {
+    const auto offset = static_cast<uint16_t>(data.size());
+    data.insert(data.end(), value, value + std::strlen(value) + 1);
+    return offset;
+  }
+
+  // Blob appends a blob with a one-byte length and returns its offset.
+  uint16_t Blob(const std::vector<uint8_t>& value) {
+    const auto offset = static_cast<uint16_t>(data.size());
+    U8(static_cast<uint8_t>(value.size()));
+    Append(value);
+    return offset;
+  }
+};
+
+// BuildImage returns a PE32 image, in file layout, of an assembly named Test
+// that references mscorlib and calls List<int>.Add.
+std::vector<uint8_t> BuildImage() {
+  Bytes strings;
+  strings.U8(0);
+  const auto module_name = strings.String("Test.dll");
+  const auto system = strings.String("System");
+  const auto object = strings.String("Object");
+  const auto generic = strings.String("System.Collections.Generic");
+  const auto list = strings.String("List`1");
+  const auto module_type = strings.String("<Module>");
+  const auto my = strings.String("My");
+  const auto program = strings.String("Program");
+  const auto other = strings.String("Other");
+  const auto main = strings.String("Main");
+  const auto run = strings.String("Run");
+  const auto helper = strings.String("Helper");
+  const auto add = strings.String("Add");
+  const auto test = strings.String("Test");
+  const auto mscorlib = strings.String("mscorlib");
+  strings.Pad(4);
+
+  Bytes blobs;
+  blobs.U8(0);
+  // GENERICINST CLASS TypeRef 2 <I4>
+  const auto list_of_int = blobs.Blob({0x15, 0x12, 0x09, 0x01, 0x08});
+  // HASTHIS void (!0)
+  const auto add_signature = blobs.Blob({0x20, 0x01, 0x01, 0x13, 0x00});
+  const auto void_signature = blobs.Blob({0x00, 0x00, 0x01});
+  // GENERICINST <I4>
+  const auto instantiation = blobs.Blob({0x0A, 0x01, 0x08});
+  blobs.Pad(4);
+
+  Bytes guids;
+  for (uint8_t i = 0; i < 16; i++) {
+    guids.U8(i);
+  }
+
+  Bytes tables;
+  tables.U32(0);
+  tables.U8(2);
+  tables.U8(0);
+  tables.U8(0);
+  tables.U8(1);
+  tables.U64(1ull << kModuleTable | 1ull << kTypeRefTable |
+             1ull << kTypeDefTable | 1ull << kMethodDefTable |
+             1ull << kMemberRefTable | 1ull << kTypeSpecTable |
+             1ull << kAssemblyTable | 1ull << kAssemblyRefTable |
+             1ull << kMethodSpecTable);
+  tables.U64(0);
+  // row counts
+  for (const uint32_t count : {1, 2, 3, 3, 1, 1, 1, 1, 1}) {
+    tables.U32(count);
+  }
+
+  // Module
+  tables.U16(0);
+  tables.U16(module_name);
+  tables.U16(1);
+  tables.U16(0);
+  tables.U16(0);
+
+  // TypeRef: ResolutionScope AssemblyRef 1
+  tables.U16(1 << 2 | 2);
+  tables.U16(object);
+  tables.U16(system);
+  tables.U16(1 << 2 | 2);
+  tables.U16(list);
+  tables.U16(generic);
+
+  // TypeDef: <Module>, My.Program with methods 1-2, My.Other with method 3
+  const uint16_t type_defs[3][3] = {
+      {module_type, 0, 1}, {program, my, 1}, {other, my, 3}};
+  for (const auto& type_def : type_defs) {
+    tables.U32(0);
+    tables.U16(type_def[0]);
+    tables.U16(type_def[1]);
+    // extends TypeRef 1
+    tables.U16(type_def[0] == module_type ? 0 : (1 << 2 | 1));
+    tables.U16(1);
+    tables.U16(type_def[2]);
+  }
+
+  // MethodDef
+  for (const auto name : {main, run, helper}) {
+    tables.U32(0);
+    tables.U16(0);
+    tables.U16(0);
+    tables.U16(name);
+    tables.U16(void_signature);
+    tables.U16(1);
+  }
+
+  // MemberRef: MemberRefParent TypeSpec 1
+  tables.U16(1 << 3 | 4);
+  tables.U16(add);
+  tables.U16(add_signature);
+
+  // TypeSpec
+  tables.U16(list_of_int);
+
+  // Assembly 1.2.3.4
+  tables.U32(0x8004);
+  tables.U16(1);
+  tables.U16(2);
+  tables.U16(3);
+  tables.U16(4);
+  tables.U32(0);
+  tables.U16(0);
+  tables.U16(test);
+  tables.U16(0);
+
+  // AssemblyRef mscorlib 4.0.0.0
+  tables.U16(4);
+  tables.U16(0);
+  tables.U16(0);
+  tables.U16(0);
+  tables.U32(0);
+  tables.U16(0);
+  tables.U16(mscorlib);
+  tables.U16(0);
+  tables.U16(0);
+
+  // MethodSpec: MethodDefOrRef MemberRef 1
+  tables.U16(1 << 1 | 1);
+  tables.U16(instantiation);
+  tables.Pad(4);
+
+  // metadata root and stream headers
+  Bytes metadata;
+  metadata.U32(0x424A5342);
+  metadata.U16(1);
+  metadata.U16(1);
+  metadata.U32(0);
+  metadata.U32(12);
+  metadata.String("v4.0.30319");
+  metadata.Pad(4);
+  metadata.U16(0);
+  metadata.U16(4);
+
+  const std::pair<const char*, const Bytes*> streams[] = {
+      {"#~", &tables}, {"#Strings", &strings}, {"#Blob", &blobs},
+      {"#GUID", &guids}};
+  std::vector<uint32_t> offset_fields;
+  for (const auto& stream : streams) {
+    offset_fields.push_back(metadata.Size());
+    metadata.U32(0);
+    metadata.U32(stream.second->Size());
+    metadata.String(stream.first);
+    metadata.Pad(4);
+  }
+  for (size_t i = 0; i < offset_fields.size(); i++) {
+    metadata.Put32(offset_fields[i], metadata.Size());
+    metadata.Append(streams[i].second->data);
+  }
+
+  const uint32_t section_rva = 0x2000;
+  const uint32_t section_offset = 0x200;
+  const uint32_t cli_header_size = 72;
+  const uint32_t section_size = cli_header_size + metadata.Size();
+
+  Bytes image;
+  image.data.resize(section_offset);
+  image.data[0] = 'M';
+  image.data[1] = 'Z';
+  image.Put32(0x3C, 0x80);
+  std::memcpy(&image.data[0x80], "PE\0\0", 4);
+  // COFF header: i386, 1 section, 224 bytes of optional header
+  image.data[0x84] = 0x4C;
+  image.data[0x85] = 0x01;
+  image.data[0x86] = 1;
+  image.data[0x94] = 224;
+  // optional header: PE32 magic, 16 data directories, CLI header
+  const uint32_t optional_header = 0x98;
+  image.data[optional_header] = 0x0B;
+  image.data[optional_header + 1] = 0x01;
+  image.Put32(optional_header + 92, 16);
+  image.Put32(optional_header + 96 + 14 * 8, section_rva);
+  image.Put32(optional_header + 96 + 14 * 8 + 4, cli_header_size);
+  // section header
+  const uint32_t section = optional_header + 224;
+  std::memcpy(&image.data[section], ".text", 5);
+  image.Put32(section + 8, section_size);
+  image.Put32(section + 12, section_rva);
+  image.Put32(section + 16, section_size);
+  image.Put32(section + 20, section_offset);
+
+  // CLI header, then the metadata
+  image.U32(cli_header_size);
+  image.U16(2);
+  image.U16(5);
+  image.U32(section_rva + cli_header_size);
+  image.U32(metadata.Size());
+  image.data.resize(section_offset + cli_header_size);
+  image.Append(metadata.data);
+
+  return image.data;
+}
+
+}  // namespace
+
+TEST(MetadataReaderTest, ReadsAssemblies) {
+  const auto image = BuildImage();
+  MetadataReader reader;
+  ASSERT_TRUE(reader.OpenImage(image.data(), image.size()));
+
+  MetadataAssembly assembly;
+  ASSERT_TRUE(reader.GetAssembly(&assembly));
+  EXPECT_EQ("Test", assembly.name);
+  EXPECT_EQ(1, assembly.major);
+  EXPECT_EQ(2, assembly.minor);
+  EXPECT_EQ(3, assembly.build);
+  EXPECT_EQ(4, assembly.revision);
+
+  ASSERT_EQ(1u, reader.RowCount(kAssemblyRefTable));
+  const auto reference = reader.GetAssemblyRef(1);
+  EXPECT_EQ("mscorlib", reference.name);
+  EXPECT_EQ(4, reference.major);
+
+  // out of range rows read as empty
+  EXPECT_EQ("", reader.GetAssemblyRef(2).name);
+}
+
+TEST(MetadataReaderTest, ReadsTypeNames) {
+  const auto image = BuildImage();
+  MetadataReader reader;
+  ASSERT_TRUE(reader.OpenImage(image.data(), image.size()));
+
+  std::string name;
+  ASSERT_TRUE(reader.GetTypeName(0x01000001, &name));
+  EXPECT_EQ("System.Object", name);
+  ASSERT_TRUE(reader.GetTypeName(0x02000001, &name));
+  EXPECT_EQ("<Module>", name);
+  ASSERT_TRUE(reader.GetTypeName(0x02000002, &name));
+  EXPECT_EQ("My.Program", name);
+  // List<int> is named after List`1
+  ASSERT_TRUE(reader.GetTypeName(0x1B000001, &name));
+  EXPECT_EQ("System.Collections.Generic.List`1", name);
+
+  EXPECT_FALSE(reader.GetTypeName(0x02000004, &name));
+  EXPECT_FALSE(reader.GetTypeName(0x06000001, &name));
+}
+
+TEST(MetadataReaderTest, DecodesTokens) {
+  const auto image = BuildImage();
+  MetadataReader reader;
+  ASSERT_TRUE(reader.OpenImage(image.data(), image.size()));
+
+  EXPECT_EQ(0x1B000001u, reader.GetToken(kMemberRefTable, 1,
+                                         column::kMemberRefClass));
+  EXPECT_STREQ("Add", reader.GetString(reader.GetColumn(
+                          kMemberRefTable, 1, column::kMemberRefName)));
+  EXPECT_EQ(0x0A000001u, reader.GetToken(kMethodSpecTable, 1,
+                                         column::kMethodSpecMethod));
+  EXPECT_EQ(0x23000001u,
+            reader.GetToken(kTypeRefTable, 2, column::kTypeRefResolutionScope));
+  EXPECT_EQ(0x06000003u,
+            reader.GetToken(kTypeDefTable, 3, column::kTypeDefMethodList));
+  // <Module> extends nothing
+  EXPECT_EQ(0u, reader.GetToken(kTypeDefTable, 1, column::kTypeDefExtends));
+  // not an index
+  EXPECT_EQ(0u, reader.GetToken(kMethodDefTable, 1, column::kMethodDefName));
+}
+
+TEST(MetadataReaderTest, FindsMethodOwners) {
+  const auto image = BuildImage();
+  MetadataReader reader;
+  ASSERT_TRUE(reader.OpenImage(image.data(), image.size()));
+
+  EXPECT_EQ(0x02000002u, reader.GetMethodDefParent(1));
+  EXPECT_EQ(0x02000002u, reader.GetMethodDefParent(2));
+  EXPECT_EQ(0x02000003u, reader.GetMethodDefParent(3));
+  EXPECT_EQ(0u, reader.GetMethodDefParent(4));
+}
+
+TEST(MetadataReaderTest, ReadsHeaps) {
+  const auto image = BuildImage();
+  MetadataReader reader;
+  ASSERT_TRUE(reader.OpenImage(image.data(), image.size()));
+
+  const uint8_t* blob;
+  uint32_t length;
+  ASSERT_TRUE(reader.GetBlob(
+      reader.GetColumn(kMethodSpecTable, 1, column::kMethodSpecInstantiation),
+      &blob, &length));
+  ASSERT_EQ(3u, length);
+  EXPECT_EQ(0x0A, blob[0]);
+  EXPECT_FALSE(reader.GetBlob(0xFFFF, &blob, &length));
+  EXPECT_EQ(nullptr, blob);
+
+  const auto mvid = reader.GetGuid(
+      reader.GetColumn(kModuleTable, 1, column::kModuleMvid));
+  ASSERT_NE(nullptr, mvid);
+  EXPECT_EQ(15, mvid[15]);
+  EXPECT_EQ(nullptr, reader.GetGuid(2));
+
+  EXPECT_STREQ("", reader.GetString(0xFFFF));
+}
+
+TEST(MetadataReaderTest, RejectsMalformedImages) {
+  const auto image = BuildImage();
+  MetadataReader reader;
+
+  for (size_t size = 0; size < image.size(); size++) {
+    EXPECT_FALSE(reader.OpenImage(image.data(), size)) << size;
+  }
+  EXPECT_EQ(0u, reader.RowCount(kMethodDefTable));
+
+  auto not_metadata = image;
+  not_metadata[0x200 + 72] = 'X';
+  EXPECT_FALSE(reader.OpenImage(not_metadata.data(), not_metadata.size()));
+
+  // edit-and-continue table stream
+  auto uncompressed = image;
+  const char name[] = "#~";
+  const auto it = std::search(uncompressed.begin(), uncompressed.end(), name,
+                              name + sizeof(name));
+  ASSERT_NE(uncompressed.end(), it);
+  *(it + 1) = '-';
+  EXPECT_FALSE(reader.OpenImage(uncompressed.data(), uncompressed.size()));
+
+  EXPECT_TRUE(reader.OpenImage(image.data(), image.size()));
+}
+
+TEST(MetadataReaderTest, MapsFiles) {
+  const auto image = BuildImage();
+  const auto path =
+      std::filesystem::temp_directory_path() / "metadata-reader-test.dll";
+  {
+    std::ofstream f(path, std::ios::binary);
+    f.write(reinterpret_cast<const char*>(image.data()), image.size());
+  }
+
+  MetadataReader reader;
+  ASSERT_TRUE(reader.Open(ToWSTRING(path.string())));
+  MetadataAssembly assembly;
+  ASSERT_TRUE(reader.GetAssembly(&assembly));
+  EXPECT_EQ("Test", assembly.name);
+
+  std::filesystem::remove(path);
+  EXPECT_FALSE(reader.Open(ToWSTRING(path.string())));
+}
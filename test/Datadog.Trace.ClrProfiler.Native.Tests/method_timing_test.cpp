@@ -0,0 +1,97 @@
+#include "pch.h"
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/latency_histogram.h"
+#include "../../src/Datadog.Trace.ClrProfiler.Native/method_timing.h"
+#include "../../src/Datadog.Trace.ClrProfiler.Native/util.h"
+
+using namespace trace;
+
+TEST(WildcardMatchTest, MatchesLiteral) {
+  EXPECT_TRUE(WildcardMatch("System.String.Concat"_W, "System.String.Concat"_W));
+  EXPECT_FALSE(WildcardMatch("System.String.Concat"_W, "System.String.Copy"_W));
+  EXPECT_FALSE(WildcardMatch("System.String"_W, "System.String.Concat"_W));
+}
+
+TEST(WildcardMatchTest, MatchesStar) {
+  EXPECT_TRUE(WildcardMatch("*"_W, ""_W));
+  EXPECT_TRUE(WildcardMatch("*.Get*"_W, "MyApp.HomeController.GetAsync"_W));
+  EXPECT_TRUE(WildcardMatch("MyApp.*Controller.*"_W,
+                            "MyApp.HomeController.Index"_W));
+  EXPECT_FALSE(WildcardMatch("MyApp.*Controller.*"_W,
+                             "MyApp.HomeService.Index"_W));
+  EXPECT_TRUE(WildcardMatch("a*b*c"_W, "aXbYbZc"_W));
+  EXPECT_FALSE(WildcardMatch("a*b*c"_W, "aXbYbZ"_W));
+}
+
+TEST(WildcardMatchTest, MatchesQuestionMark) {
+  EXPECT_TRUE(WildcardMatch("Get?"_W, "GetA"_W));
+  EXPECT_FALSE(WildcardMatch("Get?"_W, "Get"_W));
+  EXPECT_FALSE(WildcardMatch("Get?"_W, "GetAB"_W));
+}
+
+TEST(MethodPatternListTest, UnqualifiedPatternsIgnoreAssembly) {
+  MethodPatternList patterns;
+  patterns.Add(" MyApp.*Controller.Get* "_W);
+
+  EXPECT_TRUE(patterns.Matches("MyApp!MyApp.HomeController.GetAsync"_W));
+  EXPECT_TRUE(patterns.Matches("Other!MyApp.HomeController.Get"_W));
+  EXPECT_FALSE(patterns.Matches("MyApp!MyApp.HomeController.Post"_W));
+}
+
+TEST(MethodPatternListTest, QualifiedPatternsMatchAssembly) {
+  MethodPatternList patterns;
+  patterns.Add("System.Net.Http!*.SendAsync"_W);
+
+  EXPECT_TRUE(patterns.Matches(
+      "System.Net.Http!System.Net.Http.HttpClient.SendAsync"_W));
+  EXPECT_FALSE(patterns.Matches("MyApp!MyApp.Client.SendAsync"_W));
+}
+
+TEST(MethodPatternListTest, IgnoresEmptyPatterns) {
+  MethodPatternList patterns;
+  patterns.Add(""_W);
+  patterns.Add("   "_W);
+
+  EXPECT_TRUE(patterns.IsEmpty());
+  EXPECT_FALSE(patterns.Matches("MyApp!MyApp.Program.Main"_W));
+}
+
+TEST(LatencyHistogramTest, BucketsAreContiguous) {
+  for (size_t i = 1; i < kLatencyBucketCount; i++) {
+    const auto lower = LatencyBucketLowerBound(i);
+    EXPECT_EQ(LatencyBucket(lower), i);
+    EXPECT_EQ(LatencyBucket(lower - 1), i - 1);
+  }
+}
+
+TEST(LatencyHistogramTest, BucketWidthIsBounded) {
+  for (size_t i = 4; i < kLatencyBucketCount - 1; i++) {
+    const auto lower = LatencyBucketLowerBound(i);
+    const auto width = LatencyBucketLowerBound(i + 1) - lower;
+    EXPECT_LE(width * 4, lower);
+  }
+}
+
+TEST(LatencyHistogramTest, LargeValuesGoToLastBucket) {
+  EXPECT_EQ(LatencyBucket(UINT64_MAX), kLatencyBucketCount - 1);
+}
+
+TEST(LatencyHistogramTest, Percentiles) {
+  LatencyHistogram histogram;
+  for (uint64_t i = 1; i <= 1000; i++) {
+    histogram.Record(i * 1000);
+  }
+
+  EXPECT_EQ(histogram.count, 1000u);
+  EXPECT_EQ(histogram.min, 1000u);
+  EXPECT_EQ(histogram.max, 1000000u);
+
+  // within one bucket (25%) of the exact value
+  const auto p50 = histogram.Percentile(50);
+  EXPECT_GE(p50, 400000u);
+  EXPECT_LE(p50, 500000u);
+
+  const auto p99 = histogram.Percentile(99);
+  EXPECT_GE(p99, 790000u);
+  EXPECT_LE(p99, 1000000u);
+}
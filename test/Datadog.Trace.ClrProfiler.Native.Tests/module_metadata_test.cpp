@@ -0,0 +1,66 @@
+#include "pch.h"
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/module_metadata.h"
+
+using namespace trace;
+
+namespace {
+
+IntegrationMethod Replacement(const WSTRING& name) {
+  return {name,
+          {{},
+           {"Lib"_W, "Lib.Client"_W, "Send"_W, "ReplaceTargetMethod"_W,
+            Version(0, 0, 0, 0), Version(1, 0, 0, 0), {}, {}},
+           {"Wrappers"_W, "Wrappers.ClientIntegration"_W, name,
+            "ReplaceTargetMethod"_W, Version(0, 0, 0, 0), Version(1, 0, 0, 0),
+            {0x00, 0x04, 0x1C, 0x1C, 0x08, 0x08, 0x0A}, {}}}};
+}
+
+ModuleMetadata* CreateModuleMetadata() {
+  const std::vector<IntegrationMethod> integrations = {
+      Replacement("SendIntegration"_W), Replacement("OtherIntegration"_W)};
+
+  auto module_metadata = new ModuleMetadata(
+      {}, {}, {}, {}, "Samples.ExampleLibrary"_W, 1, GUID{}, integrations);
+  module_metadata->rules =
+      std::make_shared<const IntegrationRuleSet>(integrations);
+  module_metadata->call_target_tokens = {0x0A000001, 0x0A000002};
+  module_metadata->has_call_target_tokens = true;
+  return module_metadata;
+}
+
+}  // namespace
+
+TEST(ModuleMetadataTest, AccountsForOwnedMemory) {
+  std::unique_ptr<ModuleMetadata> module_metadata(CreateModuleMetadata());
+  const auto initial = module_metadata->MemoryUsage();
+  EXPECT_GT(initial, sizeof(ModuleMetadata));
+
+  module_metadata->SetWrapperMemberRef("[Wrappers]Wrappers.Send"_W,
+                                       0x0A000010);
+  EXPECT_GT(module_metadata->MemoryUsage(), initial);
+
+  // the shared rules are accounted once, not per module
+  EXPECT_GT(module_metadata->rules->MemoryUsage(), sizeof(IntegrationRuleSet));
+}
+
+TEST(ModuleMetadataTest, CompactsToMinimalRecord) {
+  std::unique_ptr<ModuleMetadata> module_metadata(CreateModuleMetadata());
+  module_metadata->SetWrapperMemberRef("[Wrappers]Wrappers.Send"_W,
+                                       0x0A000010);
+  const auto before = module_metadata->MemoryUsage();
+
+  EXPECT_TRUE(module_metadata->Compact());
+  EXPECT_FALSE(module_metadata->Compact());
+  EXPECT_TRUE(module_metadata->compacted);
+  EXPECT_LT(module_metadata->MemoryUsage(), before);
+  EXPECT_TRUE(module_metadata->integrations.empty());
+
+  // what instrumentation needs without the metadata interfaces is kept
+  mdMemberRef wrapper_ref = mdMemberRefNil;
+  EXPECT_TRUE(module_metadata->TryGetWrapperMemberRef(
+      "[Wrappers]Wrappers.Send"_W, wrapper_ref));
+  EXPECT_EQ(0x0A000010u, wrapper_ref);
+  EXPECT_EQ(2u, module_metadata->call_target_tokens.size());
+  EXPECT_NE(nullptr, module_metadata->rules);
+}
@@ -0,0 +1,92 @@
+#include "pch.h"
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/overhead_budget.h"
+
+using namespace trace;
+
+namespace {
+
+const uint64_t kMillisecond = 1000000;
+
+}  // namespace
+
+TEST(OverheadBudgetTest, IsUnlimitedByDefault) {
+  OverheadBudget budget;
+  EXPECT_FALSE(budget.IsEnabled());
+
+  for (int i = 0; i < 1000; i++) {
+    budget.AddOverhead(10 * kMillisecond, kOverheadBudgetWindowNs);
+    budget.AddRewrite(kOverheadBudgetWindowNs);
+  }
+  EXPECT_FALSE(budget.IsThrottled(kOverheadBudgetWindowNs));
+}
+
+TEST(OverheadBudgetTest, ThrottlesOverheadUntilTheNextWindow) {
+  OverheadBudget budget;
+  budget.Configure(5, 0);
+  ASSERT_TRUE(budget.IsEnabled());
+
+  const auto start = 10 * kOverheadBudgetWindowNs;
+  budget.AddOverhead(3 * kMillisecond, start);
+  EXPECT_FALSE(budget.IsThrottled(start + 1));
+
+  budget.AddOverhead(3 * kMillisecond, start + 2);
+  EXPECT_TRUE(budget.IsThrottled(start + 3));
+  EXPECT_TRUE(budget.IsThrottled(start + 4));
+
+  OverheadBudgetStats stats;
+  budget.Read(&stats);
+  EXPECT_EQ(1u, stats.throttled_windows);
+  EXPECT_EQ(1u, stats.throttled);
+
+  // the load dropped in the next window
+  EXPECT_FALSE(budget.IsThrottled(start + kOverheadBudgetWindowNs));
+
+  budget.Read(&stats);
+  EXPECT_EQ(0u, stats.throttled);
+  EXPECT_EQ(6 * kMillisecond, stats.last_window_overhead_ns);
+}
+
+TEST(OverheadBudgetTest, AccumulatesShortCallbacksPerThread) {
+  OverheadBudget budget;
+  budget.Configure(1, 0);
+
+  const auto start = 20 * kOverheadBudgetWindowNs;
+  const auto callback = kOverheadFlushThresholdNs / 4;
+
+  // below the flush threshold, nothing reaches the window
+  for (int i = 0; i < 3; i++) {
+    budget.AddOverhead(callback, start);
+  }
+  EXPECT_FALSE(budget.IsThrottled(start));
+
+  const auto count = kMillisecond / callback;
+  for (uint64_t i = 0; i < count; i++) {
+    budget.AddOverhead(callback, start);
+  }
+  EXPECT_TRUE(budget.IsThrottled(start));
+}
+
+TEST(OverheadBudgetTest, ThrottlesRewrites) {
+  OverheadBudget budget;
+  budget.Configure(0, 2);
+
+  const auto start = 30 * kOverheadBudgetWindowNs;
+  budget.AddRewrite(start);
+  EXPECT_FALSE(budget.IsThrottled(start));
+  budget.AddRewrite(start);
+  EXPECT_TRUE(budget.IsThrottled(start));
+
+  budget.OnMethodDeferred();
+  EXPECT_FALSE(budget.IsThrottled(start + kOverheadBudgetWindowNs));
+
+  budget.AddRewrite(start + 2 * kOverheadBudgetWindowNs);
+  budget.AddRewrite(start + 2 * kOverheadBudgetWindowNs);
+  EXPECT_TRUE(budget.IsThrottled(start + 2 * kOverheadBudgetWindowNs));
+
+  OverheadBudgetStats stats;
+  budget.Read(&stats);
+  EXPECT_EQ(2u, stats.throttled_windows);
+  EXPECT_EQ(1u, stats.deferred_methods);
+  EXPECT_EQ(0u, stats.last_window_rewrites);
+}
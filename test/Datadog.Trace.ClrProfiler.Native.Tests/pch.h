@@ -10,6 +10,11 @@
 
 #include "gtest/gtest.h"
 
+// before corhlpr.h, which includes windows.h and with it the old winsock.h
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+
 #include <corhlpr.h>
 #include <corprof.h>
 #include <metahost.h>
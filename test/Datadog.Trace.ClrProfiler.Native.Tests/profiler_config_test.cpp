@@ -0,0 +1,180 @@
+#include "pch.h"
+
+#include <map>
+#include <sstream>
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/environment_variables.h"
+#include "../../src/Datadog.Trace.ClrProfiler.Native/profiler_config.h"
+
+using namespace trace;
+
+namespace {
+
+ConfigurationSource FromJson(const std::string& text) {
+  ConfigurationSource source(false);
+  std::stringstream stream(text);
+  EXPECT_TRUE(source.LoadJson(stream));
+  return source;
+}
+
+}  // namespace
+
+TEST(ProfilerConfigTest, UsesDefaults) {
+  const auto config = LoadProfilerConfig(ConfigurationSource(false));
+
+  EXPECT_TRUE(config.tracing_enabled);
+  EXPECT_FALSE(config.debug_enabled);
+  EXPECT_FALSE(config.disable_optimizations);
+  EXPECT_FALSE(config.disable_rewritten_optimizations);
+  EXPECT_TRUE(config.unoptimized_methods.IsEmpty());
+  EXPECT_EQ(0u, config.overhead_budget_ms);
+  EXPECT_EQ(0u, config.rewrite_budget);
+  EXPECT_TRUE(config.low_priority_integrations.empty());
+  EXPECT_EQ(0u, config.module_idle_timeout);
+  EXPECT_FALSE(config.log_path.empty());
+  EXPECT_TRUE(config.integrations_paths.empty());
+  EXPECT_TRUE(config.timed_methods.IsEmpty());
+  EXPECT_EQ(kDefaultAllocationSamplingInterval,
+            config.allocation_sampling_interval);
+  EXPECT_FALSE(config.live_heap_enabled);
+  EXPECT_EQ(kDefaultLiveHeapMaxObjects, config.live_heap_max_objects);
+  EXPECT_EQ(kDefaultRuntimeMetricsInterval, config.runtime_metrics_interval);
+  EXPECT_FALSE(config.thread_pool_watchdog_enabled);
+  EXPECT_EQ(kDefaultThreadPoolWatchdogInterval,
+            config.thread_pool_watchdog_interval);
+  EXPECT_FALSE(config.jit_statistics_enabled);
+  EXPECT_EQ(kDefaultJitTopMethods, config.jit_statistics_top_methods);
+  EXPECT_TRUE(config.startup_methods_file.empty());
+  EXPECT_EQ(kDefaultStartupWindowMs, config.startup_window_ms);
+  EXPECT_FALSE(config.runtime_events_enabled);
+  EXPECT_EQ("localhost", config.agent_endpoint.host);
+  EXPECT_EQ(kDefaultAgentPort, config.agent_endpoint.port);
+  EXPECT_EQ(kDefaultDogStatsdPort, config.dogstatsd_port);
+  EXPECT_EQ(kDefaultDogStatsdFlushInterval, config.dogstatsd_flush_interval);
+}
+
+TEST(ProfilerConfigTest, ParsesJsonSettings) {
+  const auto config = LoadProfilerConfig(FromJson(R"TEXT(
+    {
+      "DD_TRACE_ENABLED": false,
+      "DD_TRACE_DEBUG": "1",
+      "DD_TRACE_LOG_PATH": "  /tmp/profiler.log  ",
+      "DD_INTEGRATIONS": "a.json; ;b.json",
+      "DD_DISABLED_INTEGRATIONS": ["AdoNet", "Wcf"],
+      "DD_CLR_DISABLE_OPTIMIZATIONS": true,
+      "DD_CLR_DISABLE_REWRITTEN_OPTIMIZATIONS": "1",
+      "DD_CLR_DISABLE_OPTIMIZATIONS_METHODS": ["MyApp!*.Parse*", "Lib.Run"],
+      "DD_PROFILER_OVERHEAD_BUDGET_MS": 50,
+      "DD_PROFILER_REWRITE_BUDGET": "200",
+      "DD_PROFILER_LOW_PRIORITY_INTEGRATIONS": "Wcf;ServiceStackRedis",
+      "DD_PROFILER_MODULE_IDLE_TIMEOUT": 60000,
+      "DD_PROFILER_ALLOCATIONS_SAMPLING_INTERVAL": 1024,
+      "DD_PROFILER_LIVE_HEAP_ENABLED": "true",
+      "DD_PROFILER_LIVE_HEAP_MAX_OBJECTS": 1000,
+      "DD_PROFILER_THREADPOOL_WATCHDOG_ENABLED": true,
+      "DD_PROFILER_THREADPOOL_WATCHDOG_INTERVAL": "500",
+      "DD_PROFILER_JIT_STATISTICS_ENABLED": "1",
+      "DD_PROFILER_JIT_STATISTICS_TOP_METHODS": 20,
+      "DD_PROFILER_STARTUP_METHODS_FILE": "/tmp/startup.txt",
+      "DD_PROFILER_STARTUP_WINDOW_MS": 5000,
+      "DD_PROFILER_RUNTIME_EVENTS_ENABLED": "true",
+      "DD_PROFILER_METHOD_TIMING": "MyApp.*.Get*",
+      "DD_AGENT_HOST": "agent",
+      "DD_TRACE_AGENT_PORT": "8200",
+      "DD_DOGSTATSD_PORT": 70000,
+      "DD_TRACE_GLOBAL_TAGS": { "ignored": "object" }
+    }
+  )TEXT"));
+
+  EXPECT_FALSE(config.tracing_enabled);
+  EXPECT_TRUE(config.debug_enabled);
+  EXPECT_EQ("/tmp/profiler.log"_W, config.log_path);
+  EXPECT_EQ(std::vector<WSTRING>({"a.json"_W, "b.json"_W}),
+            config.integrations_paths);
+  EXPECT_EQ(std::vector<WSTRING>({"AdoNet"_W, "Wcf"_W}),
+            config.disabled_integrations);
+  EXPECT_TRUE(config.disable_optimizations);
+  EXPECT_TRUE(config.disable_rewritten_optimizations);
+  EXPECT_EQ(2u, config.unoptimized_methods.Size());
+  EXPECT_TRUE(config.unoptimized_methods.Matches("MyApp!MyApp.Json.ParseAll"_W));
+  EXPECT_FALSE(config.unoptimized_methods.Matches("Other!MyApp.Json.Parse"_W));
+  EXPECT_EQ(50u, config.overhead_budget_ms);
+  EXPECT_EQ(200u, config.rewrite_budget);
+  EXPECT_EQ(std::vector<WSTRING>({"Wcf"_W, "ServiceStackRedis"_W}),
+            config.low_priority_integrations);
+  EXPECT_EQ(60000u, config.module_idle_timeout);
+  EXPECT_EQ(1024u, config.allocation_sampling_interval);
+  EXPECT_TRUE(config.live_heap_enabled);
+  EXPECT_EQ(1000u, config.live_heap_max_objects);
+  EXPECT_TRUE(config.thread_pool_watchdog_enabled);
+  EXPECT_EQ(500u, config.thread_pool_watchdog_interval);
+  EXPECT_TRUE(config.jit_statistics_enabled);
+  EXPECT_EQ(20u, config.jit_statistics_top_methods);
+  EXPECT_EQ("/tmp/startup.txt"_W, config.startup_methods_file);
+  EXPECT_EQ(5000u, config.startup_window_ms);
+  EXPECT_TRUE(config.runtime_events_enabled);
+  EXPECT_TRUE(config.timed_methods.Matches("App!MyApp.Home.GetIndex"_W));
+  EXPECT_EQ("agent", config.agent_endpoint.host);
+  EXPECT_EQ(8200, config.agent_endpoint.port);
+  // out of range
+  EXPECT_EQ(kDefaultDogStatsdPort, config.dogstatsd_port);
+}
+
+TEST(ProfilerConfigTest, IgnoresInvalidValues) {
+  const auto config = LoadProfilerConfig(FromJson(R"TEXT(
+    {
+      "DD_TRACE_ENABLED": "maybe",
+      "DD_PROFILER_RUNTIME_METRICS_INTERVAL": "-5",
+      "DD_DOGSTATSD_PORT": 0
+    }
+  )TEXT"));
+
+  EXPECT_TRUE(config.tracing_enabled);
+  EXPECT_EQ(kDefaultRuntimeMetricsInterval, config.runtime_metrics_interval);
+  EXPECT_EQ(kDefaultDogStatsdPort, config.dogstatsd_port);
+}
+
+TEST(ProfilerConfigTest, RejectsInvalidJson) {
+  ConfigurationSource source(false);
+
+  std::stringstream not_json("DD_TRACE_ENABLED=false");
+  EXPECT_FALSE(source.LoadJson(not_json));
+
+  std::stringstream not_object("[\"DD_TRACE_ENABLED\"]");
+  EXPECT_FALSE(source.LoadJson(not_object));
+
+  EXPECT_TRUE(LoadProfilerConfig(source).tracing_enabled);
+}
+
+TEST(ProfilerConfigTest, EnvironmentTakesPrecedenceOverFile) {
+  const auto name = "DD_PROFILER_CONFIG_TEST_SETTING"_W;
+  ConfigurationSource source;
+  std::stringstream stream(
+      R"({ "DD_PROFILER_CONFIG_TEST_SETTING": "from file" })");
+  ASSERT_TRUE(source.LoadJson(stream));
+
+  EXPECT_EQ("from file"_W, source.GetString(name));
+
+  SetEnvironmentVariableW(name.data(), L"from environment");
+  EXPECT_EQ("from environment"_W, source.GetString(name));
+
+  SetEnvironmentVariableW(name.data(), nullptr);
+  EXPECT_EQ("from file"_W, source.GetString(name));
+}
+
+TEST(ProfilerConfigTest, RecordsResolvedSettings) {
+  const auto config = LoadProfilerConfig(FromJson(R"TEXT(
+    {
+      "DD_TRACE_DEBUG": true,
+      "DD_PROFILER_RUNTIME_METRICS_INTERVAL": 500
+    }
+  )TEXT"));
+
+  std::map<WSTRING, WSTRING> settings(config.settings.begin(),
+                                      config.settings.end());
+  EXPECT_EQ(config.settings.size(), settings.size());
+  EXPECT_EQ(environment::tracing_enabled, config.settings[0].first);
+  EXPECT_EQ("true"_W, settings[environment::debug_enabled]);
+  EXPECT_EQ("500"_W, settings[environment::runtime_metrics_interval]);
+  EXPECT_EQ(""_W, settings[environment::tracing_enabled]);
+}
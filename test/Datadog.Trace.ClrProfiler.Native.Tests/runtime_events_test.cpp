@@ -0,0 +1,153 @@
+#include "pch.h"
+
+#include <cstring>
+#include <vector>
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/runtime_events.h"
+
+using namespace trace;
+
+namespace {
+
+// Payload appends fields the way the runtime writes them.
+class Payload {
+ private:
+  std::vector<BYTE> bytes_;
+
+ public:
+  template <typename T>
+  Payload& Add(T value) {
+    const auto offset = bytes_.size();
+    bytes_.resize(offset + sizeof(T));
+    memcpy(bytes_.data() + offset, &value, sizeof(T));
+    return *this;
+  }
+
+  const BYTE* data() const { return bytes_.data(); }
+  ULONG size() const { return static_cast<ULONG>(bytes_.size()); }
+};
+
+Payload ContentionStop(uint8_t flags, double duration_ns) {
+  return Payload()
+      .Add<uint8_t>(flags)
+      .Add<uint16_t>(0)
+      .Add<double>(duration_ns);
+}
+
+Payload Adjustment(double throughput, uint32_t workers, uint32_t reason) {
+  return Payload()
+      .Add<double>(throughput)
+      .Add<uint32_t>(workers)
+      .Add<uint32_t>(reason)
+      .Add<uint16_t>(0);
+}
+
+}  // namespace
+
+TEST(RuntimeEventsTest, AggregatesContentionByStack) {
+  RuntimeEventListener listener;
+  ASSERT_TRUE(listener.Start(nullptr, 0));
+
+  const UINT_PTR stack_a[] = {10, 20};
+  const UINT_PTR stack_b[] = {30};
+
+  auto stop = ContentionStop(0, 1000);
+  listener.OnEvent(kContentionStopEventId, 1, stop.data(), stop.size(),
+                   stack_a, 2, 0);
+  stop = ContentionStop(0, 3000);
+  listener.OnEvent(kContentionStopEventId, 1, stop.data(), stop.size(),
+                   stack_a, 2, 0);
+  stop = ContentionStop(0, 500);
+  listener.OnEvent(kContentionStopEventId, 1, stop.data(), stop.size(),
+                   stack_b, 1, 0);
+
+  // ContentionStop has no duration: timed from the start on this thread
+  const auto start = Payload().Add<uint8_t>(1).Add<uint16_t>(0);
+  listener.OnEvent(kContentionStartEventId, 0, start.data(), start.size(),
+                   nullptr, 0, 100);
+  const auto stop_v0 = Payload().Add<uint8_t>(1).Add<uint16_t>(0);
+  listener.OnEvent(kContentionStopEventId, 0, stop_v0.data(), stop_v0.size(),
+                   stack_b, 1, 300);
+
+  RuntimeEventStats stats{};
+  ContentionSite sites[4];
+  ASSERT_EQ(3u, listener.Read(&stats, sites, 4, 1000));
+  EXPECT_EQ(1u, stats.session_active);
+  EXPECT_EQ(1000u, stats.elapsed_ns);
+  EXPECT_EQ(5u, stats.events);
+  EXPECT_EQ(4u, stats.contention_count);
+  EXPECT_EQ(4700u, stats.contention_ns);
+  EXPECT_EQ(3u, stats.contention_site_count);
+
+  // longest first
+  EXPECT_EQ(2u, sites[0].count);
+  EXPECT_EQ(4000u, sites[0].total_ns);
+  EXPECT_EQ(3000u, sites[0].max_ns);
+  EXPECT_EQ(2u, sites[0].frame_count);
+  EXPECT_EQ(10u, sites[0].frames[0]);
+  EXPECT_EQ(0u, sites[1].flags);
+  EXPECT_EQ(500u, sites[1].total_ns);
+  EXPECT_EQ(1u, sites[2].flags);
+  EXPECT_EQ(200u, sites[2].total_ns);
+}
+
+TEST(RuntimeEventsTest, CountsThreadPoolInjections) {
+  RuntimeEventListener listener;
+  ASSERT_TRUE(listener.Start(nullptr, 0));
+
+  auto adjustment = Adjustment(10.5, 8, 0);
+  listener.OnEvent(kThreadPoolAdjustmentEventId, 0, adjustment.data(),
+                   adjustment.size(), nullptr, 0, 0);
+  adjustment = Adjustment(4.0, 10, kThreadPoolAdjustmentStarvation);
+  listener.OnEvent(kThreadPoolAdjustmentEventId, 0, adjustment.data(),
+                   adjustment.size(), nullptr, 0, 0);
+  adjustment = Adjustment(6.0, 9, 3);
+  listener.OnEvent(kThreadPoolAdjustmentEventId, 0, adjustment.data(),
+                   adjustment.size(), nullptr, 0, 0);
+  adjustment = Adjustment(8.0, 12, 3);
+  listener.OnEvent(kThreadPoolAdjustmentEventId, 0, adjustment.data(),
+                   adjustment.size(), nullptr, 0, 0);
+
+  // GCStart_V2: Count, Depth, Reason, Type, ClrInstanceID,
+  // ClientSequenceNumber
+  const auto gc = Payload()
+                      .Add<uint32_t>(1)
+                      .Add<uint32_t>(2)
+                      .Add<uint32_t>(1)
+                      .Add<uint32_t>(0)
+                      .Add<uint16_t>(0)
+                      .Add<uint64_t>(0);
+  listener.OnEvent(kGCStartEventId, 2, gc.data(), gc.size(), nullptr, 0, 0);
+
+  RuntimeEventStats stats{};
+  EXPECT_EQ(0u, listener.Read(&stats, nullptr, 0, 0));
+  EXPECT_EQ(4u, stats.thread_pool_adjustments);
+  EXPECT_EQ(12u, stats.thread_pool_workers);
+  EXPECT_EQ(2u, stats.thread_pool_injections);
+  EXPECT_EQ(5u, stats.thread_pool_injected_threads);
+  EXPECT_EQ(1u, stats.thread_pool_starvation_adjustments);
+  EXPECT_DOUBLE_EQ(8.0, stats.thread_pool_throughput);
+  EXPECT_EQ(1u, stats.gc_count);
+  EXPECT_EQ(1u, stats.gc_gen2_count);
+  EXPECT_EQ(1u, stats.gc_induced_count);
+}
+
+TEST(RuntimeEventsTest, IgnoresTruncatedPayloads) {
+  RuntimeEventListener listener;
+  ASSERT_TRUE(listener.Start(nullptr, 0));
+
+  const auto truncated = Payload().Add<double>(1.0).Add<uint16_t>(8);
+  listener.OnEvent(kThreadPoolAdjustmentEventId, 0, truncated.data(),
+                   truncated.size(), nullptr, 0, 0);
+  listener.OnEvent(kContentionStopEventId, 1, nullptr, 0, nullptr, 0, 0);
+
+  listener.Stop();
+
+  RuntimeEventStats stats{};
+  listener.Read(&stats, nullptr, 0, 0);
+  EXPECT_EQ(0u, stats.session_active);
+  EXPECT_EQ(2u, stats.events);
+  EXPECT_EQ(2u, stats.malformed_events);
+  EXPECT_EQ(0u, stats.thread_pool_adjustments);
+  EXPECT_EQ(0u, stats.contention_count);
+}
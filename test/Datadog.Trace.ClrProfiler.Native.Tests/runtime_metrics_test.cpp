@@ -0,0 +1,133 @@
+#include "pch.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/runtime_metrics.h"
+
+using namespace trace;
+
+TEST(RuntimeMetricsTest, PublishesSnapshots) {
+  RuntimeMetrics metrics;
+
+  RuntimeMetricsSnapshot snapshot{};
+  EXPECT_FALSE(metrics.Read(&snapshot));
+
+  metrics.OnThreadCreated();
+  metrics.OnThreadCreated();
+  metrics.OnModuleLoaded();
+  metrics.OnAssemblyLoaded();
+  metrics.AddOverhead(100);
+  metrics.Sample();
+
+  ASSERT_TRUE(metrics.Read(&snapshot));
+  EXPECT_GT(snapshot.timestamp_unix_ns, 0u);
+  EXPECT_EQ(2u, snapshot.thread_count);
+  EXPECT_EQ(1u, snapshot.module_count);
+  EXPECT_EQ(1u, snapshot.assembly_count);
+  EXPECT_EQ(100u, snapshot.profiler_overhead_ns);
+  EXPECT_EQ(0u, snapshot.gc_pause_count);
+
+  // unmatched unloads are clamped
+  metrics.OnModuleUnloaded();
+  metrics.OnModuleUnloaded();
+  metrics.Sample();
+  ASSERT_TRUE(metrics.Read(&snapshot));
+  EXPECT_EQ(0u, snapshot.module_count);
+}
+
+TEST(RuntimeMetricsTest, FoldsNestedJitCompilations) {
+  RuntimeMetrics metrics;
+
+  metrics.OnJitStarted();
+  metrics.OnJitStarted();
+  EXPECT_EQ(0u, metrics.OnJitFinished());
+  metrics.OnJitFinished();
+  // finished without having started
+  EXPECT_EQ(0u, metrics.OnJitFinished());
+  metrics.Sample();
+
+  RuntimeMetricsSnapshot snapshot{};
+  ASSERT_TRUE(metrics.Read(&snapshot));
+  EXPECT_EQ(1u, snapshot.jit_count);
+}
+
+TEST(RuntimeMetricsTest, NeverReadsTornSnapshots) {
+  RuntimeMetrics metrics;
+
+  // every snapshot the writer publishes has all four counters equal
+  const uint64_t sample_count = 200000;
+  std::atomic<bool> done(false);
+  std::thread writer([&]() {
+    for (uint64_t i = 0; i < sample_count; i++) {
+      metrics.OnThreadCreated();
+      metrics.OnModuleLoaded();
+      metrics.OnAssemblyLoaded();
+      metrics.AddOverhead(1);
+      metrics.Sample();
+    }
+    done = true;
+  });
+
+  std::atomic<uint64_t> torn(0);
+  std::vector<std::thread> readers;
+  for (int t = 0; t < 4; t++) {
+    readers.emplace_back([&]() {
+      uint64_t last = 0;
+      RuntimeMetricsSnapshot snapshot{};
+      while (!done) {
+        if (!metrics.Read(&snapshot)) {
+          continue;
+        }
+
+        if (snapshot.module_count != snapshot.thread_count ||
+            snapshot.assembly_count != snapshot.thread_count ||
+            snapshot.profiler_overhead_ns != snapshot.thread_count ||
+            snapshot.thread_count < last) {
+          torn++;
+        }
+        last = snapshot.thread_count;
+      }
+    });
+  }
+
+  writer.join();
+  for (auto& reader : readers) {
+    reader.join();
+  }
+
+  EXPECT_EQ(0u, torn.load());
+
+  RuntimeMetricsSnapshot snapshot{};
+  ASSERT_TRUE(metrics.Read(&snapshot));
+  EXPECT_EQ(sample_count, snapshot.thread_count);
+}
+
+TEST(RuntimeMetricsTest, CountsGen2Collections) {
+  GcTimeline timeline;
+  timeline.Initialize(nullptr);
+
+  // a gen 2 GC, with the large object heap the runtime collects along
+  BOOL collected[kGcGenerationCount] = {TRUE, TRUE, TRUE, TRUE};
+  timeline.OnRuntimeSuspendStarted(COR_PRF_SUSPEND_FOR_GC);
+  timeline.OnRuntimeSuspendFinished();
+  timeline.OnGarbageCollectionStarted(kGcGenerationCount, collected,
+                                      COR_PRF_GC_INDUCED);
+  timeline.OnGarbageCollectionFinished();
+  timeline.OnRuntimeResumeStarted();
+
+  RuntimeMetrics metrics;
+  metrics.Initialize(&timeline, 3600 * 1000);
+  // sampled by the test only
+  metrics.Stop();
+  metrics.Sample();
+
+  RuntimeMetricsSnapshot snapshot{};
+  ASSERT_TRUE(metrics.Read(&snapshot));
+  EXPECT_EQ(0u, snapshot.gc_counts[0]);
+  EXPECT_EQ(0u, snapshot.gc_counts[1]);
+  EXPECT_EQ(1u, snapshot.gc_counts[2]);
+  EXPECT_EQ(1u, snapshot.gc_counts[kGcLargeObjectHeap]);
+  EXPECT_EQ(1u, snapshot.gc_pause_count);
+}
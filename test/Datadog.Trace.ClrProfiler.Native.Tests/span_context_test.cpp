@@ -0,0 +1,116 @@
+#include "pch.h"
+
+#include <thread>
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/span_context.h"
+
+using namespace trace;
+
+TEST(SpanContextTest, TagsTheCallingThread) {
+  SpanContextTable table;
+  table.Initialize(4);
+
+  auto slot = table.Acquire(1);
+  ASSERT_NE(nullptr, slot);
+  EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(slot) % kCacheLineSize);
+  EXPECT_EQ(slot, CurrentSpanContextSlot());
+
+  slot->Set(10, 20);
+  slot->AddJit(500);
+  slot->AddJit(300);
+  slot->AddModuleLoad();
+
+  SpanNativeCost cost{};
+  slot->ReadCost(&cost);
+  EXPECT_EQ(10u, cost.trace_id);
+  EXPECT_EQ(20u, cost.span_id);
+  EXPECT_EQ(2u, cost.jit_count);
+  EXPECT_EQ(800u, cost.jit_time_ns);
+  EXPECT_EQ(1u, cost.module_loads);
+
+  // a new span starts from zero
+  slot->Set(10, 21);
+  slot->ReadCost(&cost);
+  EXPECT_EQ(21u, cost.span_id);
+  EXPECT_EQ(0u, cost.jit_count);
+
+  table.Release(1);
+  EXPECT_EQ(nullptr, CurrentSpanContextSlot());
+}
+
+TEST(SpanContextTest, FindsOtherThreads) {
+  SpanContextTable table;
+  table.Initialize(4);
+
+  std::thread worker([&table] {
+    auto slot = table.Acquire(7);
+    ASSERT_NE(nullptr, slot);
+    slot->Set(100, 200);
+  });
+  worker.join();
+
+  // the calling thread has no slot of its own
+  EXPECT_EQ(nullptr, CurrentSpanContextSlot());
+
+  SpanContext context;
+  ASSERT_TRUE(table.Find(7, &context));
+  EXPECT_EQ(100u, context.trace_id);
+  EXPECT_EQ(200u, context.span_id);
+  EXPECT_FALSE(table.Find(8, &context));
+  EXPECT_EQ(1u, table.SlotCount());
+
+  table.Release(7);
+  EXPECT_FALSE(table.Find(7, &context));
+  EXPECT_EQ(0u, table.SlotCount());
+}
+
+TEST(SpanContextTest, ReusesReleasedSlots) {
+  SpanContextTable table;
+  table.Initialize(2);
+
+  EXPECT_NE(nullptr, table.Acquire(1));
+  EXPECT_NE(nullptr, table.Acquire(2));
+  EXPECT_EQ(nullptr, table.Acquire(3));
+
+  table.Release(1);
+  auto slot = table.Acquire(3);
+  ASSERT_NE(nullptr, slot);
+
+  // released slots don't leak the span of their previous owner
+  SpanContext context;
+  ASSERT_TRUE(table.Find(3, &context));
+  EXPECT_EQ(0u, context.span_id);
+}
+
+TEST(SpanContextTest, ReleasesOnlyTheOwnedSlot) {
+  SpanContextTable table;
+  table.Initialize(1);
+
+  auto slot = table.Acquire(1);
+  ASSERT_NE(nullptr, slot);
+  slot->Set(10, 20);
+
+  // not the owner
+  table.Release(2);
+  SpanContext context;
+  ASSERT_TRUE(table.Find(1, &context));
+  EXPECT_EQ(20u, context.span_id);
+
+  // the table is full until the owner is released, from any thread
+  std::thread worker([&table] {
+    EXPECT_EQ(nullptr, table.Acquire(3));
+    EXPECT_EQ(nullptr, table.Acquire(3));
+    table.Release(1);
+
+    auto slot = table.Acquire(3);
+    ASSERT_NE(nullptr, slot);
+    SpanContext context;
+    ASSERT_TRUE(table.Find(3, &context));
+    EXPECT_EQ(0u, context.trace_id);
+    EXPECT_EQ(0u, context.span_id);
+  });
+  worker.join();
+
+  EXPECT_FALSE(table.Find(1, &context));
+  EXPECT_EQ(nullptr, CurrentSpanContextSlot());
+}
@@ -0,0 +1,174 @@
+#include "pch.h"
+
+#include <thread>
+#include <vector>
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/sql_obfuscator.h"
+#include "../../src/Datadog.Trace.ClrProfiler.Native/util.h"
+
+using namespace trace;
+
+namespace {
+
+WSTRING Obfuscate(const WSTRING& sql) {
+  WSTRING output(sql.length(), 0);
+  output.resize(ObfuscateSql(sql.data(), sql.length(), &output[0]));
+  return output;
+}
+
+struct SqlCase {
+  WSTRING sql;
+  WSTRING expected;
+};
+
+}  // namespace
+
+TEST(SqlObfuscatorTest, ReplacesLiterals) {
+  const std::vector<SqlCase> cases = {
+      {"SELECT * FROM users WHERE id = 42"_W,
+       "SELECT * FROM users WHERE id = ?"_W},
+      {"SELECT * FROM users WHERE name = 'O''Brien' AND age > 3.5e2"_W,
+       "SELECT * FROM users WHERE name = ? AND age > ?"_W},
+      {"UPDATE t SET flag = TRUE, v = null, w = False WHERE x = -0.5"_W,
+       "UPDATE t SET flag = ?, v = ?, w = ? WHERE x = -?"_W},
+      {"INSERT INTO t (a, b) VALUES (N'héllo', 0x1F)"_W,
+       "INSERT INTO t (a, b) VALUES (?, ?)"_W},
+      {"SELECT .5, 1., x1 FROM t2"_W, "SELECT ?, ?, x1 FROM t2"_W},
+      {"SELECT 'unterminated"_W, "SELECT ?"_W},
+  };
+
+  for (const auto& test : cases) {
+    EXPECT_EQ(test.expected, Obfuscate(test.sql)) << ToString(test.sql);
+  }
+}
+
+TEST(SqlObfuscatorTest, ReplacesBindVariables) {
+  const std::vector<SqlCase> cases = {
+      {"SELECT * FROM t WHERE a = @p0 AND b = @name"_W,
+       "SELECT * FROM t WHERE a = ? AND b = ?"_W},
+      {"SELECT @@ROWCOUNT"_W, "SELECT @@ROWCOUNT"_W},
+      {"SELECT * FROM t WHERE a = $1 AND b = :name AND c = ?"_W,
+       "SELECT * FROM t WHERE a = ? AND b = ? AND c = ?"_W},
+      {"SELECT a::int, b::text FROM t"_W, "SELECT a::int, b::text FROM t"_W},
+      {"SELECT $$it's$$, $fn$body $x$ more$fn$"_W, "SELECT ?, ?"_W},
+  };
+
+  for (const auto& test : cases) {
+    EXPECT_EQ(test.expected, Obfuscate(test.sql)) << ToString(test.sql);
+  }
+}
+
+TEST(SqlObfuscatorTest, KeepsIdentifiers) {
+  const std::vector<SqlCase> cases = {
+      {"SELECT [Order Id], \"user\"\"s\", `key` FROM [dbo].[Orders]"_W,
+       "SELECT [Order Id], \"user\"\"s\", `key` FROM [dbo].[Orders]"_W},
+      {"SELECT * FROM #temp JOIN t$1 ON a1 = b2"_W,
+       "SELECT * FROM #temp JOIN t$1 ON a1 = b2"_W},
+      {"SELECT arr[1] FROM t"_W, "SELECT arr[?] FROM t"_W},
+  };
+
+  for (const auto& test : cases) {
+    EXPECT_EQ(test.expected, Obfuscate(test.sql)) << ToString(test.sql);
+  }
+}
+
+TEST(SqlObfuscatorTest, CollapsesInLists) {
+  const std::vector<SqlCase> cases = {
+      {"SELECT * FROM t WHERE id IN (1, 2, 3)"_W,
+       "SELECT * FROM t WHERE id IN (?)"_W},
+      {"SELECT * FROM t WHERE id in('a','b') AND x NOT IN ( @p1 , @p2 )"_W,
+       "SELECT * FROM t WHERE id in(?) AND x NOT IN (?)"_W},
+      {"SELECT * FROM t WHERE id IN (SELECT id FROM u WHERE v = 1)"_W,
+       "SELECT * FROM t WHERE id IN (SELECT id FROM u WHERE v = ?)"_W},
+      {"SELECT * FROM t WHERE id IN (1, a)"_W,
+       "SELECT * FROM t WHERE id IN (?, a)"_W},
+      {"SELECT * FROM t WHERE (a, b) IN ((1, 2), (3, 4))"_W,
+       "SELECT * FROM t WHERE (a, b) IN ((?, ?), (?, ?))"_W},
+      {"SELECT MIN(a), b FROM t"_W, "SELECT MIN(a), b FROM t"_W},
+  };
+
+  for (const auto& test : cases) {
+    EXPECT_EQ(test.expected, Obfuscate(test.sql)) << ToString(test.sql);
+  }
+}
+
+TEST(SqlObfuscatorTest, NormalizesWhitespaceAndComments) {
+  const std::vector<SqlCase> cases = {
+      {"  SELECT\r\n\t a ,b\n  FROM   t  \n"_W, "SELECT a ,b FROM t"_W},
+      {"SELECT a -- trailing comment 123\nFROM t /* id = 5 */ WHERE x = 1"_W,
+       "SELECT a FROM t WHERE x = ?"_W},
+      {"SELECT a/*unterminated"_W, "SELECT a"_W},
+      {""_W, ""_W},
+      {" \t\n"_W, ""_W},
+  };
+
+  for (const auto& test : cases) {
+    EXPECT_EQ(test.expected, Obfuscate(test.sql)) << ToString(test.sql);
+  }
+}
+
+TEST(SqlObfuscatorTest, FindsQuotesAcrossVectorBlocks) {
+  // quotes at every offset within and across 8 code unit blocks
+  for (size_t padding = 0; padding < 20; padding++) {
+    const WSTRING sql = "SELECT '"_W + WSTRING(padding, 'x') + "''y' FROM t"_W;
+    EXPECT_EQ("SELECT ? FROM t"_W, Obfuscate(sql)) << padding;
+  }
+}
+
+TEST(SqlObfuscatorTest, CachesObfuscatedStatements) {
+  SqlObfuscationCache cache;
+  const auto sql = "SELECT * FROM t WHERE id IN (1, 2) AND name = 'x'"_W;
+  const auto expected = Obfuscate(sql);
+
+  for (int i = 0; i < 3; i++) {
+    WSTRING output(sql.length(), 0);
+    output.resize(cache.Obfuscate(sql.data(), sql.length(), &output[0]));
+    EXPECT_EQ(expected, output);
+  }
+
+  EXPECT_EQ(1u, cache.Misses());
+  EXPECT_EQ(2u, cache.Hits());
+
+  // same length, different text
+  const auto other = "SELECT * FROM u WHERE id IN (1, 2) AND name = 'x'"_W;
+  WSTRING output(other.length(), 0);
+  output.resize(cache.Obfuscate(other.data(), other.length(), &output[0]));
+  EXPECT_EQ(Obfuscate(other), output);
+  EXPECT_EQ(2u, cache.Misses());
+}
+
+TEST(SqlObfuscatorTest, CacheIsThreadSafe) {
+  SqlObfuscationCache cache;
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&cache, t] {
+      for (int i = 0; i < 2000; i++) {
+        const auto id = (i * 7 + t) % 50;
+        const WSTRING sql = "SELECT * FROM table"_W +
+                            ToWSTRING(std::to_string(id)) + " WHERE a = "_W +
+                            ToWSTRING(std::to_string(i));
+        WSTRING output(sql.length(), 0);
+        output.resize(cache.Obfuscate(sql.data(), sql.length(), &output[0]));
+        ASSERT_EQ("SELECT * FROM table"_W + ToWSTRING(std::to_string(id)) +
+                      " WHERE a = ?"_W,
+                  output);
+      }
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(8000u, cache.Hits() + cache.Misses());
+}
+
+TEST(SqlObfuscatorTest, HashDependsOnEveryCodeUnit) {
+  const auto a = "SELECT 1"_W;
+  const auto b = "SELECT 2"_W;
+  const auto c = "SELECT 1 "_W;
+  EXPECT_EQ(HashUtf16(a.data(), a.length()), HashUtf16(a.data(), a.length()));
+  EXPECT_NE(HashUtf16(a.data(), a.length()), HashUtf16(b.data(), b.length()));
+  EXPECT_NE(HashUtf16(a.data(), a.length()), HashUtf16(c.data(), c.length()));
+}
@@ -0,0 +1,175 @@
+#include "pch.h"
+
+#include <sstream>
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/startup_recorder.h"
+#include "../../src/Datadog.Trace.ClrProfiler.Native/symbol_cache.h"
+
+using namespace trace;
+
+namespace {
+
+const uint64_t kMs = 1000000;
+
+}  // namespace
+
+TEST(StartupRecorderTest, RecordsFirstCompilationsInTheWindow) {
+  StartupRecorder recorder;
+  recorder.Initialize(nullptr, "unused.txt"_W, 100, 1000 * kMs);
+
+  recorder.OnJitStarted(1, 9, 1000 * kMs);
+  recorder.OnJitStarted(2, 9, 1010 * kMs);
+  // compiled again, e.g. by a ReJIT
+  recorder.OnJitStarted(1, 9, 1020 * kMs);
+  EXPECT_EQ(2u, recorder.MethodCount());
+  EXPECT_TRUE(recorder.IsRecording());
+
+  // after the window
+  recorder.OnJitStarted(3, 9, 1100 * kMs);
+  recorder.OnJitStarted(4, 9, 1200 * kMs);
+  EXPECT_EQ(2u, recorder.MethodCount());
+  EXPECT_FALSE(recorder.IsRecording());
+}
+
+TEST(StartupRecorderTest, WritesModulesInLoadOrder) {
+  StartupRecorder recorder;
+  recorder.Initialize(nullptr, "unused.txt"_W, 100, 0);
+
+  recorder.OnModuleLoaded(1, "System.Private.CoreLib"_W,
+                          "/dotnet/corelib.dll"_W, 0);
+  recorder.OnModuleLoaded(2, "App"_W, "/app/App.dll"_W, 50 * kMs);
+  recorder.OnModuleLoaded(3, "Late"_W, "/app/Late.dll"_W, 150 * kMs);
+
+  std::ostringstream out;
+  recorder.WriteTo(out);
+
+  EXPECT_EQ(
+      "# methods JIT-compiled in the first 100 ms, in order\n"
+      "[modules]\n"
+      "System.Private.CoreLib\t/dotnet/corelib.dll\n"
+      "App\t/app/App.dll\n"
+      "[methods]\n",
+      out.str());
+}
+
+TEST(StartupRecorderTest, StopsRecordingOnceWritten) {
+  StartupRecorder recorder;
+  recorder.Initialize(nullptr, "unused.txt"_W, 100, 0);
+  recorder.OnJitStarted(1, 9, 0);
+
+  std::ostringstream out;
+  recorder.WriteTo(out);
+  EXPECT_EQ(0u, recorder.MethodCount());
+  EXPECT_FALSE(recorder.IsRecording());
+
+  recorder.OnJitStarted(2, 9, 10 * kMs);
+  recorder.OnModuleLoaded(9, "App"_W, "/app/App.dll"_W, 10 * kMs);
+  EXPECT_EQ(0u, recorder.MethodCount());
+}
+
+TEST(StartupRecorderTest, NamesMethodsWithTheirTypeArguments) {
+  SymbolCache symbols;
+  symbols.Initialize(nullptr, 16);
+  symbols.AddClass(0x100, 1, "System.Int32"_W);
+  symbols.AddClass(0x200, 1, "System.String"_W);
+  symbols.Add(0x1000, 2, 0x06000001, "App!App.Program.Main"_W);
+  // Cache<int>.Get<string>
+  symbols.Add(0x2000, 2, 0x06000002, "App!App.Cache`1.Get"_W,
+              {0x100, 0x200});
+  // an argument that cannot be named
+  symbols.Add(0x3000, 2, 0x06000003, "App!App.Box`1.Open"_W, {0x300});
+
+  StartupRecorder recorder;
+  recorder.Initialize(&symbols, "unused.txt"_W, 100, 0);
+  recorder.OnModuleLoaded(2, "App"_W, "/app/App.dll"_W, 0);
+  recorder.OnJitStarted(0x1000, 2, 0);
+  recorder.OnJitStarted(0x2000, 2, 10 * kMs);
+  recorder.OnJitStarted(0x3000, 2, 20 * kMs);
+  // not resolved: left out
+  recorder.OnJitStarted(0x4000, 2, 30 * kMs);
+
+  std::ostringstream out;
+  EXPECT_EQ(3u, recorder.WriteTo(out));
+  EXPECT_EQ(
+      "# methods JIT-compiled in the first 100 ms, in order\n"
+      "[modules]\n"
+      "App\t/app/App.dll\n"
+      "[methods]\n"
+      "0\t0\t06000001\tApp!App.Program.Main\n"
+      "10\t0\t06000002\tApp!App.Cache`1.Get[System.Int32,System.String]\n"
+      "20\t0\t06000003\tApp!App.Box`1.Open[?]\n",
+      out.str());
+}
+
+TEST(StartupRecorderTest, TellsOverloadsAndModulesApart) {
+  SymbolCache symbols;
+  symbols.Initialize(nullptr, 16);
+  // Parse(string) and Parse(string, int), and a module loaded twice
+  symbols.Add(0x1000, 1, 0x06000010, "App!App.Parser.Parse"_W);
+  symbols.Add(0x2000, 1, 0x06000011, "App!App.Parser.Parse"_W);
+  symbols.Add(0x3000, 2, 0x06000010, "App!App.Parser.Parse"_W);
+
+  StartupRecorder recorder;
+  recorder.Initialize(&symbols, "unused.txt"_W, 100, 0);
+  recorder.OnModuleLoaded(1, "App"_W, "/app/App.dll"_W, 0);
+  recorder.OnModuleLoaded(2, "App"_W, "/plugins/App.dll"_W, 0);
+  recorder.OnJitStarted(0x1000, 1, 0);
+  recorder.OnJitStarted(0x2000, 1, 0);
+  recorder.OnJitStarted(0x3000, 2, 0);
+
+  std::ostringstream out;
+  EXPECT_EQ(3u, recorder.WriteTo(out));
+  EXPECT_NE(std::string::npos,
+            out.str().find("[methods]\n"
+                           "0\t0\t06000010\tApp!App.Parser.Parse\n"
+                           "0\t0\t06000011\tApp!App.Parser.Parse\n"
+                           "0\t1\t06000010\tApp!App.Parser.Parse\n"));
+}
+
+TEST(StartupRecorderTest, ForgetsMethodsOfUnloadedModules) {
+  SymbolCache symbols;
+  symbols.Initialize(nullptr, 16);
+  symbols.Add(0x1000, 1, 0x06000001, "App!App.Program.Main"_W);
+  symbols.Add(0x2000, 2, 0x06000001, "Plugin!Plugin.Entry.Run"_W);
+
+  StartupRecorder recorder;
+  recorder.Initialize(&symbols, "unused.txt"_W, 100, 0);
+  recorder.OnModuleLoaded(1, "App"_W, "/app/App.dll"_W, 0);
+  recorder.OnModuleLoaded(2, "Plugin"_W, "/app/Plugin.dll"_W, 0);
+  recorder.OnJitStarted(0x1000, 1, 0);
+  recorder.OnJitStarted(0x2000, 2, 10 * kMs);
+
+  recorder.EvictModule(2);
+  symbols.EvictModule(2);
+  EXPECT_EQ(1u, recorder.MethodCount());
+
+  // the FunctionID is reused by a method of another module
+  symbols.Add(0x2000, 3, 0x06000002, "Other!Other.Type.Method"_W);
+  recorder.OnModuleLoaded(3, "Other"_W, "/app/Other.dll"_W, 20 * kMs);
+  recorder.OnJitStarted(0x2000, 3, 20 * kMs);
+
+  std::ostringstream out;
+  EXPECT_EQ(2u, recorder.WriteTo(out));
+  EXPECT_EQ(
+      "# methods JIT-compiled in the first 100 ms, in order\n"
+      "[modules]\n"
+      "App\t/app/App.dll\n"
+      "Plugin\t/app/Plugin.dll\n"
+      "Other\t/app/Other.dll\n"
+      "[methods]\n"
+      "0\t0\t06000001\tApp!App.Program.Main\n"
+      "20\t2\t06000002\tOther!Other.Type.Method\n",
+      out.str());
+}
+
+TEST(StartupRecorderTest, WritesAgainAfterTheFileCouldNotBeOpened) {
+  StartupRecorder recorder;
+  recorder.Initialize(nullptr, "/nonexistent-directory/startup.txt"_W, 100,
+                      0);
+  recorder.OnJitStarted(1, 9, 0);
+
+  EXPECT_FALSE(recorder.Write());
+  // still recorded, for the next attempt
+  EXPECT_FALSE(recorder.Write());
+  EXPECT_EQ(1u, recorder.MethodCount());
+}
@@ -0,0 +1,130 @@
+#include "pch.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/symbol_cache.h"
+
+using namespace trace;
+
+TEST(SymbolCacheTest, FindsPublishedSymbols) {
+  SymbolCache cache;
+  cache.Initialize(nullptr, 16);
+
+  const auto symbol =
+      cache.Add(0x1000, 7, 0x06000001, "App!App.Program.Main"_W);
+  ASSERT_NE(nullptr, symbol);
+  EXPECT_EQ(symbol, cache.Find(0x1000));
+  EXPECT_EQ(symbol, cache.GetOrResolve(0x1000));
+  EXPECT_EQ("App!App.Program.Main"_W, *cache.Find(0x1000)->name);
+  EXPECT_EQ(7u, symbol->module_id);
+
+  EXPECT_EQ(nullptr, cache.Find(0x2000));
+  EXPECT_EQ(nullptr, cache.GetOrResolve(0x2000));
+}
+
+TEST(SymbolCacheTest, EvictedSymbolsStayReadable) {
+  SymbolCache cache;
+  cache.Initialize(nullptr, 16);
+
+  const auto symbol =
+      cache.Add(0x1000, 7, 0x06000001, "App!App.Program.Main"_W);
+  cache.Add(0x2000, 8, 0x06000001, "Lib!Lib.Util.Run"_W);
+  cache.EvictModule(7);
+
+  EXPECT_EQ(nullptr, cache.Find(0x1000));
+  EXPECT_EQ(nullptr, cache.GetOrResolve(0x1000));
+  ASSERT_NE(nullptr, cache.Find(0x2000));
+
+  // a reader that still holds the symbol can use it
+  EXPECT_EQ("App!App.Program.Main"_W, *symbol->name);
+}
+
+TEST(SymbolCacheTest, ReusesEvictedSlots) {
+  SymbolCache cache;
+  // 6 symbols fit under the load limit
+  cache.Initialize(nullptr, 8);
+
+  for (ModuleID module_id = 1; module_id <= 100; module_id++) {
+    for (FunctionID i = 1; i <= 4; i++) {
+      const FunctionID function_id = (module_id * 16 + i) * 8;
+      cache.Add(function_id, module_id, 0x06000000 + i, "App!App.Type.M"_W);
+      // still in the lock-free table, not in the fallback map
+      ASSERT_NE(nullptr, cache.Find(function_id))
+          << "module " << module_id << " method " << i;
+    }
+
+    cache.EvictModule(module_id);
+  }
+}
+
+TEST(SymbolCacheTest, ResolvesInstructionPointers) {
+  SymbolCache cache;
+  cache.Initialize(nullptr, 1024);
+
+  // enough ranges to rebuild the index several times
+  for (FunctionID i = 1; i <= 200; i++) {
+    cache.Add(i * 8, 1 + i % 2, 0x06000000 + static_cast<mdToken>(i),
+              "App!App.Type.M"_W);
+    cache.AddCodeRange(0x10000 + i * 0x100, 0x80, i * 8, 1 + i % 2);
+  }
+
+  for (FunctionID i = 1; i <= 200; i++) {
+    const auto symbol = cache.GetOrResolveFromIP(0x10000 + i * 0x100 + 0x10);
+    ASSERT_NE(nullptr, symbol);
+    EXPECT_EQ(i * 8, symbol->function_id);
+
+    // in the gap after the method
+    EXPECT_EQ(nullptr, cache.GetOrResolveFromIP(0x10000 + i * 0x100 + 0x90));
+  }
+  EXPECT_EQ(nullptr, cache.GetOrResolveFromIP(0x100));
+
+  cache.EvictModule(1);
+  for (FunctionID i = 1; i <= 200; i++) {
+    const auto symbol = cache.GetOrResolveFromIP(0x10000 + i * 0x100);
+    if (i % 2 == 0) {
+      EXPECT_EQ(nullptr, symbol);
+    } else {
+      ASSERT_NE(nullptr, symbol);
+      EXPECT_EQ(i * 8, symbol->function_id);
+    }
+  }
+}
+
+TEST(SymbolCacheTest, ResolvesWhileIndexing) {
+  SymbolCache cache;
+  cache.Initialize(nullptr, 4096);
+
+  const FunctionID count = 2000;
+  for (FunctionID i = 1; i <= count; i++) {
+    cache.Add(i * 8, 1, 0x06000000 + static_cast<mdToken>(i), "App!App.T.M"_W);
+  }
+
+  std::atomic<FunctionID> indexed(0);
+  std::atomic<bool> failed(false);
+  std::vector<std::thread> readers;
+  for (int t = 0; t < 4; t++) {
+    readers.emplace_back([&]() {
+      while (indexed.load() < count) {
+        const auto last = indexed.load();
+        for (FunctionID i = 1; i <= last; i++) {
+          const auto symbol = cache.GetOrResolveFromIP(0x100000 + i * 0x40);
+          if (symbol == nullptr || symbol->function_id != i * 8) {
+            failed = true;
+          }
+        }
+      }
+    });
+  }
+
+  for (FunctionID i = 1; i <= count; i++) {
+    cache.AddCodeRange(0x100000 + i * 0x40, 0x20, i * 8, 1);
+    indexed = i;
+  }
+
+  for (auto& reader : readers) {
+    reader.join();
+  }
+  EXPECT_FALSE(failed);
+}
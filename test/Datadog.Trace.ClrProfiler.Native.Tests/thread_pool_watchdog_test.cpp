@@ -0,0 +1,124 @@
+#include "pch.h"
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/thread_pool_watchdog.h"
+
+using namespace trace;
+
+namespace {
+
+// StartWorker reports a thread-pool worker the way the runtime does: created,
+// then named when it starts.
+void StartWorker(ThreadPoolWatchdog& watchdog, ThreadID thread_id) {
+  watchdog.OnThreadCreated(thread_id);
+  watchdog.OnThreadNameChanged(thread_id, ".NET TP Worker"_W);
+}
+
+}  // namespace
+
+TEST(ThreadPoolWatchdogTest, TracksThreads) {
+  ThreadPoolWatchdog watchdog;
+  EXPECT_FALSE(watchdog.IsEnabled());
+
+  watchdog.OnThreadCreated(1);
+  watchdog.OnThreadCreated(2);
+  watchdog.OnThreadAssignedToOSThread(1, 100);
+  watchdog.OnThreadDestroyed(1);
+  // created before the profiler attached
+  watchdog.OnThreadDestroyed(3);
+  watchdog.OnThreadAssignedToOSThread(3, 300);
+
+  ThreadPoolWatchdogStats stats{};
+  watchdog.GetStats(&stats);
+  EXPECT_EQ(1u, stats.thread_count);
+  EXPECT_EQ(2u, stats.threads_created);
+  EXPECT_EQ(1u, stats.threads_destroyed);
+  EXPECT_EQ(0u, stats.detections);
+}
+
+TEST(ThreadPoolWatchdogTest, DetectsSustainedThreadInjection) {
+  ThreadPoolWatchdog watchdog;
+  ThreadID next_thread = 1;
+
+  for (uint32_t i = 1; i < kStarvationGrowthIntervals; i++) {
+    StartWorker(watchdog, next_thread++);
+    EXPECT_EQ(0u, watchdog.Evaluate());
+  }
+
+  StartWorker(watchdog, next_thread++);
+  EXPECT_EQ(kStarvationThreadInjection, watchdog.Evaluate());
+
+  // reported again only after as many intervals
+  StartWorker(watchdog, next_thread++);
+  EXPECT_EQ(0u, watchdog.Evaluate());
+
+  // workers retired as fast as they are added end the streak
+  StartWorker(watchdog, next_thread++);
+  watchdog.OnThreadDestroyed(1);
+  EXPECT_EQ(0u, watchdog.Evaluate());
+
+  for (uint32_t i = 1; i < kStarvationGrowthIntervals; i++) {
+    StartWorker(watchdog, next_thread++);
+    EXPECT_EQ(0u, watchdog.Evaluate());
+  }
+}
+
+TEST(ThreadPoolWatchdogTest, IgnoresGrowthOfOtherThreads) {
+  ThreadPoolWatchdog watchdog;
+  ThreadID next_thread = 1;
+
+  // startup and dedicated threads, named or not, and the older worker name
+  // given to a thread that is not tracked
+  for (uint32_t i = 0; i < 2 * kStarvationGrowthIntervals; i++) {
+    watchdog.OnThreadCreated(next_thread++);
+    watchdog.OnThreadCreated(next_thread);
+    watchdog.OnThreadNameChanged(next_thread++, "Worker"_W);
+    watchdog.OnThreadNameChanged(1000 + i, ".NET ThreadPool Worker"_W);
+    watchdog.Detect();
+  }
+
+  uint64_t cursor = 0;
+  StarvationEvent events[1];
+  EXPECT_EQ(0u, watchdog.Read(&cursor, events, 1));
+
+  ThreadPoolWatchdogStats stats{};
+  watchdog.GetStats(&stats);
+  EXPECT_EQ(0u, stats.detections);
+  EXPECT_EQ(4 * kStarvationGrowthIntervals, stats.thread_count);
+
+  // a thread named again and again is counted once
+  for (uint32_t i = 0; i < kStarvationGrowthIntervals; i++) {
+    watchdog.OnThreadNameChanged(1, ".NET ThreadPool Worker"_W);
+    EXPECT_EQ(0u, watchdog.Evaluate());
+  }
+}
+
+TEST(ThreadPoolWatchdogTest, ReadsEventsFromCursor) {
+  ThreadPoolWatchdog watchdog;
+  ThreadID next_thread = 1;
+
+  for (uint32_t i = 0; i < 2 * kStarvationGrowthIntervals; i++) {
+    StartWorker(watchdog, next_thread++);
+    StartWorker(watchdog, next_thread++);
+    watchdog.Detect();
+  }
+
+  // no stack sampling without the runtime
+  uint64_t cursor = 0;
+  StarvationEvent events[4];
+  ASSERT_EQ(1u, watchdog.Read(&cursor, events, 1));
+  EXPECT_EQ(1u, events[0].sequence);
+  EXPECT_EQ(kStarvationThreadInjection, events[0].reason);
+  EXPECT_EQ(2 * kStarvationGrowthIntervals, events[0].thread_count);
+  EXPECT_EQ(2 * kStarvationGrowthIntervals, events[0].injected_thread_count);
+  EXPECT_EQ(0u, events[0].sampled_thread_count);
+  EXPECT_EQ(0u, events[0].blocking_function_ids[0]);
+
+  ASSERT_EQ(1u, watchdog.Read(&cursor, events, 4));
+  EXPECT_EQ(2u, events[0].sequence);
+  EXPECT_EQ(0u, watchdog.Read(&cursor, events, 4));
+  EXPECT_EQ(2u, cursor);
+
+  ThreadPoolWatchdogStats stats{};
+  watchdog.GetStats(&stats);
+  EXPECT_EQ(2u, stats.detections);
+}
@@ -0,0 +1,197 @@
+#include "pch.h"
+
+#include <vector>
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/msgpack_writer.h"
+#include "../../src/Datadog.Trace.ClrProfiler.Native/trace_serializer.h"
+#include "../../src/Datadog.Trace.ClrProfiler.Native/utf8.h"
+
+using namespace trace;
+
+namespace {
+
+std::vector<uint8_t> Encode(const WSTRING& str) {
+  std::vector<uint8_t> buffer(Utf8MaxLength(str.length()));
+  buffer.resize(Utf16ToUtf8(str.data(), str.length(), buffer.data()));
+  return buffer;
+}
+
+std::vector<uint8_t> Bytes(const MessagePackWriter& writer) {
+  return std::vector<uint8_t>(writer.Data(), writer.Data() + writer.Size());
+}
+
+NativeString ToNative(const WSTRING& str) {
+  return NativeString{str.data(), static_cast<int32_t>(str.length()), 0};
+}
+
+}  // namespace
+
+TEST(Utf8Test, EncodesAscii) {
+  // long enough to go through the vectorized path and the tail
+  const auto str = "GET /api/v1/users/{id}/orders?page=1"_W;
+  const auto utf8 = Encode(str);
+  EXPECT_EQ(std::string(utf8.begin(), utf8.end()),
+            "GET /api/v1/users/{id}/orders?page=1");
+}
+
+TEST(Utf8Test, EncodesMultiByteCharacters) {
+  // "aé€" followed by U+1F600 as a surrogate pair
+  const WSTRING str = {'a'_W, static_cast<WCHAR>(0xE9), static_cast<WCHAR>(0x20AC),
+                       static_cast<WCHAR>(0xD83D), static_cast<WCHAR>(0xDE00)};
+  const std::vector<uint8_t> expected = {0x61, 0xC3, 0xA9, 0xE2, 0x82,
+                                         0xAC, 0xF0, 0x9F, 0x98, 0x80};
+  EXPECT_EQ(Encode(str), expected);
+}
+
+TEST(Utf8Test, ReplacesUnpairedSurrogates) {
+  const WSTRING str = {static_cast<WCHAR>(0xD83D), 'a'_W,
+                       static_cast<WCHAR>(0xDE00)};
+  const std::vector<uint8_t> expected = {0xEF, 0xBF, 0xBD, 0x61,
+                                         0xEF, 0xBF, 0xBD};
+  EXPECT_EQ(Encode(str), expected);
+}
+
+TEST(Utf8Test, EncodesNonAsciiAfterAsciiBlock) {
+  WSTRING str = "0123456789abcdef"_W;
+  str.push_back(static_cast<WCHAR>(0xE9));
+  str += "xyz"_W;
+
+  const auto utf8 = Encode(str);
+  ASSERT_EQ(utf8.size(), 21u);
+  EXPECT_EQ(utf8[16], 0xC3);
+  EXPECT_EQ(utf8[17], 0xA9);
+  EXPECT_EQ(utf8[20], 'z');
+}
+
+TEST(MessagePackWriterTest, UsesSmallestIntegerEncoding) {
+  MessagePackWriter writer;
+  writer.WriteUInt64(0);
+  writer.WriteUInt64(127);
+  writer.WriteUInt64(128);
+  writer.WriteUInt64(256);
+  writer.WriteInt64(-1);
+  writer.WriteInt64(-33);
+  writer.WriteUInt64(0x100000000ULL);
+
+  const std::vector<uint8_t> expected = {
+      0x00, 0x7F, 0xCC, 0x80, 0xCD, 0x01, 0x00, 0xFF, 0xD0, 0xDF,
+      0xCF, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00};
+  EXPECT_EQ(Bytes(writer), expected);
+}
+
+TEST(MessagePackWriterTest, WritesDoubles) {
+  MessagePackWriter writer;
+  writer.WriteDouble(1.0);
+
+  const std::vector<uint8_t> expected = {0xCB, 0x3F, 0xF0, 0x00, 0x00,
+                                         0x00, 0x00, 0x00, 0x00};
+  EXPECT_EQ(Bytes(writer), expected);
+}
+
+TEST(MessagePackWriterTest, PicksStringHeaderFromEncodedLength) {
+  MessagePackWriter writer;
+
+  // 31 bytes fit in a fixstr, although 31 UTF-16 chars could take 93 bytes
+  writer.WriteString(WSTRING(31, 'a'_W).data(), 31);
+  EXPECT_EQ(writer.Size(), 32u);
+  EXPECT_EQ(writer.Data()[0], 0xA0 | 31);
+
+  writer.Clear();
+  writer.WriteString(WSTRING(32, 'a'_W).data(), 32);
+  EXPECT_EQ(writer.Size(), 34u);
+  EXPECT_EQ(writer.Data()[0], 0xD9);
+  EXPECT_EQ(writer.Data()[1], 32);
+}
+
+TEST(TraceSerializerTest, SerializesSpan) {
+  const auto name = "op"_W;
+
+  NativeSpan span{};
+  span.trace_id = 1;
+  span.span_id = 2;
+  span.start = 3;
+  span.duration = 4;
+  span.name = ToNative(name);
+
+  const int32_t trace_sizes[] = {1};
+
+  TraceSerializer serializer;
+  ASSERT_TRUE(serializer.Serialize(&span, trace_sizes, 1));
+
+  MessagePackWriter expected;
+  expected.WriteArrayHeader(1);
+  expected.WriteArrayHeader(1);
+  expected.WriteMapHeader(8);
+  expected.WriteString("trace_id", 8);
+  expected.WriteUInt64(1);
+  expected.WriteString("span_id", 7);
+  expected.WriteUInt64(2);
+  expected.WriteString("name", 4);
+  expected.WriteString("op", 2);
+  expected.WriteString("resource", 8);
+  expected.WriteNil();
+  expected.WriteString("service", 7);
+  expected.WriteNil();
+  expected.WriteString("type", 4);
+  expected.WriteNil();
+  expected.WriteString("start", 5);
+  expected.WriteInt64(3);
+  expected.WriteString("duration", 8);
+  expected.WriteInt64(4);
+
+  EXPECT_EQ(std::vector<uint8_t>(serializer.Data(),
+                                 serializer.Data() + serializer.Size()),
+            Bytes(expected));
+}
+
+TEST(TraceSerializerTest, DeduplicatedStringsMatchFreshEncoding) {
+  const auto shared = "web-service"_W;
+  const auto copy1 = "web-service"_W;
+  const auto copy2 = "web-service"_W;
+  const auto key = "http.method"_W;
+  const auto value = "GET"_W;
+
+  const NativeTag tags[] = {{ToNative(key), ToNative(value)}};
+
+  NativeSpan spans[2] = {};
+  for (auto& span : spans) {
+    span.trace_id = 42;
+    span.span_id = 7;
+    span.parent_id = 6;
+    span.error = 1;
+    span.tags = tags;
+    span.tag_count = 1;
+  }
+
+  const int32_t trace_sizes[] = {2};
+  TraceSerializer serializer;
+
+  // same pointer twice: the second one is copied from the first
+  spans[0].service = ToNative(shared);
+  spans[1].service = ToNative(shared);
+  ASSERT_TRUE(serializer.Serialize(spans, trace_sizes, 1));
+  const std::vector<uint8_t> deduplicated(
+      serializer.Data(), serializer.Data() + serializer.Size());
+
+  // distinct pointers: both are encoded
+  spans[0].service = ToNative(copy1);
+  spans[1].service = ToNative(copy2);
+  ASSERT_TRUE(serializer.Serialize(spans, trace_sizes, 1));
+  const std::vector<uint8_t> fresh(serializer.Data(),
+                                   serializer.Data() + serializer.Size());
+
+  EXPECT_EQ(deduplicated, fresh);
+}
+
+TEST(TraceSerializerTest, RejectsInvalidInput) {
+  TraceSerializer serializer;
+  const int32_t negative[] = {-1};
+  EXPECT_FALSE(serializer.Serialize(nullptr, negative, 1));
+  EXPECT_FALSE(serializer.Serialize(nullptr, nullptr, 1));
+
+  NativeSpan span{};
+  span.tag_count = 1;
+  const int32_t one[] = {1};
+  EXPECT_FALSE(serializer.Serialize(&span, one, 1));
+  EXPECT_EQ(serializer.Size(), 0u);
+}
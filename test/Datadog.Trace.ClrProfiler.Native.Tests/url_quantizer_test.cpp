@@ -0,0 +1,120 @@
+#include "pch.h"
+
+#include <vector>
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/url_quantizer.h"
+
+using namespace trace;
+
+namespace {
+
+WSTRING Quantize(WSTRING url) {
+  url.resize(QuantizeUrl(&url[0], url.length()));
+  return url;
+}
+
+WSTRING Quantize(UrlQuantizationCache& cache, WSTRING url) {
+  url.resize(cache.Quantize(&url[0], url.length()));
+  return url;
+}
+
+struct UrlCase {
+  WSTRING url;
+  WSTRING expected;
+};
+
+}  // namespace
+
+TEST(UrlQuantizerTest, ReplacesIds) {
+  const std::vector<UrlCase> cases = {
+      {"/users/42"_W, "/users/?"_W},
+      {"/users/42/orders/7"_W, "/users/?/orders/?"_W},
+      {"/orders/3f2504e0-4f89-11d3-9a0c-0305e82c3301/items"_W,
+       "/orders/?/items"_W},
+      {"/orders/3F2504E04F8911D39A0C0305E82C3301"_W, "/orders/?"_W},
+      {"/commits/a1b2c3d4e5f6"_W, "/commits/?"_W},
+      {"/v2/deadbeef/abc123"_W, "/v2/deadbeef/abc123"_W},
+      {"/files/report-2020.pdf"_W, "/files/report-2020.pdf"_W},
+      {"/"_W, "/"_W},
+      {""_W, ""_W},
+  };
+
+  for (const auto& test : cases) {
+    EXPECT_EQ(test.expected, Quantize(test.url)) << ToString(test.url);
+  }
+}
+
+TEST(UrlQuantizerTest, StripsQueryAndLowercases) {
+  const std::vector<UrlCase> cases = {
+      {"/Search?q=Shoes&page=2"_W, "/search"_W},
+      {"/Docs/Intro#Section-2"_W, "/docs/intro"_W},
+      {"/API/Users/15/"_W, "/api/users/?/"_W},
+      {"/café/MENU"_W, "/café/menu"_W},
+      {"?only=query"_W, ""_W},
+  };
+
+  for (const auto& test : cases) {
+    EXPECT_EQ(test.expected, Quantize(test.url)) << ToString(test.url);
+  }
+}
+
+TEST(UrlQuantizerTest, KeepsAuthorityOfAbsoluteUrls) {
+  const std::vector<UrlCase> cases = {
+      {"HTTP://Example.COM:8080/Users/42?x=1"_W,
+       "http://example.com:8080/users/?"_W},
+      {"https://api.example.com"_W, "https://api.example.com"_W},
+      {"https://10.0.0.1/items/99"_W, "https://10.0.0.1/items/?"_W},
+      // only a scheme before the first '/' counts
+      {"/redirect/http://x/1"_W, "/redirect/http://x/?"_W},
+  };
+
+  for (const auto& test : cases) {
+    EXPECT_EQ(test.expected, Quantize(test.url)) << ToString(test.url);
+  }
+}
+
+TEST(UrlQuantizerTest, CachesQuantizedUrls) {
+  UrlQuantizationCache cache;
+
+  for (int i = 0; i < 3; i++) {
+    EXPECT_EQ("/users/?"_W, Quantize(cache, "/Users/42?x=1"_W));
+  }
+
+  EXPECT_EQ(1u, cache.Misses());
+  EXPECT_EQ(2u, cache.Hits());
+}
+
+TEST(UrlQuantizerTest, CacheEvictsLeastRecentlyUsed) {
+  UrlQuantizationCache cache;
+  const auto url = [](size_t i) {
+    return "/items/"_W + ToWSTRING(std::to_string(i)) + "/Detail"_W;
+  };
+
+  for (size_t i = 0; i < kUrlCacheCapacity; i++) {
+    EXPECT_EQ("/items/?/detail"_W, Quantize(cache, url(i)));
+  }
+  EXPECT_EQ(kUrlCacheCapacity, cache.Misses());
+
+  // touch the first entry so the second one becomes the oldest
+  Quantize(cache, url(0));
+  EXPECT_EQ(1u, cache.Hits());
+
+  Quantize(cache, url(kUrlCacheCapacity));
+  EXPECT_EQ(kUrlCacheCapacity + 1, cache.Misses());
+
+  Quantize(cache, url(0));
+  EXPECT_EQ(2u, cache.Hits());
+
+  Quantize(cache, url(1));
+  EXPECT_EQ(kUrlCacheCapacity + 2, cache.Misses());
+}
+
+TEST(UrlQuantizerTest, DoesNotCacheLongUrls) {
+  UrlQuantizationCache cache;
+  const WSTRING url = "/"_W + WSTRING(kMaxCachedUrlLength, 'a') + "/1"_W;
+
+  Quantize(cache, url);
+  EXPECT_EQ("/"_W + WSTRING(kMaxCachedUrlLength, 'a') + "/?"_W,
+            Quantize(cache, url));
+  EXPECT_EQ(0u, cache.Hits() + cache.Misses());
+}
@@ -0,0 +1,93 @@
+#include "pch.h"
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/util.h"
+#include "../../src/Datadog.Trace.ClrProfiler.Native/wildcard_automaton.h"
+
+using namespace trace;
+
+namespace {
+
+std::vector<uint32_t> Match(const WildcardAutomaton& automaton,
+                            const WSTRING& text) {
+  return automaton.Matches(automaton.Run(automaton.Start(), text));
+}
+
+}  // namespace
+
+TEST(WildcardAutomatonTest, MatchesAllPatternsAtOnce) {
+  WildcardAutomaton automaton;
+  const auto repository = automaton.Add("MyCompany.Data.*Repository"_W);
+  const auto any_data = automaton.Add("MyCompany.Data.*"_W);
+  const auto exact = automaton.Add("MyCompany.Data.UserRepository"_W);
+  const auto single = automaton.Add("MyCompany.Data.?"_W);
+  ASSERT_TRUE(automaton.Compile());
+
+  EXPECT_EQ(std::vector<uint32_t>({repository, any_data, exact}),
+            Match(automaton, "MyCompany.Data.UserRepository"_W));
+  EXPECT_EQ(std::vector<uint32_t>({repository, any_data}),
+            Match(automaton, "MyCompany.Data.Repository"_W));
+  EXPECT_EQ(std::vector<uint32_t>({any_data, single}),
+            Match(automaton, "MyCompany.Data.X"_W));
+  EXPECT_EQ(std::vector<uint32_t>({any_data}),
+            Match(automaton, "MyCompany.Data.UserRepositoryFactory"_W));
+  EXPECT_TRUE(Match(automaton, "MyCompany.Web.UserRepository"_W).empty());
+  EXPECT_TRUE(Match(automaton, ""_W).empty());
+}
+
+TEST(WildcardAutomatonTest, AgreesWithWildcardMatch) {
+  const std::vector<WSTRING> patterns = {
+      "*"_W,      "a*"_W,    "*a"_W,     "a*b*c"_W, "?b*"_W,
+      "*ab*ab*"_W, "a?c"_W,  "**b"_W,    "abc"_W,   "é*"_W};
+  const std::vector<WSTRING> texts = {
+      ""_W,    "a"_W,    "b"_W,      "abc"_W,  "aXbYc"_W, "abab"_W,
+      "xabab"_W, "abb"_W, "cba"_W,   "bb"_W,   "été"_W};
+
+  WildcardAutomaton automaton;
+  for (const auto& pattern : patterns) {
+    automaton.Add(pattern);
+  }
+  ASSERT_TRUE(automaton.Compile());
+
+  for (const auto& text : texts) {
+    const auto state = automaton.Run(automaton.Start(), text);
+    for (uint32_t id = 0; id < patterns.size(); id++) {
+      EXPECT_EQ(WildcardMatch(patterns[id], text), automaton.Matches(state, id))
+          << ToString(patterns[id]) << " " << ToString(text);
+    }
+  }
+}
+
+TEST(WildcardAutomatonTest, WildcardsDontMatchTheSeparator) {
+  WildcardAutomaton automaton;
+  const auto id = automaton.Add("*Repository\nExecute*Async"_W);
+  ASSERT_TRUE(automaton.Compile('\n'_W));
+
+  EXPECT_EQ(std::vector<uint32_t>({id}),
+            Match(automaton, "Data.UserRepository\nExecuteQueryAsync"_W));
+  EXPECT_TRUE(
+      Match(automaton, "Repository\nExecute\nRepository\nExecuteAsync"_W)
+          .empty());
+  EXPECT_TRUE(Match(automaton, "UserRepository\nExecute"_W).empty());
+}
+
+TEST(WildcardAutomatonTest, SharesIdenticalPatterns) {
+  WildcardAutomaton automaton;
+  EXPECT_EQ(automaton.Add("a*"_W), automaton.Add("a*"_W));
+  EXPECT_EQ(1u, automaton.PatternCount());
+}
+
+TEST(WildcardAutomatonTest, GivesUpOnTooManyStates) {
+  WildcardAutomaton automaton;
+  automaton.Add("*a*b*c*d*"_W);
+  automaton.Add("*d*c*b*a*"_W);
+  automaton.Add("*b*d*a*c*"_W);
+  EXPECT_FALSE(automaton.Compile(0, 4));
+  EXPECT_FALSE(automaton.IsCompiled());
+
+  // an uncompiled automaton matches nothing
+  EXPECT_TRUE(Match(automaton, "abcd"_W).empty());
+
+  EXPECT_TRUE(automaton.Compile());
+  EXPECT_EQ(3u, Match(automaton, "abcdcba"_W).size() +
+                    Match(automaton, "bdac"_W).size());
+}